@@ -0,0 +1,34 @@
+#ifndef REDIS_BITMAP_H
+#define REDIS_BITMAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+namespace redis {
+
+// Kernels for the bitmap commands, which treat a string as an array of
+// bits, the most significant bit of each byte first. Where the CPU has
+// AVX2 they run 32 bytes at a time, otherwise 64-bit words at a time (with
+// POPCNT when there is one).
+
+// BITCOUNT: the number of set bits.
+uint64_t countBits(std::string_view bytes);
+
+// BITPOS: the first bit equal to bit between firstBit and lastBit, both
+// included, or -1. The range must lie within bytes.
+int64_t findBit(std::string_view bytes, uint64_t firstBit, uint64_t lastBit,
+                bool bit);
+
+enum class BitOp { And, Or, Xor, Not };
+
+// BITOP: combines sources into out, which holds as many bytes as the
+// longest of them; shorter sources read as zero past their end. Not takes
+// a single source.
+void combineBits(BitOp op, std::span<const std::string_view> sources,
+                 char* out);
+
+}  // namespace redis
+
+#endif  // REDIS_BITMAP_H
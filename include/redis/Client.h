@@ -0,0 +1,96 @@
+#ifndef REDIS_CLIENT_H
+#define REDIS_CLIENT_H
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "redis/Config.h"
+#include "redis/RESPParser.h"
+#include "redis/ReplyBuffer.h"
+
+namespace redis {
+
+// Per-connection state, owned by RedisServer's fd-indexed client table.
+struct Client {
+  Client(int fd, uint64_t id) : fd(fd), id(id) {}
+
+  int fd;
+  // Unique per server; tells a reused fd apart from the client that
+  // issued a forwarded command.
+  uint64_t id;
+
+  // Bytes received but not yet parsed; may end in a partial command that is
+  // completed by a later recv.
+  std::string queryBuf;
+  RESPParser::RequestParser parser;
+
+  // Replies the kernel has not accepted yet, flushed on writability.
+  ReplyBuffer reply;
+
+  // Output buffer limits: which limits apply, and when the unsent output
+  // first reached the soft limit (0 while below it).
+  Config::ClientClass clientClass = Config::ClientClass::Normal;
+  int64_t softLimitSinceMs = 0;
+  // Input is left unread while the client is slow to take its replies;
+  // reading resumes once the output has drained.
+  bool readPaused = false;
+
+  // Threaded I/O hand-off. An I/O thread reads and parses into these; the
+  // main thread runs the commands and then drops parsedBytes of queryBuf.
+  // The argument views point into queryBuf.
+  enum class ReadStatus : uint8_t {
+    Ok,
+    More,  // stopped at the per-batch read budget with input left
+    Closed,
+    ProtocolError,
+  };
+  std::vector<std::string_view> parsedArgs;
+  std::vector<uint32_t> parsedArgc;
+  // Where each parsed command ends in queryBuf.
+  std::vector<size_t> parsedEnds;
+  size_t parsedBytes = 0;
+  ReadStatus readStatus = ReadStatus::Ok;
+  // Queued for the next threaded read batch.
+  bool readQueued = false;
+
+  // Set while a blocking command (BLPOP) waits for data; names the parked
+  // command in the server. Parsing stops meanwhile, and the rest of the
+  // pipeline runs once it is served or times out.
+  uint64_t blockedId = 0;
+
+  // Shard mode: replies still owed by other shards. Parsing stops while
+  // this is non-zero so replies stay in command order.
+  size_t awaitingShards = 0;
+  // Partial replies of a keyspace-wide command, merged once all arrive.
+  std::vector<std::string> shardReplies;
+  // The shard a forwarded blocking command may be parked on, so it can be
+  // withdrawn if the client goes away first. SIZE_MAX when there is none.
+  size_t blockedOnShard = SIZE_MAX;
+
+  // io_uring backend. A submitted send owns `sending` until it completes
+  // while new replies keep collecting in `reply`. The fd is only closed
+  // once no submitted operation refers to the client any more.
+  ReplyBuffer sending;
+  std::vector<iovec> sendIov;
+  msghdr sendMsg{};
+  uint32_t uringOps = 0;
+  bool sendQueued = false;
+  bool sendInFlight = false;
+  bool recvArmed = false;
+  bool closing = false;
+
+  // Every reply byte not yet accepted by the kernel.
+  size_t outputBytes() const {
+    return reply.pendingBytes() + sending.pendingBytes();
+  }
+};
+
+}  // namespace redis
+
+#endif  // REDIS_CLIENT_H
@@ -1,35 +1,147 @@
 #ifndef REDIS_COMMAND_HANDLER_H
 #define REDIS_COMMAND_HANDLER_H
 
+#include <cstdint>
 #include <memory>
+#include <optional>
+#include <span>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 
 namespace redis {
 
+class CommandTable;
 class Config;
+class ReplyBuffer;
+class Set;
 class Storage;
+struct CommandSpec;
 
 class CommandHandler {
  public:
   CommandHandler(std::shared_ptr<Config> config,
                  std::shared_ptr<Storage> storage);
 
-  std::string handleCommand(const std::vector<std::string> &command);
+  using ArgList = std::span<const std::string_view>;
+
+  // Executes one command, appending its reply to out.
+  void handleCommand(ArgList command, ReplyBuffer &out);
+
+  // Left by a blocking command (BLPOP, XREAD) that found nothing to serve
+  // instead of a reply. The server parks the caller and runs the command
+  // again once one of the keys is signalled ready, or replies with a null
+  // array when the timeout passes.
+  struct BlockRequest {
+    std::vector<std::string> keys;
+    int64_t timeoutMs = 0;  // 0 waits forever
+    // The command to run again, when not the one given: XREAD pins "$" to
+    // the IDs it stood for when the caller blocked.
+    std::vector<std::string> args;
+  };
+  std::optional<BlockRequest> takeBlockRequest() {
+    return std::exchange(blockRequest_, std::nullopt);
+  }
+
+  // In --shards mode: which shard's keyspace this handler serves, so SCAN
+  // can hand its cursor on to the next shard.
+  void setShard(size_t shardId, size_t shardCount) {
+    shardId_ = shardId;
+    shardCount_ = shardCount;
+  }
 
  private:
+  friend class CommandTable;
+
+  struct CommandStats {
+    uint64_t calls = 0;
+    uint64_t nanos = 0;
+    uint64_t rejectedCalls = 0;
+  };
+
   std::shared_ptr<Config> config_;
   std::shared_ptr<Storage> storage_;
+  // Indexed like CommandTable::all().
+  std::vector<CommandStats> stats_;
+  size_t shardId_ = 0;
+  size_t shardCount_ = 1;
+  std::optional<BlockRequest> blockRequest_;
+
+  void appendCommandInfo(const CommandSpec &spec, ReplyBuffer &out);
+  void incrementBy(std::string_view key, int64_t delta, ReplyBuffer &out);
+  void push(ArgList args, bool front, ReplyBuffer &out);
+  void pop(ArgList args, bool front, ReplyBuffer &out);
+  void zrange(ArgList args, bool byScore, ReplyBuffer &out);
+  bool findSets(ArgList keys, std::vector<std::optional<Set>> &sets,
+                ReplyBuffer &out);
+  std::string commandStatsInfo() const;
 
-  std::string handlePing();
-  std::string handleEcho(const std::vector<std::string> &args);
-  std::string handleSet(const std::vector<std::string> &args);
-  std::string handleGet(const std::vector<std::string> &args);
-  std::string handleConfig(const std::vector<std::string> &args);
-  std::string handleKeys(const std::vector<std::string> &args);
-  std::string handleInfo(const std::vector<std::string> &args);
-  std::string handleReplconf(const std::vector<std::string> &args);
-  std::string handlePsync(const std::vector<std::string> &args);
+  void handlePing(ArgList args, ReplyBuffer &out);
+  void handleEcho(ArgList args, ReplyBuffer &out);
+  void handleSet(ArgList args, ReplyBuffer &out);
+  void handleGet(ArgList args, ReplyBuffer &out);
+  void handleMget(ArgList args, ReplyBuffer &out);
+  void handleMset(ArgList args, ReplyBuffer &out);
+  void handleMsetnx(ArgList args, ReplyBuffer &out);
+  void handleIncr(ArgList args, ReplyBuffer &out);
+  void handleDecr(ArgList args, ReplyBuffer &out);
+  void handleIncrby(ArgList args, ReplyBuffer &out);
+  void handleDecrby(ArgList args, ReplyBuffer &out);
+  void handleIncrbyfloat(ArgList args, ReplyBuffer &out);
+  void handleSetbit(ArgList args, ReplyBuffer &out);
+  void handleGetbit(ArgList args, ReplyBuffer &out);
+  void handleBitcount(ArgList args, ReplyBuffer &out);
+  void handleBitpos(ArgList args, ReplyBuffer &out);
+  void handleBitop(ArgList args, ReplyBuffer &out);
+  void handlePfadd(ArgList args, ReplyBuffer &out);
+  void handlePfcount(ArgList args, ReplyBuffer &out);
+  void handlePfmerge(ArgList args, ReplyBuffer &out);
+  void handleDel(ArgList args, ReplyBuffer &out);
+  void handleUnlink(ArgList args, ReplyBuffer &out);
+  void handleExists(ArgList args, ReplyBuffer &out);
+  void handleFlush(ArgList args, ReplyBuffer &out);
+  void handleLpush(ArgList args, ReplyBuffer &out);
+  void handleRpush(ArgList args, ReplyBuffer &out);
+  void handleLpop(ArgList args, ReplyBuffer &out);
+  void handleRpop(ArgList args, ReplyBuffer &out);
+  void handleLlen(ArgList args, ReplyBuffer &out);
+  void handleLindex(ArgList args, ReplyBuffer &out);
+  void handleLrange(ArgList args, ReplyBuffer &out);
+  void handleBlpop(ArgList args, ReplyBuffer &out);
+  void handleHset(ArgList args, ReplyBuffer &out);
+  void handleHget(ArgList args, ReplyBuffer &out);
+  void handleHmget(ArgList args, ReplyBuffer &out);
+  void handleHgetall(ArgList args, ReplyBuffer &out);
+  void handleHdel(ArgList args, ReplyBuffer &out);
+  void handleHincrby(ArgList args, ReplyBuffer &out);
+  void handleHlen(ArgList args, ReplyBuffer &out);
+  void handleZadd(ArgList args, ReplyBuffer &out);
+  void handleZincrby(ArgList args, ReplyBuffer &out);
+  void handleZrange(ArgList args, ReplyBuffer &out);
+  void handleZrangebyscore(ArgList args, ReplyBuffer &out);
+  void handleZrank(ArgList args, ReplyBuffer &out);
+  void handleZrem(ArgList args, ReplyBuffer &out);
+  void handleZcard(ArgList args, ReplyBuffer &out);
+  void handleSadd(ArgList args, ReplyBuffer &out);
+  void handleSrem(ArgList args, ReplyBuffer &out);
+  void handleSismember(ArgList args, ReplyBuffer &out);
+  void handleSmembers(ArgList args, ReplyBuffer &out);
+  void handleScard(ArgList args, ReplyBuffer &out);
+  void handleSinter(ArgList args, ReplyBuffer &out);
+  void handleSintercard(ArgList args, ReplyBuffer &out);
+  void handleSunion(ArgList args, ReplyBuffer &out);
+  void handleSdiff(ArgList args, ReplyBuffer &out);
+  void handleXadd(ArgList args, ReplyBuffer &out);
+  void handleXrange(ArgList args, ReplyBuffer &out);
+  void handleXread(ArgList args, ReplyBuffer &out);
+  void handleConfig(ArgList args, ReplyBuffer &out);
+  void handleKeys(ArgList args, ReplyBuffer &out);
+  void handleInfo(ArgList args, ReplyBuffer &out);
+  void handleReplconf(ArgList args, ReplyBuffer &out);
+  void handlePsync(ArgList args, ReplyBuffer &out);
+  void handleCommandInfo(ArgList args, ReplyBuffer &out);
+  void handleScan(ArgList args, ReplyBuffer &out);
 };
 
 }  // namespace redis
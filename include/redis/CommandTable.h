@@ -0,0 +1,70 @@
+#ifndef REDIS_COMMAND_TABLE_H
+#define REDIS_COMMAND_TABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+namespace redis {
+
+class CommandHandler;
+class ReplyBuffer;
+
+enum CommandFlag : uint32_t {
+  kCmdReadonly = 1u << 0,
+  kCmdWrite = 1u << 1,
+  kCmdAdmin = 1u << 2,
+  kCmdBlocking = 1u << 3,
+  // Keyspace-wide: in --shards mode it runs on every shard and the replies
+  // are merged.
+  kCmdAllShards = 1u << 4,
+  // argv[1] is a SCAN cursor; in --shards mode it names the shard to run on.
+  kCmdShardCursor = 1u << 5,
+  // May add data: refused while used memory is over maxmemory and nothing
+  // can be evicted.
+  kCmdDenyOom = 1u << 6,
+};
+
+struct CommandSpec {
+  using Handler = void (CommandHandler::*)(std::span<const std::string_view>,
+                                           ReplyBuffer&);
+  using KeyFinder = std::span<const std::string_view> (*)(
+      std::span<const std::string_view>);
+
+  std::string_view name;
+  // Positive: exact argument count including the name. Negative: minimum.
+  int arity;
+  uint32_t flags;
+  // Key positions in argv (0 = no keys, negative last = counted from end).
+  int firstKey;
+  int lastKey;
+  int keyStep;
+  Handler handler;
+  // Finds the keys of a command whose key positions depend on its other
+  // arguments, like XREAD's after STREAMS (Redis's movablekeys).
+  KeyFinder findKeys = nullptr;
+
+  bool acceptsArgc(size_t argc) const {
+    return arity >= 0 ? argc == static_cast<size_t>(arity)
+                      : argc >= static_cast<size_t>(-arity);
+  }
+};
+
+// Static command table with a case-insensitive perfect hash generated at
+// compile time, so lookup is one hash, one probe and one compare.
+class CommandTable {
+ public:
+  static const CommandSpec* lookup(std::string_view name);
+  static std::span<const CommandSpec> all();
+  static size_t indexOf(const CommandSpec& spec) {
+    return &spec - all().data();
+  }
+
+ private:
+  static const CommandSpec kCommands[];
+};
+
+}  // namespace redis
+
+#endif  // REDIS_COMMAND_TABLE_H
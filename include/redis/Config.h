@@ -1,12 +1,33 @@
 #ifndef REDIS_CONFIG_H
 #define REDIS_CONFIG_H
 
+#include <array>
+#include <chrono>
+#include <cstddef>
 #include <string>
 
+#include "redis/Eviction.h"
+
 namespace redis {
 
 class Config {
  public:
+  enum class IOBackend { Epoll, Uring };
+
+  // Clients whose output buffers are limited separately.
+  enum class ClientClass { Normal, Replica };
+
+  // A client is disconnected once its unsent output reaches hardBytes, or
+  // stays at or above softBytes for softSeconds. Zero disables a limit.
+  struct OutputBufferLimit {
+    size_t hardBytes;
+    size_t softBytes;
+    std::chrono::seconds softSeconds;
+  };
+
+  static constexpr int kMaxIOThreads = 128;
+  static constexpr int kMaxShards = 256;
+
   Config();
 
   void parseArgs(int argc, char** argv);
@@ -19,12 +40,82 @@ class Config {
   const std::string& getMasterHost() const { return masterHost_; }
   int getMasterPort() const { return masterPort_; }
 
+  // Longest a serverCron expire cycle may run before yielding to clients.
+  std::chrono::microseconds getActiveExpireBudget() const {
+    return activeExpireBudget_;
+  }
+
+  // Threads doing socket I/O and parsing, including the main thread.
+  int getIOThreads() const { return ioThreads_; }
+
+  // Shared-nothing event loops; 1 is the classic single loop and 0 means
+  // one per core.
+  int getShards() const { return shards_; }
+
+  // Readiness (epoll) or completion (io_uring) based networking.
+  IOBackend getIOBackend() const { return ioBackend_; }
+
+  // Free large expired values on the lazyfree thread.
+  bool getLazyFreeLazyExpire() const { return lazyFreeLazyExpire_; }
+
+  // A hash leaves the listpack encoding once it holds more fields than
+  // this, or a field or value longer than getHashMaxListpackValue().
+  size_t getHashMaxListpackEntries() const {
+    return hashMaxListpackEntries_;
+  }
+  size_t getHashMaxListpackValue() const { return hashMaxListpackValue_; }
+  // The same for sorted sets, by member count and member length.
+  size_t getZsetMaxListpackEntries() const {
+    return zsetMaxListpackEntries_;
+  }
+  size_t getZsetMaxListpackValue() const { return zsetMaxListpackValue_; }
+  // A set of integers leaves the intset encoding past this many members.
+  size_t getSetMaxIntsetEntries() const { return setMaxIntsetEntries_; }
+
+  // Memory the keyspace may use, 0 for no limit, and what is evicted to
+  // stay under it. In --shards mode each shard gets an equal part.
+  size_t getMaxMemory() const { return maxMemory_; }
+  EvictionPolicy getMaxMemoryPolicy() const { return maxMemoryPolicy_; }
+
+  // Active defrag of the keyspace's slabs: whether it runs, the wasted
+  // bytes below which it does not start, and the least and most CPU, in
+  // percent, each cron tick gives it.
+  bool getActiveDefrag() const { return activeDefrag_; }
+  size_t getActiveDefragIgnoreBytes() const {
+    return activeDefragIgnoreBytes_;
+  }
+  int getActiveDefragCycleMin() const { return activeDefragCycleMin_; }
+  int getActiveDefragCycleMax() const { return activeDefragCycleMax_; }
+
+  const OutputBufferLimit& getOutputBufferLimit(ClientClass cls) const {
+    return outputBufferLimits_[static_cast<size_t>(cls)];
+  }
+
  private:
+  bool parseOutputBufferLimits(const std::string& spec);
+
   std::string dir_;
   std::string dbfilename_;
   int port_;
   std::string masterHost_;
   int masterPort_;
+  std::chrono::microseconds activeExpireBudget_;
+  int ioThreads_;
+  int shards_;
+  IOBackend ioBackend_;
+  bool lazyFreeLazyExpire_;
+  size_t hashMaxListpackEntries_;
+  size_t hashMaxListpackValue_;
+  size_t zsetMaxListpackEntries_;
+  size_t zsetMaxListpackValue_;
+  size_t setMaxIntsetEntries_;
+  size_t maxMemory_;
+  EvictionPolicy maxMemoryPolicy_;
+  bool activeDefrag_;
+  size_t activeDefragIgnoreBytes_;
+  int activeDefragCycleMin_;
+  int activeDefragCycleMax_;
+  std::array<OutputBufferLimit, 2> outputBufferLimits_;
 };
 
 }  // namespace redis
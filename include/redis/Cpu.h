@@ -0,0 +1,34 @@
+#ifndef REDIS_CPU_H
+#define REDIS_CPU_H
+
+// The build targets baseline x86-64, so kernels that want AVX2 or POPCNT
+// are compiled for them one function at a time, with
+// __attribute__((target(...))), and chosen at run time by what the CPU
+// reports. Elsewhere only the portable versions exist.
+#if defined(__x86_64__) && defined(__GNUC__)
+#define REDIS_X86_DISPATCH 1
+#endif
+
+namespace redis {
+
+inline bool cpuHasAvx2() {
+#if defined(REDIS_X86_DISPATCH)
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+#else
+  return false;
+#endif
+}
+
+inline bool cpuHasPopcnt() {
+#if defined(REDIS_X86_DISPATCH)
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("popcnt");
+#else
+  return false;
+#endif
+}
+
+}  // namespace redis
+
+#endif  // REDIS_CPU_H
@@ -0,0 +1,515 @@
+#ifndef REDIS_DICT_H
+#define REDIS_DICT_H
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <new>
+#include <string_view>
+#include <utility>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace redis {
+
+namespace dict_detail {
+
+inline constexpr int8_t kEmpty = -128;  // 0b10000000
+inline constexpr int8_t kDeleted = -2;  // 0b11111110
+inline constexpr size_t kGroupWidth = 16;
+
+// Sixteen control bytes probed together. A full slot stores the low seven
+// bits of its key's hash, so one compare filters a whole group.
+class Group {
+ public:
+#if defined(__SSE2__)
+  explicit Group(const int8_t* ctrl)
+      : ctrl_(_mm_load_si128(reinterpret_cast<const __m128i*>(ctrl))) {}
+
+  uint32_t match(int8_t tag) const {
+    return static_cast<uint32_t>(
+        _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl_, _mm_set1_epi8(tag))));
+  }
+
+  // Empty and deleted both have the high bit set; full slots never do.
+  uint32_t matchEmptyOrDeleted() const {
+    return static_cast<uint32_t>(_mm_movemask_epi8(ctrl_));
+  }
+
+ private:
+  __m128i ctrl_;
+#else
+  explicit Group(const int8_t* ctrl) : ctrl_(ctrl) {}
+
+  uint32_t match(int8_t tag) const {
+    uint32_t mask = 0;
+    for (size_t i = 0; i < kGroupWidth; i++) {
+      mask |= static_cast<uint32_t>(ctrl_[i] == tag) << i;
+    }
+    return mask;
+  }
+
+  uint32_t matchEmptyOrDeleted() const {
+    uint32_t mask = 0;
+    for (size_t i = 0; i < kGroupWidth; i++) {
+      mask |= static_cast<uint32_t>(ctrl_[i] < 0) << i;
+    }
+    return mask;
+  }
+
+ private:
+  const int8_t* ctrl_;
+#endif
+
+ public:
+  uint32_t matchEmpty() const { return match(kEmpty); }
+  uint32_t matchFull() const { return ~matchEmptyOrDeleted() & 0xFFFFu; }
+};
+
+inline uint64_t hashKey(std::string_view key) {
+  return std::hash<std::string_view>{}(key);
+}
+
+inline int8_t tagOf(uint64_t hash) { return static_cast<int8_t>(hash & 0x7F); }
+
+}  // namespace dict_detail
+
+// Open-addressing hash table in the SwissTable layout: a flat array of
+// control bytes probed sixteen at a time, next to a flat array of slots.
+// Lookups take any string_view; Traits::key(const T&) yields a slot's key.
+//
+// Growing never happens all at once. A resize allocates the new table and
+// then moves one group per insert or erase (plus whatever the owner spends
+// in rehashSteps), so latency stays flat while the keyspace grows. Pointers
+// returned by find are invalidated by the next insert or erase.
+template <typename T, typename Traits>
+class Dict {
+ public:
+  Dict() = default;
+  ~Dict() {
+    freeTable(table_);
+    freeTable(rehashFrom_);
+  }
+
+  Dict(const Dict&) = delete;
+  Dict& operator=(const Dict&) = delete;
+
+  Dict(Dict&& other) noexcept { swap(other); }
+  Dict& operator=(Dict&& other) noexcept {
+    Dict(std::move(other)).swap(*this);
+    return *this;
+  }
+
+  void swap(Dict& other) noexcept {
+    std::swap(table_, other.table_);
+    std::swap(rehashFrom_, other.rehashFrom_);
+    std::swap(rehashGroup_, other.rehashGroup_);
+  }
+
+  size_t size() const { return table_.size + rehashFrom_.size; }
+  bool empty() const { return size() == 0; }
+  bool isRehashing() const { return rehashFrom_.capacity != 0; }
+  size_t capacity() const { return table_.capacity + rehashFrom_.capacity; }
+
+  // The hash find and prefetch take, for callers that look up a batch of
+  // keys and want to compute it once.
+  static uint64_t hashOf(std::string_view key) {
+    return dict_detail::hashKey(key);
+  }
+
+  // Pulls the control bytes and first slots of hash's home group into the
+  // cache, so a find issued a little later does not stall on them.
+  void prefetch(uint64_t hash) const {
+    prefetchIn(table_, hash);
+    if (isRehashing()) prefetchIn(rehashFrom_, hash);
+  }
+
+  T* find(std::string_view key) { return find(key, hashOf(key)); }
+
+  T* find(std::string_view key, uint64_t hash) {
+    size_t index = findIn(table_, key, hash);
+    if (index != kNotFound) return &table_.slots[index];
+    if (isRehashing()) {
+      index = findIn(rehashFrom_, key, hash);
+      if (index != kNotFound) return &rehashFrom_.slots[index];
+    }
+    return nullptr;
+  }
+
+  const T* find(std::string_view key) const {
+    return const_cast<Dict*>(this)->find(key);
+  }
+
+  // Returns the slot holding key, constructing it from make() if absent.
+  // The bool is true when a new slot was inserted.
+  template <typename Make>
+  std::pair<T*, bool> findOrInsert(std::string_view key, Make&& make) {
+    rehashStep();
+
+    if (T* existing = find(key)) {
+      return {existing, false};
+    }
+
+    if (table_.growthLeft == 0) {
+      // Finish any resize still in flight before starting the next one; the
+      // pacing below makes this rare.
+      while (isRehashing()) rehashStep();
+      startRehash(capacityFor(size() + 1));
+    }
+
+    uint64_t hash = dict_detail::hashKey(key);
+    size_t index = insertUnique(table_, hash, make());
+    return {&table_.slots[index], true};
+  }
+
+  bool erase(std::string_view key) {
+    rehashStep();
+
+    auto [table, index] = locate(key);
+    if (table == nullptr) return false;
+    eraseAt(*table, index);
+    maybeShrink();
+    return true;
+  }
+
+  // Moves the value out of the table and erases its slot. key may point
+  // into the value itself.
+  template <typename Out>
+  bool extract(std::string_view key, Out& out) {
+    rehashStep();
+
+    auto [table, index] = locate(key);
+    if (table == nullptr) return false;
+    out = std::move(table->slots[index]);
+    eraseAt(*table, index);
+    maybeShrink();
+    return true;
+  }
+
+  template <typename Fn>
+  void forEach(Fn&& fn) {
+    forEachIn(table_, fn);
+    forEachIn(rehashFrom_, fn);
+  }
+
+  template <typename Fn>
+  void forEach(Fn&& fn) const {
+    const_cast<Dict*>(this)->forEach(
+        [&fn](T& slot) { fn(std::as_const(slot)); });
+  }
+
+  // Erases every slot for which pred returns true.
+  template <typename Pred>
+  size_t eraseIf(Pred&& pred) {
+    size_t erased = eraseIfIn(table_, pred) + eraseIfIn(rehashFrom_, pred);
+    if (erased) maybeShrink();
+    return erased;
+  }
+
+  // Visits the entries of one home group per table and returns the cursor of
+  // the next call; a scan is complete when it returns 0. The cursor counts
+  // in reverse binary, as Redis's dictScan does, so every entry present for
+  // the whole scan is visited at least once even if the table is resized
+  // between calls. fn must not modify the table.
+  template <typename Fn>
+  uint64_t scan(uint64_t cursor, Fn&& fn) {
+    if (table_.capacity == 0) return 0;
+
+    if (!isRehashing()) {
+      uint64_t mask = groupMask(table_);
+      visitHomeGroup(table_, cursor & mask, fn);
+      return nextCursor(cursor, mask);
+    }
+
+    // Visit the cursor's group in the smaller table, then every group of
+    // the larger table that expands from it.
+    Table* small = &table_;
+    Table* large = &rehashFrom_;
+    if (small->capacity > large->capacity) std::swap(small, large);
+    uint64_t smallMask = groupMask(*small);
+    uint64_t largeMask = groupMask(*large);
+
+    visitHomeGroup(*small, cursor & smallMask, fn);
+    do {
+      visitHomeGroup(*large, cursor & largeMask, fn);
+      cursor = nextCursor(cursor, largeMask);
+    } while (cursor & (smallMask ^ largeMask));
+    return cursor;
+  }
+
+  void clear() {
+    freeTable(table_);
+    freeTable(rehashFrom_);
+    rehashGroup_ = 0;
+  }
+
+  // Moves up to `groups` groups of the old table into the new one. Returns
+  // true while a resize is still in progress.
+  bool rehashSteps(size_t groups) {
+    // Empty groups are cheap, so allow visiting more of them per step.
+    size_t emptyVisits = groups * 10;
+    size_t numGroups = rehashFrom_.capacity / dict_detail::kGroupWidth;
+
+    while (groups > 0 && rehashGroup_ < numGroups) {
+      size_t base = rehashGroup_ * dict_detail::kGroupWidth;
+      uint32_t full = dict_detail::Group(rehashFrom_.ctrl + base).matchFull();
+      if (full == 0) {
+        rehashGroup_++;
+        if (--emptyVisits == 0) break;
+        continue;
+      }
+
+      for (; full; full &= full - 1) {
+        size_t index = base + std::countr_zero(full);
+        T& slot = rehashFrom_.slots[index];
+        insertUnique(table_, dict_detail::hashKey(Traits::key(slot)),
+                     std::move(slot));
+        std::destroy_at(&slot);
+        // Keep the probe chains of the old table intact for lookups.
+        rehashFrom_.ctrl[index] = dict_detail::kDeleted;
+        rehashFrom_.size--;
+      }
+      rehashGroup_++;
+      groups--;
+    }
+
+    if (isRehashing() && rehashGroup_ >= numGroups) {
+      freeTable(rehashFrom_);
+      rehashGroup_ = 0;
+    }
+    return isRehashing();
+  }
+
+ private:
+  struct Table {
+    int8_t* ctrl = nullptr;
+    T* slots = nullptr;
+    size_t capacity = 0;
+    size_t size = 0;
+    // Inserts left before the table reaches its 7/8 load limit; deleted
+    // slots count against it until the next resize.
+    size_t growthLeft = 0;
+  };
+
+  static constexpr size_t kNotFound = static_cast<size_t>(-1);
+  static constexpr size_t kMinCapacity = dict_detail::kGroupWidth;
+
+  static size_t maxLoad(size_t capacity) { return capacity - capacity / 8; }
+
+  // Smallest table that holds n entries at no more than half its load limit.
+  static size_t capacityFor(size_t n) {
+    size_t capacity = kMinCapacity;
+    while (maxLoad(capacity) < n * 2) capacity *= 2;
+    return capacity;
+  }
+
+  static void allocateTable(Table& table, size_t capacity) {
+    size_t ctrlBytes = (capacity + alignof(T) - 1) / alignof(T) * alignof(T);
+    void* memory = ::operator new(ctrlBytes + capacity * sizeof(T),
+                                  std::align_val_t(dict_detail::kGroupWidth));
+    table.ctrl = static_cast<int8_t*>(memory);
+    table.slots = reinterpret_cast<T*>(static_cast<char*>(memory) + ctrlBytes);
+    table.capacity = capacity;
+    table.size = 0;
+    table.growthLeft = maxLoad(capacity);
+    std::fill_n(table.ctrl, capacity, dict_detail::kEmpty);
+  }
+
+  static void freeTable(Table& table) {
+    if (table.capacity == 0) return;
+    forEachIn(table, [](T& slot) { std::destroy_at(&slot); });
+    ::operator delete(table.ctrl, std::align_val_t(dict_detail::kGroupWidth));
+    table = Table();
+  }
+
+  template <typename Fn>
+  static void forEachIn(Table& table, Fn&& fn) {
+    for (size_t g = 0; g < table.capacity; g += dict_detail::kGroupWidth) {
+      uint32_t full = dict_detail::Group(table.ctrl + g).matchFull();
+      for (; full; full &= full - 1) {
+        fn(table.slots[g + std::countr_zero(full)]);
+      }
+    }
+  }
+
+  template <typename Pred>
+  static size_t eraseIfIn(Table& table, Pred&& pred) {
+    size_t erased = 0;
+    for (size_t g = 0; g < table.capacity; g += dict_detail::kGroupWidth) {
+      uint32_t full = dict_detail::Group(table.ctrl + g).matchFull();
+      for (; full; full &= full - 1) {
+        size_t index = g + std::countr_zero(full);
+        if (pred(table.slots[index])) {
+          eraseAt(table, index);
+          erased++;
+        }
+      }
+    }
+    return erased;
+  }
+
+  // Triangular probing over groups visits every group of a power-of-two
+  // table exactly once.
+  class ProbeSeq {
+   public:
+    ProbeSeq(const Table& table, uint64_t hash)
+        : mask_(table.capacity / dict_detail::kGroupWidth - 1),
+          group_((hash >> 7) & mask_) {}
+
+    size_t offset() const { return group_ * dict_detail::kGroupWidth; }
+    void next() { group_ = (group_ + ++step_) & mask_; }
+    bool exhausted() const { return step_ > mask_; }
+
+   private:
+    size_t mask_;
+    size_t group_;
+    size_t step_ = 0;
+  };
+
+  // The table and slot holding key, or a null table.
+  std::pair<Table*, size_t> locate(std::string_view key) {
+    uint64_t hash = dict_detail::hashKey(key);
+    size_t index = findIn(table_, key, hash);
+    if (index != kNotFound) return {&table_, index};
+    if (isRehashing()) {
+      index = findIn(rehashFrom_, key, hash);
+      if (index != kNotFound) return {&rehashFrom_, index};
+    }
+    return {nullptr, kNotFound};
+  }
+
+  static void prefetchIn(const Table& table, uint64_t hash) {
+    if (table.size == 0) return;
+    size_t base = homeGroup(table, hash) * dict_detail::kGroupWidth;
+    __builtin_prefetch(table.ctrl + base);
+    __builtin_prefetch(table.slots + base);
+  }
+
+  static size_t findIn(const Table& table, std::string_view key,
+                       uint64_t hash) {
+    if (table.size == 0) return kNotFound;
+    int8_t tag = dict_detail::tagOf(hash);
+
+    for (ProbeSeq seq(table, hash); !seq.exhausted(); seq.next()) {
+      size_t base = seq.offset();
+      dict_detail::Group group(table.ctrl + base);
+      for (uint32_t match = group.match(tag); match; match &= match - 1) {
+        size_t index = base + std::countr_zero(match);
+        if (Traits::key(table.slots[index]) == key) return index;
+      }
+      // An empty slot ends the chain: the key would have been placed here.
+      if (group.matchEmpty()) return kNotFound;
+    }
+    return kNotFound;
+  }
+
+  static uint64_t groupMask(const Table& table) {
+    return table.capacity / dict_detail::kGroupWidth - 1;
+  }
+
+  static uint64_t homeGroup(const Table& table, uint64_t hash) {
+    return (hash >> 7) & groupMask(table);
+  }
+
+  // Increments the bits of cursor covered by mask in reverse order.
+  static uint64_t nextCursor(uint64_t cursor, uint64_t mask) {
+    cursor |= ~mask;
+    cursor = reverseBits(cursor);
+    cursor++;
+    return reverseBits(cursor);
+  }
+
+  static uint64_t reverseBits(uint64_t v) {
+    v = ((v >> 1) & 0x5555555555555555ull) | ((v & 0x5555555555555555ull) << 1);
+    v = ((v >> 2) & 0x3333333333333333ull) | ((v & 0x3333333333333333ull) << 2);
+    v = ((v >> 4) & 0x0F0F0F0F0F0F0F0Full) | ((v & 0x0F0F0F0F0F0F0F0Full) << 4);
+    return __builtin_bswap64(v);
+  }
+
+  // Entries whose home is group `home` sit on its probe sequence no later
+  // than the first group with an empty slot, so a short walk finds them all.
+  template <typename Fn>
+  static void visitHomeGroup(Table& table, uint64_t home, Fn& fn) {
+    if (table.size == 0) return;
+
+    uint64_t hash = home << 7;
+    for (ProbeSeq seq(table, hash); !seq.exhausted(); seq.next()) {
+      size_t base = seq.offset();
+      dict_detail::Group group(table.ctrl + base);
+      for (uint32_t full = group.matchFull(); full; full &= full - 1) {
+        T& slot = table.slots[base + std::countr_zero(full)];
+        if (homeGroup(table, dict_detail::hashKey(Traits::key(slot))) ==
+            home) {
+          fn(slot);
+        }
+      }
+      if (group.matchEmpty()) return;
+    }
+  }
+
+  static size_t insertUnique(Table& table, uint64_t hash, T&& value) {
+    size_t index = kNotFound;
+    for (ProbeSeq seq(table, hash); index == kNotFound; seq.next()) {
+      size_t base = seq.offset();
+      uint32_t free =
+          dict_detail::Group(table.ctrl + base).matchEmptyOrDeleted();
+      if (free) index = base + std::countr_zero(free);
+    }
+
+    if (table.ctrl[index] == dict_detail::kEmpty) {
+      table.growthLeft--;
+    }
+    table.ctrl[index] = dict_detail::tagOf(hash);
+    std::construct_at(&table.slots[index], std::move(value));
+    table.size++;
+    return index;
+  }
+
+  static void eraseAt(Table& table, size_t index) {
+    std::destroy_at(&table.slots[index]);
+    size_t base = index & ~(dict_detail::kGroupWidth - 1);
+    // If the group already has an empty slot no probe chain runs through
+    // it, so the slot can become empty again; otherwise leave a tombstone.
+    if (dict_detail::Group(table.ctrl + base).matchEmpty()) {
+      table.ctrl[index] = dict_detail::kEmpty;
+      table.growthLeft++;
+    } else {
+      table.ctrl[index] = dict_detail::kDeleted;
+    }
+    table.size--;
+  }
+
+  void startRehash(size_t capacity) {
+    rehashFrom_ = table_;
+    rehashGroup_ = 0;
+    allocateTable(table_, capacity);
+    if (rehashFrom_.size == 0) {
+      freeTable(rehashFrom_);
+    }
+  }
+
+  void rehashStep() {
+    if (isRehashing()) rehashSteps(1);
+  }
+
+  void maybeShrink() {
+    if (isRehashing() || table_.capacity <= kMinCapacity) return;
+    if (table_.size < maxLoad(table_.capacity) / 8) {
+      startRehash(capacityFor(table_.size));
+    }
+  }
+
+  Table table_;
+  // The previous table while a resize is in progress; empty otherwise.
+  Table rehashFrom_;
+  size_t rehashGroup_ = 0;
+};
+
+}  // namespace redis
+
+#endif  // REDIS_DICT_H
@@ -0,0 +1,256 @@
+#ifndef REDIS_ENTRY_H
+#define REDIS_ENTRY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace redis {
+
+class HashTable;
+class IntSet;
+class Listpack;
+class Quicklist;
+class SetTable;
+class SkipListSet;
+class Stream;
+
+// Values are immutable and shared so a reply can reference them while the
+// key is overwritten or deleted.
+using SharedValue = std::shared_ptr<const std::string>;
+
+enum class ValueType : uint8_t {
+  String = 0,
+  List = 1,
+  Hash = 2,
+  ZSet = 3,
+  Stream = 4,
+  Set = 5,
+};
+
+inline constexpr ValueType kValueTypes[] = {ValueType::String, ValueType::List,
+                                            ValueType::Hash, ValueType::ZSet,
+                                            ValueType::Stream, ValueType::Set};
+
+// The name TYPE reports and SCAN ... TYPE filters on.
+constexpr std::string_view typeName(ValueType type) {
+  switch (type) {
+    case ValueType::String:
+      return "string";
+    case ValueType::List:
+      return "list";
+    case ValueType::Hash:
+      return "hash";
+    case ValueType::ZSet:
+      return "zset";
+    case ValueType::Stream:
+      return "stream";
+    case ValueType::Set:
+      return "set";
+  }
+  return "none";
+}
+
+enum class Encoding : uint8_t {
+  Int = 0,        // string holding a canonical 64-bit integer
+  Embedded = 1,   // short string stored inside the entry
+  Raw = 2,        // longer string in a shared heap buffer
+  Quicklist = 3,  // list owned through a pointer in the payload
+  Listpack = 4,   // small hash or sorted set packed into the payload
+  HashTable = 5,  // hash owned through a pointer in the payload
+  SkipList = 6,   // sorted set owned through a pointer in the payload
+  Stream = 7,     // stream owned through a pointer in the payload
+  IntSet = 8,     // set of integers packed into the payload
+  SetTable = 9,   // set owned through a pointer in the payload
+};
+
+// One keyspace entry in a single allocation: an 8-byte tagged header, the
+// expiry only when the key has one, the value payload and the key bytes.
+//
+//   [header][expireAt?][payload][key]
+//
+// Integers and short strings live in the payload itself, so a typical small
+// key costs one allocation instead of a table node plus two strings. The
+// allocation comes from the thread's SlabAllocator.
+class Entry {
+ public:
+  // Longest value stored inline with the key.
+  static constexpr size_t kMaxEmbeddedLength = 64;
+  // Longest key: the header keeps its length in 24 bits, next to the
+  // access bits eviction reads. Callers reject longer ones first.
+  static constexpr size_t kMaxKeyLength = (size_t{1} << 24) - 1;
+
+  static Entry* createString(std::string_view key, std::string_view value,
+                             std::optional<int64_t> expireAtMs);
+  static Entry* createInteger(std::string_view key, int64_t value,
+                              std::optional<int64_t> expireAtMs);
+  // Always Encoding::Raw, whatever the value, for strings edited in place.
+  static Entry* createRawString(std::string_view key, std::string_view value,
+                                std::optional<int64_t> expireAtMs);
+  // An empty list; the entry owns it.
+  static Entry* createList(std::string_view key,
+                           std::optional<int64_t> expireAtMs);
+  // An empty hash, in the listpack encoding.
+  static Entry* createHash(std::string_view key,
+                           std::optional<int64_t> expireAtMs);
+  // An empty sorted set, in the listpack encoding.
+  static Entry* createSortedSet(std::string_view key,
+                                std::optional<int64_t> expireAtMs);
+  // An empty stream.
+  static Entry* createStream(std::string_view key,
+                             std::optional<int64_t> expireAtMs);
+  // An empty set, in the intset encoding.
+  static Entry* createSet(std::string_view key,
+                          std::optional<int64_t> expireAtMs);
+  static void destroy(Entry* entry);
+  // Moves an entry to a new allocation and frees the old one, for active
+  // defrag. The caller repoints whatever referred to the old entry.
+  static Entry* relocate(Entry* entry);
+
+  Entry(const Entry&) = delete;
+  Entry& operator=(const Entry&) = delete;
+
+  std::string_view key() const {
+    return std::string_view(reinterpret_cast<const char*>(this) + keyOffset(),
+                            keyLength_);
+  }
+
+  ValueType type() const { return static_cast<ValueType>(type_); }
+  Encoding encoding() const { return static_cast<Encoding>(encoding_); }
+
+  bool hasExpiry() const { return hasExpiry_; }
+  int64_t expireAtMs() const { return hasExpiry() ? *expirySlot() : -1; }
+  bool isExpired(int64_t nowMs) const {
+    return hasExpiry() && nowMs >= *expirySlot();
+  }
+
+  // Payload accessors; the caller checks encoding() first.
+  int64_t intValue() const { return *payloadAs<int64_t>(); }
+  // Counters are updated where they stand, with no new entry.
+  void setIntValue(int64_t value) { *payloadAs<int64_t>() = value; }
+  std::string_view embeddedValue() const {
+    return std::string_view(payloadAs<char>(), embeddedLength_);
+  }
+  const SharedValue& rawValue() const { return *payloadAs<SharedValue>(); }
+  // The raw string to write to, as SETBIT and PFADD do. A value a pending
+  // reply still references is copied first, so the reply keeps the bytes
+  // it was given.
+  std::string& mutableRawValue();
+  // Unlike strings, lists are modified in place.
+  Quicklist& listValue() { return **payloadAs<Quicklist*>(); }
+  const Quicklist& listValue() const { return **payloadAs<Quicklist*>(); }
+  Listpack& listpackValue() { return *payloadAs<Listpack>(); }
+  const Listpack& listpackValue() const { return *payloadAs<Listpack>(); }
+  HashTable& hashTableValue() { return **payloadAs<HashTable*>(); }
+  const HashTable& hashTableValue() const {
+    return **payloadAs<HashTable*>();
+  }
+  // Moves a hash from the listpack to the table encoding. Both fit the
+  // same payload, so the entry stays where it is.
+  void convertToHashTable(std::unique_ptr<HashTable> table);
+  SkipListSet& skipListValue() { return **payloadAs<SkipListSet*>(); }
+  const SkipListSet& skipListValue() const {
+    return **payloadAs<SkipListSet*>();
+  }
+  // The same for a sorted set.
+  void convertToSkipList(std::unique_ptr<SkipListSet> set);
+  Stream& streamValue() { return **payloadAs<Stream*>(); }
+  const Stream& streamValue() const { return **payloadAs<Stream*>(); }
+  IntSet& intSetValue() { return *payloadAs<IntSet>(); }
+  const IntSet& intSetValue() const { return *payloadAs<IntSet>(); }
+  SetTable& setTableValue() { return **payloadAs<SetTable*>(); }
+  const SetTable& setTableValue() const { return **payloadAs<SetTable*>(); }
+  // The same for a set leaving its intset.
+  void convertToSetTable(std::unique_ptr<SetTable> table);
+
+  // Bytes owned by this entry, including the shared buffer of a raw value
+  // and the nodes of a collection.
+  size_t memoryUsage() const;
+  // Bytes of the entry's own allocation, without what the payload owns.
+  size_t allocationSize() const { return keyOffset() + keyLength_; }
+
+  // The LRU clock or LFU counter of the last access; see access::.
+  uint32_t access() const { return access_; }
+  void setAccess(uint32_t bits) { access_ = bits; }
+
+  // Set by Storage while the entry may be growing under a handle it gave
+  // out, so that its memory accounting is settled later.
+  bool unsettled() const { return unsettled_; }
+  void setUnsettled(bool unsettled) { unsettled_ = unsettled; }
+
+ private:
+  Entry() = default;
+
+  static Entry* allocate(std::string_view key, ValueType type,
+                         Encoding encoding, size_t payloadSize,
+                         std::optional<int64_t> expireAtMs);
+  static size_t payloadSizeFor(Encoding encoding, size_t embeddedLength);
+
+  size_t payloadOffset() const {
+    return sizeof(Entry) + (hasExpiry() ? sizeof(int64_t) : 0);
+  }
+  size_t keyOffset() const {
+    return payloadOffset() + payloadSizeFor(encoding(), embeddedLength_);
+  }
+
+  const int64_t* expirySlot() const {
+    return reinterpret_cast<const int64_t*>(this + 1);
+  }
+  int64_t* expirySlot() { return reinterpret_cast<int64_t*>(this + 1); }
+
+  template <typename T>
+  const T* payloadAs() const {
+    return reinterpret_cast<const T*>(reinterpret_cast<const char*>(this) +
+                                      payloadOffset());
+  }
+  template <typename T>
+  T* payloadAs() {
+    return reinterpret_cast<T*>(reinterpret_cast<char*>(this) +
+                                payloadOffset());
+  }
+
+  uint64_t type_ : 3;
+  uint64_t encoding_ : 4;
+  uint64_t hasExpiry_ : 1;
+  uint64_t embeddedLength_ : 7;
+  uint64_t unsettled_ : 1;
+  uint64_t access_ : 24;
+  uint64_t keyLength_ : 24;
+};
+
+static_assert(sizeof(Entry) == 8, "entry header must stay at 8 bytes");
+static_assert(Entry::kMaxEmbeddedLength < 128,
+              "embedded length must fit its 7 bits");
+
+struct EntryDeleter {
+  void operator()(Entry* entry) const { Entry::destroy(entry); }
+};
+
+using EntryPtr = std::unique_ptr<Entry, EntryDeleter>;
+
+// A string value copied out of an entry without allocating: integers are
+// formatted into a small buffer, short strings are copied, and long strings
+// share the stored buffer.
+class StringValue {
+ public:
+  explicit StringValue(const Entry& entry);
+
+  std::string_view view() const {
+    return shared_ ? std::string_view(*shared_)
+                   : std::string_view(inline_, inlineLength_);
+  }
+  // Owner of view()'s bytes when they live outside this object.
+  const SharedValue& shared() const { return shared_; }
+
+ private:
+  char inline_[Entry::kMaxEmbeddedLength];
+  size_t inlineLength_ = 0;
+  SharedValue shared_;
+};
+
+}  // namespace redis
+
+#endif  // REDIS_ENTRY_H
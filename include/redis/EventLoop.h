@@ -0,0 +1,58 @@
+#ifndef REDIS_EVENT_LOOP_H
+#define REDIS_EVENT_LOOP_H
+
+#include <sys/epoll.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace redis {
+
+// Thin wrapper around an edge-triggered epoll instance. The loop only
+// reports which descriptors are ready; dispatching is left to the owner,
+// which keeps its per-fd state in a flat table.
+class EventLoop {
+ public:
+  static constexpr uint32_t kReadable = 1u << 0;
+  static constexpr uint32_t kWritable = 1u << 1;
+  static constexpr uint32_t kHangup = 1u << 2;
+
+  struct Event {
+    int fd;
+    uint32_t mask;
+  };
+
+  EventLoop();
+  ~EventLoop();
+
+  EventLoop(const EventLoop&) = delete;
+  EventLoop& operator=(const EventLoop&) = delete;
+
+  bool init();
+
+  // Registers fd for edge-triggered notifications on the given mask.
+  bool addFd(int fd, uint32_t mask);
+  bool modifyFd(int fd, uint32_t mask);
+  void removeFd(int fd);
+
+  // Creates a periodic timerfd that fires every intervalMs and registers it
+  // with the loop. Returns the timer fd, or -1 on failure.
+  int addTimer(int intervalMs);
+  // The unregistered timerfd behind addTimer, for other backends.
+  static int createTimerFd(int intervalMs);
+  // Consumes the expiration count of a timer fd after it became readable.
+  static uint64_t drainTimer(int timerFd);
+
+  // Waits for events; the ready set is valid until the next call.
+  int poll(int timeoutMs);
+  const Event& ready(int i) const { return ready_[i]; }
+
+ private:
+  int epollFd_;
+  std::vector<epoll_event> events_;
+  std::vector<Event> ready_;
+};
+
+}  // namespace redis
+
+#endif  // REDIS_EVENT_LOOP_H
@@ -0,0 +1,96 @@
+#ifndef REDIS_EVICTION_H
+#define REDIS_EVICTION_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace redis {
+
+// maxmemory-policy: what goes once the keyspace outgrows maxmemory.
+enum class EvictionPolicy : uint8_t {
+  NoEviction,   // nothing; writes that add data are refused instead
+  AllKeysLru,   // the least recently used key
+  AllKeysLfu,   // the least frequently used key
+  VolatileTtl,  // of the keys with a TTL, the one expiring soonest
+};
+
+constexpr std::string_view evictionPolicyName(EvictionPolicy policy) {
+  switch (policy) {
+    case EvictionPolicy::NoEviction:
+      return "noeviction";
+    case EvictionPolicy::AllKeysLru:
+      return "allkeys-lru";
+    case EvictionPolicy::AllKeysLfu:
+      return "allkeys-lfu";
+    case EvictionPolicy::VolatileTtl:
+      return "volatile-ttl";
+  }
+  return "noeviction";
+}
+
+bool parseEvictionPolicy(std::string_view name, EvictionPolicy& policy);
+
+// The 24 access bits every entry carries, as Redis's robj.lru. Under an
+// LFU policy they hold a 16-bit minute stamp of the last decrement and an
+// 8-bit logarithmic access counter; otherwise the second of the last
+// access. Times are in milliseconds of the steady clock.
+namespace access {
+
+inline constexpr uint32_t kBits = 24;
+inline constexpr uint32_t kMask = (1u << kBits) - 1;
+
+// A new key's counter, so it is not evicted before it had a chance to be
+// used again.
+inline constexpr uint8_t kLfuInitValue = 5;
+
+// LRU clock: seconds, wrapping every 194 days.
+inline uint32_t lruClock(int64_t nowMs) {
+  return static_cast<uint32_t>(nowMs / 1000) & kMask;
+}
+// Milliseconds since an LRU stamp, to the second.
+uint64_t lruIdleMs(uint32_t bits, int64_t nowMs);
+
+inline uint32_t lfuInitial(int64_t nowMs) {
+  uint32_t minutes = static_cast<uint32_t>(nowMs / 60000) & 0xffff;
+  return minutes << 8 | kLfuInitValue;
+}
+// The counter less one per minute since the stamp, as Redis's
+// LFUDecrAndReturn with lfu-decay-time 1.
+uint8_t lfuCounter(uint32_t bits, int64_t nowMs);
+// An access: decays the counter, then increments it with a probability
+// that falls as it grows (lfu-log-factor 10), so 255 takes about a million
+// hits. random is uniform in [0, 1).
+uint32_t lfuTouch(uint32_t bits, int64_t nowMs, double random);
+
+}  // namespace access
+
+// Redis's eviction pool: the best candidates of the samples taken so far,
+// kept across evictions so every round does not start from scratch.
+// Higher scores go first.
+class EvictionPool {
+ public:
+  static constexpr size_t kSize = 16;
+
+  // Keeps key if it scores above the worst candidate or there is room.
+  void offer(std::string_view key, uint64_t score);
+  // Takes the best candidate; false once the pool is empty.
+  bool pop(std::string& key);
+  void clear() { size_ = 0; }
+
+ private:
+  struct Candidate {
+    uint64_t score = 0;
+    std::string key;
+  };
+
+  // Ascending by score; the best is last.
+  std::array<Candidate, kSize> candidates_;
+  size_t size_ = 0;
+};
+
+}  // namespace redis
+
+#endif  // REDIS_EVICTION_H
@@ -0,0 +1,50 @@
+#ifndef REDIS_GLOB_PATTERN_H
+#define REDIS_GLOB_PATTERN_H
+
+#include <bitset>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace redis {
+
+// A Redis glob (KEYS, SCAN MATCH) compiled once and then matched against
+// many keys. Supports *, ?, [abc], [^a-z] and \ escapes with the same
+// rules as Redis's stringmatchlen. Patterns that are all "*", a plain
+// string, or a plain prefix followed by "*" never reach the general
+// matcher.
+class GlobPattern {
+ public:
+  explicit GlobPattern(std::string_view pattern);
+
+  bool matches(std::string_view str) const;
+
+  bool matchesAll() const { return kind_ == Kind::All; }
+  // The one string matched when the pattern has no wildcards.
+  std::optional<std::string_view> literal() const {
+    if (kind_ != Kind::Exact) return std::nullopt;
+    return std::string_view(literal_);
+  }
+
+ private:
+  enum class Kind { All, Exact, Prefix, General };
+
+  struct Token {
+    enum class Op { Literal, AnyChar, Star, Class };
+    Op op;
+    std::string literal;       // Literal: a run of plain characters
+    std::bitset<256> members;  // Class: accepted bytes, negation applied
+  };
+
+  bool matchesGeneral(std::string_view str) const;
+
+  Kind kind_ = Kind::General;
+  // Exact: the whole pattern. Prefix: everything before the "*".
+  std::string literal_;
+  std::vector<Token> tokens_;
+};
+
+}  // namespace redis
+
+#endif  // REDIS_GLOB_PATTERN_H
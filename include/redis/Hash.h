@@ -0,0 +1,113 @@
+#ifndef REDIS_HASH_H
+#define REDIS_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string_view>
+
+#include "redis/Dict.h"
+
+namespace redis {
+
+class Entry;
+
+// When a hash outgrows its listpack, like hash-max-listpack-entries and
+// hash-max-listpack-value.
+struct HashLimits {
+  size_t maxListpackEntries = 128;
+  size_t maxListpackValue = 64;
+};
+
+// One field of a large hash: both strings in a single allocation.
+//
+//   [fieldLength][valueLength][field][value]
+class HashField {
+ public:
+  static HashField* create(std::string_view field, std::string_view value);
+  static void destroy(HashField* field) { ::operator delete(field); }
+
+  HashField(const HashField&) = delete;
+  HashField& operator=(const HashField&) = delete;
+
+  std::string_view field() const {
+    return std::string_view(reinterpret_cast<const char*>(this + 1),
+                            fieldLength_);
+  }
+  std::string_view value() const {
+    return std::string_view(
+        reinterpret_cast<const char*>(this + 1) + fieldLength_, valueLength_);
+  }
+  size_t allocationSize() const {
+    return sizeof(HashField) + fieldLength_ + valueLength_;
+  }
+
+ private:
+  HashField() = default;
+
+  uint32_t fieldLength_;
+  uint32_t valueLength_;
+};
+
+struct HashFieldDeleter {
+  void operator()(HashField* field) const { HashField::destroy(field); }
+};
+
+using HashFieldPtr = std::unique_ptr<HashField, HashFieldDeleter>;
+
+struct HashFieldTraits {
+  static std::string_view key(const HashFieldPtr& field) {
+    return field->field();
+  }
+};
+
+// The table encoding of a hash that outgrew its listpack.
+class HashTable {
+ public:
+  size_t size() const { return fields_.size(); }
+  size_t memoryUsage() const;
+
+  const HashField* find(std::string_view field) const;
+  // Returns true when the field is new.
+  bool set(std::string_view field, std::string_view value);
+  bool remove(std::string_view field);
+  void forEach(const std::function<void(std::string_view, std::string_view)>&
+                   visit) const;
+
+ private:
+  Dict<HashFieldPtr, HashFieldTraits> fields_;
+  // Bytes of the field allocations.
+  size_t bytes_ = 0;
+};
+
+// The hash stored in an entry, over whichever encoding it has. A small hash
+// is a listpack of alternating fields and values, found by a linear scan
+// that stays within a cache line or two; it becomes a HashTable for good
+// once it holds more than maxListpackEntries fields or a field or value
+// longer than maxListpackValue. A view: it is invalidated with the entry.
+class Hash {
+ public:
+  Hash(Entry& entry, const HashLimits& limits)
+      : entry_(&entry), limits_(&limits) {}
+
+  size_t size() const;
+  // The view is valid until the hash is modified.
+  std::optional<std::string_view> get(std::string_view field) const;
+  // Returns true when the field is new.
+  bool set(std::string_view field, std::string_view value);
+  bool remove(std::string_view field);
+  void forEach(const std::function<void(std::string_view, std::string_view)>&
+                   visit) const;
+
+ private:
+  HashTable& convertToTable();
+
+  Entry* entry_;
+  const HashLimits* limits_;
+};
+
+}  // namespace redis
+
+#endif  // REDIS_HASH_H
@@ -0,0 +1,66 @@
+#ifndef REDIS_HYPER_LOG_LOG_H
+#define REDIS_HYPER_LOG_LOG_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace redis {
+
+// A HyperLogLog kept in a string value, byte for byte as Redis stores one,
+// so PFADD keys from an RDB file load as they are:
+//
+//   [magic "HYLL"][encoding: u8][unused: 3][cached cardinality: u64 LE]
+//
+// then 16384 six-bit registers, in one of two encodings. Dense packs them
+// into 12 KiB. Sparse, which every HyperLogLog starts as, run-length codes
+// them: runs of zeros and short runs of small values, a few hundred bytes
+// for a few hundred elements. A sparse one turns dense for good once it
+// outgrows kSparseMaxBytes or a register exceeds 32. The top bit of the
+// cached cardinality marks it stale.
+//
+// A view over the string: it is invalidated with the entry.
+class HyperLogLog {
+ public:
+  static constexpr size_t kRegisters = 16384;
+  // Like hll-sparse-max-bytes.
+  static constexpr size_t kSparseMaxBytes = 3000;
+
+  // One byte per register, as PFCOUNT and PFMERGE fold several together.
+  using Registers = std::array<uint8_t, kRegisters>;
+
+  // Whether bytes hold a HyperLogLog: the header, the size a dense one
+  // has, or sparse runs that cover the registers exactly.
+  static bool isValid(std::string_view bytes);
+  // Raises each of registers to the value the valid HyperLogLog in bytes
+  // has for it, where that is larger.
+  static void mergeInto(std::string_view bytes, Registers& registers);
+
+  explicit HyperLogLog(std::string& bytes) : bytes_(&bytes) {}
+
+  // Makes the string an empty, sparse HyperLogLog.
+  void clear();
+  // PFADD of one element; returns whether a register changed.
+  bool add(std::string_view element);
+  // PFCOUNT of this one alone, cached in the header until it changes.
+  uint64_t count();
+  // Replaces the contents with registers, sparse if they fit.
+  void assign(const Registers& registers);
+
+ private:
+  bool setSparse(size_t index, uint8_t value);
+  bool setDense(size_t index, uint8_t value);
+  void toDense();
+  void invalidateCache();
+
+  std::string* bytes_;
+};
+
+// The estimated cardinality of a set of registers.
+uint64_t estimateCardinality(const HyperLogLog::Registers& registers);
+
+}  // namespace redis
+
+#endif  // REDIS_HYPER_LOG_LOG_H
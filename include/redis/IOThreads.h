@@ -0,0 +1,54 @@
+#ifndef REDIS_IO_THREADS_H
+#define REDIS_IO_THREADS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace redis {
+
+// Fixed pool of I/O threads driven by the event loop thread, as in Redis's
+// threaded I/O: the loop hands out a batch of clients, takes a share itself
+// and waits for the rest before touching shared state again. Workers only
+// ever see per-client data, so no locks are needed around it.
+class IOThreads {
+ public:
+  // count includes the calling thread; 1 means no workers are started.
+  explicit IOThreads(size_t count);
+  ~IOThreads();
+
+  IOThreads(const IOThreads&) = delete;
+  IOThreads& operator=(const IOThreads&) = delete;
+
+  size_t size() const { return count_; }
+
+  // Calls job(i) for every i in [0, n). Item i runs on thread i % size(),
+  // with thread 0 being the caller. Batches too small to be worth waking
+  // the workers (fewer than two items per thread) run inline. Returns once
+  // every item is done.
+  void run(size_t n, const std::function<void(size_t)>& job);
+
+ private:
+  void workerMain(size_t id);
+  void runShare(size_t id);
+
+  size_t count_;
+  std::vector<std::thread> workers_;
+
+  // Bumped once per batch; workers wait on it between batches.
+  std::atomic<uint64_t> generation_;
+  // Workers still busy with the current batch.
+  std::atomic<size_t> active_;
+  std::atomic<bool> stopping_;
+
+  // Current batch, published by the generation_ release store.
+  const std::function<void(size_t)>* job_;
+  size_t jobSize_;
+};
+
+}  // namespace redis
+
+#endif  // REDIS_IO_THREADS_H
@@ -0,0 +1,92 @@
+#ifndef REDIS_INT_SET_H
+#define REDIS_INT_SET_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <span>
+#include <string_view>
+#include <utility>
+
+namespace redis {
+
+// A set of integers as a sorted array in one allocation, after Redis's
+// intset. Every value takes the width of the widest one, 2, 4 or 8 bytes;
+// adding a wider value upgrades the whole array, and nothing downgrades it.
+// Membership is a binary search. The buffer is laid out as RDB stores it,
+//
+//   [encoding: u32][length: u32][values, little-endian]
+//
+// so loading one is a copy. Like Listpack, the handle is a single pointer
+// and an empty set owns no memory.
+class IntSet {
+ public:
+  IntSet() = default;
+  ~IntSet() { std::free(buf_); }
+
+  IntSet(IntSet&& other) noexcept : buf_(std::exchange(other.buf_, nullptr)) {}
+  IntSet& operator=(IntSet&& other) noexcept {
+    std::swap(buf_, other.buf_);
+    return *this;
+  }
+
+  size_t size() const { return buf_ ? header().length : 0; }
+  bool empty() const { return buf_ == nullptr; }
+  // The allocation, header included; 0 when empty.
+  size_t bytes() const { return buf_ ? kHeaderSize + size() * width() : 0; }
+  // Bytes per value.
+  size_t width() const { return buf_ ? header().encoding : sizeof(int16_t); }
+
+  // The value at index, in ascending order.
+  int64_t get(size_t index) const;
+  bool contains(int64_t value) const;
+  // Both return whether the set changed.
+  bool insert(int64_t value);
+  bool erase(int64_t value);
+
+  // The values as stored; T must be as wide as width().
+  template <typename T>
+  std::span<const T> values() const {
+    return {reinterpret_cast<const T*>(buf_ + kHeaderSize), size()};
+  }
+
+  // Replaces the contents with an RDB intset blob. False, leaving the set
+  // empty, unless the blob is well formed: a known width, the length it
+  // claims, and values strictly ascending.
+  bool assign(std::string_view blob);
+
+ private:
+  struct Header {
+    uint32_t encoding;
+    uint32_t length;
+  };
+  static constexpr size_t kHeaderSize = sizeof(Header);
+
+  Header& header() { return *reinterpret_cast<Header*>(buf_); }
+  const Header& header() const {
+    return *reinterpret_cast<const Header*>(buf_);
+  }
+  // Index of value, or where it would go, and whether it is there.
+  bool search(int64_t value, size_t& index) const;
+  void set(size_t index, int64_t value);
+  // Reallocates for length values of the given width, keeping the header.
+  void resize(size_t length, size_t width);
+  void upgradeAndInsert(int64_t value);
+
+  char* buf_ = nullptr;
+};
+
+// Intersections of ascending arrays of distinct values, writing the common
+// values to out in order and returning their count. out may alias a: the
+// kernels never write ahead of what they have read. Lopsided inputs are
+// galloped through, the larger searched for each value of the smaller;
+// similar ones are merged. With SSE2, 32-bit values are compared four
+// against four per step.
+size_t intersectSorted(std::span<const int32_t> a, std::span<const int32_t> b,
+                       int32_t* out);
+size_t intersectSorted(std::span<const int64_t> a, std::span<const int64_t> b,
+                       int64_t* out);
+
+}  // namespace redis
+
+#endif  // REDIS_INT_SET_H
@@ -0,0 +1,69 @@
+#ifndef REDIS_LAZY_FREE_H
+#define REDIS_LAZY_FREE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace redis {
+
+// Background reclamation, as in Redis's lazyfree: large values and whole
+// detached keyspaces are handed to one thread that releases them, so
+// deleting a multi-hundred-MB value or flushing millions of keys does not
+// stall the event loop. Shared by every shard; jobs are rare and coarse,
+// so a plain locked queue is enough.
+class LazyFree {
+ public:
+  static LazyFree& instance();
+
+  LazyFree(const LazyFree&) = delete;
+  LazyFree& operator=(const LazyFree&) = delete;
+
+  // Destroys object on the background thread. objects is what it adds to
+  // the pending count until then, e.g. the keys of a flushed keyspace.
+  template <typename T>
+  void free(T object, size_t objects = 1) {
+    submit(
+        [object = std::move(object)]() mutable {
+          T dying(std::move(object));
+        },
+        objects);
+  }
+
+  size_t pendingObjects() const {
+    return pending_.load(std::memory_order_relaxed);
+  }
+  uint64_t freedObjects() const {
+    return freed_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  struct Job {
+    std::move_only_function<void()> run;
+    size_t objects;
+  };
+
+  LazyFree();
+  ~LazyFree();
+
+  void submit(std::move_only_function<void()> run, size_t objects);
+  void threadMain();
+
+  std::mutex mutex_;
+  std::condition_variable ready_;
+  std::deque<Job> jobs_;
+  bool stopping_;
+  std::atomic<size_t> pending_;
+  std::atomic<uint64_t> freed_;
+  std::thread thread_;
+};
+
+}  // namespace redis
+
+#endif  // REDIS_LAZY_FREE_H
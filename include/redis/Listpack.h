@@ -0,0 +1,86 @@
+#ifndef REDIS_LISTPACK_H
+#define REDIS_LISTPACK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <span>
+#include <string_view>
+#include <utility>
+
+namespace redis {
+
+// A sequence of strings packed into one allocation, after Redis's listpack:
+// the compact encoding that quicklist nodes and small collections share.
+// After an 8-byte header each element is [length][bytes][back length]; the
+// length is a varint read forwards, the back length the size of the first
+// two fields as a varint read backwards, so the sequence can be walked from
+// either end. Elements are addressed by byte position, and any change
+// invalidates positions and views.
+//
+// The handle is a single pointer and an empty listpack owns no memory. The
+// buffer is always sized exactly, trading a realloc per change for memory:
+// listpacks are kept small.
+class Listpack {
+ public:
+  Listpack() = default;
+  ~Listpack() { std::free(buf_); }
+
+  Listpack(Listpack&& other) noexcept
+      : buf_(std::exchange(other.buf_, nullptr)) {}
+  Listpack& operator=(Listpack&& other) noexcept {
+    std::swap(buf_, other.buf_);
+    return *this;
+  }
+
+  // Bytes an element of the given length takes, framing included.
+  static size_t encodedSize(size_t length);
+
+  size_t size() const { return buf_ ? header().count : 0; }
+  bool empty() const { return buf_ == nullptr; }
+  // The allocation, header included; 0 when empty.
+  size_t bytes() const { return buf_ ? header().bytes : 0; }
+
+  // Positions: begin() is the first element, end() one past the last.
+  size_t begin() const { return kHeaderSize; }
+  size_t end() const { return buf_ ? header().bytes : kHeaderSize; }
+  size_t next(size_t pos) const;
+  size_t prev(size_t pos) const;
+  std::string_view get(size_t pos) const;
+
+  // Position of the first element equal to value, looking at every
+  // (skip + 1)th element from pos on: with skip 1 it searches only the
+  // fields of field-value pairs. end() if there is none.
+  size_t find(size_t pos, std::string_view value, size_t skip) const;
+
+  // Inserts value before pos, or appends at end().
+  void insert(size_t pos, std::string_view value);
+  void pushFront(std::string_view value) { insert(begin(), value); }
+  void pushBack(std::string_view value) { insert(end(), value); }
+  // Appends several elements with a single reallocation.
+  void pushBack(std::span<const std::string_view> values);
+  void replace(size_t pos, std::string_view value);
+  // Removes count elements starting at pos.
+  void erase(size_t pos, size_t count = 1);
+
+ private:
+  struct Header {
+    uint32_t bytes;
+    uint32_t count;
+  };
+  static constexpr size_t kHeaderSize = sizeof(Header);
+
+  Header& header() { return *reinterpret_cast<Header*>(buf_); }
+  const Header& header() const {
+    return *reinterpret_cast<const Header*>(buf_);
+  }
+  // Resizes the buffer so the bytes from pos on move to pos + newSize -
+  // oldSize, making room for (or closing) an element.
+  void resize(size_t pos, size_t oldSize, size_t newSize);
+
+  char* buf_ = nullptr;
+};
+
+}  // namespace redis
+
+#endif  // REDIS_LISTPACK_H
@@ -0,0 +1,76 @@
+#ifndef REDIS_QUICKLIST_H
+#define REDIS_QUICKLIST_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "redis/Listpack.h"
+
+namespace redis {
+
+// The list value type, after Redis's quicklist: a doubly linked list of
+// nodes, each a listpack of packed elements. A node fills up to
+// kMaxNodeBytes, so walking a list touches a few large buffers instead of
+// one heap node per element, and small elements cost two or three bytes of
+// framing rather than a pointer pair and a string header.
+class Quicklist {
+ public:
+  // Like list-max-listpack-size -2. An element larger than this gets a
+  // node of its own.
+  static constexpr size_t kMaxNodeBytes = 8 * 1024;
+
+  Quicklist() = default;
+  ~Quicklist();
+
+  Quicklist(const Quicklist&) = delete;
+  Quicklist& operator=(const Quicklist&) = delete;
+
+  size_t size() const { return count_; }
+  bool empty() const { return count_ == 0; }
+  size_t nodeCount() const { return nodes_; }
+  size_t memoryUsage() const;
+
+  void pushFront(std::string_view value);
+  void pushBack(std::string_view value);
+  // The list must not be empty.
+  std::string popFront();
+  std::string popBack();
+
+  // The element at index, which must be below size(). The view is valid
+  // until the list is modified.
+  std::string_view at(size_t index) const;
+  // Visits count elements from start on, in order; the range must lie
+  // within the list.
+  void forRange(size_t start, size_t count,
+                const std::function<void(std::string_view)>& visit) const;
+
+ private:
+  struct Node {
+    Node* prev = nullptr;
+    Node* next = nullptr;
+    Listpack entries;
+  };
+
+  // The node holding index and the element's position within it, found
+  // from whichever end of the list is closer.
+  std::pair<const Node*, size_t> locate(size_t index) const;
+  Node* insertNode(Node* after);
+  void unlinkNode(Node* node);
+  // Room for an element of encodedSize bytes at one end of the list.
+  Node* nodeWithRoom(Node* end, size_t encodedSize, bool front);
+
+  Node* head_ = nullptr;
+  Node* tail_ = nullptr;
+  size_t count_ = 0;
+  size_t nodes_ = 0;
+  // Listpack bytes across all nodes.
+  size_t bytes_ = 0;
+};
+
+}  // namespace redis
+
+#endif  // REDIS_QUICKLIST_H
@@ -1,29 +1,64 @@
 #ifndef REDIS_RDB_PARSER_H
 #define REDIS_RDB_PARSER_H
 
+#include <cstddef>
 #include <cstdint>
-#include <fstream>
+#include <functional>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace redis {
 
+class Quicklist;
+class Set;
 class Storage;
 
+// Decodes an RDB file mapped into memory. Every read is checked against
+// the end of the mapping: a truncated or corrupt file fails the load
+// instead of yielding made-up values.
 class RDBParser {
  public:
   RDBParser() = default;
 
   bool parseFile(const std::string& filepath, Storage& storage);
 
+  // Only keys the filter accepts are loaded; a shard uses this to keep
+  // just the keys it owns.
+  void setKeyFilter(std::function<bool(std::string_view)> filter) {
+    keyFilter_ = std::move(filter);
+  }
+
  private:
-  std::ifstream file_;
+  // The unread part of the mapped file.
+  const uint8_t* pos_ = nullptr;
+  const uint8_t* end_ = nullptr;
+  // Set by the first read past the end or of malformed data, after which
+  // every read returns zeros; as a stream's failbit, checked once per
+  // value rather than after every field.
+  bool failed_ = false;
+  std::function<bool(std::string_view)> keyFilter_;
 
   bool readHeader();
   bool skipMetadata();
   bool readDatabase(Storage& storage);
+  bool readList(uint8_t type, Quicklist& list);
+  // Calls visit with each field and value of a hash.
+  bool readHash(
+      uint8_t type,
+      const std::function<void(std::string_view, std::string_view)>& visit);
+  // Calls visit with each member and score of a sorted set.
+  bool readSortedSet(
+      uint8_t type, const std::function<void(std::string_view, double)>& visit);
+  bool readTextScore(double& score);
+  // Adds the members of a set to set, or only reads past them when null.
+  bool readSet(uint8_t type, Set* set);
 
+  // Whether count more bytes are there; fails the parser if not.
+  bool need(size_t count);
+  uint8_t peekByte();
   uint8_t readByte();
   uint32_t readUInt32LE();
   uint64_t readUInt64LE();
@@ -1,13 +1,56 @@
 #ifndef REDIS_RESP_PARSER_H
 #define REDIS_RESP_PARSER_H
 
+#include <cstddef>
+#include <cstdint>
+#include <span>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace redis {
 
 class RESPParser {
  public:
+  enum class ParseResult { Complete, Incomplete, Error };
+
+  // Resumable multibulk request parser that works in place over a
+  // connection's query buffer. Arguments are sliced by their "$<len>"
+  // prefix and returned as views into the buffer, so nothing is copied and
+  // values may contain CR/LF. Progress on a partial frame is kept between
+  // calls; only the new bytes are examined when more data arrives.
+  class RequestParser {
+   public:
+    // data must start at the current frame and extend the bytes passed on
+    // the previous Incomplete call. On Complete, consumed is the frame size
+    // and args() holds the arguments until data is modified or parse() is
+    // called again.
+    ParseResult parse(std::string_view data, size_t& consumed);
+
+    std::span<const std::string_view> args() const { return args_; }
+
+    // Total frame size once the current bulk is known, so callers can size
+    // their buffer for a large value in one step. Zero if not yet known.
+    size_t bytesNeeded() const;
+
+    void reset();
+
+   private:
+    enum class State { ArrayHeader, BulkHeader, BulkBody };
+
+    ParseResult readLength(std::string_view data, char prefix,
+                           long long& value);
+
+    State state_ = State::ArrayHeader;
+    size_t pos_ = 0;
+    long long remaining_ = 0;
+    long long bulkLength_ = 0;
+    // Offsets relative to the frame start; views are only materialised once
+    // the frame is complete because the buffer may move while it grows.
+    std::vector<std::pair<uint32_t, uint32_t>> offsets_;
+    std::vector<std::string_view> args_;
+  };
+
   static std::vector<std::string> parseArray(const std::string& data);
   static std::string parseSimpleString(const std::string& data);
 
@@ -0,0 +1,194 @@
+#ifndef REDIS_RADIX_TREE_H
+#define REDIS_RADIX_TREE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace redis {
+
+// An ordered map from byte strings to values, after Redis's rax: a radix
+// tree whose edges carry whole runs of bytes, so keys sharing a long prefix
+// (like big-endian stream IDs minted in the same second) share its nodes.
+// Lookups and seeks cost one step per edge, independent of the number of
+// keys; keys compare bytewise, as unsigned chars.
+template <typename T>
+class RadixTree {
+ public:
+  RadixTree() : root_(std::make_unique<Node>()) {}
+
+  RadixTree(const RadixTree&) = delete;
+  RadixTree& operator=(const RadixTree&) = delete;
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  // Inserts or replaces the value for key.
+  void insert(std::string_view key, T value) {
+    Node* node = root_.get();
+    size_t depth = 0;
+    while (depth < key.size()) {
+      std::string_view rest = key.substr(depth);
+      auto it = childFor(*node, static_cast<unsigned char>(rest[0]));
+      if (it == node->children.end() ||
+          static_cast<unsigned char>((*it)->edge[0]) !=
+              static_cast<unsigned char>(rest[0])) {
+        auto leaf = std::make_unique<Node>();
+        leaf->edge = rest;
+        leaf->value = std::move(value);
+        node->children.insert(it, std::move(leaf));
+        size_++;
+        return;
+      }
+
+      Node* child = it->get();
+      size_t common = std::mismatch(child->edge.begin(), child->edge.end(),
+                                    rest.begin(), rest.end())
+                          .first -
+                      child->edge.begin();
+      if (common < child->edge.size()) {
+        // Split the edge where the new key leaves it.
+        auto middle = std::make_unique<Node>();
+        middle->edge = child->edge.substr(0, common);
+        child->edge.erase(0, common);
+        middle->children.push_back(std::move(*it));
+        *it = std::move(middle);
+        child = it->get();
+      }
+      node = child;
+      depth += common;
+    }
+    if (!node->value) {
+      size_++;
+    }
+    node->value = std::move(value);
+  }
+
+  const T* find(std::string_view key) const {
+    const Node* node = root_.get();
+    size_t depth = 0;
+    while (depth < key.size()) {
+      std::string_view rest = key.substr(depth);
+      auto it = childFor(*node, static_cast<unsigned char>(rest[0]));
+      if (it == node->children.end() || !rest.starts_with((*it)->edge)) {
+        return nullptr;
+      }
+      node = it->get();
+      depth += node->edge.size();
+    }
+    return node->value ? &*node->value : nullptr;
+  }
+
+  // The value of the greatest key not above key, or null.
+  const T* floor(std::string_view key) const {
+    return floorIn(*root_, key, 0);
+  }
+
+  // The value of the smallest key not below key, or null.
+  const T* ceiling(std::string_view key) const {
+    return ceilingIn(*root_, key, 0);
+  }
+
+ private:
+  struct Node {
+    // The bytes on the edge leading here.
+    std::string edge;
+    // Sorted by the first byte of their edge, which is unique among them.
+    std::vector<std::unique_ptr<Node>> children;
+    std::optional<T> value;
+  };
+  using Children = std::vector<std::unique_ptr<Node>>;
+
+  // The first child whose edge starts at or after byte.
+  static typename Children::const_iterator childFor(const Node& node,
+                                                    unsigned char byte) {
+    return std::lower_bound(node.children.begin(), node.children.end(), byte,
+                            [](const std::unique_ptr<Node>& child,
+                               unsigned char b) {
+                              return static_cast<unsigned char>(
+                                         child->edge[0]) < b;
+                            });
+  }
+  static typename Children::iterator childFor(Node& node,
+                                              unsigned char byte) {
+    auto it = childFor(static_cast<const Node&>(node), byte);
+    return node.children.begin() + (it - node.children.cbegin());
+  }
+
+  // How a child's edge compares with the key bytes it would cover: below,
+  // above, or a prefix of the rest of the key to descend into.
+  enum class EdgeOrder { Below, Above, Descend };
+
+  static EdgeOrder compareEdge(std::string_view edge, std::string_view rest) {
+    std::string_view covered = rest.substr(0, edge.size());
+    for (size_t i = 0; i < covered.size(); i++) {
+      auto a = static_cast<unsigned char>(edge[i]);
+      auto b = static_cast<unsigned char>(covered[i]);
+      if (a != b) return a < b ? EdgeOrder::Below : EdgeOrder::Above;
+    }
+    // The key ends inside the edge: everything below is longer, so above.
+    return covered.size() < edge.size() ? EdgeOrder::Above
+                                        : EdgeOrder::Descend;
+  }
+
+  static const T* minIn(const Node& node) {
+    if (node.value) return &*node.value;
+    return node.children.empty() ? nullptr : minIn(*node.children.front());
+  }
+
+  static const T* maxIn(const Node& node) {
+    if (!node.children.empty()) return maxIn(*node.children.back());
+    return node.value ? &*node.value : nullptr;
+  }
+
+  // node's own key is key[0, depth).
+  static const T* floorIn(const Node& node, std::string_view key,
+                          size_t depth) {
+    if (depth < key.size()) {
+      std::string_view rest = key.substr(depth);
+      for (auto it = node.children.rbegin(); it != node.children.rend();
+           ++it) {
+        const Node& child = **it;
+        EdgeOrder order = compareEdge(child.edge, rest);
+        if (order == EdgeOrder::Below) return maxIn(child);
+        if (order == EdgeOrder::Descend) {
+          if (const T* found =
+                  floorIn(child, key, depth + child.edge.size())) {
+            return found;
+          }
+        }
+      }
+    }
+    // A node's own key is below every key in its subtree.
+    return node.value ? &*node.value : nullptr;
+  }
+
+  static const T* ceilingIn(const Node& node, std::string_view key,
+                            size_t depth) {
+    if (depth == key.size()) return minIn(node);
+    std::string_view rest = key.substr(depth);
+    for (const auto& child : node.children) {
+      EdgeOrder order = compareEdge(child->edge, rest);
+      if (order == EdgeOrder::Above) return minIn(*child);
+      if (order == EdgeOrder::Descend) {
+        if (const T* found =
+                ceilingIn(*child, key, depth + child->edge.size())) {
+          return found;
+        }
+      }
+    }
+    return nullptr;
+  }
+
+  std::unique_ptr<Node> root_;
+  size_t size_ = 0;
+};
+
+}  // namespace redis
+
+#endif  // REDIS_RADIX_TREE_H
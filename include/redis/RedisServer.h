@@ -1,40 +1,171 @@
 #ifndef REDIS_SERVER_H
 #define REDIS_SERVER_H
 
+#include <chrono>
+#include <cstdint>
+#include <deque>
 #include <memory>
 #include <set>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "redis/CommandHandler.h"
+#include "redis/EventLoop.h"
+#include "redis/UringLoop.h"
 
 namespace redis {
 
 class Config;
 class Storage;
-class CommandHandler;
 class RDBParser;
+class ReplyBuffer;
+class IOThreads;
+class ShardSet;
+struct Client;
+struct ShardMessage;
 
 class RedisServer {
  public:
   RedisServer(std::shared_ptr<Config> config);
+  // One shard of a ShardSet, owning the keys that hash to shardId.
+  RedisServer(std::shared_ptr<Config> config, ShardSet *shards,
+              size_t shardId);
   ~RedisServer();
 
   void run();
 
  private:
+  static constexpr int kServerHz = 10;
+  static constexpr size_t kIOBufferSize = 16 * 1024;
+  static constexpr size_t kMaxQueryBufferSize = 1024 * 1024 * 1024;
+  static constexpr size_t kIdleQueryBufferCapacity = 32 * 1024;
+  static constexpr std::chrono::microseconds kActiveRehashBudget{1000};
+  static constexpr std::chrono::microseconds kFastExpireBudget{1000};
+  // Bytes an I/O thread reads from one client per batch before yielding,
+  // so a fast pipelining client cannot stall the batch.
+  static constexpr size_t kIOThreadReadBudget = 1024 * 1024;
+  // A client with this much unsent output is not read from again until
+  // the socket drains, so a slow consumer cannot queue unbounded replies.
+  static constexpr size_t kReadPauseOutputBytes = 1024 * 1024;
+  // io_uring backend: submission queue depth and the number of kernel
+  // provided receive buffers (kIOBufferSize each) shared by all clients.
+  static constexpr unsigned kUringEntries = 4096;
+  static constexpr unsigned kUringBufferCount = 1024;
+
+  enum class ReadResult { Data, Drained, Closed };
+
   bool loadRDBFile();
   std::shared_ptr<Config> config_;
   std::shared_ptr<Storage> storage_;
   std::shared_ptr<CommandHandler> commandHandler_;
 
+  EventLoop loop_;
   int serverFd_;
-  std::set<int> clientFds_;
+  int cronTimerFd_;
   int masterFd_;
 
+  // Connection state indexed by fd; null slots are unused descriptors.
+  std::vector<std::unique_ptr<Client>> clients_;
+  size_t numClients_;
+  uint64_t cronLoops_;
+  size_t clientsCronCursor_;
+
+  // Threaded I/O (--io-threads > 1): clients with input waiting for the
+  // next read batch, and scratch space for the batches themselves.
+  std::unique_ptr<IOThreads> ioThreads_;
+  std::vector<Client *> pendingReads_;
+  std::vector<Client *> readBatch_;
+  std::vector<Client *> writeBatch_;
+  std::vector<uint8_t> writeFailed_;
+
+  // Shard mode: null for a standalone server.
+  ShardSet *shards_;
+  size_t shardId_;
+  uint64_t nextClientId_;
+  // Messages per destination shard that did not fit its queue yet.
+  std::vector<std::vector<ShardMessage *>> outbox_;
+
+  // Commands parked by a blocking command (BLPOP) until one of their keys
+  // gets data, as in Redis's blocking_keys: the waiters of each key in
+  // arrival order, and the deadlines of those with a timeout. A waiter is
+  // a local client or, in shard mode, a command forwarded by another
+  // shard.
+  struct BlockedCommand {
+    std::vector<std::string> args;
+    std::vector<std::string> keys;
+    int64_t deadlineMs = 0;  // 0 waits forever
+    Client *client = nullptr;
+    ShardMessage *message = nullptr;
+  };
+  uint64_t nextBlockedId_;
+  std::unordered_map<uint64_t, BlockedCommand> blocked_;
+  std::unordered_map<std::string, std::deque<uint64_t>> blockingKeys_;
+  std::set<std::pair<int64_t, uint64_t>> blockedTimeouts_;
+  // Clients (fd, id) served while another command ran; their pipelines
+  // resume before the loop sleeps.
+  std::vector<std::pair<int, uint64_t>> unblockedClients_;
+
+  // io_uring backend (--io-backend io_uring); null when running on epoll.
+  std::unique_ptr<UringLoop> uring_;
+  // Clients with output to submit before the next io_uring_enter.
+  std::vector<int> sendQueue_;
+
+  void runEpoll();
+  void runUring();
   bool createServerSocket();
   bool connectToMaster();
   void handleNewConnection();
+  Client &addClient(int clientFd);
   void handleClientData(int clientFd);
+  void handleClientWritable(int clientFd);
+  static ReadResult readQueryBuffer(Client &client);
+  bool processQueryBuffer(Client &client);
+  bool processInput(Client &client);
+  bool consumeQueryBuffer(Client &client, size_t parsed);
+  void queueClientRead(int clientFd);
+  void handleClientsPendingReads();
+  void readAndParse(Client &client);
+  bool executeParsedCommands(Client &client);
+  void dispatchCommand(Client &client, std::span<const std::string_view> argv);
+  bool call(Client *client, ShardMessage *message,
+            std::span<const std::string_view> argv, ReplyBuffer &out);
+  void blockCommand(Client *client, ShardMessage *message,
+                    std::span<const std::string_view> argv,
+                    CommandHandler::BlockRequest request);
+  BlockedCommand unlinkBlockedCommand(uint64_t id);
+  void unblockCommand(uint64_t id, ReplyBuffer &&reply);
+  void handleClientsBlockedOnKeys();
+  void handleBlockedClientsTimeout();
+  void processUnblockedClients();
+  void cancelParkedCommand(ShardMessage *cancel);
+  void forwardCommand(Client &client, std::span<const std::string_view> argv,
+                      size_t shard, bool broadcast);
+  void broadcastCommand(Client &client,
+                        std::span<const std::string_view> argv);
+  void handleShardMessages();
+  void completeForwardedCommand(ShardMessage *message);
+  bool flushShardOutbox();
+
+  void handleUringCompletion(const UringLoop::Completion &event);
+  void armUringRecv(Client &client);
+  void handleUringRecv(int fd, const UringLoop::Completion &event);
+  void queueUringSend(Client &client);
+  void submitUringSends();
+  void handleUringSend(int fd, const UringLoop::Completion &event);
+  void closeUringClient(int clientFd);
+  void finishUringClose(Client &client);
+  void pauseClientReads(Client &client);
+  void resumeClientReads(Client &client);
+  bool checkOutputBufferLimits(Client &client);
+  bool flushPendingOutput(Client &client);
   void closeClient(int clientFd);
+  void serverCron();
 };
 
 }  // namespace redis
 
-#endif  // REDIS_SERVER_H
\ No newline at end of file
+#endif  // REDIS_SERVER_H
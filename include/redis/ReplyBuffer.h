@@ -0,0 +1,115 @@
+#ifndef REDIS_REPLY_BUFFER_H
+#define REDIS_REPLY_BUFFER_H
+
+#include <sys/uio.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace redis {
+
+// Pre-encoded replies shared by every client.
+namespace reply {
+
+inline constexpr std::string_view kOk = "+OK\r\n";
+inline constexpr std::string_view kPong = "+PONG\r\n";
+inline constexpr std::string_view kNull = "$-1\r\n";
+inline constexpr std::string_view kNullArray = "*-1\r\n";
+inline constexpr std::string_view kEmptyArray = "*0\r\n";
+inline constexpr std::string_view kZero = ":0\r\n";
+inline constexpr std::string_view kOne = ":1\r\n";
+inline constexpr std::string_view kSyntaxError = "-ERR syntax error\r\n";
+inline constexpr std::string_view kProtocolError = "-ERR Protocol error\r\n";
+inline constexpr std::string_view kNotInteger =
+    "-ERR value is not an integer or out of range\r\n";
+inline constexpr std::string_view kCrossSlot =
+    "-CROSSSLOT Keys in request don't hash to the same slot\r\n";
+inline constexpr std::string_view kWrongType =
+    "-WRONGTYPE Operation against a key holding the wrong kind of value\r\n";
+inline constexpr std::string_view kOom =
+    "-OOM command not allowed when used memory > 'maxmemory'.\r\n";
+
+}  // namespace reply
+
+// Per-client output buffer that RESP frames are appended to in place.
+// Small frames are packed into one contiguous buffer; large bulk values can
+// be referenced instead of copied, and the whole queue is written with a
+// single scatter-gather sendmsg.
+class ReplyBuffer {
+ public:
+  // Bulk values at least this large are referenced rather than copied.
+  static constexpr size_t kMinReferencedBulk = 16 * 1024;
+
+  void appendRaw(std::string_view data);
+  void appendSimpleString(std::string_view str);
+  void appendError(std::string_view error);
+  void appendInteger(int64_t value);
+  void appendBulkString(std::string_view str);
+  void appendArrayHeader(size_t count);
+  void appendNull() { appendRaw(reply::kNull); }
+
+  // Appends a bulk string whose bytes stay owned by owner; the reply keeps
+  // owner alive until the bytes have been written.
+  void appendBulkString(std::string_view str,
+                        std::shared_ptr<const void> owner);
+
+  // Reserves room for an array header whose length is only known after
+  // the elements have been appended.
+  size_t beginDeferredArray();
+  void setDeferredArrayLength(size_t handle, size_t count);
+
+  // Moves everything other still has to send to the end of this buffer.
+  // Referenced values stay referenced; other is left empty.
+  void append(ReplyBuffer&& other);
+  // Copies out the unsent bytes, e.g. to inspect or merge a reply.
+  std::string toString() const;
+
+  bool empty() const { return pendingBytes_ == 0; }
+  size_t pendingBytes() const { return pendingBytes_; }
+
+  enum class WriteResult { Done, Blocked, Error };
+
+  // Writes as much as the socket accepts without blocking.
+  WriteResult writeTo(int fd);
+
+  // For writers that submit the bytes themselves (io_uring): describes up
+  // to max unsent chunks, then consume() marks sent bytes as written. The
+  // described memory stays put until consumed as long as nothing else is
+  // appended in between.
+  size_t iovNeeded() const;
+  size_t fillIov(iovec* iov, size_t max);
+  void consume(size_t sent);
+
+ private:
+  // Either a range of buffer_ (data == nullptr) or external bytes that are
+  // kept alive by owner.
+  struct Segment {
+    const char* data = nullptr;
+    size_t offset = 0;
+    size_t length = 0;
+    std::shared_ptr<const void> owner;
+  };
+
+  void appendPrefixed(char prefix, int64_t value);
+  void sealInline();
+  void pushExternal(const char* data, size_t length,
+                    std::shared_ptr<const void> owner);
+  void clear();
+
+  std::string buffer_;
+  std::vector<Segment> segments_;
+  // Start of the inline bytes not yet covered by a segment.
+  size_t inlineStart_ = 0;
+  // Write progress through segments_.
+  size_t sentSegments_ = 0;
+  size_t sentOffset_ = 0;
+  size_t pendingBytes_ = 0;
+};
+
+}  // namespace redis
+
+#endif  // REDIS_REPLY_BUFFER_H
@@ -0,0 +1,69 @@
+#ifndef REDIS_SPSC_QUEUE_H
+#define REDIS_SPSC_QUEUE_H
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <utility>
+
+namespace redis {
+
+// Bounded lock-free ring for exactly one producer thread and one consumer
+// thread. Each side keeps a cached copy of the other side's index and only
+// rereads the shared atomic when the cache says the ring is full or empty,
+// so the steady state touches no shared cache line but the slots.
+template <typename T, size_t Capacity>
+class SPSCQueue {
+  static_assert(std::has_single_bit(Capacity),
+                "capacity must be a power of two");
+
+ public:
+  SPSCQueue() = default;
+  SPSCQueue(const SPSCQueue&) = delete;
+  SPSCQueue& operator=(const SPSCQueue&) = delete;
+
+  // Producer side. Returns false when the ring is full.
+  bool push(T value) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - cachedHead_ == Capacity) {
+      cachedHead_ = head_.load(std::memory_order_acquire);
+      if (tail - cachedHead_ == Capacity) {
+        return false;
+      }
+    }
+    slots_[tail & (Capacity - 1)] = std::move(value);
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side. Returns false when the ring is empty.
+  bool pop(T& out) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head == cachedTail_) {
+      cachedTail_ = tail_.load(std::memory_order_acquire);
+      if (head == cachedTail_) {
+        return false;
+      }
+    }
+    out = std::move(slots_[head & (Capacity - 1)]);
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+ private:
+  static constexpr size_t kLine = 64;
+
+  // Consumer-owned.
+  alignas(kLine) std::atomic<size_t> head_{0};
+  size_t cachedTail_ = 0;
+  // Producer-owned.
+  alignas(kLine) std::atomic<size_t> tail_{0};
+  size_t cachedHead_ = 0;
+
+  alignas(kLine) std::array<T, Capacity> slots_{};
+};
+
+}  // namespace redis
+
+#endif  // REDIS_SPSC_QUEUE_H
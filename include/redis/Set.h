@@ -0,0 +1,122 @@
+#ifndef REDIS_SET_H
+#define REDIS_SET_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <span>
+#include <string_view>
+
+#include "redis/Dict.h"
+
+namespace redis {
+
+class Entry;
+class IntSet;
+
+// When a set of integers leaves the intset encoding, like
+// set-max-intset-entries.
+struct SetLimits {
+  size_t maxIntsetEntries = 512;
+};
+
+// One member of a large set, in a single allocation.
+//
+//   [length][bytes]
+class SetMember {
+ public:
+  static SetMember* create(std::string_view member);
+  static void destroy(SetMember* member) { ::operator delete(member); }
+
+  SetMember(const SetMember&) = delete;
+  SetMember& operator=(const SetMember&) = delete;
+
+  std::string_view view() const {
+    return std::string_view(reinterpret_cast<const char*>(this + 1),
+                            length_);
+  }
+  size_t allocationSize() const { return sizeof(SetMember) + length_; }
+
+ private:
+  SetMember() = default;
+
+  uint32_t length_;
+};
+
+struct SetMemberDeleter {
+  void operator()(SetMember* member) const { SetMember::destroy(member); }
+};
+
+using SetMemberPtr = std::unique_ptr<SetMember, SetMemberDeleter>;
+
+struct SetMemberTraits {
+  static std::string_view key(const SetMemberPtr& member) {
+    return member->view();
+  }
+};
+
+using MemberVisitor = std::function<void(std::string_view)>;
+
+// The table encoding of a set that holds strings or outgrew its intset.
+class SetTable {
+ public:
+  size_t size() const { return members_.size(); }
+  size_t memoryUsage() const;
+
+  bool contains(std::string_view member) const {
+    return members_.find(member) != nullptr;
+  }
+  // Both return whether the set changed.
+  bool add(std::string_view member);
+  bool remove(std::string_view member);
+  void forEach(const MemberVisitor& visit) const;
+
+ private:
+  Dict<SetMemberPtr, SetMemberTraits> members_;
+  // Bytes of the member allocations.
+  size_t bytes_ = 0;
+};
+
+// The set stored in an entry, over whichever encoding it has. A set of
+// integers is an IntSet, searched in O(log n) and intersected with other
+// intsets by the sorted-array kernels; it becomes a SetTable for good once
+// a member is not an integer or it holds more than maxIntsetEntries. A
+// view: it is invalidated with the entry.
+class Set {
+ public:
+  Set(Entry& entry, const SetLimits& limits)
+      : entry_(&entry), limits_(&limits) {}
+
+  size_t size() const;
+  bool contains(std::string_view member) const;
+  // Both return whether the set changed.
+  bool add(std::string_view member);
+  bool remove(std::string_view member);
+  // Integers are visited in ascending order, as text.
+  void forEach(const MemberVisitor& visit) const;
+
+  // The intset, or null when the set is a table.
+  const IntSet* intSet() const;
+  // Fills an empty set from an intset loaded whole, keeping it as it is
+  // when within the limits.
+  void assign(IntSet&& values);
+
+ private:
+  SetTable& convertToTable();
+
+  Entry* entry_;
+  const SetLimits* limits_;
+};
+
+// SINTER: visits the members common to every set, up to limit of them.
+void intersectSets(std::span<const Set> sets, size_t limit,
+                   const MemberVisitor& visit);
+// SUNION: visits each member of any set once.
+void unionSets(std::span<const Set> sets, const MemberVisitor& visit);
+// SDIFF: visits the members of the first set that no other holds.
+void diffSets(std::span<const Set> sets, const MemberVisitor& visit);
+
+}  // namespace redis
+
+#endif  // REDIS_SET_H
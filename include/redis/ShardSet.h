@@ -0,0 +1,118 @@
+#ifndef REDIS_SHARD_SET_H
+#define REDIS_SHARD_SET_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "redis/Config.h"
+#include "redis/ReplyBuffer.h"
+#include "redis/SPSCQueue.h"
+
+namespace redis {
+
+struct CommandSpec;
+
+// A command travelling between shards. The origin shard owns it: it sends
+// it to the shard owning the keys, which runs the command, fills reply and
+// sends the same message back.
+struct ShardMessage {
+  size_t origin = 0;
+  // The waiting client on the origin shard; the id detects a closed fd
+  // that was reused while the command was away.
+  int clientFd = -1;
+  uint64_t clientId = 0;
+  // Part of a keyspace-wide command whose replies are merged.
+  bool broadcast = false;
+  // Withdraws the client's blocking command if it is still parked on the
+  // receiving shard; sent when the client disconnects. Comes back like
+  // any other message.
+  bool cancel = false;
+
+  std::vector<std::string> args;
+  ReplyBuffer reply;
+};
+
+// Shared-nothing mode (--shards N): one RedisServer per shard, each with
+// its own thread, event loop, SO_REUSEPORT listener and Storage. Keys are
+// partitioned by their Redis Cluster hash slot, hash tags included, and a
+// command for another shard's keys is forwarded to it through a lock-free
+// SPSC queue per shard pair, with an eventfd to wake the owner.
+class ShardSet {
+ public:
+  // Targets returned by route() besides a shard index.
+  static constexpr size_t kLocal = SIZE_MAX;        // no keys
+  static constexpr size_t kAllShards = SIZE_MAX - 1;
+  static constexpr size_t kCrossShard = SIZE_MAX - 2;
+
+  static constexpr size_t kQueueCapacity = 4096;
+
+  ShardSet(std::shared_ptr<Config> config, size_t count);
+  ~ShardSet();
+
+  ShardSet(const ShardSet&) = delete;
+  ShardSet& operator=(const ShardSet&) = delete;
+
+  // Runs every shard on its own thread, pinned to a core, until they exit.
+  void run();
+
+  size_t size() const { return count_; }
+
+  // CRC16 slot in [0, 16384), hashing only a non-empty {tag} if present.
+  static uint16_t keyHashSlot(std::string_view key);
+  size_t shardOf(std::string_view key) const {
+    return keyHashSlot(key) % count_;
+  }
+
+  // A SCAN cursor carries the shard it is on in its low byte, so one cursor
+  // walks every shard in turn.
+  static constexpr unsigned kCursorShardBits = 8;
+  static_assert(Config::kMaxShards <= 1u << kCursorShardBits);
+  static uint64_t encodeCursor(uint64_t cursor, size_t shard) {
+    return (cursor << kCursorShardBits) | shard;
+  }
+  static size_t cursorShard(uint64_t cursor) {
+    return cursor & ((1u << kCursorShardBits) - 1);
+  }
+  static uint64_t localCursor(uint64_t cursor) {
+    return cursor >> kCursorShardBits;
+  }
+
+  // Which shard a command runs on, from its key positions.
+  size_t route(const CommandSpec& spec,
+               std::span<const std::string_view> argv) const;
+
+  // Queue operations. send returns false when the queue is full, and the
+  // sender retries later; notify wakes the receiving shard's loop.
+  bool send(size_t from, size_t to, ShardMessage* message) {
+    return queue(from, to).push(message);
+  }
+  bool receive(size_t from, size_t to, ShardMessage*& message) {
+    return queue(from, to).pop(message);
+  }
+  void notify(size_t shard);
+  int eventFd(size_t shard) const { return eventFds_[shard]; }
+
+  // Combines the replies of a broadcast command: arrays are concatenated,
+  // integers summed, and the first error wins.
+  static void mergeReplies(const std::vector<std::string>& replies,
+                           ReplyBuffer& out);
+
+ private:
+  using Queue = SPSCQueue<ShardMessage*, kQueueCapacity>;
+
+  Queue& queue(size_t from, size_t to) { return *queues_[from * count_ + to]; }
+
+  std::shared_ptr<Config> config_;
+  size_t count_;
+  std::vector<std::unique_ptr<Queue>> queues_;
+  std::vector<int> eventFds_;
+};
+
+}  // namespace redis
+
+#endif  // REDIS_SHARD_SET_H
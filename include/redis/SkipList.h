@@ -0,0 +1,119 @@
+#ifndef REDIS_SKIP_LIST_H
+#define REDIS_SKIP_LIST_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace redis {
+
+// A score interval as ZRANGEBYSCORE takes it, either end open or closed.
+struct ScoreRange {
+  double min;
+  double max;
+  bool minExclusive = false;
+  bool maxExclusive = false;
+
+  bool aboveMin(double score) const {
+    return minExclusive ? score > min : score >= min;
+  }
+  bool belowMax(double score) const {
+    return maxExclusive ? score < max : score <= max;
+  }
+  bool isEmpty() const {
+    return min > max || (min == max && (minExclusive || maxExclusive));
+  }
+};
+
+// The ordered half of a large sorted set, after Redis's zskiplist: members
+// sorted by score, then bytewise. Every forward link records its span, the
+// number of level-0 steps it skips, so the rank of a member and the member
+// at a rank are both found in O(log n) as a side effect of the descent.
+//
+// Members are unique; the caller checks that before inserting, typically
+// against the dictionary that maps members to their nodes. Nodes never move,
+// so those pointers stay valid until the member is erased.
+class SkipList {
+ public:
+  static constexpr int kMaxLevel = 32;
+
+  class Node {
+   public:
+    double score() const { return score_; }
+    std::string_view member() const {
+      return std::string_view(
+          reinterpret_cast<const char*>(levels() + level_), memberLength_);
+    }
+    Node* next() const { return levels()[0].forward; }
+    Node* prev() const { return backward_; }
+
+   private:
+    friend class SkipList;
+
+    struct Level {
+      Node* forward;
+      size_t span;
+    };
+
+    Level* levels() { return reinterpret_cast<Level*>(this + 1); }
+    const Level* levels() const {
+      return reinterpret_cast<const Level*>(this + 1);
+    }
+
+    double score_;
+    Node* backward_;
+    uint32_t memberLength_;
+    uint8_t level_;
+  };
+
+  SkipList();
+  ~SkipList();
+
+  SkipList(const SkipList&) = delete;
+  SkipList& operator=(const SkipList&) = delete;
+
+  size_t size() const { return length_; }
+  // Bytes of the nodes, the list head included.
+  size_t nodeBytes() const { return bytes_; }
+
+  Node* first() const { return head_->levels()[0].forward; }
+  Node* last() const { return tail_; }
+
+  Node* insert(double score, std::string_view member);
+  // Removes the node holding score and member, if any.
+  bool erase(double score, std::string_view member);
+  // Moves node to newScore, relinking it only if its position changes. The
+  // node stays the same, so pointers to it remain valid.
+  void updateScore(Node* node, double newScore);
+
+  // 1-based rank of the member, or 0 if it is not in the list.
+  size_t rank(double score, std::string_view member) const;
+  // The node at a 1-based rank, or null past the end.
+  Node* byRank(size_t rank) const;
+
+  // The first and last nodes whose score lies in range, or null.
+  Node* firstInRange(const ScoreRange& range) const;
+  Node* lastInRange(const ScoreRange& range) const;
+
+ private:
+  static Node* createNode(int level, double score, std::string_view member);
+  static size_t nodeSize(int level, size_t memberLength);
+  static int randomLevel();
+
+  // Finds the last node before (score, member) on every level, and each
+  // one's rank, as insertion and removal need them.
+  void findPredecessors(double score, std::string_view member,
+                        Node** update, size_t* rank) const;
+  void link(Node* node, Node** update, const size_t* rank);
+  void unlink(Node* node, Node** update);
+
+  Node* head_;
+  Node* tail_ = nullptr;
+  size_t length_ = 0;
+  int level_ = 1;
+  size_t bytes_ = 0;
+};
+
+}  // namespace redis
+
+#endif  // REDIS_SKIP_LIST_H
@@ -0,0 +1,104 @@
+#ifndef REDIS_SLAB_ALLOCATOR_H
+#define REDIS_SLAB_ALLOCATOR_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace redis {
+
+// Size-class slabs for keyspace entries. Each thread that runs commands
+// has its own allocator, so the hot path takes no lock: objects of up to
+// kMaxObjectBytes are rounded up to one of 32 classes (16-byte steps to
+// 256, then 32 and 64) and carved out of 64 KiB slabs of that class.
+// Larger ones go to operator new.
+//
+// A slab is aligned to its size, so the slab of any object, and the
+// allocator that owns it, is found from the address alone. An object
+// freed on another thread, as the lazyfree thread does, is pushed onto
+// its owner's lock-free list and taken back on the owner's next
+// allocation.
+//
+// Slabs come from 4 MiB chunks mapped from the kernel; an emptied slab's
+// pages are handed back with madvise and the slab is reused. What cannot
+// be handed back is the space between live objects in part-empty slabs:
+// active defrag (see shouldMove) moves objects out of the emptiest ones.
+class SlabAllocator {
+ public:
+  static constexpr size_t kSlabBytes = 64 * 1024;
+  static constexpr size_t kMaxObjectBytes = 1024;
+  static constexpr size_t kClasses = 32;
+
+  struct Stats {
+    // Bytes of the live objects, each rounded up to its class.
+    size_t allocated = 0;
+    // Bytes of the slabs holding them.
+    size_t active = 0;
+  };
+
+  // The calling thread's allocator, created on first use and never
+  // destroyed, since objects may be freed after their thread has ended.
+  static SlabAllocator& local();
+
+  SlabAllocator(const SlabAllocator&) = delete;
+  SlabAllocator& operator=(const SlabAllocator&) = delete;
+
+  void* allocate(size_t size);
+  // Frees an object of size bytes, from any thread.
+  static void deallocate(void* p, size_t size);
+
+  // Whether moving the object to a new allocation would help free its
+  // slab: it sits in a slab emptier than its class average, and not in the
+  // one allocations are taken from. Objects of other threads' allocators
+  // always move. The defrag hint jemalloc gives Redis.
+  bool shouldMove(const void* p, size_t size) const;
+
+  // Takes back the objects other threads freed.
+  void reclaimRemoteFrees();
+
+  // Slabs only; objects beyond kMaxObjectBytes are not counted.
+  Stats stats() const;
+
+ private:
+  struct Slab;
+
+  struct SizeClass {
+    // Where allocations come from until it fills up.
+    Slab* current = nullptr;
+    // Slabs neither full nor current, most recently part-freed first.
+    Slab* partial = nullptr;
+    size_t slabs = 0;
+    size_t used = 0;
+  };
+
+  SlabAllocator() = default;
+
+  static size_t classOf(size_t size);
+  static size_t classSize(size_t index);
+  static Slab* slabOf(const void* p);
+
+  Slab* nextSlab(size_t index);
+  Slab* newSlab(size_t index);
+  void releaseSlab(Slab* slab);
+  void freeLocal(Slab* slab, void* p);
+  void linkPartial(SizeClass& cls, Slab* slab);
+  void unlinkPartial(SizeClass& cls, Slab* slab);
+
+  std::array<SizeClass, kClasses> classes_;
+  // Uncarved remainder of the newest chunk.
+  char* chunkNext_ = nullptr;
+  char* chunkEnd_ = nullptr;
+  // Emptied slabs, their pages already given back.
+  std::vector<Slab*> freeSlabs_;
+  // Objects freed by other threads, linked through their first word.
+  std::atomic<void*> remoteFrees_{nullptr};
+};
+
+// The process's resident set size, or 0 where /proc is not available.
+size_t residentMemory();
+
+}  // namespace redis
+
+#endif  // REDIS_SLAB_ALLOCATOR_H
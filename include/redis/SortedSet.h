@@ -0,0 +1,87 @@
+#ifndef REDIS_SORTED_SET_H
+#define REDIS_SORTED_SET_H
+
+#include <cstddef>
+#include <functional>
+#include <optional>
+#include <string_view>
+
+#include "redis/Dict.h"
+#include "redis/SkipList.h"
+
+namespace redis {
+
+class Entry;
+
+// When a sorted set outgrows its listpack, like zset-max-listpack-entries
+// and zset-max-listpack-value.
+struct SortedSetLimits {
+  size_t maxListpackEntries = 128;
+  size_t maxListpackValue = 64;
+};
+
+struct SkipListNodeTraits {
+  static std::string_view key(const SkipList::Node* node) {
+    return node->member();
+  }
+};
+
+// The large encoding, as in Redis: the skiplist orders members for rank and
+// range queries, and a dictionary of its nodes answers score lookups in
+// O(1).
+class SkipListSet {
+ public:
+  size_t size() const { return list_.size(); }
+  size_t memoryUsage() const;
+
+  const SkipList& list() const { return list_; }
+  const SkipList::Node* find(std::string_view member) const;
+  // Returns true when the member is new.
+  bool set(std::string_view member, double score);
+  bool remove(std::string_view member);
+
+ private:
+  SkipList list_;
+  Dict<SkipList::Node*, SkipListNodeTraits> members_;
+};
+
+// Visits a member and its score.
+using ScoredMemberVisitor = std::function<void(std::string_view, double)>;
+
+// The sorted set stored in an entry, over whichever encoding it has. A small
+// set is a listpack of alternating members and scores, kept in (score,
+// member) order, so ranges are a walk over one buffer; it becomes a
+// SkipListSet for good once it holds more than maxListpackEntries members
+// or a member longer than maxListpackValue. A view, like Hash.
+class SortedSet {
+ public:
+  SortedSet(Entry& entry, const SortedSetLimits& limits)
+      : entry_(&entry), limits_(&limits) {}
+
+  size_t size() const;
+  std::optional<double> score(std::string_view member) const;
+  // Adds the member or moves it to score. Returns true when it is new.
+  bool set(std::string_view member, double score);
+  bool remove(std::string_view member);
+  // 0-based rank, counted from the highest score with reverse.
+  std::optional<size_t> rank(std::string_view member, bool reverse) const;
+
+  // Visits the members at ranks start to stop inclusive, which must lie
+  // within the set.
+  void forRankRange(size_t start, size_t stop, bool reverse,
+                    const ScoredMemberVisitor& visit) const;
+  // Visits the members scored within range, in order or from the highest
+  // with reverse, skipping offset of them and stopping after count.
+  void forScoreRange(const ScoreRange& range, bool reverse, size_t offset,
+                     size_t count, const ScoredMemberVisitor& visit) const;
+
+ private:
+  SkipListSet& convertToSkipList();
+
+  Entry* entry_;
+  const SortedSetLimits* limits_;
+};
+
+}  // namespace redis
+
+#endif  // REDIS_SORTED_SET_H
@@ -2,42 +2,304 @@
 #define REDIS_STORAGE_H
 
 #include <chrono>
-#include <mutex>
+#include <cstdint>
+#include <functional>
 #include <optional>
+#include <span>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <vector>
+
+#include "redis/Dict.h"
+#include "redis/Entry.h"
+#include "redis/Eviction.h"
+#include "redis/Hash.h"
+#include "redis/Set.h"
+#include "redis/SortedSet.h"
 
 namespace redis {
 
-struct ValueWithExpiry {
-  std::string value;
-  std::chrono::steady_clock::time_point expiryTime;
-  bool hasExpiry;
+class Quicklist;
+class Stream;
+
+struct EntryTraits {
+  static std::string_view key(const EntryPtr& entry) { return entry->key(); }
+};
+
+// The expires index holds non-owning pointers to the keyspace entries that
+// carry a TTL.
+struct ExpiringEntryTraits {
+  static std::string_view key(const Entry* entry) { return entry->key(); }
+};
+
+enum class ExpireCycle {
+  Slow,  // from serverCron, with the configured budget
+  Fast,  // before the loop sleeps, when the last slow cycle ran out of time
+};
+
+struct ExpireStats {
+  uint64_t expiredKeys = 0;
+  // Running estimate of the share of volatile keys that are already
+  // expired but not yet reclaimed.
+  double expiredStalePerc = 0.0;
+  uint64_t timeCapReachedCount = 0;
+  int64_t avgTtlMs = 0;
+};
 
-  ValueWithExpiry() : hasExpiry(false) {}
-  ValueWithExpiry(const std::string& val) : value(val), hasExpiry(false) {}
-  ValueWithExpiry(const std::string& val,
-                  std::chrono::steady_clock::time_point expiry)
-      : value(val), expiryTime(expiry), hasExpiry(true) {}
+// Active defrag, after Redis's activedefrag settings. A pass over the
+// keyspace starts once the slabs hold at least ignoreBytes and 10% more
+// than their objects need, and each cron tick gives it between
+// cycleMinPercent and cycleMaxPercent of the CPU, more the worse the
+// fragmentation.
+struct DefragLimits {
+  bool enabled = false;
+  size_t ignoreBytes = 100 * 1024 * 1024;
+  int cycleMinPercent = 1;
+  int cycleMaxPercent = 25;
 };
 
+struct DefragStats {
+  bool running = false;
+  // Entries moved, and entries looked at but left where they were.
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+};
+
+// How a counter update went.
+enum class IncrStatus {
+  Ok,
+  WrongType,  // the key holds something other than a string
+  NotNumber,  // the string does not parse as the counter's kind of number
+  Overflow,   // the result does not fit, or is not finite
+};
+
+// The keyspace. Not thread-safe: a Storage is owned by the one thread that
+// executes commands against it, which is the event loop, or one shard's
+// loop in --shards mode. Other threads reach it by message passing.
 class Storage {
  public:
   Storage() = default;
+  ~Storage();
 
-  void set(const std::string& key, const std::string& value);
-  void setWithExpiry(const std::string& key, const std::string& value,
+  void set(std::string_view key, std::string_view value);
+  // A TTL past the end of the clock is capped there.
+  void setWithExpiry(std::string_view key, std::string_view value,
                      int64_t expiryMs);
-  std::optional<std::string> get(const std::string& key);
-  std::vector<std::string> getAllKeys();
+  // Whether a TTL from a command is positive and its deadline fits the
+  // clock, as Redis requires of SET PX.
+  static bool isValidExpiry(int64_t expiryMs);
+  std::optional<std::string> get(std::string_view key);
+  // Like get, but avoids allocating: see StringValue.
+  std::optional<StringValue> getString(std::string_view key);
+  bool contains(std::string_view key);
+  // Counters, for INCR and friends. A missing key counts from 0 and an
+  // existing one keeps its TTL. An integer-encoded value is updated in
+  // place: no lookup past the first, no text and no allocation.
+  IncrStatus incrementBy(std::string_view key, int64_t delta,
+                         int64_t& value);
+  // INCRBYFLOAT: the result is stored as Redis prints it, see
+  // formatLongDouble.
+  IncrStatus incrementByFloat(std::string_view key, long double delta,
+                              long double& value);
+  // Strings edited in place, for the bitmap and HyperLogLog commands, the
+  // same way as lists: findMutableString returns null for a missing key
+  // and sets wrongType when the key holds another type. The string keeps
+  // its TTL.
+  std::string* findMutableString(std::string_view key, bool& wrongType);
+  // Stores an empty string under key, replacing any value.
+  std::string& createMutableString(std::string_view key);
+  // The live entry for key, or null; an expired key is erased first.
+  const Entry* lookup(std::string_view key);
+  // Returns whether the key existed. With lazy, a large value is freed on
+  // the lazyfree thread.
+  bool remove(std::string_view key, bool lazy = false);
+
+  // Lists. findList returns null for a missing key and sets wrongType
+  // when the key holds another type. Lists are never left empty: the
+  // caller removes one its pop has emptied.
+  Quicklist* findList(std::string_view key, bool& wrongType);
+  // Stores an empty list under key, replacing any value.
+  Quicklist& createList(std::string_view key,
+                        std::optional<int64_t> expiryMs = std::nullopt);
+
+  // Hashes, the same way: findHash returns nothing for a missing key and
+  // the caller removes a hash its HDEL has emptied.
+  std::optional<Hash> findHash(std::string_view key, bool& wrongType);
+  // Stores an empty hash under key, replacing any value.
+  Hash createHash(std::string_view key,
+                  std::optional<int64_t> expiryMs = std::nullopt);
+  void setHashLimits(const HashLimits& limits) { hashLimits_ = limits; }
+
+  // Sorted sets, the same way again.
+  std::optional<SortedSet> findSortedSet(std::string_view key,
+                                         bool& wrongType);
+  SortedSet createSortedSet(std::string_view key,
+                            std::optional<int64_t> expiryMs = std::nullopt);
+  void setSortedSetLimits(const SortedSetLimits& limits) {
+    sortedSetLimits_ = limits;
+  }
+
+  // Sets, the same way again.
+  std::optional<Set> findSet(std::string_view key, bool& wrongType);
+  Set createSet(std::string_view key,
+                std::optional<int64_t> expiryMs = std::nullopt);
+  void setSetLimits(const SetLimits& limits) { setLimits_ = limits; }
+
+  // Streams, like lists. XADD creates them and they may stay empty.
+  Stream* findStream(std::string_view key, bool& wrongType);
+  Stream& createStream(std::string_view key);
+
+  // Blocking pops, like Redis's blocking_keys and ready_keys: the server
+  // registers the keys its blocked clients wait on, and a write that gives
+  // one of them data marks it ready to be served after the command.
+  void addBlockingKey(std::string_view key);
+  void removeBlockingKey(std::string_view key);
+  void signalKeyAsReady(std::string_view key);
+  bool hasReadyKeys() const { return !readyKeys_.empty(); }
+  std::vector<std::string> takeReadyKeys();
+
+  // Multi-key access for MGET, MSET, DEL and friends. Keys are taken in
+  // small windows: every key of a window is hashed and its bucket
+  // prefetched before the first one is probed, so the cache misses of a
+  // large batch overlap instead of queueing up one key at a time.
+  //
+  // Calls visit with each key's live entry, or null, in key order.
+  void getMany(std::span<const std::string_view> keys,
+               const std::function<void(const Entry*)>& visit);
+  // keyValues alternates keys and values.
+  void setMany(std::span<const std::string_view> keyValues);
+  // Returns how many of the keys existed and were removed. With lazy
+  // (UNLINK), large values are freed on the lazyfree thread.
+  size_t removeMany(std::span<const std::string_view> keys, bool lazy);
+
+  // Drops every key (FLUSHALL/FLUSHDB). A lazy flush swaps in empty tables
+  // and leaves freeing the old ones to the lazyfree thread.
+  void flush(bool lazy);
+
+  // lazyfree-lazy-expire: free large expired values in the background.
+  void setLazyFreeExpire(bool lazy) { lazyFreeExpire_ = lazy; }
+  // Visits every live key, dropping expired ones on the way.
+  void forEachKey(const std::function<void(std::string_view)>& visit);
+  // One SCAN step: visits the live entries of a slice of the keyspace and
+  // returns the cursor of the next step, 0 once every key has been seen.
+  // Keys present for the whole scan are visited at least once, even across
+  // a resize. Expired keys met on the way are dropped; visit must not
+  // modify the keyspace.
+  uint64_t scan(uint64_t cursor,
+                const std::function<void(const Entry&)>& visit);
+
+  size_t size() const;
+  size_t expiresSize() const;
+  ExpireStats expireStats() const;
+
+  // maxmemory, 0 for none, and what to evict to stay under it.
+  void setMaxMemory(size_t bytes) { maxMemory_ = bytes; }
+  size_t maxMemory() const { return maxMemory_; }
+  void setEvictionPolicy(EvictionPolicy policy) { evictionPolicy_ = policy; }
+  EvictionPolicy evictionPolicy() const { return evictionPolicy_; }
+  // The entries' memoryUsage() plus both tables, kept as a running total
+  // as keys come and go rather than measured. Collections change size
+  // through the handles find and create return, so the entries handed out
+  // since the last call are measured again here; call it between
+  // commands.
+  size_t usedMemory();
+  // Evicts keys by the policy until usedMemory() is within maxmemory, the
+  // way Redis does before each command: candidates are sampled into a
+  // pool that keeps the best of them across calls. Returns false when it
+  // cannot get there, under noeviction or with nothing left to evict. A
+  // call that runs out of time returns true and the next one carries on.
+  bool performEvictions();
+  uint64_t evictedKeys() const { return evictedKeys_; }
+  // Adds this keyspace's usedMemory() to processUsedMemory(), the sum over
+  // every shard's Storage as of their last call.
+  void publishUsedMemory();
+  static size_t processUsedMemory();
+
+  void setDefragLimits(const DefragLimits& limits) { defragLimits_ = limits; }
+  // One cron tick of active defrag: moves entries out of the emptiest
+  // slabs of the thread's SlabAllocator, so that those slabs can be given
+  // back, for up to the tick's share of period. A pass resumes where the
+  // last tick stopped.
+  void activeDefragCycle(std::chrono::microseconds period);
+  DefragStats defragStats() const { return defragStats_; }
+
+  // Spends up to budget moving entries into a resized table so reads do not
+  // have to wait for writes to finish a rehash. Returns true while work
+  // remains.
+  bool activeRehash(std::chrono::microseconds budget);
+
+  // Reclaims expired keys by sampling the expires index, Redis style: keep
+  // sampling while more than 10% of a sample was expired, but never past
+  // budget.
+  void activeExpireCycle(ExpireCycle type, std::chrono::microseconds budget);
+  // True when the last slow cycle stopped on its budget with stale keys
+  // left, so a fast cycle before sleeping is worthwhile.
+  bool needsFastExpireCycle() const;
 
  private:
-  std::unordered_map<std::string, ValueWithExpiry> data_;
-  mutable std::mutex mutex_;
+  using Keyspace = Dict<EntryPtr, EntryTraits>;
+  using ExpiresIndex = Dict<Entry*, ExpiringEntryTraits>;
+
+  Keyspace data_;
+  ExpiresIndex expires_;
+
+  uint64_t expireCursor_ = 0;
+  bool expireTimeLimitHit_ = false;
+  std::chrono::steady_clock::time_point lastFastExpireCycle_;
+  ExpireStats expireStats_;
+  bool lazyFreeExpire_ = false;
+  HashLimits hashLimits_;
+  SortedSetLimits sortedSetLimits_;
+  SetLimits setLimits_;
+
+  size_t maxMemory_ = 0;
+  EvictionPolicy evictionPolicy_ = EvictionPolicy::NoEviction;
+  EvictionPool evictionPool_;
+  std::string evictionKey_;
+  uint64_t evictedKeys_ = 0;
+  uint64_t random_ = 0x9e3779b97f4a7c15;
+
+  // Sum of the entries' memoryUsage(), as last measured: for an unsettled
+  // entry, the size recorded in pending_.
+  size_t entriesBytes_ = 0;
+  struct PendingEntry {
+    Entry* entry;
+    size_t bytes;
+  };
+  std::vector<PendingEntry> pending_;
+  size_t publishedMemory_ = 0;
+
+  DefragLimits defragLimits_;
+  DefragStats defragStats_;
+  uint64_t defragCursor_ = 0;
+
+  struct BlockingKey {
+    size_t waiters = 0;
+    bool ready = false;
+  };
+  std::unordered_map<std::string, BlockingKey> blockingKeys_;
+  std::vector<std::string> readyKeys_;
 
-  void removeExpiredKey(const std::string& key);
+  void store(Entry* entry);
+  // Marks an entry handed out for writing, so its size is measured again.
+  void markUnsettled(Entry* entry);
+  // Measures the unsettled entries and clears the marks.
+  void settle();
+  // Takes an entry about to be destroyed out of the total and returns its
+  // size.
+  size_t untrack(const Entry& entry);
+  // Records an access, for the eviction policy.
+  void touch(Entry* entry, int64_t now);
+  uint64_t nextRandom();
+  bool evictOne();
+  void sampleForEviction();
+  // Removes a key found expired and counts it.
+  bool expire(std::string_view key);
+  void removeExpired(const std::vector<const Entry*>& expired);
+  Entry* lookupEntry(std::string_view key);
 };
 
 }  // namespace redis
 
-#endif  // REDIS_STORAGE_H
\ No newline at end of file
+#endif  // REDIS_STORAGE_H
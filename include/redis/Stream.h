@@ -0,0 +1,92 @@
+#ifndef REDIS_STREAM_H
+#define REDIS_STREAM_H
+
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include "redis/Listpack.h"
+#include "redis/RadixTree.h"
+
+namespace redis {
+
+// A stream entry ID: milliseconds and a sequence within the millisecond.
+struct StreamID {
+  uint64_t ms = 0;
+  uint64_t seq = 0;
+
+  static constexpr StreamID max() { return {UINT64_MAX, UINT64_MAX}; }
+
+  auto operator<=>(const StreamID&) const = default;
+
+  // "<ms>-<seq>".
+  std::string toString() const;
+};
+
+// The stream value type, after Redis's: entries are appended to blocks of
+// up to kMaxBlockEntries entries or kMaxBlockBytes, and a radix tree keyed
+// by each block's first ID finds the block holding an ID in a few steps.
+//
+// A block is a listpack. It starts with the field names of its first entry;
+// each entry stores its ID as deltas from the block's first ID, and its
+// values alone when its fields are the same as those, which is the common
+// case for an event log. So an entry costs a few bytes beyond its values,
+// instead of a map of strings.
+class Stream {
+ public:
+  // Like stream-node-max-entries and stream-node-max-bytes.
+  static constexpr size_t kMaxBlockEntries = 100;
+  static constexpr size_t kMaxBlockBytes = 4096;
+
+  // fields and values alternate.
+  using EntryVisitor =
+      std::function<void(StreamID, std::span<const std::string_view>)>;
+
+  Stream() = default;
+  ~Stream();
+
+  Stream(const Stream&) = delete;
+  Stream& operator=(const Stream&) = delete;
+
+  size_t size() const { return length_; }
+  // 0-0 while nothing was ever added.
+  StreamID lastId() const { return lastId_; }
+  size_t memoryUsage() const;
+
+  // Appends an entry; id must be above lastId() and fieldValues non-empty
+  // and even.
+  void append(StreamID id, std::span<const std::string_view> fieldValues);
+
+  // Visits the entries from start to end inclusive, in order, stopping
+  // after count.
+  void range(StreamID start, StreamID end, size_t count,
+             const EntryVisitor& visit) const;
+
+ private:
+  struct Block {
+    StreamID first;
+    Listpack entries;
+    size_t count = 0;
+    size_t masterFields = 0;
+    Block* next = nullptr;
+  };
+
+  // Radix keys are IDs in big-endian bytes, so they sort like the IDs.
+  static std::string radixKey(StreamID id);
+
+  RadixTree<Block*> index_;
+  Block* head_ = nullptr;
+  Block* tail_ = nullptr;
+  size_t length_ = 0;
+  StreamID lastId_;
+  size_t blocks_ = 0;
+  size_t bytes_ = 0;
+};
+
+}  // namespace redis
+
+#endif  // REDIS_STREAM_H
@@ -0,0 +1,115 @@
+#ifndef REDIS_STRING_UTIL_H
+#define REDIS_STRING_UTIL_H
+
+#include <charconv>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string_view>
+
+namespace redis {
+
+constexpr char toLowerAscii(char c) {
+  return (c >= 'A' && c <= 'Z') ? static_cast<char>(c + ('a' - 'A')) : c;
+}
+
+constexpr bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+  if (a.size() != b.size()) return false;
+  for (size_t i = 0; i < a.size(); i++) {
+    if (toLowerAscii(a[i]) != toLowerAscii(b[i])) return false;
+  }
+  return true;
+}
+
+// Parses a whole argument as a signed 64-bit integer.
+inline bool parseInt64(std::string_view str, int64_t& value) {
+  if (str.empty()) return false;
+  auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+  return ec == std::errc() && ptr == str.data() + str.size();
+}
+
+// Parses a whole argument as an unsigned 64-bit integer, e.g. a cursor.
+inline bool parseUint64(std::string_view str, uint64_t& value) {
+  if (str.empty()) return false;
+  auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+  return ec == std::errc() && ptr == str.data() + str.size();
+}
+
+// Like parseInt64, but only accepts the form the integer prints as (no sign
+// on zero, no leading zeros), so the original string can be rebuilt exactly.
+inline bool parseCanonicalInt64(std::string_view str, int64_t& value) {
+  if (str.empty() || str.size() > 20) return false;
+  bool negative = str[0] == '-';
+  std::string_view digits = negative ? str.substr(1) : str;
+  if (digits.empty() || (digits[0] == '0' && (negative || str.size() > 1))) {
+    return false;
+  }
+  return parseInt64(str, value);
+}
+
+// Parses a whole argument as a double, as scores are given: "inf", "+inf"
+// and "-inf" are accepted, NaN is not.
+inline bool parseDouble(std::string_view str, double& value) {
+  if (str.size() > 1 && str[0] == '+' && str[1] != '-') {
+    str.remove_prefix(1);
+  }
+  if (str.empty()) return false;
+  auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+  return ec == std::errc() && ptr == str.data() + str.size() &&
+         !std::isnan(value);
+}
+
+// Parses a whole argument as a long double, as INCRBYFLOAT takes them: no
+// NaN and no leading whitespace.
+inline bool parseLongDouble(std::string_view str, long double& value) {
+  if (str.size() > 1 && str[0] == '+' && str[1] != '-') {
+    str.remove_prefix(1);
+  }
+  if (str.empty()) return false;
+  auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+  return ec == std::errc() && ptr == str.data() + str.size() &&
+         !std::isnan(value);
+}
+
+// Enough for any double formatDouble writes.
+inline constexpr size_t kMaxDoubleChars = 32;
+
+// The shortest text that parses back to value, as Redis 7 formats scores;
+// infinities print as "inf" and "-inf".
+inline std::string_view formatDouble(double value,
+                                     char (&buf)[kMaxDoubleChars]) {
+  auto result = std::to_chars(buf, buf + kMaxDoubleChars, value);
+  return std::string_view(buf, result.ptr - buf);
+}
+
+// Enough for any finite long double in fixed notation.
+inline constexpr size_t kMaxLongDoubleChars = 5 * 1024;
+
+// Fixed notation with 17 decimals and the trailing zeros trimmed, as Redis
+// formats INCRBYFLOAT results: the extra precision of the sum is rounded
+// away, so adding 0.1 ten times gives "1".
+inline std::string_view formatLongDouble(long double value,
+                                         char (&buf)[kMaxLongDoubleChars]) {
+  int written = std::snprintf(buf, kMaxLongDoubleChars, "%.17Lf", value);
+  std::string_view text(buf, static_cast<size_t>(written));
+  if (text.find('.') != std::string_view::npos) {
+    while (text.back() == '0') text.remove_suffix(1);
+    if (text.back() == '.') text.remove_suffix(1);
+  }
+  if (text == "-0") text = "0";
+  return text;
+}
+
+// Enough for any 64-bit integer, sign included.
+inline constexpr size_t kMaxInt64Chars = 20;
+
+inline std::string_view formatInt64(int64_t value,
+                                    char (&buf)[kMaxInt64Chars]) {
+  auto result = std::to_chars(buf, buf + kMaxInt64Chars, value);
+  return std::string_view(buf, result.ptr - buf);
+}
+
+}  // namespace redis
+
+#endif  // REDIS_STRING_UTIL_H
@@ -0,0 +1,112 @@
+#ifndef REDIS_URING_LOOP_H
+#define REDIS_URING_LOOP_H
+
+#include <linux/io_uring.h>
+#include <sys/socket.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace redis {
+
+// Minimal io_uring driver on the raw syscalls, for the completion-based
+// backend (--io-backend io_uring). Sockets are read with multishot recv
+// into a ring of kernel-provided buffers, and everything prepared during a
+// loop iteration goes to the kernel in one io_uring_enter.
+class UringLoop {
+ public:
+  struct Completion {
+    uint64_t userData;
+    int32_t result;
+    uint32_t flags;
+  };
+
+  UringLoop();
+  ~UringLoop();
+
+  UringLoop(const UringLoop&) = delete;
+  UringLoop& operator=(const UringLoop&) = delete;
+
+  // Sets up the rings and registers bufferCount receive buffers of
+  // bufferSize bytes. Returns false when the kernel lacks io_uring or any
+  // feature the backend relies on, so the caller can fall back to epoll.
+  bool init(unsigned entries, unsigned bufferCount, unsigned bufferSize);
+
+  // Operations are only queued here; they reach the kernel on submit.
+  void prepareMultishotAccept(int fd, uint64_t userData);
+  void prepareMultishotRecv(int fd, uint64_t userData);
+  // Level-style readiness for eventfds and timerfds.
+  void prepareMultishotPoll(int fd, uint64_t userData);
+  void prepareSendmsg(int fd, const msghdr* message, uint64_t userData);
+  // Cancels every operation still pending on fd.
+  void prepareCancelFd(int fd, uint64_t userData);
+  // Cancels the one pending operation submitted with user data target.
+  void prepareCancel(uint64_t target, uint64_t userData);
+
+  // Submits the queued operations and, if wait is set, blocks until at
+  // least one completion is available. Returns the number of completions
+  // collected, or -1 on error; they stay valid until the next call.
+  int submitAndWait(bool wait);
+  const Completion& completion(int i) const { return completions_[i]; }
+
+  static bool hasMore(uint32_t flags) { return flags & IORING_CQE_F_MORE; }
+  static bool hasBuffer(uint32_t flags) { return flags & IORING_CQE_F_BUFFER; }
+  static uint16_t bufferId(uint32_t flags) {
+    return static_cast<uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT);
+  }
+
+  // Bytes the kernel received into a provided buffer; the buffer goes
+  // back to the kernel with recycleBuffer once they are consumed.
+  std::string_view buffer(uint16_t id, size_t length) const {
+    return std::string_view(buffers_ + static_cast<size_t>(id) * bufferSize_,
+                            length);
+  }
+  void recycleBuffer(uint16_t id);
+
+ private:
+  static constexpr uint16_t kBufferGroup = 0;
+
+  io_uring_sqe* nextSqe();
+  int enter(unsigned toSubmit, unsigned minComplete, unsigned flags);
+  bool probeOps();
+  void publishBuffers();
+
+  int ringFd_;
+
+  // Mapped ring regions.
+  void* sqRing_;
+  size_t sqRingSize_;
+  void* cqRing_;
+  size_t cqRingSize_;
+  io_uring_sqe* sqes_;
+  size_t sqesSize_;
+
+  unsigned* sqHead_;
+  unsigned* sqTail_;
+  unsigned sqMask_;
+  unsigned sqEntries_;
+  unsigned* cqHead_;
+  unsigned* cqTail_;
+  unsigned cqMask_;
+  io_uring_cqe* cqes_;
+  // SQEs filled in but not yet handed to the kernel.
+  unsigned sqLocalTail_;
+  unsigned toSubmit_;
+
+  // Provided buffer ring and the buffers it points at.
+  io_uring_buf_ring* bufRing_;
+  size_t bufRingSize_;
+  char* buffers_;
+  size_t buffersSize_;
+  unsigned bufferCount_;
+  unsigned bufferSize_;
+  uint16_t bufLocalTail_;
+
+  std::vector<Completion> completions_;
+};
+
+}  // namespace redis
+
+#endif  // REDIS_URING_LOOP_H
@@ -0,0 +1,256 @@
+#include "redis/Bitmap.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+#include "redis/Cpu.h"
+
+#if defined(REDIS_X86_DISPATCH)
+#include <immintrin.h>
+#endif
+
+namespace redis {
+
+namespace {
+
+const bool kHasAvx2 = cpuHasAvx2();
+const bool kHasPopcnt = cpuHasPopcnt();
+
+uint64_t loadWord(const char* p) {
+  uint64_t word;
+  std::memcpy(&word, p, sizeof(word));
+  return word;
+}
+
+uint8_t byteAt(std::string_view bytes, size_t i) {
+  return i < bytes.size() ? static_cast<uint8_t>(bytes[i]) : 0;
+}
+
+uint64_t countBitsWords(const char* p, size_t size) {
+  uint64_t count = 0;
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    count += std::popcount(loadWord(p + i));
+  }
+  for (; i < size; i++) {
+    count += std::popcount(static_cast<uint8_t>(p[i]));
+  }
+  return count;
+}
+
+#if defined(REDIS_X86_DISPATCH)
+// Four words per step into separate sums, so the adds do not wait on each
+// other.
+__attribute__((target("popcnt"))) uint64_t countBitsPopcnt(const char* p,
+                                                           size_t size) {
+  uint64_t sums[4] = {};
+  size_t i = 0;
+  for (; i + 32 <= size; i += 32) {
+    for (size_t k = 0; k < 4; k++) {
+      sums[k] += __builtin_popcountll(loadWord(p + i + k * 8));
+    }
+  }
+  return sums[0] + sums[1] + sums[2] + sums[3] +
+         countBitsWords(p + i, size - i);
+}
+
+// Looks up the count of each nibble with a byte shuffle, adds the counts
+// up bytewise for eight blocks, at most 64 per byte, then widens them into
+// four 64-bit sums.
+__attribute__((target("avx2,popcnt"))) uint64_t countBitsAvx2(const char* p,
+                                                              size_t size) {
+  const __m256i lookup =
+      _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1,
+                       1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  const __m256i lowNibbles = _mm256_set1_epi8(0x0f);
+  __m256i sums = _mm256_setzero_si256();
+  size_t i = 0;
+  while (i + 32 <= size) {
+    __m256i counts = _mm256_setzero_si256();
+    for (size_t block = 0; block < 8 && i + 32 <= size; block++, i += 32) {
+      __m256i v =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+      __m256i lo = _mm256_and_si256(v, lowNibbles);
+      __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), lowNibbles);
+      counts = _mm256_add_epi8(
+          counts, _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo),
+                                  _mm256_shuffle_epi8(lookup, hi)));
+    }
+    sums = _mm256_add_epi64(
+        sums, _mm256_sad_epu8(counts, _mm256_setzero_si256()));
+  }
+  alignas(32) uint64_t lanes[4];
+  _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), sums);
+  return lanes[0] + lanes[1] + lanes[2] + lanes[3] +
+         countBitsPopcnt(p + i, size - i);
+}
+#endif
+
+template <BitOp kOp, typename T>
+T apply(T a, T b) {
+  if constexpr (kOp == BitOp::And) {
+    return a & b;
+  } else if constexpr (kOp == BitOp::Or) {
+    return a | b;
+  } else {
+    return a ^ b;
+  }
+}
+
+// Combines the first size bytes of every source a word at a time, starting
+// at from.
+template <BitOp kOp>
+void combineWords(std::span<const std::string_view> sources, size_t from,
+                  size_t size, char* out) {
+  size_t i = from;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t word = loadWord(sources[0].data() + i);
+    for (size_t k = 1; k < sources.size(); k++) {
+      word = apply<kOp>(word, loadWord(sources[k].data() + i));
+    }
+    if constexpr (kOp == BitOp::Not) {
+      word = ~word;
+    }
+    std::memcpy(out + i, &word, sizeof(word));
+  }
+  for (; i < size; i++) {
+    uint8_t byte = static_cast<uint8_t>(sources[0][i]);
+    for (size_t k = 1; k < sources.size(); k++) {
+      byte = apply<kOp>(byte, static_cast<uint8_t>(sources[k][i]));
+    }
+    if constexpr (kOp == BitOp::Not) {
+      byte = static_cast<uint8_t>(~byte);
+    }
+    out[i] = static_cast<char>(byte);
+  }
+}
+
+#if defined(REDIS_X86_DISPATCH)
+// The same 32 bytes at a time; returns how many bytes it covered.
+template <BitOp kOp>
+__attribute__((target("avx2"))) size_t combineAvx2(
+    std::span<const std::string_view> sources, size_t size, char* out) {
+  size_t i = 0;
+  for (; i + 32 <= size; i += 32) {
+    __m256i acc = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(sources[0].data() + i));
+    for (size_t k = 1; k < sources.size(); k++) {
+      __m256i v = _mm256_loadu_si256(
+          reinterpret_cast<const __m256i*>(sources[k].data() + i));
+      if constexpr (kOp == BitOp::And) {
+        acc = _mm256_and_si256(acc, v);
+      } else if constexpr (kOp == BitOp::Or) {
+        acc = _mm256_or_si256(acc, v);
+      } else {
+        acc = _mm256_xor_si256(acc, v);
+      }
+    }
+    if constexpr (kOp == BitOp::Not) {
+      acc = _mm256_xor_si256(acc, _mm256_set1_epi8(-1));
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), acc);
+  }
+  return i;
+}
+#endif
+
+template <BitOp kOp>
+void combine(std::span<const std::string_view> sources, size_t size,
+             char* out) {
+  size_t done = 0;
+#if defined(REDIS_X86_DISPATCH)
+  if (kHasAvx2) {
+    done = combineAvx2<kOp>(sources, size, out);
+  }
+#endif
+  combineWords<kOp>(sources, done, size, out);
+}
+
+}  // namespace
+
+uint64_t countBits(std::string_view bytes) {
+#if defined(REDIS_X86_DISPATCH)
+  if (kHasAvx2) {
+    return countBitsAvx2(bytes.data(), bytes.size());
+  }
+  if (kHasPopcnt) {
+    return countBitsPopcnt(bytes.data(), bytes.size());
+  }
+#endif
+  return countBitsWords(bytes.data(), bytes.size());
+}
+
+int64_t findBit(std::string_view bytes, uint64_t firstBit, uint64_t lastBit,
+                bool bit) {
+  const auto* p = reinterpret_cast<const uint8_t*>(bytes.data());
+  // Looks for set bits in the bytes, complemented when the bit sought is 0.
+  uint8_t flip = bit ? 0 : 0xff;
+  uint64_t skip = bit ? 0 : ~uint64_t{0};
+  size_t first = firstBit / 8;
+  size_t last = lastBit / 8;
+  for (size_t i = first; i <= last;) {
+    // Whole words inside the range without a candidate are skipped.
+    if (i > first && i + 8 <= last && loadWord(bytes.data() + i) == skip) {
+      i += 8;
+      continue;
+    }
+    uint8_t byte = p[i] ^ flip;
+    if (i == first) {
+      byte &= 0xff >> (firstBit % 8);
+    }
+    if (i == last) {
+      byte &= static_cast<uint8_t>(0xff << (7 - lastBit % 8));
+    }
+    if (byte != 0) {
+      return static_cast<int64_t>(i * 8 + std::countl_zero(byte));
+    }
+    i++;
+  }
+  return -1;
+}
+
+void combineBits(BitOp op, std::span<const std::string_view> sources,
+                 char* out) {
+  size_t shortest = SIZE_MAX;
+  size_t longest = 0;
+  for (std::string_view source : sources) {
+    shortest = std::min(shortest, source.size());
+    longest = std::max(longest, source.size());
+  }
+  // The kernels take the bytes every source has; the rest are padded.
+  switch (op) {
+    case BitOp::And:
+      combine<BitOp::And>(sources, shortest, out);
+      break;
+    case BitOp::Or:
+      combine<BitOp::Or>(sources, shortest, out);
+      break;
+    case BitOp::Xor:
+      combine<BitOp::Xor>(sources, shortest, out);
+      break;
+    case BitOp::Not:
+      combine<BitOp::Not>(sources, shortest, out);
+      return;
+  }
+  for (size_t i = shortest; i < longest; i++) {
+    uint8_t byte = byteAt(sources[0], i);
+    for (size_t k = 1; k < sources.size(); k++) {
+      uint8_t other = byteAt(sources[k], i);
+      switch (op) {
+        case BitOp::And:
+          byte &= other;
+          break;
+        case BitOp::Or:
+          byte |= other;
+          break;
+        default:
+          byte ^= other;
+          break;
+      }
+    }
+    out[i] = static_cast<char>(byte);
+  }
+}
+
+}  // namespace redis
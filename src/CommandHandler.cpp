@@ -1,202 +1,2142 @@
 #include "redis/CommandHandler.h"
 
 #include <algorithm>
-#include <cctype>
+#include <bit>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <iterator>
+#include <optional>
 
+#include "redis/CommandTable.h"
 #include "redis/Config.h"
-#include "redis/RESPParser.h"
+#include "redis/Bitmap.h"
+#include "redis/Entry.h"
+#include "redis/Eviction.h"
+#include "redis/GlobPattern.h"
+#include "redis/HyperLogLog.h"
+#include "redis/LazyFree.h"
+#include "redis/Quicklist.h"
+#include "redis/ReplyBuffer.h"
+#include "redis/Set.h"
+#include "redis/ShardSet.h"
+#include "redis/SlabAllocator.h"
 #include "redis/Storage.h"
+#include "redis/Stream.h"
+#include "redis/StringUtil.h"
 
 namespace redis {
 
+namespace {
+
+void appendFlagNames(uint32_t flags, ReplyBuffer& out) {
+  static constexpr std::pair<CommandFlag, std::string_view> kFlagNames[] = {
+      {kCmdReadonly, "readonly"},
+      {kCmdWrite, "write"},
+      {kCmdAdmin, "admin"},
+      {kCmdBlocking, "blocking"},
+      {kCmdDenyOom, "denyoom"},
+  };
+
+  size_t count = std::count_if(
+      std::begin(kFlagNames), std::end(kFlagNames),
+      [flags](const auto& entry) { return (flags & entry.first) != 0; });
+  out.appendArrayHeader(count);
+  for (const auto& [flag, name] : kFlagNames) {
+    if (flags & flag) {
+      out.appendSimpleString(name);
+    }
+  }
+}
+
+// Whether a key argument is longer than an entry can hold. Such arguments
+// are rare enough that the key positions are only worked out once one is
+// seen.
+bool hasOversizedKey(const CommandSpec& spec,
+                     std::span<const std::string_view> argv) {
+  auto oversized = [](std::string_view arg) {
+    return arg.size() > Entry::kMaxKeyLength;
+  };
+  if (std::none_of(argv.begin(), argv.end(), oversized)) {
+    return false;
+  }
+  if (spec.findKeys != nullptr) {
+    std::span<const std::string_view> keys = spec.findKeys(argv);
+    return std::any_of(keys.begin(), keys.end(), oversized);
+  }
+  if (spec.firstKey <= 0) {
+    return false;
+  }
+  int argc = static_cast<int>(argv.size());
+  int last = spec.lastKey < 0 ? argc + spec.lastKey : spec.lastKey;
+  int step = std::max(spec.keyStep, 1);
+  for (int i = spec.firstKey; i <= last && i < argc; i += step) {
+    if (oversized(argv[i])) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// A blocking command's timeout: seconds, fractions allowed, 0 for none.
+// A positive timeout waits at least a millisecond.
+bool parseTimeout(std::string_view text, int64_t& timeoutMs,
+                  ReplyBuffer& out) {
+  constexpr double kMaxTimeoutMs = 1e15;
+  double seconds = 0;
+  auto [ptr, ec] =
+      std::from_chars(text.data(), text.data() + text.size(), seconds);
+  if (ec != std::errc() || ptr != text.data() + text.size() ||
+      !std::isfinite(seconds) || seconds * 1000 > kMaxTimeoutMs) {
+    out.appendError("ERR timeout is not a float or out of range");
+    return false;
+  }
+  if (seconds < 0) {
+    out.appendError("ERR timeout is negative");
+    return false;
+  }
+  timeoutMs = static_cast<int64_t>(std::ceil(seconds * 1000));
+  return true;
+}
+
+// One end of a score range: a float, "-inf" or "+inf", open with a leading
+// '('.
+bool parseScoreBound(std::string_view text, double& value, bool& exclusive) {
+  exclusive = !text.empty() && text[0] == '(';
+  if (exclusive) {
+    text.remove_prefix(1);
+  }
+  return parseDouble(text, value);
+}
+
+void appendScore(double score, ReplyBuffer& out) {
+  char text[kMaxDoubleChars];
+  out.appendBulkString(formatDouble(score, text));
+}
+
+// Offsets stop at 2^32 bits, a 512 MB string, as in Redis.
+constexpr uint64_t kMaxBitOffset = (uint64_t{1} << 32) - 1;
+
+bool parseBitOffset(std::string_view text, uint64_t& offset) {
+  return parseUint64(text, offset) && offset <= kMaxBitOffset;
+}
+
+// Resolves a BITCOUNT or BITPOS range over length bytes or bits: negative
+// ends count from the back, and both are clamped to the string. False
+// when nothing is left.
+bool clampRange(int64_t& start, int64_t& end, int64_t length) {
+  if (start < 0) start += length;
+  if (end < 0) end += length;
+  start = std::max<int64_t>(start, 0);
+  end = std::max<int64_t>(end, 0);
+  end = std::min(end, length - 1);
+  return start <= end;
+}
+
+constexpr std::string_view kNotHyperLogLog =
+    "-WRONGTYPE Key is not a valid HyperLogLog string value.\r\n";
+
+constexpr std::string_view kInvalidStreamId =
+    "ERR Invalid stream ID specified as stream command argument";
+
+// "<ms>-<seq>", or "<ms>" alone, which takes seq as its sequence.
+bool parseStreamId(std::string_view text, uint64_t seq, StreamID& id) {
+  size_t dash = text.find('-');
+  id.seq = seq;
+  if (dash != std::string_view::npos &&
+      !parseUint64(text.substr(dash + 1), id.seq)) {
+    return false;
+  }
+  return parseUint64(text.substr(0, dash), id.ms);
+}
+
+// The IDs just after and before id, or false at either end.
+bool nextStreamId(StreamID& id) {
+  if (id == StreamID::max()) return false;
+  id = id.seq == UINT64_MAX ? StreamID{id.ms + 1, 0}
+                            : StreamID{id.ms, id.seq + 1};
+  return true;
+}
+
+bool prevStreamId(StreamID& id) {
+  if (id == StreamID{}) return false;
+  id = id.seq == 0 ? StreamID{id.ms - 1, UINT64_MAX}
+                   : StreamID{id.ms, id.seq - 1};
+  return true;
+}
+
+// One end of an XRANGE: "-", "+", or an ID, left open with a leading '('.
+// An end given in milliseconds alone covers the whole millisecond.
+bool parseStreamBound(std::string_view text, bool isEnd, StreamID& id) {
+  if (text == "-" || text == "+") {
+    id = text == "-" ? StreamID{} : StreamID::max();
+    return true;
+  }
+  bool exclusive = !text.empty() && text[0] == '(';
+  if (exclusive) {
+    text.remove_prefix(1);
+  }
+  if (!parseStreamId(text, isEnd ? UINT64_MAX : 0, id)) {
+    return false;
+  }
+  return !exclusive || (isEnd ? prevStreamId(id) : nextStreamId(id));
+}
+
+void appendStreamEntry(StreamID id,
+                       std::span<const std::string_view> fieldValues,
+                       ReplyBuffer& out) {
+  out.appendArrayHeader(2);
+  out.appendBulkString(id.toString());
+  out.appendArrayHeader(fieldValues.size());
+  for (std::string_view text : fieldValues) {
+    out.appendBulkString(text);
+  }
+}
+
+}  // namespace
+
 CommandHandler::CommandHandler(std::shared_ptr<Config> config,
                                std::shared_ptr<Storage> storage)
-    : config_(config), storage_(storage) {}
+    : config_(config),
+      storage_(storage),
+      stats_(CommandTable::all().size()) {}
 
-std::string CommandHandler::handleCommand(
-    const std::vector<std::string>& command) {
+void CommandHandler::handleCommand(ArgList command, ReplyBuffer& out) {
   if (command.empty()) {
-    return RESPParser::encodeError("ERR empty command");
-  }
-
-  std::string cmd = command[0];
-  std::transform(cmd.begin(), cmd.end(), cmd.begin(), ::toupper);
-
-  if (cmd == "PING") {
-    return handlePing();
-  } else if (cmd == "ECHO") {
-    return handleEcho(
-        std::vector<std::string>(command.begin() + 1, command.end()));
-  } else if (cmd == "SET") {
-    return handleSet(
-        std::vector<std::string>(command.begin() + 1, command.end()));
-  } else if (cmd == "GET") {
-    return handleGet(
-        std::vector<std::string>(command.begin() + 1, command.end()));
-  } else if (cmd == "CONFIG") {
-    return handleConfig(
-        std::vector<std::string>(command.begin() + 1, command.end()));
-  } else if (cmd == "KEYS") {
-    return handleKeys(
-        std::vector<std::string>(command.begin() + 1, command.end()));
-  } else if (cmd == "INFO") {
-    return handleInfo(
-        std::vector<std::string>(command.begin() + 1, command.end()));
-  } else if (cmd == "REPLCONF") {
-    return handleReplconf(
-        std::vector<std::string>(command.begin() + 1, command.end()));
-  } else if (cmd == "PSYNC") {
-    return handlePsync(
-        std::vector<std::string>(command.begin() + 1, command.end()));
-  } else {
-    return RESPParser::encodeError("ERR unknown command '" + command[0] + "'");
+    out.appendError("ERR empty command");
+    return;
+  }
+
+  const CommandSpec* spec = CommandTable::lookup(command[0]);
+  if (spec == nullptr) {
+    out.appendError("ERR unknown command '" + std::string(command[0]) + "'");
+    return;
+  }
+
+  CommandStats& stats = stats_[CommandTable::indexOf(*spec)];
+  if (!spec->acceptsArgc(command.size())) {
+    stats.rejectedCalls++;
+    out.appendError("ERR wrong number of arguments for '" +
+                    std::string(spec->name) + "' command");
+    return;
+  }
+  if (hasOversizedKey(*spec, command)) {
+    stats.rejectedCalls++;
+    out.appendError("ERR key is too long");
+    return;
+  }
+  // Under maxmemory, room is made before the command runs; what cannot be
+  // made only refuses commands that would add data.
+  if (!storage_->performEvictions() && (spec->flags & kCmdDenyOom)) {
+    stats.rejectedCalls++;
+    out.appendRaw(reply::kOom);
+    return;
   }
-}
 
-std::string CommandHandler::handlePing() {
-  return RESPParser::encodeSimpleString("PONG");
+  auto start = std::chrono::steady_clock::now();
+  (this->*spec->handler)(command.subspan(1), out);
+  auto elapsed = std::chrono::steady_clock::now() - start;
+
+  stats.calls++;
+  stats.nanos +=
+      std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
 }
 
-std::string CommandHandler::handleEcho(const std::vector<std::string>& args) {
+void CommandHandler::handlePing(ArgList args, ReplyBuffer& out) {
   if (args.empty()) {
-    return RESPParser::encodeError(
-        "ERR wrong number of arguments for 'echo' command");
+    out.appendRaw(reply::kPong);
+  } else {
+    out.appendBulkString(args[0]);
   }
-  return RESPParser::encodeBulkString(args[0]);
 }
 
-std::string CommandHandler::handleSet(const std::vector<std::string>& args) {
-  if (args.size() < 2) {
-    return RESPParser::encodeError(
-        "ERR wrong number of arguments for 'set' command");
-  }
+void CommandHandler::handleEcho(ArgList args, ReplyBuffer& out) {
+  out.appendBulkString(args[0]);
+}
 
-  const std::string& key = args[0];
-  const std::string& value = args[1];
+void CommandHandler::handleSet(ArgList args, ReplyBuffer& out) {
+  std::string_view key = args[0];
+  std::string_view value = args[1];
 
   if (args.size() >= 4) {
-    std::string option = args[2];
-    std::transform(option.begin(), option.end(), option.begin(), ::toupper);
-
-    if (option == "PX") {
-      try {
-        int expiryMs = std::stoi(args[3]);
-        storage_->setWithExpiry(key, value, expiryMs);
-        return RESPParser::encodeSimpleString("OK");
-      } catch (const std::exception& e) {
-        return RESPParser::encodeError(
-            "ERR invalid expire time in 'set' command");
+    if (equalsIgnoreCase(args[2], "PX")) {
+      int64_t expiryMs = 0;
+      if (!parseInt64(args[3], expiryMs) ||
+          !Storage::isValidExpiry(expiryMs)) {
+        out.appendError("ERR invalid expire time in 'set' command");
+        return;
       }
+      storage_->setWithExpiry(key, value, expiryMs);
+      out.appendRaw(reply::kOk);
+      return;
     }
   }
 
   storage_->set(key, value);
-  return RESPParser::encodeSimpleString("OK");
+  out.appendRaw(reply::kOk);
 }
 
-std::string CommandHandler::handleGet(const std::vector<std::string>& args) {
-  if (args.empty()) {
-    return RESPParser::encodeError(
-        "ERR wrong number of arguments for 'get' command");
+void CommandHandler::handleGet(ArgList args, ReplyBuffer& out) {
+  const Entry* entry = storage_->lookup(args[0]);
+  if (entry == nullptr) {
+    out.appendNull();
+    return;
+  }
+  if (entry->type() != ValueType::String) {
+    out.appendRaw(reply::kWrongType);
+    return;
+  }
+  StringValue value(*entry);
+  out.appendBulkString(value.view(), value.shared());
+}
+
+void CommandHandler::handleMget(ArgList args, ReplyBuffer& out) {
+  // Values are streamed into the reply as the batch is looked up; a key
+  // holding another type reads as missing, as in Redis.
+  out.appendArrayHeader(args.size());
+  storage_->getMany(args, [&out](const Entry* entry) {
+    if (entry == nullptr || entry->type() != ValueType::String) {
+      out.appendNull();
+      return;
+    }
+    StringValue value(*entry);
+    out.appendBulkString(value.view(), value.shared());
+  });
+}
+
+void CommandHandler::handleMset(ArgList args, ReplyBuffer& out) {
+  if (args.size() % 2 != 0) {
+    out.appendError("ERR wrong number of arguments for 'mset' command");
+    return;
+  }
+  storage_->setMany(args);
+  out.appendRaw(reply::kOk);
+}
+
+void CommandHandler::handleMsetnx(ArgList args, ReplyBuffer& out) {
+  if (args.size() % 2 != 0) {
+    out.appendError("ERR wrong number of arguments for 'msetnx' command");
+    return;
+  }
+
+  std::vector<std::string_view> keys;
+  keys.reserve(args.size() / 2);
+  for (size_t i = 0; i < args.size(); i += 2) {
+    keys.push_back(args[i]);
+  }
+  bool anyExists = false;
+  storage_->getMany(keys, [&anyExists](const Entry* entry) {
+    anyExists = anyExists || entry != nullptr;
+  });
+  if (anyExists) {
+    out.appendRaw(reply::kZero);
+    return;
+  }
+  storage_->setMany(args);
+  out.appendRaw(reply::kOne);
+}
+
+void CommandHandler::incrementBy(std::string_view key, int64_t delta,
+                                 ReplyBuffer& out) {
+  int64_t value = 0;
+  switch (storage_->incrementBy(key, delta, value)) {
+    case IncrStatus::Ok:
+      out.appendInteger(value);
+      break;
+    case IncrStatus::WrongType:
+      out.appendRaw(reply::kWrongType);
+      break;
+    case IncrStatus::NotNumber:
+      out.appendRaw(reply::kNotInteger);
+      break;
+    case IncrStatus::Overflow:
+      out.appendError("ERR increment or decrement would overflow");
+      break;
+  }
+}
+
+void CommandHandler::handleIncr(ArgList args, ReplyBuffer& out) {
+  incrementBy(args[0], 1, out);
+}
+
+void CommandHandler::handleDecr(ArgList args, ReplyBuffer& out) {
+  incrementBy(args[0], -1, out);
+}
+
+void CommandHandler::handleIncrby(ArgList args, ReplyBuffer& out) {
+  int64_t delta = 0;
+  if (!parseInt64(args[1], delta)) {
+    out.appendRaw(reply::kNotInteger);
+    return;
+  }
+  incrementBy(args[0], delta, out);
+}
+
+void CommandHandler::handleDecrby(ArgList args, ReplyBuffer& out) {
+  int64_t delta = 0;
+  if (!parseInt64(args[1], delta)) {
+    out.appendRaw(reply::kNotInteger);
+    return;
+  }
+  if (delta == INT64_MIN) {
+    out.appendError("ERR decrement would overflow");
+    return;
+  }
+  incrementBy(args[0], -delta, out);
+}
+
+void CommandHandler::handleIncrbyfloat(ArgList args, ReplyBuffer& out) {
+  long double delta = 0;
+  if (!parseLongDouble(args[1], delta)) {
+    out.appendError("ERR value is not a valid float");
+    return;
+  }
+  long double value = 0;
+  switch (storage_->incrementByFloat(args[0], delta, value)) {
+    case IncrStatus::Ok: {
+      char text[kMaxLongDoubleChars];
+      out.appendBulkString(formatLongDouble(value, text));
+      break;
+    }
+    case IncrStatus::WrongType:
+      out.appendRaw(reply::kWrongType);
+      break;
+    case IncrStatus::NotNumber:
+      out.appendError("ERR value is not a valid float");
+      break;
+    case IncrStatus::Overflow:
+      out.appendError("ERR increment would produce NaN or Infinity");
+      break;
+  }
+}
+
+void CommandHandler::handleSetbit(ArgList args, ReplyBuffer& out) {
+  uint64_t offset = 0;
+  if (!parseBitOffset(args[1], offset)) {
+    out.appendError("ERR bit offset is not an integer or out of range");
+    return;
+  }
+  if (args[2] != "0" && args[2] != "1") {
+    out.appendError("ERR bit is not an integer or out of range");
+    return;
+  }
+  bool wrongType;
+  std::string* bytes = storage_->findMutableString(args[0], wrongType);
+  if (wrongType) {
+    out.appendRaw(reply::kWrongType);
+    return;
+  }
+  if (bytes == nullptr) {
+    bytes = &storage_->createMutableString(args[0]);
+  }
+
+  size_t index = offset / 8;
+  if (bytes->size() <= index) {
+    bytes->resize(index + 1, '\0');
+  }
+  auto mask = static_cast<char>(0x80 >> (offset % 8));
+  char& byte = (*bytes)[index];
+  out.appendRaw((byte & mask) != 0 ? reply::kOne : reply::kZero);
+  byte = args[2] == "1" ? (byte | mask) : (byte & ~mask);
+}
+
+void CommandHandler::handleGetbit(ArgList args, ReplyBuffer& out) {
+  uint64_t offset = 0;
+  if (!parseBitOffset(args[1], offset)) {
+    out.appendError("ERR bit offset is not an integer or out of range");
+    return;
+  }
+  const Entry* entry = storage_->lookup(args[0]);
+  if (entry != nullptr && entry->type() != ValueType::String) {
+    out.appendRaw(reply::kWrongType);
+    return;
+  }
+  bool set = false;
+  if (entry != nullptr) {
+    StringValue value(*entry);
+    std::string_view bytes = value.view();
+    set = offset / 8 < bytes.size() &&
+          (bytes[offset / 8] & (0x80 >> (offset % 8))) != 0;
+  }
+  out.appendRaw(set ? reply::kOne : reply::kZero);
+}
+
+// BITCOUNT key [start end [BYTE|BIT]]
+void CommandHandler::handleBitcount(ArgList args, ReplyBuffer& out) {
+  int64_t start = 0;
+  int64_t end = -1;
+  bool bitUnits = false;
+  if (args.size() == 2 || args.size() > 4) {
+    out.appendRaw(reply::kSyntaxError);
+    return;
+  }
+  if (args.size() >= 3 &&
+      (!parseInt64(args[1], start) || !parseInt64(args[2], end))) {
+    out.appendRaw(reply::kNotInteger);
+    return;
+  }
+  if (args.size() == 4) {
+    bitUnits = equalsIgnoreCase(args[3], "BIT");
+    if (!bitUnits && !equalsIgnoreCase(args[3], "BYTE")) {
+      out.appendRaw(reply::kSyntaxError);
+      return;
+    }
+  }
+  const Entry* entry = storage_->lookup(args[0]);
+  if (entry == nullptr) {
+    out.appendRaw(reply::kZero);
+    return;
+  }
+  if (entry->type() != ValueType::String) {
+    out.appendRaw(reply::kWrongType);
+    return;
+  }
+
+  StringValue value(*entry);
+  std::string_view bytes = value.view();
+  int64_t length = static_cast<int64_t>(bytes.size()) * (bitUnits ? 8 : 1);
+  if (!clampRange(start, end, length)) {
+    out.appendRaw(reply::kZero);
+    return;
+  }
+  if (!bitUnits) {
+    out.appendInteger(static_cast<int64_t>(
+        countBits(bytes.substr(start, end - start + 1))));
+    return;
+  }
+  // The whole bytes, less the bits of the end ones outside the range.
+  size_t first = start / 8;
+  size_t last = end / 8;
+  auto head = static_cast<uint8_t>(bytes[first] & ~(0xff >> (start % 8)));
+  auto tail = static_cast<uint8_t>(bytes[last] & (0xff >> (end % 8 + 1)));
+  uint64_t count = countBits(bytes.substr(first, last - first + 1)) -
+                   std::popcount(head) - std::popcount(tail);
+  out.appendInteger(static_cast<int64_t>(count));
+}
+
+// BITPOS key bit [start [end [BYTE|BIT]]]
+void CommandHandler::handleBitpos(ArgList args, ReplyBuffer& out) {
+  if (args.size() > 5) {
+    out.appendRaw(reply::kSyntaxError);
+    return;
+  }
+  int64_t bit = 0;
+  if (!parseInt64(args[1], bit)) {
+    out.appendRaw(reply::kNotInteger);
+    return;
+  }
+  if (bit != 0 && bit != 1) {
+    out.appendError("ERR The bit argument must be 1 or 0.");
+    return;
+  }
+  int64_t start = 0;
+  int64_t end = -1;
+  bool endGiven = args.size() >= 4;
+  if ((args.size() >= 3 && !parseInt64(args[2], start)) ||
+      (endGiven && !parseInt64(args[3], end))) {
+    out.appendRaw(reply::kNotInteger);
+    return;
+  }
+  bool bitUnits = false;
+  if (args.size() == 5) {
+    bitUnits = equalsIgnoreCase(args[4], "BIT");
+    if (!bitUnits && !equalsIgnoreCase(args[4], "BYTE")) {
+      out.appendRaw(reply::kSyntaxError);
+      return;
+    }
+  }
+  const Entry* entry = storage_->lookup(args[0]);
+  if (entry == nullptr) {
+    // A missing key is an empty string padded with zeros.
+    out.appendInteger(bit == 1 ? -1 : 0);
+    return;
+  }
+  if (entry->type() != ValueType::String) {
+    out.appendRaw(reply::kWrongType);
+    return;
+  }
+
+  StringValue value(*entry);
+  std::string_view bytes = value.view();
+  int64_t length = static_cast<int64_t>(bytes.size()) * (bitUnits ? 8 : 1);
+  if (!clampRange(start, end, length)) {
+    out.appendInteger(-1);
+    return;
+  }
+  uint64_t firstBit = bitUnits ? start : start * 8;
+  uint64_t lastBit = bitUnits ? end : end * 8 + 7;
+  int64_t pos = findBit(bytes, firstBit, lastBit, bit == 1);
+  // Without an end, the string reads as padded with zeros past it.
+  if (pos == -1 && bit == 0 && !endGiven) {
+    pos = static_cast<int64_t>(lastBit + 1);
+  }
+  out.appendInteger(pos);
+}
+
+// BITOP AND|OR|XOR|NOT destkey key [key ...]
+void CommandHandler::handleBitop(ArgList args, ReplyBuffer& out) {
+  BitOp op;
+  if (equalsIgnoreCase(args[0], "AND")) {
+    op = BitOp::And;
+  } else if (equalsIgnoreCase(args[0], "OR")) {
+    op = BitOp::Or;
+  } else if (equalsIgnoreCase(args[0], "XOR")) {
+    op = BitOp::Xor;
+  } else if (equalsIgnoreCase(args[0], "NOT")) {
+    op = BitOp::Not;
+  } else {
+    out.appendRaw(reply::kSyntaxError);
+    return;
+  }
+  ArgList keys = args.subspan(2);
+  if (op == BitOp::Not && keys.size() != 1) {
+    out.appendError("ERR BITOP NOT must be called with a single source key.");
+    return;
+  }
+
+  // Missing keys read as empty strings.
+  std::vector<StringValue> values;
+  values.reserve(keys.size());
+  for (std::string_view key : keys) {
+    const Entry* entry = storage_->lookup(key);
+    if (entry != nullptr && entry->type() != ValueType::String) {
+      out.appendRaw(reply::kWrongType);
+      return;
+    }
+    if (entry != nullptr) {
+      values.emplace_back(*entry);
+    }
+  }
+  std::vector<std::string_view> sources;
+  sources.reserve(keys.size());
+  size_t length = 0;
+  for (const StringValue& value : values) {
+    sources.push_back(value.view());
+    length = std::max(length, value.view().size());
+  }
+  sources.resize(keys.size());
+
+  if (length == 0) {
+    storage_->remove(args[1]);
+    out.appendRaw(reply::kZero);
+    return;
+  }
+  std::string result(length, '\0');
+  combineBits(op, sources, result.data());
+  storage_->set(args[1], result);
+  out.appendInteger(static_cast<int64_t>(length));
+}
+
+void CommandHandler::handlePfadd(ArgList args, ReplyBuffer& out) {
+  bool wrongType;
+  std::string* bytes = storage_->findMutableString(args[0], wrongType);
+  if (wrongType) {
+    out.appendRaw(reply::kWrongType);
+    return;
+  }
+  bool changed = false;
+  if (bytes == nullptr) {
+    bytes = &storage_->createMutableString(args[0]);
+    HyperLogLog(*bytes).clear();
+    changed = true;
+  } else if (!HyperLogLog::isValid(*bytes)) {
+    out.appendRaw(kNotHyperLogLog);
+    return;
+  }
+  HyperLogLog hll(*bytes);
+  for (std::string_view element : args.subspan(1)) {
+    changed = hll.add(element) || changed;
+  }
+  out.appendRaw(changed ? reply::kOne : reply::kZero);
+}
+
+void CommandHandler::handlePfcount(ArgList args, ReplyBuffer& out) {
+  if (args.size() == 1) {
+    // One key's count is cached in it.
+    bool wrongType;
+    std::string* bytes = storage_->findMutableString(args[0], wrongType);
+    if (wrongType) {
+      out.appendRaw(reply::kWrongType);
+    } else if (bytes == nullptr) {
+      out.appendRaw(reply::kZero);
+    } else if (!HyperLogLog::isValid(*bytes)) {
+      out.appendRaw(kNotHyperLogLog);
+    } else {
+      out.appendInteger(static_cast<int64_t>(HyperLogLog(*bytes).count()));
+    }
+    return;
+  }
+
+  // Several are counted as their union.
+  HyperLogLog::Registers registers{};
+  for (std::string_view key : args) {
+    const Entry* entry = storage_->lookup(key);
+    if (entry == nullptr) {
+      continue;
+    }
+    if (entry->type() != ValueType::String) {
+      out.appendRaw(reply::kWrongType);
+      return;
+    }
+    StringValue value(*entry);
+    if (!HyperLogLog::isValid(value.view())) {
+      out.appendRaw(kNotHyperLogLog);
+      return;
+    }
+    HyperLogLog::mergeInto(value.view(), registers);
+  }
+  out.appendInteger(static_cast<int64_t>(estimateCardinality(registers)));
+}
+
+// PFMERGE destkey [sourcekey ...]: the union, destkey's own registers
+// included, replaces destkey, which keeps its TTL.
+void CommandHandler::handlePfmerge(ArgList args, ReplyBuffer& out) {
+  HyperLogLog::Registers registers{};
+  for (std::string_view key : args) {
+    const Entry* entry = storage_->lookup(key);
+    if (entry == nullptr) {
+      continue;
+    }
+    if (entry->type() != ValueType::String) {
+      out.appendRaw(reply::kWrongType);
+      return;
+    }
+    StringValue value(*entry);
+    if (!HyperLogLog::isValid(value.view())) {
+      out.appendRaw(kNotHyperLogLog);
+      return;
+    }
+    HyperLogLog::mergeInto(value.view(), registers);
+  }
+  bool wrongType;
+  std::string* bytes = storage_->findMutableString(args[0], wrongType);
+  if (bytes == nullptr) {
+    bytes = &storage_->createMutableString(args[0]);
+  }
+  HyperLogLog(*bytes).assign(registers);
+  out.appendRaw(reply::kOk);
+}
+
+void CommandHandler::handleDel(ArgList args, ReplyBuffer& out) {
+  out.appendInteger(static_cast<int64_t>(storage_->removeMany(args, false)));
+}
+
+void CommandHandler::handleUnlink(ArgList args, ReplyBuffer& out) {
+  // Like DEL, but large values are released in the background.
+  out.appendInteger(static_cast<int64_t>(storage_->removeMany(args, true)));
+}
+
+void CommandHandler::handleExists(ArgList args, ReplyBuffer& out) {
+  // A key named twice counts twice.
+  int64_t count = 0;
+  storage_->getMany(args, [&count](const Entry* entry) {
+    count += entry != nullptr;
+  });
+  out.appendInteger(count);
+}
+
+// FLUSHALL and FLUSHDB; there is only db0.
+void CommandHandler::handleFlush(ArgList args, ReplyBuffer& out) {
+  bool lazy = false;
+  if (args.size() == 1 && equalsIgnoreCase(args[0], "ASYNC")) {
+    lazy = true;
+  } else if (args.size() > 1 ||
+             (args.size() == 1 && !equalsIgnoreCase(args[0], "SYNC"))) {
+    out.appendRaw(reply::kSyntaxError);
+    return;
+  }
+  storage_->flush(lazy);
+  out.appendRaw(reply::kOk);
+}
+
+void CommandHandler::handleLpush(ArgList args, ReplyBuffer& out) {
+  push(args, true, out);
+}
+
+void CommandHandler::handleRpush(ArgList args, ReplyBuffer& out) {
+  push(args, false, out);
+}
+
+void CommandHandler::push(ArgList args, bool front, ReplyBuffer& out) {
+  std::string_view key = args[0];
+  bool wrongType;
+  Quicklist* list = storage_->findList(key, wrongType);
+  if (wrongType) {
+    out.appendRaw(reply::kWrongType);
+    return;
+  }
+  if (list == nullptr) {
+    list = &storage_->createList(key);
+  }
+  for (std::string_view value : args.subspan(1)) {
+    if (front) {
+      list->pushFront(value);
+    } else {
+      list->pushBack(value);
+    }
+  }
+  // Clients blocked on the key are served once this command is done.
+  storage_->signalKeyAsReady(key);
+  out.appendInteger(static_cast<int64_t>(list->size()));
+}
+
+void CommandHandler::handleLpop(ArgList args, ReplyBuffer& out) {
+  pop(args, true, out);
+}
+
+void CommandHandler::handleRpop(ArgList args, ReplyBuffer& out) {
+  pop(args, false, out);
+}
+
+// LPOP and RPOP key [count]: without a count the reply is one element,
+// with one it is an array.
+void CommandHandler::pop(ArgList args, bool front, ReplyBuffer& out) {
+  if (args.size() > 2) {
+    out.appendError(front
+                        ? "ERR wrong number of arguments for 'lpop' command"
+                        : "ERR wrong number of arguments for 'rpop' command");
+    return;
+  }
+  std::optional<int64_t> count;
+  if (args.size() == 2) {
+    int64_t value = 0;
+    if (!parseInt64(args[1], value) || value < 0) {
+      out.appendError("ERR value is out of range, must be positive");
+      return;
+    }
+    count = value;
+  }
+
+  bool wrongType;
+  Quicklist* list = storage_->findList(args[0], wrongType);
+  if (wrongType) {
+    out.appendRaw(reply::kWrongType);
+    return;
+  }
+  if (list == nullptr) {
+    out.appendRaw(count ? reply::kNullArray : reply::kNull);
+    return;
+  }
+
+  size_t popped = count ? std::min<size_t>(*count, list->size()) : 1;
+  if (count) {
+    out.appendArrayHeader(popped);
+  }
+  for (size_t i = 0; i < popped; i++) {
+    out.appendBulkString(front ? list->popFront() : list->popBack());
+  }
+  if (list->empty()) {
+    storage_->remove(args[0]);
+  }
+}
+
+void CommandHandler::handleLlen(ArgList args, ReplyBuffer& out) {
+  bool wrongType;
+  Quicklist* list = storage_->findList(args[0], wrongType);
+  if (wrongType) {
+    out.appendRaw(reply::kWrongType);
+    return;
+  }
+  out.appendInteger(list ? static_cast<int64_t>(list->size()) : 0);
+}
+
+void CommandHandler::handleLindex(ArgList args, ReplyBuffer& out) {
+  int64_t index = 0;
+  if (!parseInt64(args[1], index)) {
+    out.appendRaw(reply::kNotInteger);
+    return;
+  }
+  bool wrongType;
+  Quicklist* list = storage_->findList(args[0], wrongType);
+  if (wrongType) {
+    out.appendRaw(reply::kWrongType);
+    return;
+  }
+
+  int64_t size = list ? static_cast<int64_t>(list->size()) : 0;
+  if (index < 0) {
+    index += size;
+  }
+  if (index < 0 || index >= size) {
+    out.appendNull();
+    return;
+  }
+  out.appendBulkString(list->at(static_cast<size_t>(index)));
+}
+
+void CommandHandler::handleLrange(ArgList args, ReplyBuffer& out) {
+  int64_t start = 0;
+  int64_t stop = 0;
+  if (!parseInt64(args[1], start) || !parseInt64(args[2], stop)) {
+    out.appendRaw(reply::kNotInteger);
+    return;
+  }
+  bool wrongType;
+  Quicklist* list = storage_->findList(args[0], wrongType);
+  if (wrongType) {
+    out.appendRaw(reply::kWrongType);
+    return;
+  }
+
+  // Negative indexes count from the end; the range is clamped to the list.
+  int64_t size = list ? static_cast<int64_t>(list->size()) : 0;
+  if (start < 0) start = std::max<int64_t>(start + size, 0);
+  if (stop < 0) stop += size;
+  stop = std::min(stop, size - 1);
+  if (start > stop) {
+    out.appendRaw(reply::kEmptyArray);
+    return;
+  }
+
+  size_t count = static_cast<size_t>(stop - start + 1);
+  out.appendArrayHeader(count);
+  list->forRange(static_cast<size_t>(start), count,
+                 [&out](std::string_view value) {
+                   out.appendBulkString(value);
+                 });
+}
+
+void CommandHandler::handleBlpop(ArgList args, ReplyBuffer& out) {
+  // BLPOP key [key ...] timeout: pops from the first non-empty list.
+  int64_t timeoutMs = 0;
+  if (!parseTimeout(args.back(), timeoutMs, out)) {
+    return;
+  }
+  ArgList keys = args.first(args.size() - 1);
+  for (std::string_view key : keys) {
+    bool wrongType;
+    Quicklist* list = storage_->findList(key, wrongType);
+    if (wrongType) {
+      out.appendRaw(reply::kWrongType);
+      return;
+    }
+    if (list != nullptr) {
+      std::string value = list->popFront();
+      if (list->empty()) {
+        storage_->remove(key);
+      }
+      out.appendArrayHeader(2);
+      out.appendBulkString(key);
+      out.appendBulkString(value);
+      return;
+    }
+  }
+
+  // All empty: leave it to the server to wait.
+  BlockRequest request;
+  request.timeoutMs = timeoutMs;
+  for (std::string_view key : keys) {
+    if (std::find(request.keys.begin(), request.keys.end(), key) ==
+        request.keys.end()) {
+      request.keys.emplace_back(key);
+    }
+  }
+  blockRequest_ = std::move(request);
+}
+
+void CommandHandler::handleHset(ArgList args, ReplyBuffer& out) {
+  // HSET key field value [field value ...]
+  if (args.size() % 2 != 1) {
+    out.appendError("ERR wrong number of arguments for 'hset' command");
+    return;
+  }
+  std::string_view key = args[0];
+  bool wrongType;
+  std::optional<Hash> hash = storage_->findHash(key, wrongType);
+  if (wrongType) {
+    out.appendRaw(reply::kWrongType);
+    return;
+  }
+  if (!hash) {
+    hash = storage_->createHash(key);
+  }
+  int64_t added = 0;
+  for (size_t i = 1; i < args.size(); i += 2) {
+    added += hash->set(args[i], args[i + 1]);
+  }
+  out.appendInteger(added);
+}
+
+void CommandHandler::handleHget(ArgList args, ReplyBuffer& out) {
+  bool wrongType;
+  std::optional<Hash> hash = storage_->findHash(args[0], wrongType);
+  if (wrongType) {
+    out.appendRaw(reply::kWrongType);
+    return;
+  }
+  std::optional<std::string_view> value;
+  if (hash) {
+    value = hash->get(args[1]);
+  }
+  if (value) {
+    out.appendBulkString(*value);
+  } else {
+    out.appendNull();
+  }
+}
+
+void CommandHandler::handleHmget(ArgList args, ReplyBuffer& out) {
+  bool wrongType;
+  std::optional<Hash> hash = storage_->findHash(args[0], wrongType);
+  if (wrongType) {
+    out.appendRaw(reply::kWrongType);
+    return;
+  }
+  ArgList fields = args.subspan(1);
+  out.appendArrayHeader(fields.size());
+  for (std::string_view field : fields) {
+    std::optional<std::string_view> value;
+    if (hash) {
+      value = hash->get(field);
+    }
+    if (value) {
+      out.appendBulkString(*value);
+    } else {
+      out.appendNull();
+    }
+  }
+}
+
+void CommandHandler::handleHgetall(ArgList args, ReplyBuffer& out) {
+  bool wrongType;
+  std::optional<Hash> hash = storage_->findHash(args[0], wrongType);
+  if (wrongType) {
+    out.appendRaw(reply::kWrongType);
+    return;
+  }
+  if (!hash) {
+    out.appendRaw(reply::kEmptyArray);
+    return;
+  }
+  // Fields and values alternate in one flat array.
+  out.appendArrayHeader(hash->size() * 2);
+  hash->forEach([&out](std::string_view field, std::string_view value) {
+    out.appendBulkString(field);
+    out.appendBulkString(value);
+  });
+}
+
+void CommandHandler::handleHdel(ArgList args, ReplyBuffer& out) {
+  bool wrongType;
+  std::optional<Hash> hash = storage_->findHash(args[0], wrongType);
+  if (wrongType) {
+    out.appendRaw(reply::kWrongType);
+    return;
+  }
+  int64_t removed = 0;
+  if (hash) {
+    for (std::string_view field : args.subspan(1)) {
+      removed += hash->remove(field);
+    }
+    if (hash->size() == 0) {
+      storage_->remove(args[0]);
+    }
+  }
+  out.appendInteger(removed);
+}
+
+void CommandHandler::handleHincrby(ArgList args, ReplyBuffer& out) {
+  int64_t increment = 0;
+  if (!parseInt64(args[2], increment)) {
+    out.appendRaw(reply::kNotInteger);
+    return;
+  }
+  std::string_view key = args[0];
+  bool wrongType;
+  std::optional<Hash> hash = storage_->findHash(key, wrongType);
+  if (wrongType) {
+    out.appendRaw(reply::kWrongType);
+    return;
+  }
+  if (!hash) {
+    hash = storage_->createHash(key);
+  }
+
+  int64_t value = 0;
+  if (std::optional<std::string_view> current = hash->get(args[1])) {
+    if (!parseInt64(*current, value)) {
+      out.appendError("ERR hash value is not an integer");
+      return;
+    }
+  }
+  if (__builtin_add_overflow(value, increment, &value)) {
+    out.appendError("ERR increment or decrement would overflow");
+    return;
+  }
+  char text[24];
+  auto end = std::to_chars(text, text + sizeof(text), value).ptr;
+  hash->set(args[1], std::string_view(text, end - text));
+  out.appendInteger(value);
+}
+
+void CommandHandler::handleHlen(ArgList args, ReplyBuffer& out) {
+  bool wrongType;
+  std::optional<Hash> hash = storage_->findHash(args[0], wrongType);
+  if (wrongType) {
+    out.appendRaw(reply::kWrongType);
+    return;
+  }
+  out.appendInteger(hash ? static_cast<int64_t>(hash->size()) : 0);
+}
+
+void CommandHandler::handleZadd(ArgList args, ReplyBuffer& out) {
+  // ZADD key [NX|XX] [GT|LT] [CH] [INCR] score member [score member ...]
+  bool nx = false, xx = false, gt = false, lt = false, ch = false;
+  bool incr = false;
+  size_t first = 1;
+  for (; first < args.size(); first++) {
+    std::string_view option = args[first];
+    if (equalsIgnoreCase(option, "NX")) {
+      nx = true;
+    } else if (equalsIgnoreCase(option, "XX")) {
+      xx = true;
+    } else if (equalsIgnoreCase(option, "GT")) {
+      gt = true;
+    } else if (equalsIgnoreCase(option, "LT")) {
+      lt = true;
+    } else if (equalsIgnoreCase(option, "CH")) {
+      ch = true;
+    } else if (equalsIgnoreCase(option, "INCR")) {
+      incr = true;
+    } else {
+      break;
+    }
+  }
+  ArgList pairs = args.subspan(first);
+  if (pairs.empty() || pairs.size() % 2 != 0) {
+    out.appendRaw(reply::kSyntaxError);
+    return;
+  }
+  if (nx && xx) {
+    out.appendError(
+        "ERR XX and NX options at the same time are not compatible");
+    return;
+  }
+  if ((gt && lt) || (nx && (gt || lt))) {
+    out.appendError(
+        "ERR GT, LT, and/or NX options at the same time are not compatible");
+    return;
+  }
+  if (incr && pairs.size() > 2) {
+    out.appendError("ERR INCR option supports a single increment-element pair");
+    return;
+  }
+  // Every score is checked before the set is touched.
+  std::vector<double> scores(pairs.size() / 2);
+  for (size_t i = 0; i < scores.size(); i++) {
+    if (!parseDouble(pairs[2 * i], scores[i])) {
+      out.appendError("ERR value is not a valid float");
+      return;
+    }
+  }
+
+  std::string_view key = args[0];
+  bool wrongType;
+  std::optional<SortedSet> set = storage_->findSortedSet(key, wrongType);
+  if (wrongType) {
+    out.appendRaw(reply::kWrongType);
+    return;
+  }
+  if (!set && xx) {
+    out.appendRaw(incr ? reply::kNull : reply::kZero);
+    return;
+  }
+  if (!set) {
+    set = storage_->createSortedSet(key);
+  }
+
+  int64_t added = 0;
+  int64_t updated = 0;
+  std::optional<double> incrResult;
+  for (size_t i = 0; i < scores.size(); i++) {
+    std::string_view member = pairs[2 * i + 1];
+    double score = scores[i];
+    std::optional<double> current = set->score(member);
+    if (!current) {
+      if (xx) continue;
+      set->set(member, score);
+      added++;
+      incrResult = score;
+      continue;
+    }
+    if (nx) continue;
+    if (incr) {
+      score += *current;
+      if (std::isnan(score)) {
+        out.appendError("ERR resulting score is not a number (NaN)");
+        return;
+      }
+    }
+    if ((gt && score <= *current) || (lt && score >= *current)) continue;
+    if (score != *current) {
+      set->set(member, score);
+      updated++;
+    }
+    incrResult = score;
   }
 
-  auto value = storage_->get(args[0]);
-  if (value.has_value()) {
-    return RESPParser::encodeBulkString(value.value());
+  if (!incr) {
+    out.appendInteger(ch ? added + updated : added);
+  } else if (incrResult) {
+    appendScore(*incrResult, out);
   } else {
-    return RESPParser::encodeNull();
+    out.appendNull();
+  }
+}
+
+void CommandHandler::handleZincrby(ArgList args, ReplyBuffer& out) {
+  double increment = 0;
+  if (!parseDouble(args[1], increment)) {
+    out.appendError("ERR value is not a valid float");
+    return;
+  }
+  std::string_view key = args[0];
+  bool wrongType;
+  std::optional<SortedSet> set = storage_->findSortedSet(key, wrongType);
+  if (wrongType) {
+    out.appendRaw(reply::kWrongType);
+    return;
+  }
+  if (!set) {
+    set = storage_->createSortedSet(key);
+  }
+  double score = set->score(args[2]).value_or(0) + increment;
+  if (std::isnan(score)) {
+    out.appendError("ERR resulting score is not a number (NaN)");
+    return;
+  }
+  set->set(args[2], score);
+  appendScore(score, out);
+}
+
+void CommandHandler::handleZrange(ArgList args, ReplyBuffer& out) {
+  zrange(args, false, out);
+}
+
+void CommandHandler::handleZrangebyscore(ArgList args, ReplyBuffer& out) {
+  zrange(args, true, out);
+}
+
+// ZRANGE key start stop [BYSCORE] [REV] [LIMIT offset count] [WITHSCORES]
+// and ZRANGEBYSCORE key min max [WITHSCORES] [LIMIT offset count], which is
+// ZRANGE with BYSCORE implied.
+void CommandHandler::zrange(ArgList args, bool byScore, ReplyBuffer& out) {
+  bool isZrange = !byScore;
+  bool reverse = false;
+  bool withScores = false;
+  bool limited = false;
+  int64_t offset = 0;
+  int64_t count = -1;
+  for (size_t i = 3; i < args.size(); i++) {
+    if (equalsIgnoreCase(args[i], "WITHSCORES")) {
+      withScores = true;
+    } else if (isZrange && equalsIgnoreCase(args[i], "BYSCORE")) {
+      byScore = true;
+    } else if (isZrange && equalsIgnoreCase(args[i], "REV")) {
+      reverse = true;
+    } else if (equalsIgnoreCase(args[i], "LIMIT") && i + 2 < args.size()) {
+      if (!parseInt64(args[i + 1], offset) ||
+          !parseInt64(args[i + 2], count)) {
+        out.appendRaw(reply::kNotInteger);
+        return;
+      }
+      limited = true;
+      i += 2;
+    } else {
+      out.appendRaw(reply::kSyntaxError);
+      return;
+    }
+  }
+  if (limited && !byScore) {
+    out.appendError(
+        "ERR syntax error, LIMIT is only supported in combination with "
+        "either BYSCORE or BYLEX");
+    return;
+  }
+
+  ScoreRange range{};
+  int64_t start = 0;
+  int64_t stop = 0;
+  if (byScore) {
+    // Reversed, the range is given from max to min.
+    std::string_view min = reverse ? args[2] : args[1];
+    std::string_view max = reverse ? args[1] : args[2];
+    if (!parseScoreBound(min, range.min, range.minExclusive) ||
+        !parseScoreBound(max, range.max, range.maxExclusive)) {
+      out.appendError("ERR min or max is not a float");
+      return;
+    }
+  } else if (!parseInt64(args[1], start) || !parseInt64(args[2], stop)) {
+    out.appendRaw(reply::kNotInteger);
+    return;
+  }
+
+  bool wrongType;
+  std::optional<SortedSet> set = storage_->findSortedSet(args[0], wrongType);
+  if (wrongType) {
+    out.appendRaw(reply::kWrongType);
+    return;
+  }
+  if (!set) {
+    out.appendRaw(reply::kEmptyArray);
+    return;
+  }
+
+  auto appendMember = [&out, withScores](std::string_view member,
+                                         double score) {
+    out.appendBulkString(member);
+    if (withScores) {
+      appendScore(score, out);
+    }
+  };
+  if (byScore) {
+    if (offset < 0) {
+      out.appendRaw(reply::kEmptyArray);
+      return;
+    }
+    // The length is only known once the range has been walked.
+    size_t handle = out.beginDeferredArray();
+    size_t visited = 0;
+    set->forScoreRange(
+        range, reverse, static_cast<size_t>(offset),
+        count < 0 ? SIZE_MAX : static_cast<size_t>(count),
+        [&](std::string_view member, double score) {
+          appendMember(member, score);
+          visited++;
+        });
+    out.setDeferredArrayLength(handle, visited * (withScores ? 2 : 1));
+    return;
+  }
+
+  // Negative ranks count from the end; the range is clamped to the set.
+  int64_t size = static_cast<int64_t>(set->size());
+  if (start < 0) start = std::max<int64_t>(start + size, 0);
+  if (stop < 0) stop += size;
+  stop = std::min(stop, size - 1);
+  if (start > stop) {
+    out.appendRaw(reply::kEmptyArray);
+    return;
+  }
+  out.appendArrayHeader(static_cast<size_t>(stop - start + 1) *
+                        (withScores ? 2 : 1));
+  set->forRankRange(static_cast<size_t>(start), static_cast<size_t>(stop),
+                    reverse, appendMember);
+}
+
+void CommandHandler::handleZrank(ArgList args, ReplyBuffer& out) {
+  // ZRANK key member [WITHSCORE]
+  bool withScore = args.size() == 3;
+  if (args.size() > 3 ||
+      (withScore && !equalsIgnoreCase(args[2], "WITHSCORE"))) {
+    out.appendRaw(reply::kSyntaxError);
+    return;
+  }
+  bool wrongType;
+  std::optional<SortedSet> set = storage_->findSortedSet(args[0], wrongType);
+  if (wrongType) {
+    out.appendRaw(reply::kWrongType);
+    return;
+  }
+  std::optional<size_t> rank;
+  if (set) {
+    rank = set->rank(args[1], false);
+  }
+  if (!rank) {
+    out.appendRaw(withScore ? reply::kNullArray : reply::kNull);
+    return;
+  }
+  if (withScore) {
+    out.appendArrayHeader(2);
+    out.appendInteger(static_cast<int64_t>(*rank));
+    appendScore(*set->score(args[1]), out);
+  } else {
+    out.appendInteger(static_cast<int64_t>(*rank));
+  }
+}
+
+void CommandHandler::handleZrem(ArgList args, ReplyBuffer& out) {
+  bool wrongType;
+  std::optional<SortedSet> set = storage_->findSortedSet(args[0], wrongType);
+  if (wrongType) {
+    out.appendRaw(reply::kWrongType);
+    return;
+  }
+  int64_t removed = 0;
+  if (set) {
+    for (std::string_view member : args.subspan(1)) {
+      removed += set->remove(member);
+    }
+    if (set->size() == 0) {
+      storage_->remove(args[0]);
+    }
+  }
+  out.appendInteger(removed);
+}
+
+void CommandHandler::handleZcard(ArgList args, ReplyBuffer& out) {
+  bool wrongType;
+  std::optional<SortedSet> set = storage_->findSortedSet(args[0], wrongType);
+  if (wrongType) {
+    out.appendRaw(reply::kWrongType);
+    return;
+  }
+  out.appendInteger(set ? static_cast<int64_t>(set->size()) : 0);
+}
+
+void CommandHandler::handleSadd(ArgList args, ReplyBuffer& out) {
+  bool wrongType;
+  std::optional<Set> set = storage_->findSet(args[0], wrongType);
+  if (wrongType) {
+    out.appendRaw(reply::kWrongType);
+    return;
+  }
+  if (!set) {
+    set = storage_->createSet(args[0]);
+  }
+  int64_t added = 0;
+  for (std::string_view member : args.subspan(1)) {
+    added += set->add(member);
+  }
+  out.appendInteger(added);
+}
+
+void CommandHandler::handleSrem(ArgList args, ReplyBuffer& out) {
+  bool wrongType;
+  std::optional<Set> set = storage_->findSet(args[0], wrongType);
+  if (wrongType) {
+    out.appendRaw(reply::kWrongType);
+    return;
+  }
+  int64_t removed = 0;
+  if (set) {
+    for (std::string_view member : args.subspan(1)) {
+      removed += set->remove(member);
+    }
+    if (set->size() == 0) {
+      storage_->remove(args[0]);
+    }
+  }
+  out.appendInteger(removed);
+}
+
+void CommandHandler::handleSismember(ArgList args, ReplyBuffer& out) {
+  bool wrongType;
+  std::optional<Set> set = storage_->findSet(args[0], wrongType);
+  if (wrongType) {
+    out.appendRaw(reply::kWrongType);
+    return;
+  }
+  out.appendInteger(set && set->contains(args[1]) ? 1 : 0);
+}
+
+void CommandHandler::handleSmembers(ArgList args, ReplyBuffer& out) {
+  bool wrongType;
+  std::optional<Set> set = storage_->findSet(args[0], wrongType);
+  if (wrongType) {
+    out.appendRaw(reply::kWrongType);
+    return;
+  }
+  if (!set) {
+    out.appendRaw(reply::kEmptyArray);
+    return;
+  }
+  out.appendArrayHeader(set->size());
+  set->forEach([&out](std::string_view member) {
+    out.appendBulkString(member);
+  });
+}
+
+void CommandHandler::handleScard(ArgList args, ReplyBuffer& out) {
+  bool wrongType;
+  std::optional<Set> set = storage_->findSet(args[0], wrongType);
+  if (wrongType) {
+    out.appendRaw(reply::kWrongType);
+    return;
+  }
+  out.appendInteger(set ? static_cast<int64_t>(set->size()) : 0);
+}
+
+// The sets under keys, nothing for a missing key. False, with the error
+// replied, if one holds another type.
+bool CommandHandler::findSets(ArgList keys,
+                              std::vector<std::optional<Set>>& sets,
+                              ReplyBuffer& out) {
+  sets.clear();
+  sets.reserve(keys.size());
+  for (std::string_view key : keys) {
+    bool wrongType;
+    sets.push_back(storage_->findSet(key, wrongType));
+    if (wrongType) {
+      out.appendRaw(reply::kWrongType);
+      return false;
+    }
   }
+  return true;
 }
 
-std::string CommandHandler::handleConfig(const std::vector<std::string>& args) {
-  if (args.size() < 2) {
-    return RESPParser::encodeError(
-        "ERR wrong number of arguments for 'config' command");
+void CommandHandler::handleSinter(ArgList args, ReplyBuffer& out) {
+  std::vector<std::optional<Set>> found;
+  if (!findSets(args, found, out)) {
+    return;
   }
+  // A missing key is an empty set, and so is the intersection.
+  std::vector<Set> sets;
+  for (const std::optional<Set>& set : found) {
+    if (!set) {
+      out.appendRaw(reply::kEmptyArray);
+      return;
+    }
+    sets.push_back(*set);
+  }
+  size_t handle = out.beginDeferredArray();
+  size_t count = 0;
+  intersectSets(sets, SIZE_MAX, [&](std::string_view member) {
+    out.appendBulkString(member);
+    count++;
+  });
+  out.setDeferredArrayLength(handle, count);
+}
+
+void CommandHandler::handleSintercard(ArgList args, ReplyBuffer& out) {
+  // SINTERCARD numkeys key [key ...] [LIMIT limit]
+  int64_t numKeys = 0;
+  if (!parseInt64(args[0], numKeys) || numKeys <= 0) {
+    out.appendError("ERR numkeys should be greater than 0");
+    return;
+  }
+  if (static_cast<uint64_t>(numKeys) > args.size() - 1) {
+    out.appendError(
+        "ERR Number of keys can't be greater than number of args");
+    return;
+  }
+  ArgList keys = args.subspan(1, static_cast<size_t>(numKeys));
+  ArgList rest = args.subspan(1 + keys.size());
+  int64_t limit = 0;
+  if (rest.size() == 2 && equalsIgnoreCase(rest[0], "LIMIT")) {
+    if (!parseInt64(rest[1], limit) || limit < 0) {
+      out.appendError("ERR LIMIT can't be negative");
+      return;
+    }
+  } else if (!rest.empty()) {
+    out.appendRaw(reply::kSyntaxError);
+    return;
+  }
+
+  std::vector<std::optional<Set>> found;
+  if (!findSets(keys, found, out)) {
+    return;
+  }
+  std::vector<Set> sets;
+  for (const std::optional<Set>& set : found) {
+    if (!set) {
+      out.appendInteger(0);
+      return;
+    }
+    sets.push_back(*set);
+  }
+  // LIMIT 0 counts them all.
+  int64_t count = 0;
+  intersectSets(sets, limit == 0 ? SIZE_MAX : static_cast<size_t>(limit),
+                [&count](std::string_view) { count++; });
+  out.appendInteger(count);
+}
+
+void CommandHandler::handleSunion(ArgList args, ReplyBuffer& out) {
+  std::vector<std::optional<Set>> found;
+  if (!findSets(args, found, out)) {
+    return;
+  }
+  std::vector<Set> sets;
+  for (const std::optional<Set>& set : found) {
+    if (set) sets.push_back(*set);
+  }
+  size_t handle = out.beginDeferredArray();
+  size_t count = 0;
+  unionSets(sets, [&](std::string_view member) {
+    out.appendBulkString(member);
+    count++;
+  });
+  out.setDeferredArrayLength(handle, count);
+}
+
+void CommandHandler::handleSdiff(ArgList args, ReplyBuffer& out) {
+  std::vector<std::optional<Set>> found;
+  if (!findSets(args, found, out)) {
+    return;
+  }
+  if (!found[0]) {
+    out.appendRaw(reply::kEmptyArray);
+    return;
+  }
+  std::vector<Set> sets;
+  for (const std::optional<Set>& set : found) {
+    if (set) sets.push_back(*set);
+  }
+  size_t handle = out.beginDeferredArray();
+  size_t count = 0;
+  diffSets(sets, [&](std::string_view member) {
+    out.appendBulkString(member);
+    count++;
+  });
+  out.setDeferredArrayLength(handle, count);
+}
+
+void CommandHandler::handleXadd(ArgList args, ReplyBuffer& out) {
+  // XADD key [NOMKSTREAM] <* | ms | ms-* | ms-seq> field value [...]
+  bool noMkStream = equalsIgnoreCase(args[1], "NOMKSTREAM");
+  size_t idArg = noMkStream ? 2 : 1;
+  ArgList fieldValues = args.subspan(std::min(idArg + 1, args.size()));
+  if (fieldValues.empty() || fieldValues.size() % 2 != 0) {
+    out.appendError("ERR wrong number of arguments for 'xadd' command");
+    return;
+  }
+
+  bool wrongType;
+  Stream* stream = storage_->findStream(args[0], wrongType);
+  if (wrongType) {
+    out.appendRaw(reply::kWrongType);
+    return;
+  }
+
+  // An ID left for the server to pick follows the last one, from the wall
+  // clock's millisecond or, when the clock is behind, the last's. One that
+  // cannot (after the largest ID) fails the check against the last below.
+  StreamID last = stream ? stream->lastId() : StreamID{};
+  std::string_view text = args[idArg];
+  StreamID id;
+  if (text == "*") {
+    id.ms = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch())
+            .count());
+    if (id.ms <= last.ms) {
+      id = last;
+      nextStreamId(id);
+    }
+  } else if (text.ends_with("-*")) {
+    if (!parseUint64(text.substr(0, text.size() - 2), id.ms)) {
+      out.appendError(kInvalidStreamId);
+      return;
+    }
+    if (stream && id.ms == last.ms) {
+      id.seq = last.seq == UINT64_MAX ? last.seq : last.seq + 1;
+    } else {
+      id.seq = id.ms == 0 ? 1 : 0;
+    }
+  } else if (!parseStreamId(text, 0, id)) {
+    out.appendError(kInvalidStreamId);
+    return;
+  }
+  if (id == StreamID{}) {
+    out.appendError("ERR The ID specified in XADD must be greater than 0-0");
+    return;
+  }
+  if (stream && id <= last) {
+    out.appendError(
+        "ERR The ID specified in XADD is equal or smaller than the target "
+        "stream top item");
+    return;
+  }
+
+  if (stream == nullptr) {
+    if (noMkStream) {
+      out.appendNull();
+      return;
+    }
+    stream = &storage_->createStream(args[0]);
+  }
+  stream->append(id, fieldValues);
+  storage_->signalKeyAsReady(args[0]);
+  out.appendBulkString(id.toString());
+}
+
+void CommandHandler::handleXrange(ArgList args, ReplyBuffer& out) {
+  // XRANGE key start end [COUNT count]
+  int64_t count = -1;
+  if (args.size() == 5 && equalsIgnoreCase(args[3], "COUNT")) {
+    if (!parseInt64(args[4], count)) {
+      out.appendRaw(reply::kNotInteger);
+      return;
+    }
+  } else if (args.size() != 3) {
+    out.appendRaw(reply::kSyntaxError);
+    return;
+  }
+  StreamID start;
+  StreamID end;
+  if (!parseStreamBound(args[1], false, start) ||
+      !parseStreamBound(args[2], true, end)) {
+    out.appendError(kInvalidStreamId);
+    return;
+  }
+
+  bool wrongType;
+  const Stream* stream = storage_->findStream(args[0], wrongType);
+  if (wrongType) {
+    out.appendRaw(reply::kWrongType);
+    return;
+  }
+  if (stream == nullptr || count == 0) {
+    out.appendRaw(reply::kEmptyArray);
+    return;
+  }
+  size_t handle = out.beginDeferredArray();
+  size_t visited = 0;
+  stream->range(start, end, count < 0 ? SIZE_MAX : static_cast<size_t>(count),
+                [&](StreamID id, std::span<const std::string_view> entry) {
+                  appendStreamEntry(id, entry, out);
+                  visited++;
+                });
+  out.setDeferredArrayLength(handle, visited);
+}
 
-  std::string subcmd = args[0];
-  std::transform(subcmd.begin(), subcmd.end(), subcmd.begin(), ::toupper);
+void CommandHandler::handleXread(ArgList args, ReplyBuffer& out) {
+  // XREAD [COUNT count] [BLOCK milliseconds] STREAMS key [...] id [...]
+  int64_t count = 0;
+  int64_t blockMs = -1;
+  size_t i = 0;
+  for (; i < args.size() && !equalsIgnoreCase(args[i], "STREAMS"); i++) {
+    bool isCount = equalsIgnoreCase(args[i], "COUNT");
+    if ((!isCount && !equalsIgnoreCase(args[i], "BLOCK")) ||
+        i + 1 == args.size()) {
+      out.appendRaw(reply::kSyntaxError);
+      return;
+    }
+    if (!parseInt64(args[++i], isCount ? count : blockMs)) {
+      out.appendRaw(reply::kNotInteger);
+      return;
+    }
+    if (!isCount && blockMs < 0) {
+      out.appendError("ERR timeout is negative");
+      return;
+    }
+  }
+  ArgList streams = args.subspan(std::min(i + 1, args.size()));
+  if (streams.empty() || streams.size() % 2 != 0) {
+    out.appendError(
+        "ERR Unbalanced 'xread' list of streams: for each stream key an ID "
+        "or '$' must be specified.");
+    return;
+  }
+  ArgList keys = streams.first(streams.size() / 2);
+  ArgList idArgs = streams.subspan(keys.size());
 
-  if (subcmd == "GET") {
-    std::string param = args[1];
-    std::transform(param.begin(), param.end(), param.begin(), ::tolower);
+  // Entries are read after each ID; "$" stands for the stream's last.
+  std::vector<const Stream*> found(keys.size());
+  std::vector<StreamID> after(keys.size());
+  for (size_t k = 0; k < keys.size(); k++) {
+    bool wrongType;
+    found[k] = storage_->findStream(keys[k], wrongType);
+    if (wrongType) {
+      out.appendRaw(reply::kWrongType);
+      return;
+    }
+    if (idArgs[k] == "$") {
+      after[k] = found[k] ? found[k]->lastId() : StreamID{};
+    } else if (!parseStreamId(idArgs[k], 0, after[k])) {
+      out.appendError(kInvalidStreamId);
+      return;
+    }
+  }
+
+  size_t limit = count > 0 ? static_cast<size_t>(count) : SIZE_MAX;
+  size_t ready = 0;
+  for (size_t k = 0; k < keys.size(); k++) {
+    ready += found[k] && found[k]->lastId() > after[k];
+  }
+  if (ready > 0) {
+    out.appendArrayHeader(ready);
+    for (size_t k = 0; k < keys.size(); k++) {
+      StreamID start = after[k];
+      if (!found[k] || found[k]->lastId() <= start) continue;
+      nextStreamId(start);
+      out.appendArrayHeader(2);
+      out.appendBulkString(keys[k]);
+      size_t handle = out.beginDeferredArray();
+      size_t visited = 0;
+      found[k]->range(start, StreamID::max(), limit,
+                      [&](StreamID id, std::span<const std::string_view> e) {
+                        appendStreamEntry(id, e, out);
+                        visited++;
+                      });
+      out.setDeferredArrayLength(handle, visited);
+    }
+    return;
+  }
+  if (blockMs < 0) {
+    out.appendRaw(reply::kNullArray);
+    return;
+  }
+
+  // Nothing yet: wait for any of the streams, for entries after the IDs
+  // read now, so that a later "$" does not skip what arrives meanwhile.
+  BlockRequest request;
+  request.timeoutMs = blockMs;
+  request.args.assign({"XREAD", "COUNT", std::to_string(count), "BLOCK",
+                       std::to_string(blockMs), "STREAMS"});
+  request.args.insert(request.args.end(), keys.begin(), keys.end());
+  for (size_t k = 0; k < keys.size(); k++) {
+    request.args.push_back(after[k].toString());
+    if (std::find(request.keys.begin(), request.keys.end(), keys[k]) ==
+        request.keys.end()) {
+      request.keys.emplace_back(keys[k]);
+    }
+  }
+  blockRequest_ = std::move(request);
+}
+
+void CommandHandler::handleConfig(ArgList args, ReplyBuffer& out) {
+  if (equalsIgnoreCase(args[0], "GET") && args.size() == 2) {
+    std::string param(args[1]);
+    std::transform(param.begin(), param.end(), param.begin(), toLowerAscii);
 
     std::string value;
     if (param == "dir") {
       value = config_->getDir();
     } else if (param == "dbfilename") {
       value = config_->getDbFilename();
+    } else if (param == "hash-max-listpack-entries") {
+      value = std::to_string(config_->getHashMaxListpackEntries());
+    } else if (param == "hash-max-listpack-value") {
+      value = std::to_string(config_->getHashMaxListpackValue());
+    } else if (param == "zset-max-listpack-entries") {
+      value = std::to_string(config_->getZsetMaxListpackEntries());
+    } else if (param == "zset-max-listpack-value") {
+      value = std::to_string(config_->getZsetMaxListpackValue());
+    } else if (param == "set-max-intset-entries") {
+      value = std::to_string(config_->getSetMaxIntsetEntries());
+    } else if (param == "maxmemory") {
+      value = std::to_string(config_->getMaxMemory());
+    } else if (param == "maxmemory-policy") {
+      value = evictionPolicyName(config_->getMaxMemoryPolicy());
+    } else if (param == "activedefrag") {
+      value = config_->getActiveDefrag() ? "yes" : "no";
     } else {
-      return RESPParser::encodeArray({});
+      out.appendArrayHeader(0);
+      return;
     }
 
-    return RESPParser::encodeArray({param, value});
+    out.appendArrayHeader(2);
+    out.appendBulkString(param);
+    out.appendBulkString(value);
   } else {
-    return RESPParser::encodeError("ERR Unknown CONFIG subcommand");
+    out.appendError("ERR Unknown CONFIG subcommand");
   }
 }
 
-std::string CommandHandler::handleKeys(const std::vector<std::string>& args) {
-  if (args.empty()) {
-    return RESPParser::encodeError(
-        "ERR wrong number of arguments for 'keys' command");
+void CommandHandler::handleKeys(ArgList args, ReplyBuffer& out) {
+  GlobPattern pattern(args[0]);
+
+  // Without wildcards there is at most one match: look it up directly.
+  if (auto key = pattern.literal()) {
+    if (storage_->contains(*key)) {
+      out.appendArrayHeader(1);
+      out.appendBulkString(*key);
+    } else {
+      out.appendArrayHeader(0);
+    }
+    return;
+  }
+
+  // Keys are encoded straight into the reply as the keyspace is walked.
+  size_t header = out.beginDeferredArray();
+  size_t count = 0;
+  storage_->forEachKey([&](std::string_view key) {
+    if (pattern.matches(key)) {
+      out.appendBulkString(key);
+      count++;
+    }
+  });
+  out.setDeferredArrayLength(header, count);
+}
+
+void CommandHandler::handleScan(ArgList args, ReplyBuffer& out) {
+  // SCAN cursor [MATCH pattern] [COUNT count] [TYPE type]
+  uint64_t cursor;
+  if (!parseUint64(args[0], cursor)) {
+    out.appendError("ERR invalid cursor");
+    return;
+  }
+
+  std::optional<GlobPattern> pattern;
+  int64_t count = 10;
+  std::optional<ValueType> type;
+  for (size_t i = 1; i < args.size(); i += 2) {
+    if (i + 1 >= args.size()) {
+      out.appendRaw(reply::kSyntaxError);
+      return;
+    }
+    std::string_view value = args[i + 1];
+    if (equalsIgnoreCase(args[i], "MATCH")) {
+      pattern.emplace(value);
+      if (pattern->matchesAll()) pattern.reset();
+    } else if (equalsIgnoreCase(args[i], "COUNT")) {
+      if (!parseInt64(value, count)) {
+        out.appendRaw(reply::kNotInteger);
+        return;
+      }
+      if (count < 1) {
+        out.appendRaw(reply::kSyntaxError);
+        return;
+      }
+    } else if (equalsIgnoreCase(args[i], "TYPE")) {
+      auto known = std::find_if(std::begin(kValueTypes),
+                                std::end(kValueTypes), [value](ValueType t) {
+                                  return equalsIgnoreCase(typeName(t), value);
+                                });
+      if (known == std::end(kValueTypes)) {
+        out.appendError("ERR unknown type name '" + std::string(value) + "'");
+        return;
+      }
+      type = *known;
+    } else {
+      out.appendRaw(reply::kSyntaxError);
+      return;
+    }
   }
 
-  // For now, only support "*" pattern
-  if (args[0] != "*") {
-    return RESPParser::encodeError("ERR pattern not supported");
+  // In shard mode the router has already sent the command to the shard
+  // the cursor is on.
+  uint64_t local = cursor;
+  if (shardCount_ > 1) {
+    if (ShardSet::cursorShard(cursor) != shardId_) {
+      out.appendError("ERR invalid cursor");
+      return;
+    }
+    local = ShardSet::localCursor(cursor);
   }
 
-  auto keys = storage_->getAllKeys();
-  return RESPParser::encodeArray(keys);
+  // As in Redis, COUNT bounds the keys visited, before filtering, and a
+  // sparse table gives up after ten times as many steps.
+  std::vector<std::string> keys;
+  size_t visited = 0;
+  int64_t maxSteps = count * 10;
+  do {
+    local = storage_->scan(local, [&](const Entry& entry) {
+      visited++;
+      if (type && entry.type() != *type) return;
+      if (pattern && !pattern->matches(entry.key())) return;
+      keys.emplace_back(entry.key());
+    });
+  } while (local != 0 && --maxSteps > 0 &&
+           visited < static_cast<size_t>(count));
+
+  uint64_t next = local;
+  if (shardCount_ > 1) {
+    if (local != 0) {
+      next = ShardSet::encodeCursor(local, shardId_);
+    } else if (shardId_ + 1 < shardCount_) {
+      next = ShardSet::encodeCursor(0, shardId_ + 1);
+    }
+  }
+
+  char cursorText[24];
+  auto end = std::to_chars(cursorText, cursorText + sizeof(cursorText), next);
+  out.appendArrayHeader(2);
+  out.appendBulkString(std::string_view(cursorText, end.ptr - cursorText));
+  out.appendArrayHeader(keys.size());
+  for (const std::string& key : keys) {
+    out.appendBulkString(key);
+  }
 }
 
-std::string CommandHandler::handleInfo(const std::vector<std::string>& args) {
-  // Check if the command has arguments and if it's "replication"
-  if (!args.empty()) {
-    std::string section = args[0];
-    std::transform(section.begin(), section.end(), section.begin(), ::tolower);
+void CommandHandler::handleInfo(ArgList args, ReplyBuffer& out) {
+  // Without arguments every section is returned.
+  auto wants = [&args](std::string_view section) {
+    return args.empty() || equalsIgnoreCase(args[0], "all") ||
+           equalsIgnoreCase(args[0], "default") ||
+           equalsIgnoreCase(args[0], section);
+  };
 
-    if (section == "replication") {
-      // Return replication info as a bulk string
-      std::string role = config_->isReplica() ? "slave" : "master";
-      std::string info = "role:" + role + "\r\n";
+  std::string info;
 
-      // Add master_replid and master_repl_offset for master nodes
-      if (!config_->isReplica()) {
-        info += "master_replid:8371b4fb1155b71f4a04d3e1bc3e18c4a990aeeb\r\n";
-        info += "master_repl_offset:0";
-      }
+  if (wants("replication")) {
+    std::string role = config_->isReplica() ? "slave" : "master";
+    info += "# Replication\r\n";
+    info += "role:" + role + "\r\n";
 
-      return RESPParser::encodeBulkString(info);
+    // Add master_replid and master_repl_offset for master nodes
+    if (!config_->isReplica()) {
+      info += "master_replid:8371b4fb1155b71f4a04d3e1bc3e18c4a990aeeb\r\n";
+      info += "master_repl_offset:0\r\n";
     }
   }
 
-  // For now, only support the replication section
-  return RESPParser::encodeError("ERR wrong section for 'info' command");
+  if (wants("memory")) {
+    // In --shards mode, this shard's keyspace, slabs and part of
+    // maxmemory; the RSS and its ratio are the whole process's.
+    storage_->publishUsedMemory();
+    size_t rss = residentMemory();
+    size_t processUsed = Storage::processUsedMemory();
+    SlabAllocator::Stats slabs = SlabAllocator::local().stats();
+    std::string_view policy = evictionPolicyName(storage_->evictionPolicy());
+    char line[512];
+    int len = snprintf(
+        line, sizeof(line),
+        "# Memory\r\n"
+        "used_memory:%zu\r\n"
+        "used_memory_rss:%zu\r\n"
+        "mem_fragmentation_ratio:%.2f\r\n"
+        "allocator_allocated:%zu\r\n"
+        "allocator_active:%zu\r\n"
+        "allocator_frag_ratio:%.2f\r\n"
+        "maxmemory:%zu\r\n"
+        "maxmemory_policy:%.*s\r\n"
+        "active_defrag_running:%d\r\n"
+        "lazyfree_pending_objects:%zu\r\n",
+        storage_->usedMemory(), rss,
+        processUsed ? static_cast<double>(rss) / processUsed : 0.0,
+        slabs.allocated, slabs.active,
+        slabs.allocated ? static_cast<double>(slabs.active) / slabs.allocated
+                        : 0.0,
+        storage_->maxMemory(), static_cast<int>(policy.size()),
+        policy.data(), storage_->defragStats().running ? 1 : 0,
+        LazyFree::instance().pendingObjects());
+    info.append(line, len);
+  }
+
+  if (wants("stats")) {
+    ExpireStats expire = storage_->expireStats();
+    DefragStats defrag = storage_->defragStats();
+    char line[512];
+    int len = snprintf(line, sizeof(line),
+                       "# Stats\r\n"
+                       "expired_keys:%llu\r\n"
+                       "expired_stale_perc:%.2f\r\n"
+                       "expired_time_cap_reached_count:%llu\r\n"
+                       "evicted_keys:%llu\r\n"
+                       "active_defrag_hits:%llu\r\n"
+                       "active_defrag_misses:%llu\r\n"
+                       "lazyfreed_objects:%llu\r\n",
+                       static_cast<unsigned long long>(expire.expiredKeys),
+                       expire.expiredStalePerc,
+                       static_cast<unsigned long long>(
+                           expire.timeCapReachedCount),
+                       static_cast<unsigned long long>(
+                           storage_->evictedKeys()),
+                       static_cast<unsigned long long>(defrag.hits),
+                       static_cast<unsigned long long>(defrag.misses),
+                       static_cast<unsigned long long>(
+                           LazyFree::instance().freedObjects()));
+    info.append(line, len);
+  }
+
+  if (wants("commandstats")) {
+    info += commandStatsInfo();
+  }
+
+  if (wants("keyspace")) {
+    info += "# Keyspace\r\n";
+    size_t keys = storage_->size();
+    if (keys > 0) {
+      long long avgTtl = storage_->expireStats().avgTtlMs;
+      char line[128];
+      int len = snprintf(line, sizeof(line),
+                         "db0:keys=%zu,expires=%zu,avg_ttl=%lld\r\n", keys,
+                         storage_->expiresSize(), avgTtl);
+      info.append(line, len);
+    }
+  }
+
+  if (info.empty()) {
+    out.appendError("ERR wrong section for 'info' command");
+    return;
+  }
+  out.appendBulkString(info);
 }
 
-std::string CommandHandler::handleReplconf(
-    const std::vector<std::string>& args) {
+std::string CommandHandler::commandStatsInfo() const {
+  std::string info = "# Commandstats\r\n";
+  auto commands = CommandTable::all();
+  for (size_t i = 0; i < commands.size(); i++) {
+    const CommandStats& stats = stats_[i];
+    if (stats.calls == 0 && stats.rejectedCalls == 0) continue;
+
+    uint64_t usec = stats.nanos / 1000;
+    double perCall =
+        stats.calls ? static_cast<double>(stats.nanos) / 1000 / stats.calls
+                    : 0.0;
+    char line[256];
+    int len = snprintf(line, sizeof(line),
+                       "cmdstat_%.*s:calls=%llu,usec=%llu,usec_per_call=%.2f,"
+                       "rejected_calls=%llu\r\n",
+                       static_cast<int>(commands[i].name.size()),
+                       commands[i].name.data(),
+                       static_cast<unsigned long long>(stats.calls),
+                       static_cast<unsigned long long>(usec), perCall,
+                       static_cast<unsigned long long>(stats.rejectedCalls));
+    info.append(line, len);
+  }
+  return info;
+}
+
+void CommandHandler::handleReplconf(ArgList /*args*/, ReplyBuffer& out) {
   // For the purposes of this challenge, we ignore the arguments
   // and just respond with +OK\r\n
-  return RESPParser::encodeSimpleString("OK");
+  out.appendRaw(reply::kOk);
 }
 
-std::string CommandHandler::handlePsync(const std::vector<std::string>& args) {
-  // PSYNC expects 2 arguments: replication_id and offset
-  if (args.size() != 2) {
-    return RESPParser::encodeError(
-        "ERR wrong number of arguments for 'psync' command");
-  }
-
+void CommandHandler::handlePsync(ArgList /*args*/, ReplyBuffer& out) {
+  // PSYNC takes replication_id and offset; arity is checked by the table.
   // For full resynchronization, we respond with:
   // +FULLRESYNC <REPL_ID> 0\r\n
   std::string replId = "8371b4fb1155b71f4a04d3e1bc3e18c4a990aeeb";
   std::string offset = "0";
   std::string response = "FULLRESYNC " + replId + " " + offset;
 
-  return RESPParser::encodeSimpleString(response);
+  out.appendSimpleString(response);
+}
+
+void CommandHandler::handleCommandInfo(ArgList args, ReplyBuffer& out) {
+  auto commands = CommandTable::all();
+
+  if (args.empty()) {
+    out.appendArrayHeader(commands.size());
+    for (const CommandSpec& spec : commands) {
+      appendCommandInfo(spec, out);
+    }
+    return;
+  }
+
+  if (equalsIgnoreCase(args[0], "COUNT") && args.size() == 1) {
+    out.appendInteger(static_cast<int64_t>(commands.size()));
+  } else if (equalsIgnoreCase(args[0], "LIST") && args.size() == 1) {
+    out.appendArrayHeader(commands.size());
+    for (const CommandSpec& spec : commands) {
+      out.appendBulkString(spec.name);
+    }
+  } else if (equalsIgnoreCase(args[0], "INFO")) {
+    out.appendArrayHeader(args.size() - 1);
+    for (std::string_view name : args.subspan(1)) {
+      const CommandSpec* spec = CommandTable::lookup(name);
+      if (spec) {
+        appendCommandInfo(*spec, out);
+      } else {
+        out.appendRaw(reply::kNullArray);
+      }
+    }
+  } else {
+    out.appendError("ERR unknown subcommand '" + std::string(args[0]) +
+                    "'. Try COMMAND HELP.");
+  }
+}
+
+void CommandHandler::appendCommandInfo(const CommandSpec& spec,
+                                       ReplyBuffer& out) {
+  // name, arity, flags, first key, last key, key step, ACL categories,
+  // tips, key specs, subcommands.
+  out.appendArrayHeader(10);
+  out.appendBulkString(spec.name);
+  out.appendInteger(spec.arity);
+  appendFlagNames(spec.flags, out);
+  out.appendInteger(spec.firstKey);
+  out.appendInteger(spec.lastKey);
+  out.appendInteger(spec.keyStep);
+  for (int i = 0; i < 4; i++) {
+    out.appendArrayHeader(0);
+  }
 }
 
-}  // namespace redis
\ No newline at end of file
+}  // namespace redis
@@ -0,0 +1,199 @@
+#include "redis/CommandTable.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <iterator>
+
+#include "redis/CommandHandler.h"
+#include "redis/StringUtil.h"
+
+namespace redis {
+
+namespace {
+
+// XREAD [COUNT n] [BLOCK ms] STREAMS key [key ...] id [id ...]
+std::span<const std::string_view> xreadKeys(
+    std::span<const std::string_view> argv) {
+  for (size_t i = 1; i < argv.size(); i++) {
+    if (equalsIgnoreCase(argv[i], "STREAMS")) {
+      std::span<const std::string_view> rest = argv.subspan(i + 1);
+      return rest.first(rest.size() / 2);
+    }
+  }
+  return {};
+}
+
+// SINTERCARD numkeys key [key ...] [LIMIT limit]
+std::span<const std::string_view> sintercardKeys(
+    std::span<const std::string_view> argv) {
+  uint64_t numKeys = 0;
+  if (argv.size() < 2 || !parseUint64(argv[1], numKeys)) {
+    return {};
+  }
+  return argv.subspan(2, std::min<uint64_t>(numKeys, argv.size() - 2));
+}
+
+}  // namespace
+
+constexpr CommandSpec CommandTable::kCommands[] = {
+    {"ping", -1, 0, 0, 0, 0, &CommandHandler::handlePing},
+    {"echo", 2, 0, 0, 0, 0, &CommandHandler::handleEcho},
+    {"set", -3, kCmdWrite | kCmdDenyOom, 1, 1, 1, &CommandHandler::handleSet},
+    {"get", 2, kCmdReadonly, 1, 1, 1, &CommandHandler::handleGet},
+    {"mget", -2, kCmdReadonly, 1, -1, 1, &CommandHandler::handleMget},
+    {"mset", -3, kCmdWrite | kCmdDenyOom, 1, -1, 2,
+     &CommandHandler::handleMset},
+    {"msetnx", -3, kCmdWrite | kCmdDenyOom, 1, -1, 2,
+     &CommandHandler::handleMsetnx},
+    {"incr", 2, kCmdWrite | kCmdDenyOom, 1, 1, 1, &CommandHandler::handleIncr},
+    {"decr", 2, kCmdWrite | kCmdDenyOom, 1, 1, 1, &CommandHandler::handleDecr},
+    {"incrby", 3, kCmdWrite | kCmdDenyOom, 1, 1, 1,
+     &CommandHandler::handleIncrby},
+    {"decrby", 3, kCmdWrite | kCmdDenyOom, 1, 1, 1,
+     &CommandHandler::handleDecrby},
+    {"incrbyfloat", 3, kCmdWrite | kCmdDenyOom, 1, 1, 1,
+     &CommandHandler::handleIncrbyfloat},
+    {"setbit", 4, kCmdWrite | kCmdDenyOom, 1, 1, 1,
+     &CommandHandler::handleSetbit},
+    {"getbit", 3, kCmdReadonly, 1, 1, 1, &CommandHandler::handleGetbit},
+    {"bitcount", -2, kCmdReadonly, 1, 1, 1, &CommandHandler::handleBitcount},
+    {"bitpos", -3, kCmdReadonly, 1, 1, 1, &CommandHandler::handleBitpos},
+    {"bitop", -4, kCmdWrite | kCmdDenyOom, 2, -1, 1,
+     &CommandHandler::handleBitop},
+    {"pfadd", -2, kCmdWrite | kCmdDenyOom, 1, 1, 1,
+     &CommandHandler::handlePfadd},
+    {"pfcount", -2, kCmdReadonly, 1, -1, 1, &CommandHandler::handlePfcount},
+    {"pfmerge", -2, kCmdWrite | kCmdDenyOom, 1, -1, 1,
+     &CommandHandler::handlePfmerge},
+    {"del", -2, kCmdWrite, 1, -1, 1, &CommandHandler::handleDel},
+    {"unlink", -2, kCmdWrite, 1, -1, 1, &CommandHandler::handleUnlink},
+    {"exists", -2, kCmdReadonly, 1, -1, 1, &CommandHandler::handleExists},
+    {"lpush", -3, kCmdWrite | kCmdDenyOom, 1, 1, 1,
+     &CommandHandler::handleLpush},
+    {"rpush", -3, kCmdWrite | kCmdDenyOom, 1, 1, 1,
+     &CommandHandler::handleRpush},
+    {"lpop", -2, kCmdWrite, 1, 1, 1, &CommandHandler::handleLpop},
+    {"rpop", -2, kCmdWrite, 1, 1, 1, &CommandHandler::handleRpop},
+    {"llen", 2, kCmdReadonly, 1, 1, 1, &CommandHandler::handleLlen},
+    {"lindex", 3, kCmdReadonly, 1, 1, 1, &CommandHandler::handleLindex},
+    {"lrange", 4, kCmdReadonly, 1, 1, 1, &CommandHandler::handleLrange},
+    {"blpop", -3, kCmdWrite | kCmdBlocking, 1, -2, 1,
+     &CommandHandler::handleBlpop},
+    {"hset", -4, kCmdWrite | kCmdDenyOom, 1, 1, 1, &CommandHandler::handleHset},
+    {"hget", 3, kCmdReadonly, 1, 1, 1, &CommandHandler::handleHget},
+    {"hmget", -3, kCmdReadonly, 1, 1, 1, &CommandHandler::handleHmget},
+    {"hgetall", 2, kCmdReadonly, 1, 1, 1, &CommandHandler::handleHgetall},
+    {"hdel", -3, kCmdWrite, 1, 1, 1, &CommandHandler::handleHdel},
+    {"hincrby", 4, kCmdWrite | kCmdDenyOom, 1, 1, 1,
+     &CommandHandler::handleHincrby},
+    {"hlen", 2, kCmdReadonly, 1, 1, 1, &CommandHandler::handleHlen},
+    {"zadd", -4, kCmdWrite | kCmdDenyOom, 1, 1, 1, &CommandHandler::handleZadd},
+    {"zincrby", 4, kCmdWrite | kCmdDenyOom, 1, 1, 1,
+     &CommandHandler::handleZincrby},
+    {"zrange", -4, kCmdReadonly, 1, 1, 1, &CommandHandler::handleZrange},
+    {"zrangebyscore", -4, kCmdReadonly, 1, 1, 1,
+     &CommandHandler::handleZrangebyscore},
+    {"zrank", -3, kCmdReadonly, 1, 1, 1, &CommandHandler::handleZrank},
+    {"zrem", -3, kCmdWrite, 1, 1, 1, &CommandHandler::handleZrem},
+    {"zcard", 2, kCmdReadonly, 1, 1, 1, &CommandHandler::handleZcard},
+    {"sadd", -3, kCmdWrite | kCmdDenyOom, 1, 1, 1, &CommandHandler::handleSadd},
+    {"srem", -3, kCmdWrite, 1, 1, 1, &CommandHandler::handleSrem},
+    {"sismember", 3, kCmdReadonly, 1, 1, 1,
+     &CommandHandler::handleSismember},
+    {"smembers", 2, kCmdReadonly, 1, 1, 1, &CommandHandler::handleSmembers},
+    {"scard", 2, kCmdReadonly, 1, 1, 1, &CommandHandler::handleScard},
+    {"sinter", -2, kCmdReadonly, 1, -1, 1, &CommandHandler::handleSinter},
+    {"sintercard", -3, kCmdReadonly, 0, 0, 0,
+     &CommandHandler::handleSintercard, sintercardKeys},
+    {"sunion", -2, kCmdReadonly, 1, -1, 1, &CommandHandler::handleSunion},
+    {"sdiff", -2, kCmdReadonly, 1, -1, 1, &CommandHandler::handleSdiff},
+    {"xadd", -5, kCmdWrite | kCmdDenyOom, 1, 1, 1, &CommandHandler::handleXadd},
+    {"xrange", -4, kCmdReadonly, 1, 1, 1, &CommandHandler::handleXrange},
+    {"xread", -4, kCmdReadonly | kCmdBlocking, 0, 0, 0,
+     &CommandHandler::handleXread, xreadKeys},
+    {"config", -2, kCmdAdmin, 0, 0, 0, &CommandHandler::handleConfig},
+    {"flushall", -1, kCmdWrite | kCmdAllShards, 0, 0, 0,
+     &CommandHandler::handleFlush},
+    {"flushdb", -1, kCmdWrite | kCmdAllShards, 0, 0, 0,
+     &CommandHandler::handleFlush},
+    {"keys", 2, kCmdReadonly | kCmdAllShards, 0, 0, 0,
+     &CommandHandler::handleKeys},
+    {"info", -1, 0, 0, 0, 0, &CommandHandler::handleInfo},
+    {"replconf", -1, kCmdAdmin, 0, 0, 0, &CommandHandler::handleReplconf},
+    {"psync", 3, kCmdAdmin, 0, 0, 0, &CommandHandler::handlePsync},
+    {"command", -1, 0, 0, 0, 0, &CommandHandler::handleCommandInfo},
+    {"scan", -2, kCmdReadonly | kCmdShardCursor, 0, 0, 0,
+     &CommandHandler::handleScan},
+};
+
+namespace {
+
+constexpr uint8_t kEmptySlot = 0xFF;
+
+// FNV-1a over the lowercased name followed by a final avalanche, so that
+// "GET", "get" and "Get" land in the same slot.
+constexpr uint32_t hashName(std::string_view name, uint32_t seed) {
+  uint32_t hash = 2166136261u ^ seed;
+  for (char c : name) {
+    hash ^= static_cast<uint8_t>(toLowerAscii(c));
+    hash *= 16777619u;
+  }
+  hash ^= hash >> 15;
+  hash *= 0x2c1b3c6du;
+  hash ^= hash >> 12;
+  return hash;
+}
+
+template <size_t N>
+struct PerfectHash {
+  // Eight slots per command keeps the seed search short.
+  static constexpr size_t kSlots = std::bit_ceil(N) * 8;
+  static_assert(N < kEmptySlot, "command index must fit in a slot byte");
+
+  uint32_t seed = 0;
+  std::array<uint8_t, kSlots> slots{};
+};
+
+// Searches for a seed under which every command name hashes to a distinct
+// slot. Runs at compile time; failing to find one is a build error.
+template <size_t N>
+consteval PerfectHash<N> buildPerfectHash(const CommandSpec (&commands)[N]) {
+  using Hash = PerfectHash<N>;
+  for (uint32_t seed = 0; seed < 1000000; seed++) {
+    Hash result;
+    result.seed = seed;
+    result.slots.fill(kEmptySlot);
+
+    bool collision = false;
+    for (size_t i = 0; i < N && !collision; i++) {
+      uint8_t& slot =
+          result.slots[hashName(commands[i].name, seed) & (Hash::kSlots - 1)];
+      if (slot != kEmptySlot) {
+        collision = true;
+      } else {
+        slot = static_cast<uint8_t>(i);
+      }
+    }
+    if (!collision) {
+      return result;
+    }
+  }
+  throw "no perfect hash seed for the command table";
+}
+
+}  // namespace
+
+const CommandSpec* CommandTable::lookup(std::string_view name) {
+  static constexpr auto kHash = buildPerfectHash(kCommands);
+
+  uint8_t index = kHash.slots[hashName(name, kHash.seed) & (kHash.kSlots - 1)];
+  if (index == kEmptySlot || !equalsIgnoreCase(kCommands[index].name, name)) {
+    return nullptr;
+  }
+  return &kCommands[index];
+}
+
+std::span<const CommandSpec> CommandTable::all() { return kCommands; }
+
+}  // namespace redis
@@ -1,16 +1,78 @@
 #include "redis/Config.h"
 
+#include <algorithm>
+#include <cctype>
+#include <charconv>
 #include <cstring>
+#include <iostream>
 #include <sstream>
+#include <string_view>
+#include <thread>
+#include <utility>
 
 namespace redis {
 
+namespace {
+
+// Parses a byte count with an optional unit: k/m/g are powers of 1000,
+// kb/mb/gb powers of 1024.
+bool parseMemory(const std::string& str, size_t& bytes) {
+  const char* last = str.data() + str.size();
+  size_t value = 0;
+  auto [end, ec] = std::from_chars(str.data(), last, value);
+  if (ec != std::errc()) return false;
+
+  std::string unit(end, last);
+  for (char& c : unit) {
+    c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+  }
+  static constexpr std::pair<std::string_view, size_t> kUnits[] = {
+      {"", 1},
+      {"b", 1},
+      {"k", 1000},
+      {"kb", 1024},
+      {"m", 1000 * 1000},
+      {"mb", 1024 * 1024},
+      {"g", 1000 * 1000 * 1000},
+      {"gb", 1024 * 1024 * 1024},
+  };
+  for (const auto& [name, multiplier] : kUnits) {
+    if (unit == name) {
+      bytes = value * multiplier;
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace
+
 Config::Config()
     : dir_("."),
       dbfilename_("dump.rdb"),
       port_(6379),
       masterHost_(""),
-      masterPort_(0) {}
+      masterPort_(0),
+      activeExpireBudget_(25000),
+      ioThreads_(1),
+      shards_(1),
+      ioBackend_(IOBackend::Epoll),
+      lazyFreeLazyExpire_(false),
+      hashMaxListpackEntries_(128),
+      hashMaxListpackValue_(64),
+      zsetMaxListpackEntries_(128),
+      zsetMaxListpackValue_(64),
+      setMaxIntsetEntries_(512),
+      maxMemory_(0),
+      maxMemoryPolicy_(EvictionPolicy::NoEviction),
+      activeDefrag_(false),
+      activeDefragIgnoreBytes_(100 * 1024 * 1024),
+      activeDefragCycleMin_(1),
+      activeDefragCycleMax_(25),
+      outputBufferLimits_{{
+          {0, 0, std::chrono::seconds(0)},
+          {256 * 1024 * 1024, 64 * 1024 * 1024, std::chrono::seconds(60)},
+      }} {}
 
 void Config::parseArgs(int argc, char** argv) {
   for (int i = 1; i < argc; i++) {
@@ -25,8 +87,121 @@ void Config::parseArgs(int argc, char** argv) {
       std::string replicaof = argv[++i];
       std::istringstream iss(replicaof);
       iss >> masterHost_ >> masterPort_;
+    } else if (std::strcmp(argv[i], "--active-expire-budget-us") == 0 &&
+               i + 1 < argc) {
+      activeExpireBudget_ = std::chrono::microseconds(std::stoll(argv[++i]));
+    } else if (std::strcmp(argv[i], "--io-threads") == 0 && i + 1 < argc) {
+      ioThreads_ = std::clamp(std::stoi(argv[++i]), 1, kMaxIOThreads);
+    } else if (std::strcmp(argv[i], "--shards") == 0 && i + 1 < argc) {
+      shards_ = std::stoi(argv[++i]);
+      if (shards_ <= 0) {
+        shards_ = static_cast<int>(std::thread::hardware_concurrency());
+      }
+      shards_ = std::clamp(shards_, 1, kMaxShards);
+    } else if (std::strcmp(argv[i], "--io-backend") == 0 && i + 1 < argc) {
+      std::string backend = argv[++i];
+      if (backend == "io_uring" || backend == "uring") {
+        ioBackend_ = IOBackend::Uring;
+      } else if (backend == "epoll") {
+        ioBackend_ = IOBackend::Epoll;
+      } else {
+        std::cerr << "Unknown --io-backend " << backend << ", using epoll"
+                  << std::endl;
+      }
+    } else if (std::strcmp(argv[i], "--lazyfree-lazy-expire") == 0 &&
+               i + 1 < argc) {
+      lazyFreeLazyExpire_ = std::strcmp(argv[++i], "yes") == 0;
+    } else if (std::strcmp(argv[i], "--hash-max-listpack-entries") == 0 &&
+               i + 1 < argc) {
+      hashMaxListpackEntries_ = std::stoul(argv[++i]);
+    } else if (std::strcmp(argv[i], "--hash-max-listpack-value") == 0 &&
+               i + 1 < argc) {
+      hashMaxListpackValue_ = std::stoul(argv[++i]);
+    } else if (std::strcmp(argv[i], "--zset-max-listpack-entries") == 0 &&
+               i + 1 < argc) {
+      zsetMaxListpackEntries_ = std::stoul(argv[++i]);
+    } else if (std::strcmp(argv[i], "--zset-max-listpack-value") == 0 &&
+               i + 1 < argc) {
+      zsetMaxListpackValue_ = std::stoul(argv[++i]);
+    } else if (std::strcmp(argv[i], "--set-max-intset-entries") == 0 &&
+               i + 1 < argc) {
+      setMaxIntsetEntries_ = std::stoul(argv[++i]);
+    } else if (std::strcmp(argv[i], "--maxmemory") == 0 && i + 1 < argc) {
+      std::string limit = argv[++i];
+      if (!parseMemory(limit, maxMemory_)) {
+        std::cerr << "Invalid --maxmemory '" << limit << "'" << std::endl;
+      }
+    } else if (std::strcmp(argv[i], "--maxmemory-policy") == 0 &&
+               i + 1 < argc) {
+      std::string policy = argv[++i];
+      if (!parseEvictionPolicy(policy, maxMemoryPolicy_)) {
+        std::cerr << "Unknown --maxmemory-policy " << policy
+                  << ", using noeviction" << std::endl;
+      }
+    } else if (std::strcmp(argv[i], "--activedefrag") == 0 && i + 1 < argc) {
+      activeDefrag_ = std::strcmp(argv[++i], "yes") == 0;
+    } else if (std::strcmp(argv[i], "--active-defrag-ignore-bytes") == 0 &&
+               i + 1 < argc) {
+      std::string bytes = argv[++i];
+      if (!parseMemory(bytes, activeDefragIgnoreBytes_)) {
+        std::cerr << "Invalid --active-defrag-ignore-bytes '" << bytes << "'"
+                  << std::endl;
+      }
+    } else if (std::strcmp(argv[i], "--active-defrag-cycle-min") == 0 &&
+               i + 1 < argc) {
+      activeDefragCycleMin_ = std::clamp(std::stoi(argv[++i]), 1, 99);
+    } else if (std::strcmp(argv[i], "--active-defrag-cycle-max") == 0 &&
+               i + 1 < argc) {
+      activeDefragCycleMax_ = std::clamp(std::stoi(argv[++i]), 1, 99);
+    } else if (std::strcmp(argv[i], "--client-output-buffer-limit") == 0 &&
+               i + 1 < argc) {
+      std::string spec = argv[++i];
+      if (!parseOutputBufferLimits(spec)) {
+        std::cerr << "Invalid --client-output-buffer-limit '" << spec
+                  << "', expected <class> <hard> <soft> <soft seconds>"
+                  << std::endl;
+      }
     }
   }
 }
 
+// Groups of "<class> <hard> <soft> <soft seconds>", where class is normal
+// or replica (slave is accepted too). The whole argument is rejected if any
+// group is malformed.
+bool Config::parseOutputBufferLimits(const std::string& spec) {
+  std::istringstream iss(spec);
+  std::string cls, hard, soft, seconds;
+  auto limits = outputBufferLimits_;
+  bool any = false;
+  while (iss >> cls) {
+    if (!(iss >> hard >> soft >> seconds)) return false;
+
+    ClientClass target;
+    if (cls == "normal") {
+      target = ClientClass::Normal;
+    } else if (cls == "replica" || cls == "slave") {
+      target = ClientClass::Replica;
+    } else {
+      return false;
+    }
+
+    OutputBufferLimit limit;
+    unsigned softSeconds = 0;
+    auto [end, ec] = std::from_chars(
+        seconds.data(), seconds.data() + seconds.size(), softSeconds);
+    if (!parseMemory(hard, limit.hardBytes) ||
+        !parseMemory(soft, limit.softBytes) || ec != std::errc() ||
+        end != seconds.data() + seconds.size()) {
+      return false;
+    }
+    limit.softSeconds = std::chrono::seconds(softSeconds);
+    limits[static_cast<size_t>(target)] = limit;
+    any = true;
+  }
+  if (any) {
+    outputBufferLimits_ = limits;
+  }
+  return any;
+}
+
 }  // namespace redis
\ No newline at end of file
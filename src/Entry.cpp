@@ -0,0 +1,297 @@
+#include "redis/Entry.h"
+
+#include <charconv>
+#include <cstring>
+#include <new>
+
+#include "redis/Hash.h"
+#include "redis/IntSet.h"
+#include "redis/Listpack.h"
+#include "redis/Quicklist.h"
+#include "redis/Set.h"
+#include "redis/SlabAllocator.h"
+#include "redis/SortedSet.h"
+#include "redis/Stream.h"
+#include "redis/StringUtil.h"
+
+namespace redis {
+
+size_t Entry::payloadSizeFor(Encoding encoding, size_t embeddedLength) {
+  switch (encoding) {
+    case Encoding::Int:
+      return sizeof(int64_t);
+    case Encoding::Embedded:
+      return embeddedLength;
+    case Encoding::Raw:
+      return sizeof(SharedValue);
+    case Encoding::Quicklist:
+      return sizeof(Quicklist*);
+    case Encoding::Listpack:
+      return sizeof(Listpack);
+    case Encoding::HashTable:
+      return sizeof(HashTable*);
+    case Encoding::SkipList:
+      return sizeof(SkipListSet*);
+    case Encoding::Stream:
+      return sizeof(Stream*);
+    case Encoding::IntSet:
+      return sizeof(IntSet);
+    case Encoding::SetTable:
+      return sizeof(SetTable*);
+  }
+  return 0;
+}
+
+Entry* Entry::allocate(std::string_view key, ValueType type,
+                       Encoding encoding, size_t payloadSize,
+                       std::optional<int64_t> expireAtMs) {
+  size_t size = sizeof(Entry) + (expireAtMs ? sizeof(int64_t) : 0) +
+                payloadSize + key.size();
+
+  Entry* entry = new (SlabAllocator::local().allocate(size)) Entry();
+  entry->type_ = static_cast<uint8_t>(type);
+  entry->encoding_ = static_cast<uint8_t>(encoding);
+  entry->hasExpiry_ = expireAtMs.has_value();
+  entry->embeddedLength_ =
+      encoding == Encoding::Embedded ? static_cast<uint8_t>(payloadSize) : 0;
+  entry->unsettled_ = false;
+  entry->access_ = 0;
+  entry->keyLength_ = static_cast<uint32_t>(key.size());
+
+  if (expireAtMs) {
+    *entry->expirySlot() = *expireAtMs;
+  }
+  std::memcpy(reinterpret_cast<char*>(entry) + entry->keyOffset(), key.data(),
+              key.size());
+  return entry;
+}
+
+Entry* Entry::createString(std::string_view key, std::string_view value,
+                           std::optional<int64_t> expireAtMs) {
+  int64_t number = 0;
+  if (parseCanonicalInt64(value, number)) {
+    return createInteger(key, number, expireAtMs);
+  }
+
+  if (value.size() <= kMaxEmbeddedLength) {
+    Entry* entry = allocate(key, ValueType::String, Encoding::Embedded,
+                            value.size(), expireAtMs);
+    std::memcpy(entry->payloadAs<char>(), value.data(), value.size());
+    return entry;
+  }
+
+  return createRawString(key, value, expireAtMs);
+}
+
+Entry* Entry::createRawString(std::string_view key, std::string_view value,
+                              std::optional<int64_t> expireAtMs) {
+  Entry* entry = allocate(key, ValueType::String, Encoding::Raw,
+                          sizeof(SharedValue), expireAtMs);
+  // Not created const, so that mutableRawValue may write to it.
+  new (entry->payloadAs<SharedValue>())
+      SharedValue(std::make_shared<std::string>(value));
+  return entry;
+}
+
+std::string& Entry::mutableRawValue() {
+  SharedValue& value = *payloadAs<SharedValue>();
+  if (value.use_count() != 1) {
+    value = std::make_shared<std::string>(*value);
+  }
+  return const_cast<std::string&>(*value);
+}
+
+Entry* Entry::createInteger(std::string_view key, int64_t value,
+                            std::optional<int64_t> expireAtMs) {
+  Entry* entry = allocate(key, ValueType::String, Encoding::Int,
+                          sizeof(int64_t), expireAtMs);
+  *entry->payloadAs<int64_t>() = value;
+  return entry;
+}
+
+Entry* Entry::createList(std::string_view key,
+                         std::optional<int64_t> expireAtMs) {
+  Entry* entry = allocate(key, ValueType::List, Encoding::Quicklist,
+                          sizeof(Quicklist*), expireAtMs);
+  *entry->payloadAs<Quicklist*>() = new Quicklist;
+  return entry;
+}
+
+Entry* Entry::createHash(std::string_view key,
+                         std::optional<int64_t> expireAtMs) {
+  Entry* entry = allocate(key, ValueType::Hash, Encoding::Listpack,
+                          sizeof(Listpack), expireAtMs);
+  new (entry->payloadAs<Listpack>()) Listpack();
+  return entry;
+}
+
+Entry* Entry::createSortedSet(std::string_view key,
+                              std::optional<int64_t> expireAtMs) {
+  Entry* entry = allocate(key, ValueType::ZSet, Encoding::Listpack,
+                          sizeof(Listpack), expireAtMs);
+  new (entry->payloadAs<Listpack>()) Listpack();
+  return entry;
+}
+
+Entry* Entry::createStream(std::string_view key,
+                           std::optional<int64_t> expireAtMs) {
+  Entry* entry = allocate(key, ValueType::Stream, Encoding::Stream,
+                          sizeof(Stream*), expireAtMs);
+  *entry->payloadAs<Stream*>() = new Stream;
+  return entry;
+}
+
+Entry* Entry::createSet(std::string_view key,
+                        std::optional<int64_t> expireAtMs) {
+  Entry* entry = allocate(key, ValueType::Set, Encoding::IntSet,
+                          sizeof(IntSet), expireAtMs);
+  new (entry->payloadAs<IntSet>()) IntSet();
+  return entry;
+}
+
+void Entry::convertToHashTable(std::unique_ptr<HashTable> table) {
+  static_assert(sizeof(Listpack) == sizeof(HashTable*));
+  std::destroy_at(payloadAs<Listpack>());
+  *payloadAs<HashTable*>() = table.release();
+  encoding_ = static_cast<uint8_t>(Encoding::HashTable);
+}
+
+void Entry::convertToSkipList(std::unique_ptr<SkipListSet> set) {
+  static_assert(sizeof(Listpack) == sizeof(SkipListSet*));
+  std::destroy_at(payloadAs<Listpack>());
+  *payloadAs<SkipListSet*>() = set.release();
+  encoding_ = static_cast<uint8_t>(Encoding::SkipList);
+}
+
+void Entry::convertToSetTable(std::unique_ptr<SetTable> table) {
+  static_assert(sizeof(IntSet) == sizeof(SetTable*));
+  std::destroy_at(payloadAs<IntSet>());
+  *payloadAs<SetTable*>() = table.release();
+  encoding_ = static_cast<uint8_t>(Encoding::SetTable);
+}
+
+void Entry::destroy(Entry* entry) {
+  size_t size = entry->allocationSize();
+  switch (entry->encoding()) {
+    case Encoding::Raw:
+      std::destroy_at(entry->payloadAs<SharedValue>());
+      break;
+    case Encoding::Quicklist:
+      delete *entry->payloadAs<Quicklist*>();
+      break;
+    case Encoding::Listpack:
+      std::destroy_at(entry->payloadAs<Listpack>());
+      break;
+    case Encoding::HashTable:
+      delete *entry->payloadAs<HashTable*>();
+      break;
+    case Encoding::SkipList:
+      delete *entry->payloadAs<SkipListSet*>();
+      break;
+    case Encoding::Stream:
+      delete *entry->payloadAs<Stream*>();
+      break;
+    case Encoding::IntSet:
+      std::destroy_at(entry->payloadAs<IntSet>());
+      break;
+    case Encoding::SetTable:
+      delete *entry->payloadAs<SetTable*>();
+      break;
+    case Encoding::Int:
+    case Encoding::Embedded:
+      break;
+  }
+  entry->~Entry();
+  SlabAllocator::deallocate(entry, size);
+}
+
+Entry* Entry::relocate(Entry* entry) {
+  size_t size = entry->allocationSize();
+  void* memory = SlabAllocator::local().allocate(size);
+  // Header, expiry, key and a payload of plain values or pointers are
+  // bytes; values that own memory are moved over them.
+  std::memcpy(memory, static_cast<const void*>(entry), size);
+  auto* moved = static_cast<Entry*>(memory);
+  switch (entry->encoding()) {
+    case Encoding::Raw:
+      new (moved->payloadAs<SharedValue>())
+          SharedValue(std::move(*entry->payloadAs<SharedValue>()));
+      std::destroy_at(entry->payloadAs<SharedValue>());
+      break;
+    case Encoding::Listpack:
+      new (moved->payloadAs<Listpack>())
+          Listpack(std::move(*entry->payloadAs<Listpack>()));
+      std::destroy_at(entry->payloadAs<Listpack>());
+      break;
+    case Encoding::IntSet:
+      new (moved->payloadAs<IntSet>())
+          IntSet(std::move(*entry->payloadAs<IntSet>()));
+      std::destroy_at(entry->payloadAs<IntSet>());
+      break;
+    case Encoding::Int:
+    case Encoding::Embedded:
+    case Encoding::Quicklist:
+    case Encoding::HashTable:
+    case Encoding::SkipList:
+    case Encoding::Stream:
+    case Encoding::SetTable:
+      break;
+  }
+  entry->~Entry();
+  SlabAllocator::deallocate(entry, size);
+  return moved;
+}
+
+size_t Entry::memoryUsage() const {
+  size_t size = allocationSize();
+  if (encoding() == Encoding::Raw) {
+    // The shared string and its control block live in one allocation.
+    size += sizeof(std::string) + 2 * sizeof(void*) + rawValue()->capacity();
+  } else if (encoding() == Encoding::Quicklist) {
+    size += listValue().memoryUsage();
+  } else if (encoding() == Encoding::Listpack) {
+    size += listpackValue().bytes();
+  } else if (encoding() == Encoding::HashTable) {
+    size += hashTableValue().memoryUsage();
+  } else if (encoding() == Encoding::SkipList) {
+    size += skipListValue().memoryUsage();
+  } else if (encoding() == Encoding::Stream) {
+    size += streamValue().memoryUsage();
+  } else if (encoding() == Encoding::IntSet) {
+    size += intSetValue().bytes();
+  } else if (encoding() == Encoding::SetTable) {
+    size += setTableValue().memoryUsage();
+  }
+  return size;
+}
+
+StringValue::StringValue(const Entry& entry) {
+  switch (entry.encoding()) {
+    case Encoding::Int: {
+      auto result = std::to_chars(inline_, inline_ + sizeof(inline_),
+                                  entry.intValue());
+      inlineLength_ = result.ptr - inline_;
+      break;
+    }
+    case Encoding::Embedded: {
+      std::string_view value = entry.embeddedValue();
+      std::memcpy(inline_, value.data(), value.size());
+      inlineLength_ = value.size();
+      break;
+    }
+    case Encoding::Raw:
+      shared_ = entry.rawValue();
+      break;
+    case Encoding::Quicklist:
+    case Encoding::Listpack:
+    case Encoding::HashTable:
+    case Encoding::SkipList:
+    case Encoding::Stream:
+    case Encoding::IntSet:
+    case Encoding::SetTable:
+      // Not a string; callers check the type first.
+      break;
+  }
+}
+
+}  // namespace redis
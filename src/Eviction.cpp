@@ -0,0 +1,89 @@
+#include "redis/Eviction.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace redis {
+
+namespace {
+
+constexpr double kLfuLogFactor = 10;
+
+uint32_t minutesNow(int64_t nowMs) {
+  return static_cast<uint32_t>(nowMs / 60000) & 0xffff;
+}
+
+}  // namespace
+
+bool parseEvictionPolicy(std::string_view name, EvictionPolicy& policy) {
+  for (EvictionPolicy candidate :
+       {EvictionPolicy::NoEviction, EvictionPolicy::AllKeysLru,
+        EvictionPolicy::AllKeysLfu, EvictionPolicy::VolatileTtl}) {
+    if (name == evictionPolicyName(candidate)) {
+      policy = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+namespace access {
+
+uint64_t lruIdleMs(uint32_t bits, int64_t nowMs) {
+  uint32_t seconds = (lruClock(nowMs) - bits) & kMask;
+  return uint64_t{seconds} * 1000;
+}
+
+uint8_t lfuCounter(uint32_t bits, int64_t nowMs) {
+  uint32_t elapsed = (minutesNow(nowMs) - (bits >> 8)) & 0xffff;
+  uint32_t counter = bits & 0xff;
+  return static_cast<uint8_t>(elapsed >= counter ? 0 : counter - elapsed);
+}
+
+uint32_t lfuTouch(uint32_t bits, int64_t nowMs, double random) {
+  uint32_t counter = lfuCounter(bits, nowMs);
+  if (counter < 255) {
+    double base = std::max<double>(counter - kLfuInitValue, 0);
+    if (random < 1.0 / (base * kLfuLogFactor + 1)) {
+      counter++;
+    }
+  }
+  return minutesNow(nowMs) << 8 | counter;
+}
+
+}  // namespace access
+
+void EvictionPool::offer(std::string_view key, uint64_t score) {
+  // The first candidate scoring at least as high.
+  size_t pos = 0;
+  while (pos < size_ && candidates_[pos].score < score) {
+    pos++;
+  }
+  if (size_ == kSize) {
+    if (pos == 0) {
+      return;
+    }
+    // Full: the worst candidate makes room, shifting the lower ones down.
+    pos--;
+    std::rotate(candidates_.begin(), candidates_.begin() + 1,
+                candidates_.begin() + pos + 1);
+  } else {
+    std::rotate(candidates_.begin() + pos, candidates_.begin() + size_,
+                candidates_.begin() + size_ + 1);
+    size_++;
+  }
+  // The string keeps its buffer when slots are reused.
+  candidates_[pos].score = score;
+  candidates_[pos].key.assign(key);
+}
+
+bool EvictionPool::pop(std::string& key) {
+  if (size_ == 0) {
+    return false;
+  }
+  size_--;
+  std::swap(key, candidates_[size_].key);
+  return true;
+}
+
+}  // namespace redis
@@ -0,0 +1,146 @@
+#include "redis/GlobPattern.h"
+
+#include <utility>
+
+namespace redis {
+
+GlobPattern::GlobPattern(std::string_view pattern) {
+  size_t i = 0;
+  auto appendLiteral = [this](char c) {
+    if (tokens_.empty() || tokens_.back().op != Token::Op::Literal) {
+      tokens_.push_back(Token{Token::Op::Literal, {}, {}});
+    }
+    tokens_.back().literal.push_back(c);
+  };
+
+  while (i < pattern.size()) {
+    char c = pattern[i++];
+    switch (c) {
+      case '*':
+        // Consecutive stars match the same as one.
+        if (tokens_.empty() || tokens_.back().op != Token::Op::Star) {
+          tokens_.push_back(Token{Token::Op::Star, {}, {}});
+        }
+        break;
+
+      case '?':
+        tokens_.push_back(Token{Token::Op::AnyChar, {}, {}});
+        break;
+
+      case '\\':
+        // A trailing backslash matches itself.
+        appendLiteral(i < pattern.size() ? pattern[i++] : '\\');
+        break;
+
+      case '[': {
+        Token token{Token::Op::Class, {}, {}};
+        bool negate = i < pattern.size() && pattern[i] == '^';
+        if (negate) i++;
+        // Like stringmatchlen, an unterminated class ends with the pattern.
+        while (i < pattern.size() && pattern[i] != ']') {
+          if (pattern[i] == '\\' && i + 1 < pattern.size()) {
+            token.members.set(static_cast<unsigned char>(pattern[i + 1]));
+            i += 2;
+          } else if (i + 2 < pattern.size() && pattern[i + 1] == '-') {
+            auto start = static_cast<unsigned char>(pattern[i]);
+            auto end = static_cast<unsigned char>(pattern[i + 2]);
+            if (start > end) std::swap(start, end);
+            for (unsigned b = start; b <= end; b++) {
+              token.members.set(b);
+            }
+            i += 3;
+          } else {
+            token.members.set(static_cast<unsigned char>(pattern[i]));
+            i++;
+          }
+        }
+        if (i < pattern.size()) i++;  // the closing ']'
+        if (negate) token.members.flip();
+        tokens_.push_back(std::move(token));
+        break;
+      }
+
+      default:
+        appendLiteral(c);
+        break;
+    }
+  }
+
+  // Shapes that need no general matching.
+  if (tokens_.size() == 1 && tokens_[0].op == Token::Op::Star) {
+    kind_ = Kind::All;
+  } else if (tokens_.empty() ||
+             (tokens_.size() == 1 && tokens_[0].op == Token::Op::Literal)) {
+    kind_ = Kind::Exact;
+    literal_ = tokens_.empty() ? std::string() : tokens_[0].literal;
+  } else if (tokens_.size() == 2 && tokens_[0].op == Token::Op::Literal &&
+             tokens_[1].op == Token::Op::Star) {
+    kind_ = Kind::Prefix;
+    literal_ = tokens_[0].literal;
+  }
+}
+
+bool GlobPattern::matches(std::string_view str) const {
+  switch (kind_) {
+    case Kind::All:
+      return true;
+    case Kind::Exact:
+      return str == literal_;
+    case Kind::Prefix:
+      return str.starts_with(literal_);
+    case Kind::General:
+      break;
+  }
+  return matchesGeneral(str);
+}
+
+bool GlobPattern::matchesGeneral(std::string_view str) const {
+  // Every token but "*" matches a fixed number of bytes, so it is enough to
+  // remember the last star: on a mismatch it absorbs one more byte and
+  // matching resumes after it. Worst case O(pattern * string).
+  constexpr size_t kNoStar = static_cast<size_t>(-1);
+  size_t t = 0;
+  size_t s = 0;
+  size_t starToken = kNoStar;
+  size_t starPos = 0;
+
+  while (true) {
+    if (t < tokens_.size()) {
+      const Token& token = tokens_[t];
+      bool matched = false;
+      switch (token.op) {
+        case Token::Op::Star:
+          starToken = ++t;
+          starPos = s;
+          continue;
+        case Token::Op::Literal:
+          matched = str.substr(s).starts_with(token.literal);
+          if (matched) s += token.literal.size();
+          break;
+        case Token::Op::AnyChar:
+          matched = s < str.size();
+          if (matched) s++;
+          break;
+        case Token::Op::Class:
+          matched = s < str.size() &&
+                    token.members.test(static_cast<unsigned char>(str[s]));
+          if (matched) s++;
+          break;
+      }
+      if (matched) {
+        t++;
+        continue;
+      }
+    } else if (s == str.size()) {
+      return true;
+    }
+
+    if (starToken == kNoStar || starPos >= str.size()) {
+      return false;
+    }
+    t = starToken;
+    s = ++starPos;
+  }
+}
+
+}  // namespace redis
@@ -0,0 +1,142 @@
+#include "redis/Hash.h"
+
+#include <cstring>
+#include <new>
+
+#include "redis/Entry.h"
+#include "redis/Listpack.h"
+
+namespace redis {
+
+HashField* HashField::create(std::string_view field, std::string_view value) {
+  HashField* created = new (::operator new(
+      sizeof(HashField) + field.size() + value.size())) HashField();
+  created->fieldLength_ = static_cast<uint32_t>(field.size());
+  created->valueLength_ = static_cast<uint32_t>(value.size());
+  char* data = reinterpret_cast<char*>(created + 1);
+  std::memcpy(data, field.data(), field.size());
+  std::memcpy(data + field.size(), value.data(), value.size());
+  return created;
+}
+
+size_t HashTable::memoryUsage() const {
+  // A slot and its control byte per bucket.
+  return sizeof(HashTable) +
+         fields_.capacity() * (sizeof(HashFieldPtr) + 1) + bytes_;
+}
+
+const HashField* HashTable::find(std::string_view field) const {
+  const HashFieldPtr* slot = fields_.find(field);
+  return slot ? slot->get() : nullptr;
+}
+
+bool HashTable::set(std::string_view field, std::string_view value) {
+  auto [slot, inserted] = fields_.findOrInsert(
+      field, [&] { return HashFieldPtr(HashField::create(field, value)); });
+  if (!inserted) {
+    bytes_ -= (*slot)->allocationSize();
+    slot->reset(HashField::create(field, value));
+  }
+  bytes_ += (*slot)->allocationSize();
+  return inserted;
+}
+
+bool HashTable::remove(std::string_view field) {
+  HashFieldPtr removed;
+  if (!fields_.extract(field, removed)) {
+    return false;
+  }
+  bytes_ -= removed->allocationSize();
+  return true;
+}
+
+void HashTable::forEach(
+    const std::function<void(std::string_view, std::string_view)>& visit)
+    const {
+  fields_.forEach([&visit](const HashFieldPtr& slot) {
+    visit(slot->field(), slot->value());
+  });
+}
+
+size_t Hash::size() const {
+  if (entry_->encoding() == Encoding::Listpack) {
+    return entry_->listpackValue().size() / 2;
+  }
+  return entry_->hashTableValue().size();
+}
+
+std::optional<std::string_view> Hash::get(std::string_view field) const {
+  if (entry_->encoding() == Encoding::Listpack) {
+    const Listpack& listpack = entry_->listpackValue();
+    size_t pos = listpack.find(listpack.begin(), field, 1);
+    if (pos == listpack.end()) {
+      return std::nullopt;
+    }
+    return listpack.get(listpack.next(pos));
+  }
+  const HashField* found = entry_->hashTableValue().find(field);
+  if (found == nullptr) {
+    return std::nullopt;
+  }
+  return found->value();
+}
+
+bool Hash::set(std::string_view field, std::string_view value) {
+  if (entry_->encoding() == Encoding::Listpack) {
+    Listpack& listpack = entry_->listpackValue();
+    bool fits = field.size() <= limits_->maxListpackValue &&
+                value.size() <= limits_->maxListpackValue;
+    size_t pos = listpack.find(listpack.begin(), field, 1);
+    if (pos != listpack.end()) {
+      if (fits) {
+        listpack.replace(listpack.next(pos), value);
+        return false;
+      }
+    } else if (fits && size() < limits_->maxListpackEntries) {
+      listpack.pushBack(field);
+      listpack.pushBack(value);
+      return true;
+    }
+    return convertToTable().set(field, value);
+  }
+  return entry_->hashTableValue().set(field, value);
+}
+
+bool Hash::remove(std::string_view field) {
+  if (entry_->encoding() == Encoding::Listpack) {
+    Listpack& listpack = entry_->listpackValue();
+    size_t pos = listpack.find(listpack.begin(), field, 1);
+    if (pos == listpack.end()) {
+      return false;
+    }
+    listpack.erase(pos, 2);
+    return true;
+  }
+  return entry_->hashTableValue().remove(field);
+}
+
+void Hash::forEach(
+    const std::function<void(std::string_view, std::string_view)>& visit)
+    const {
+  if (entry_->encoding() == Encoding::Listpack) {
+    const Listpack& listpack = entry_->listpackValue();
+    for (size_t pos = listpack.begin(); pos < listpack.end();) {
+      size_t valuePos = listpack.next(pos);
+      visit(listpack.get(pos), listpack.get(valuePos));
+      pos = listpack.next(valuePos);
+    }
+    return;
+  }
+  entry_->hashTableValue().forEach(visit);
+}
+
+HashTable& Hash::convertToTable() {
+  auto table = std::make_unique<HashTable>();
+  forEach([&table](std::string_view field, std::string_view value) {
+    table->set(field, value);
+  });
+  entry_->convertToHashTable(std::move(table));
+  return entry_->hashTableValue();
+}
+
+}  // namespace redis
@@ -0,0 +1,504 @@
+#include "redis/HyperLogLog.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+
+#include "redis/Cpu.h"
+
+#if defined(REDIS_X86_DISPATCH)
+#include <immintrin.h>
+#endif
+
+namespace redis {
+
+namespace {
+
+constexpr std::string_view kMagic = "HYLL";
+constexpr size_t kHeaderSize = 16;
+constexpr size_t kEncodingOffset = 4;
+constexpr size_t kCardinalityOffset = 8;
+constexpr char kDense = 0;
+constexpr char kSparse = 1;
+
+// Register index bits, and the hash bits left to count zeros in.
+constexpr int kIndexBits = 14;
+constexpr int kCountBits = 64 - kIndexBits;
+constexpr size_t kDenseBytes = HyperLogLog::kRegisters * 6 / 8;
+// Dense registers come in groups of four to three bytes.
+constexpr size_t kGroups = HyperLogLog::kRegisters / 4;
+
+// Sparse opcodes:
+//   00xxxxxx           ZERO:  1-64 zero registers
+//   01xxxxxx yyyyyyyy  XZERO: 1-16384 zero registers
+//   1vvvvvxx           VAL:   1-4 registers of value 1-32
+constexpr uint8_t kSparseMaxValue = 32;
+constexpr size_t kSparseMaxRun = 4;
+constexpr size_t kZeroMaxRun = 64;
+constexpr size_t kXZeroMaxRun = HyperLogLog::kRegisters;
+
+const bool kHasAvx2 = cpuHasAvx2();
+
+// MurmurHash64A with Redis's seed, so elements land in the registers a
+// Redis server would put them in.
+uint64_t hashElement(std::string_view element) {
+  constexpr uint64_t kM = 0xc6a4a7935bd1e995;
+  constexpr int kR = 47;
+  const auto* data = reinterpret_cast<const uint8_t*>(element.data());
+  size_t length = element.size();
+  uint64_t h = 0xadc83b19ULL ^ (length * kM);
+  const uint8_t* end = data + (length - (length & 7));
+  for (; data != end; data += 8) {
+    uint64_t k;
+    std::memcpy(&k, data, sizeof(k));
+    k *= kM;
+    k ^= k >> kR;
+    k *= kM;
+    h ^= k;
+    h *= kM;
+  }
+  size_t tail = length & 7;
+  if (tail != 0) {
+    for (size_t i = tail; i-- > 0;) {
+      h ^= static_cast<uint64_t>(data[i]) << (8 * i);
+    }
+    h *= kM;
+  }
+  h ^= h >> kR;
+  h *= kM;
+  h ^= h >> kR;
+  return h;
+}
+
+struct SparseOp {
+  size_t run;
+  uint8_t value;  // 0 for ZERO and XZERO
+  size_t bytes;   // 0 when the opcode is cut off
+};
+
+SparseOp decodeOp(const uint8_t* p, const uint8_t* end) {
+  uint8_t b = *p;
+  if (b & 0x80) {
+    return {static_cast<size_t>(b & 3) + 1,
+            static_cast<uint8_t>(((b >> 2) & 0x1f) + 1), 1};
+  }
+  if (b & 0x40) {
+    if (p + 1 >= end) {
+      return {0, 0, 0};
+    }
+    return {((static_cast<size_t>(b & 0x3f) << 8) | p[1]) + 1, 0, 2};
+  }
+  return {static_cast<size_t>(b & 0x3f) + 1, 0, 1};
+}
+
+uint8_t valueOp(uint8_t value, size_t run) {
+  return static_cast<uint8_t>(0x80 | ((value - 1) << 2) | (run - 1));
+}
+
+// Writes a run of up to kXZeroMaxRun zeros; returns the bytes written.
+size_t writeZeros(uint8_t* out, size_t run) {
+  if (run == 0) {
+    return 0;
+  }
+  if (run <= kZeroMaxRun) {
+    out[0] = static_cast<uint8_t>(run - 1);
+    return 1;
+  }
+  out[0] = static_cast<uint8_t>(0x40 | ((run - 1) >> 8));
+  out[1] = static_cast<uint8_t>((run - 1) & 0xff);
+  return 2;
+}
+
+uint8_t getDense(const uint8_t* registers, size_t index) {
+  size_t bit = index * 6;
+  unsigned shift = bit % 8;
+  unsigned value = registers[bit / 8] >> shift;
+  if (shift > 2) {
+    value |= static_cast<unsigned>(registers[bit / 8 + 1]) << (8 - shift);
+  }
+  return static_cast<uint8_t>(value & 63);
+}
+
+void setDenseRegister(uint8_t* registers, size_t index, uint8_t value) {
+  size_t bit = index * 6;
+  size_t byte = bit / 8;
+  unsigned shift = bit % 8;
+  registers[byte] = static_cast<uint8_t>(
+      (registers[byte] & ~(63u << shift)) | (unsigned{value} << shift));
+  if (shift > 2) {
+    registers[byte + 1] = static_cast<uint8_t>(
+        (registers[byte + 1] & ~(63u >> (8 - shift))) |
+        (unsigned{value} >> (8 - shift)));
+  }
+}
+
+void packDense(const HyperLogLog::Registers& registers, uint8_t* out) {
+  for (size_t g = 0; g < kGroups; g++) {
+    const uint8_t* r = registers.data() + 4 * g;
+    uint32_t v = r[0] | (r[1] << 6) | (r[2] << 12) | (uint32_t{r[3]} << 18);
+    out[3 * g] = static_cast<uint8_t>(v);
+    out[3 * g + 1] = static_cast<uint8_t>(v >> 8);
+    out[3 * g + 2] = static_cast<uint8_t>(v >> 16);
+  }
+}
+
+// Unpacks dense registers from group from on, raising each of registers
+// to its value.
+void maxDenseGroups(const uint8_t* dense, size_t from, uint8_t* registers) {
+  for (size_t g = from; g < kGroups; g++) {
+    const uint8_t* p = dense + 3 * g;
+    uint32_t v = p[0] | (p[1] << 8) | (uint32_t{p[2]} << 16);
+    for (size_t k = 0; k < 4; k++) {
+      uint8_t value = (v >> (6 * k)) & 63;
+      registers[4 * g + k] = std::max(registers[4 * g + k], value);
+    }
+  }
+}
+
+#if defined(REDIS_X86_DISPATCH)
+// Eight groups per step: each 128-bit lane spreads four groups of three
+// bytes into four 32-bit words, and shifts and masks move the four
+// registers of a word into its four bytes. Returns the groups it covered;
+// the last few are left to the scalar loop, as the second load would read
+// past the registers.
+__attribute__((target("avx2"))) size_t maxDenseAvx2(const uint8_t* dense,
+                                                    uint8_t* registers) {
+  const __m256i spread = _mm256_setr_epi8(
+      0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1, 0, 1, 2, -1, 3, 4,
+      5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+  const __m256i mask0 = _mm256_set1_epi32(0x3f);
+  const __m256i mask1 = _mm256_set1_epi32(0x3f00);
+  const __m256i mask2 = _mm256_set1_epi32(0x3f0000);
+  const __m256i mask3 = _mm256_set1_epi32(0x3f000000);
+  size_t g = 0;
+  for (; 3 * g + 28 <= kDenseBytes; g += 8) {
+    const uint8_t* p = dense + 3 * g;
+    __m256i in = _mm256_inserti128_si256(
+        _mm256_castsi128_si256(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(p))),
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 12)), 1);
+    __m256i v = _mm256_shuffle_epi8(in, spread);
+    __m256i unpacked = _mm256_or_si256(
+        _mm256_or_si256(_mm256_and_si256(v, mask0),
+                        _mm256_and_si256(_mm256_slli_epi32(v, 2), mask1)),
+        _mm256_or_si256(_mm256_and_si256(_mm256_slli_epi32(v, 4), mask2),
+                        _mm256_and_si256(_mm256_slli_epi32(v, 6), mask3)));
+    auto* out = reinterpret_cast<__m256i*>(registers + 4 * g);
+    _mm256_storeu_si256(out,
+                        _mm256_max_epu8(_mm256_loadu_si256(out), unpacked));
+  }
+  return g;
+}
+#endif
+
+void maxDense(const uint8_t* dense, uint8_t* registers) {
+  size_t done = 0;
+#if defined(REDIS_X86_DISPATCH)
+  if (kHasAvx2) {
+    done = maxDenseAvx2(dense, registers);
+  }
+#endif
+  maxDenseGroups(dense, done, registers);
+}
+
+using Histogram = std::array<uint32_t, 64>;
+
+// Counts registers by value. Four partial counts keep runs of one value
+// from serializing on a single counter.
+Histogram histogramOf(const HyperLogLog::Registers& registers) {
+  uint32_t parts[4][64] = {};
+  for (size_t i = 0; i < registers.size(); i += 4) {
+    parts[0][registers[i]]++;
+    parts[1][registers[i + 1]]++;
+    parts[2][registers[i + 2]]++;
+    parts[3][registers[i + 3]]++;
+  }
+  Histogram histogram{};
+  for (size_t v = 0; v < histogram.size(); v++) {
+    histogram[v] = parts[0][v] + parts[1][v] + parts[2][v] + parts[3][v];
+  }
+  return histogram;
+}
+
+double sigma(double x) {
+  if (x == 1.0) {
+    return INFINITY;
+  }
+  double y = 1.0;
+  double z = x;
+  double previous;
+  do {
+    x *= x;
+    previous = z;
+    z += x * y;
+    y += y;
+  } while (previous != z);
+  return z;
+}
+
+double tau(double x) {
+  if (x == 0.0 || x == 1.0) {
+    return 0.0;
+  }
+  double y = 1.0;
+  double z = 1 - x;
+  double previous;
+  do {
+    x = std::sqrt(x);
+    previous = z;
+    y *= 0.5;
+    z -= (1 - x) * (1 - x) * y;
+  } while (previous != z);
+  return z / 3;
+}
+
+// Ertl's improved estimator, as Redis computes it, from the histogram of
+// register values.
+uint64_t estimate(const Histogram& histogram) {
+  constexpr double kAlphaInf = 0.721347520444481703680;
+  double m = HyperLogLog::kRegisters;
+  double z = m * tau((m - histogram[kCountBits + 1]) / m);
+  for (int j = kCountBits; j >= 1; j--) {
+    z += histogram[j];
+    z *= 0.5;
+  }
+  z += m * sigma(histogram[0] / m);
+  return static_cast<uint64_t>(std::llround(kAlphaInf * m * m / z));
+}
+
+std::string header(char encoding) {
+  std::string bytes(kHeaderSize, '\0');
+  bytes.replace(0, kMagic.size(), kMagic);
+  bytes[kEncodingOffset] = encoding;
+  return bytes;
+}
+
+}  // namespace
+
+bool HyperLogLog::isValid(std::string_view bytes) {
+  if (bytes.size() < kHeaderSize || !bytes.starts_with(kMagic)) {
+    return false;
+  }
+  if (bytes[kEncodingOffset] == kDense) {
+    return bytes.size() == kHeaderSize + kDenseBytes;
+  }
+  if (bytes[kEncodingOffset] != kSparse) {
+    return false;
+  }
+  const auto* p = reinterpret_cast<const uint8_t*>(bytes.data());
+  const uint8_t* end = p + bytes.size();
+  size_t covered = 0;
+  for (p += kHeaderSize; p < end;) {
+    SparseOp op = decodeOp(p, end);
+    if (op.bytes == 0) {
+      return false;
+    }
+    covered += op.run;
+    p += op.bytes;
+  }
+  return covered == kRegisters;
+}
+
+void HyperLogLog::clear() {
+  *bytes_ = header(kSparse);
+  uint8_t zeros[2];
+  bytes_->append(reinterpret_cast<char*>(zeros),
+                 writeZeros(zeros, kXZeroMaxRun));
+}
+
+bool HyperLogLog::add(std::string_view element) {
+  uint64_t hash = hashElement(element);
+  size_t index = hash & (kRegisters - 1);
+  // The position of the first set bit of the rest, which is why the top
+  // bit is set: no count exceeds kCountBits + 1.
+  hash = (hash >> kIndexBits) | (uint64_t{1} << kCountBits);
+  auto value = static_cast<uint8_t>(std::countr_zero(hash) + 1);
+  bool changed = (*bytes_)[kEncodingOffset] == kSparse
+                     ? setSparse(index, value)
+                     : setDense(index, value);
+  if (changed) {
+    invalidateCache();
+  }
+  return changed;
+}
+
+bool HyperLogLog::setDense(size_t index, uint8_t value) {
+  auto* registers = reinterpret_cast<uint8_t*>(bytes_->data() + kHeaderSize);
+  if (getDense(registers, index) >= value) {
+    return false;
+  }
+  setDenseRegister(registers, index, value);
+  return true;
+}
+
+// Finds the opcode covering index and splits it around the new value: up
+// to five bytes replace one or two. The VAL runs around the change are
+// then joined where they can be, as Redis does.
+bool HyperLogLog::setSparse(size_t index, uint8_t value) {
+  if (value > kSparseMaxValue) {
+    toDense();
+    return setDense(index, value);
+  }
+  const auto* data = reinterpret_cast<const uint8_t*>(bytes_->data());
+  const uint8_t* end = data + bytes_->size();
+  size_t pos = kHeaderSize;
+  size_t previous = pos;
+  size_t first = 0;
+  SparseOp op = decodeOp(data + pos, end);
+  while (index >= first + op.run) {
+    first += op.run;
+    previous = pos;
+    pos += op.bytes;
+    op = decodeOp(data + pos, end);
+  }
+  if (op.value >= value) {
+    return false;
+  }
+
+  uint8_t seq[5];
+  size_t length = 0;
+  size_t before = index - first;
+  size_t after = first + op.run - index - 1;
+  if (op.value == 0) {
+    length += writeZeros(seq, before);
+    seq[length++] = valueOp(value, 1);
+    length += writeZeros(seq + length, after);
+  } else {
+    if (before != 0) {
+      seq[length++] = valueOp(op.value, before);
+    }
+    seq[length++] = valueOp(value, 1);
+    if (after != 0) {
+      seq[length++] = valueOp(op.value, after);
+    }
+  }
+  bytes_->replace(pos, op.bytes, reinterpret_cast<char*>(seq), length);
+  if (bytes_->size() > kSparseMaxBytes) {
+    toDense();
+    return true;
+  }
+
+  auto* p = reinterpret_cast<uint8_t*>(bytes_->data());
+  for (int scan = 0; scan < 5 && previous + 1 < bytes_->size(); scan++) {
+    SparseOp current = decodeOp(p + previous, p + bytes_->size());
+    if (current.value != 0) {
+      SparseOp next = decodeOp(p + previous + 1, p + bytes_->size());
+      if (next.value == current.value &&
+          current.run + next.run <= kSparseMaxRun) {
+        p[previous] = valueOp(current.value, current.run + next.run);
+        bytes_->erase(previous + 1, 1);
+        continue;
+      }
+    }
+    previous += current.bytes;
+  }
+  return true;
+}
+
+void HyperLogLog::toDense() {
+  Registers registers{};
+  mergeInto(*bytes_, registers);
+  std::string dense = header(kDense);
+  dense.replace(kCardinalityOffset, 8, *bytes_, kCardinalityOffset, 8);
+  dense.resize(kHeaderSize + kDenseBytes);
+  packDense(registers, reinterpret_cast<uint8_t*>(dense.data()) + kHeaderSize);
+  bytes_->swap(dense);
+}
+
+void HyperLogLog::invalidateCache() {
+  (*bytes_)[kCardinalityOffset + 7] |= static_cast<char>(0x80);
+}
+
+uint64_t HyperLogLog::count() {
+  auto* card =
+      reinterpret_cast<uint8_t*>(bytes_->data() + kCardinalityOffset);
+  if ((card[7] & 0x80) == 0) {
+    uint64_t cached = 0;
+    for (size_t i = 0; i < 8; i++) {
+      cached |= uint64_t{card[i]} << (8 * i);
+    }
+    return cached;
+  }
+
+  Histogram histogram{};
+  if ((*bytes_)[kEncodingOffset] == kSparse) {
+    // Straight from the runs, without unpacking.
+    const auto* p = reinterpret_cast<const uint8_t*>(bytes_->data());
+    const uint8_t* end = p + bytes_->size();
+    for (p += kHeaderSize; p < end;) {
+      SparseOp op = decodeOp(p, end);
+      histogram[op.value] += static_cast<uint32_t>(op.run);
+      p += op.bytes;
+    }
+  } else {
+    Registers registers{};
+    mergeInto(*bytes_, registers);
+    histogram = histogramOf(registers);
+  }
+  uint64_t result = estimate(histogram);
+  for (size_t i = 0; i < 8; i++) {
+    card[i] = static_cast<uint8_t>(result >> (8 * i));
+  }
+  return result;
+}
+
+void HyperLogLog::mergeInto(std::string_view bytes, Registers& registers) {
+  const auto* p = reinterpret_cast<const uint8_t*>(bytes.data());
+  if (bytes[kEncodingOffset] == kDense) {
+    maxDense(p + kHeaderSize, registers.data());
+    return;
+  }
+  const uint8_t* end = p + bytes.size();
+  size_t index = 0;
+  for (p += kHeaderSize; p < end;) {
+    SparseOp op = decodeOp(p, end);
+    if (op.value != 0) {
+      for (size_t k = 0; k < op.run; k++) {
+        registers[index + k] = std::max(registers[index + k], op.value);
+      }
+    }
+    index += op.run;
+    p += op.bytes;
+  }
+}
+
+void HyperLogLog::assign(const Registers& registers) {
+  std::string sparse = header(kSparse);
+  bool fits = true;
+  for (size_t i = 0; i < kRegisters && fits;) {
+    uint8_t value = registers[i];
+    size_t run = 1;
+    while (i + run < kRegisters && registers[i + run] == value) {
+      run++;
+    }
+    i += run;
+    if (value > kSparseMaxValue) {
+      fits = false;
+    } else if (value == 0) {
+      uint8_t zeros[2];
+      sparse.append(reinterpret_cast<char*>(zeros), writeZeros(zeros, run));
+    } else {
+      for (; run > 0; run -= std::min(run, kSparseMaxRun)) {
+        sparse.push_back(
+            static_cast<char>(valueOp(value, std::min(run, kSparseMaxRun))));
+      }
+    }
+    fits = fits && sparse.size() <= kSparseMaxBytes;
+  }
+  if (fits) {
+    *bytes_ = std::move(sparse);
+  } else {
+    *bytes_ = header(kDense);
+    bytes_->resize(kHeaderSize + kDenseBytes);
+    packDense(registers,
+              reinterpret_cast<uint8_t*>(bytes_->data()) + kHeaderSize);
+  }
+  invalidateCache();
+}
+
+uint64_t estimateCardinality(const HyperLogLog::Registers& registers) {
+  return estimate(histogramOf(registers));
+}
+
+}  // namespace redis
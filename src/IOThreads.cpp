@@ -0,0 +1,92 @@
+#include "redis/IOThreads.h"
+
+namespace redis {
+
+namespace {
+
+// Polls before parking on a futex. Batches arrive once per loop iteration,
+// so under load a worker is usually woken within the spin.
+constexpr int kSpinIterations = 4096;
+
+}  // namespace
+
+IOThreads::IOThreads(size_t count)
+    : count_(count == 0 ? 1 : count),
+      generation_(0),
+      active_(0),
+      stopping_(false),
+      job_(nullptr),
+      jobSize_(0) {
+  workers_.reserve(count_ - 1);
+  for (size_t id = 1; id < count_; id++) {
+    workers_.emplace_back([this, id] { workerMain(id); });
+  }
+}
+
+IOThreads::~IOThreads() {
+  stopping_.store(true, std::memory_order_relaxed);
+  generation_.fetch_add(1, std::memory_order_release);
+  generation_.notify_all();
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+void IOThreads::run(size_t n, const std::function<void(size_t)>& job) {
+  if (n < count_ * 2) {
+    for (size_t i = 0; i < n; i++) {
+      job(i);
+    }
+    return;
+  }
+
+  job_ = &job;
+  jobSize_ = n;
+  active_.store(count_ - 1, std::memory_order_relaxed);
+  generation_.fetch_add(1, std::memory_order_release);
+  generation_.notify_all();
+
+  runShare(0);
+
+  for (int spin = 0; spin < kSpinIterations; spin++) {
+    if (active_.load(std::memory_order_acquire) == 0) {
+      return;
+    }
+  }
+  size_t remaining;
+  while ((remaining = active_.load(std::memory_order_acquire)) != 0) {
+    active_.wait(remaining, std::memory_order_acquire);
+  }
+}
+
+void IOThreads::runShare(size_t id) {
+  for (size_t i = id; i < jobSize_; i += count_) {
+    (*job_)(i);
+  }
+}
+
+void IOThreads::workerMain(size_t id) {
+  uint64_t seen = 0;
+  while (true) {
+    uint64_t generation = generation_.load(std::memory_order_acquire);
+    for (int spin = 0; spin < kSpinIterations && generation == seen; spin++) {
+      generation = generation_.load(std::memory_order_acquire);
+    }
+    if (generation == seen) {
+      generation_.wait(seen, std::memory_order_acquire);
+      continue;
+    }
+    seen = generation;
+
+    if (stopping_.load(std::memory_order_relaxed)) {
+      return;
+    }
+
+    runShare(id);
+    if (active_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      active_.notify_one();
+    }
+  }
+}
+
+}  // namespace redis
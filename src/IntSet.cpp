@@ -0,0 +1,343 @@
+#include "redis/IntSet.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <new>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace redis {
+
+namespace {
+
+size_t widthOf(int64_t value) {
+  if (value >= INT16_MIN && value <= INT16_MAX) return sizeof(int16_t);
+  if (value >= INT32_MIN && value <= INT32_MAX) return sizeof(int32_t);
+  return sizeof(int64_t);
+}
+
+int64_t readAt(const char* values, size_t width, size_t index) {
+  switch (width) {
+    case sizeof(int16_t):
+      return reinterpret_cast<const int16_t*>(values)[index];
+    case sizeof(int32_t):
+      return reinterpret_cast<const int32_t*>(values)[index];
+    default:
+      return reinterpret_cast<const int64_t*>(values)[index];
+  }
+}
+
+// Beyond this ratio of sizes, searching the larger array for each value of
+// the smaller beats walking both.
+constexpr size_t kGallopRatio = 32;
+
+template <typename T>
+size_t lowerBound(const T* data, size_t /*size*/, size_t lo, size_t hi,
+                  T x) {
+  return std::lower_bound(data + lo, data + hi, x) - data;
+}
+
+#if defined(__SSE2__)
+// Binary search down to sixteen candidates, then count those below x with
+// four compares instead of four more branches.
+size_t lowerBound(const int32_t* data, size_t size, size_t lo, size_t hi,
+                  int32_t x) {
+  constexpr size_t kWindow = 16;
+  while (hi - lo > kWindow) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (data[mid] < x) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  if (lo + kWindow > size) {
+    return std::lower_bound(data + lo, data + hi, x) - data;
+  }
+  // The window is sorted, so the values below x are a prefix of it.
+  __m128i vx = _mm_set1_epi32(x);
+  const auto* window = reinterpret_cast<const __m128i*>(data + lo);
+  uint32_t below = 0;
+  for (size_t k = 0; k < kWindow / 4; k++) {
+    __m128i lt = _mm_cmplt_epi32(_mm_loadu_si128(window + k), vx);
+    below += std::popcount(static_cast<uint32_t>(
+        _mm_movemask_ps(_mm_castsi128_ps(lt))));
+  }
+  return lo + below;
+}
+#endif
+
+// For each value of small, doubles a stride through large until it passes
+// the value, then searches the last stride.
+template <typename T>
+size_t gallopIntersect(std::span<const T> small, std::span<const T> large,
+                       T* out) {
+  size_t count = 0;
+  size_t j = 0;
+  for (size_t i = 0; i < small.size() && j < large.size(); i++) {
+    T x = small[i];
+    size_t lo = j;
+    size_t hi = j;
+    for (size_t step = 1; hi < large.size() && large[hi] < x; step *= 2) {
+      lo = hi + 1;
+      hi += step;
+    }
+    j = lowerBound(large.data(), large.size(), lo,
+                   std::min(hi + 1, large.size()), x);
+    if (j < large.size() && large[j] == x) {
+      out[count++] = x;
+      j++;
+    }
+  }
+  return count;
+}
+
+template <typename T>
+size_t mergeIntersect(std::span<const T> a, std::span<const T> b, T* out,
+                      size_t i = 0, size_t j = 0, size_t count = 0) {
+  while (i < a.size() && j < b.size()) {
+    if (a[i] < b[j]) {
+      i++;
+    } else if (b[j] < a[i]) {
+      j++;
+    } else {
+      out[count++] = a[i];
+      i++;
+      j++;
+    }
+  }
+  return count;
+}
+
+#if defined(__SSE2__)
+// Four values of a against four of b per step: b and its three rotations
+// cover every pair. Whichever block ends lower moves on, both when they
+// end alike. A block of a keeps its matches until it moves on, so out,
+// which may alias a, is only written behind what has been read.
+size_t mergeIntersect(std::span<const int32_t> a, std::span<const int32_t> b,
+                      int32_t* out) {
+  size_t i = 0;
+  size_t j = 0;
+  size_t count = 0;
+  if (a.size() < 4 || b.size() < 4) {
+    return mergeIntersect<int32_t>(a, b, out);
+  }
+
+  alignas(16) int32_t block[4];
+  auto emit = [&](uint32_t matched) {
+    _mm_store_si128(reinterpret_cast<__m128i*>(block),
+                    _mm_loadu_si128(
+                        reinterpret_cast<const __m128i*>(a.data() + i)));
+    for (; matched != 0; matched &= matched - 1) {
+      out[count++] = block[std::countr_zero(matched)];
+    }
+  };
+
+  uint32_t matched = 0;
+  __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a.data()));
+  __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b.data()));
+  while (true) {
+    __m128i rot1 = _mm_shuffle_epi32(vb, _MM_SHUFFLE(0, 3, 2, 1));
+    __m128i rot2 = _mm_shuffle_epi32(vb, _MM_SHUFFLE(1, 0, 3, 2));
+    __m128i rot3 = _mm_shuffle_epi32(vb, _MM_SHUFFLE(2, 1, 0, 3));
+    __m128i eq = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi32(va, vb), _mm_cmpeq_epi32(va, rot1)),
+        _mm_or_si128(_mm_cmpeq_epi32(va, rot2), _mm_cmpeq_epi32(va, rot3)));
+    matched |= static_cast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(eq)));
+
+    int32_t aLast = a[i + 3];
+    int32_t bLast = b[j + 3];
+    if (aLast <= bLast) {
+      emit(std::exchange(matched, 0));
+      i += 4;
+    }
+    if (bLast <= aLast) {
+      j += 4;
+    }
+    if (i + 4 > a.size() || j + 4 > b.size()) {
+      break;
+    }
+    if (aLast <= bLast) {
+      va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a.data() + i));
+    }
+    if (bLast <= aLast) {
+      vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b.data() + j));
+    }
+  }
+  // b ran out under a half-compared block of a: keep what it matched and
+  // go on after the last match, everything before which is below b[j].
+  if (matched != 0) {
+    emit(matched);
+    i += std::bit_width(matched);
+  }
+  return mergeIntersect<int32_t>(a, b, out, i, j, count);
+}
+#endif
+
+template <typename T>
+size_t intersect(std::span<const T> a, std::span<const T> b, T* out) {
+  if (a.size() * kGallopRatio < b.size()) {
+    return gallopIntersect(a, b, out);
+  }
+  if (b.size() * kGallopRatio < a.size()) {
+    return gallopIntersect(b, a, out);
+  }
+  return mergeIntersect(a, b, out);
+}
+
+}  // namespace
+
+int64_t IntSet::get(size_t index) const {
+  return readAt(buf_ + kHeaderSize, width(), index);
+}
+
+bool IntSet::search(int64_t value, size_t& index) const {
+  size_t length = size();
+  // Appends in order are common, so try past the end first.
+  if (length == 0 || value > get(length - 1)) {
+    index = length;
+    return false;
+  }
+  size_t lo = 0;
+  size_t hi = length;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (get(mid) < value) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  index = lo;
+  return get(lo) == value;
+}
+
+bool IntSet::contains(int64_t value) const {
+  size_t index;
+  return widthOf(value) <= width() && search(value, index);
+}
+
+void IntSet::set(size_t index, int64_t value) {
+  char* values = buf_ + kHeaderSize;
+  switch (width()) {
+    case sizeof(int16_t):
+      reinterpret_cast<int16_t*>(values)[index] =
+          static_cast<int16_t>(value);
+      break;
+    case sizeof(int32_t):
+      reinterpret_cast<int32_t*>(values)[index] =
+          static_cast<int32_t>(value);
+      break;
+    default:
+      reinterpret_cast<int64_t*>(values)[index] = value;
+      break;
+  }
+}
+
+void IntSet::resize(size_t length, size_t width) {
+  if (length == 0) {
+    std::free(std::exchange(buf_, nullptr));
+    return;
+  }
+  char* grown =
+      static_cast<char*>(std::realloc(buf_, kHeaderSize + length * width));
+  if (grown == nullptr) {
+    throw std::bad_alloc();
+  }
+  buf_ = grown;
+  header().encoding = static_cast<uint32_t>(width);
+  header().length = static_cast<uint32_t>(length);
+}
+
+bool IntSet::insert(int64_t value) {
+  if (widthOf(value) > width()) {
+    upgradeAndInsert(value);
+    return true;
+  }
+  size_t index;
+  if (search(value, index)) {
+    return false;
+  }
+  size_t length = size();
+  size_t w = width();
+  resize(length + 1, w);
+  char* values = buf_ + kHeaderSize;
+  std::memmove(values + (index + 1) * w, values + index * w,
+               (length - index) * w);
+  set(index, value);
+  return true;
+}
+
+// A value too wide for the array is below or above everything in it, so it
+// goes at one end while the rest are widened, from the back so that none
+// is overwritten before it is read.
+void IntSet::upgradeAndInsert(int64_t value) {
+  size_t length = size();
+  size_t oldWidth = width();
+  size_t prepend = value < 0 ? 1 : 0;
+  resize(length + 1, widthOf(value));
+  for (size_t i = length; i-- > 0;) {
+    set(i + prepend, readAt(buf_ + kHeaderSize, oldWidth, i));
+  }
+  set(prepend ? 0 : length, value);
+}
+
+bool IntSet::erase(int64_t value) {
+  size_t index;
+  if (widthOf(value) > width() || !search(value, index)) {
+    return false;
+  }
+  size_t length = size();
+  size_t w = width();
+  char* values = buf_ + kHeaderSize;
+  std::memmove(values + index * w, values + (index + 1) * w,
+               (length - index - 1) * w);
+  resize(length - 1, w);
+  return true;
+}
+
+bool IntSet::assign(std::string_view blob) {
+  std::free(std::exchange(buf_, nullptr));
+  Header blobHeader;
+  if (blob.size() < kHeaderSize) {
+    return false;
+  }
+  std::memcpy(&blobHeader, blob.data(), kHeaderSize);
+  size_t w = blobHeader.encoding;
+  if ((w != sizeof(int16_t) && w != sizeof(int32_t) &&
+       w != sizeof(int64_t)) ||
+      blob.size() != kHeaderSize + size_t{blobHeader.length} * w) {
+    return false;
+  }
+  if (blobHeader.length == 0) {
+    return true;
+  }
+
+  buf_ = static_cast<char*>(std::malloc(blob.size()));
+  if (buf_ == nullptr) {
+    throw std::bad_alloc();
+  }
+  std::memcpy(buf_, blob.data(), blob.size());
+  for (size_t i = 1; i < size(); i++) {
+    if (get(i - 1) >= get(i)) {
+      std::free(std::exchange(buf_, nullptr));
+      return false;
+    }
+  }
+  return true;
+}
+
+size_t intersectSorted(std::span<const int32_t> a, std::span<const int32_t> b,
+                       int32_t* out) {
+  return intersect(a, b, out);
+}
+
+size_t intersectSorted(std::span<const int64_t> a, std::span<const int64_t> b,
+                       int64_t* out) {
+  return intersect(a, b, out);
+}
+
+}  // namespace redis
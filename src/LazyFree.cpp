@@ -0,0 +1,54 @@
+#include "redis/LazyFree.h"
+
+namespace redis {
+
+LazyFree& LazyFree::instance() {
+  static LazyFree lazyFree;
+  return lazyFree;
+}
+
+LazyFree::LazyFree()
+    : stopping_(false), pending_(0), freed_(0), thread_([this] {
+        threadMain();
+      }) {}
+
+LazyFree::~LazyFree() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  ready_.notify_one();
+  thread_.join();
+}
+
+void LazyFree::submit(std::move_only_function<void()> run, size_t objects) {
+  pending_.fetch_add(objects, std::memory_order_relaxed);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    jobs_.push_back(Job{std::move(run), objects});
+  }
+  ready_.notify_one();
+}
+
+void LazyFree::threadMain() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    ready_.wait(lock, [this] { return stopping_ || !jobs_.empty(); });
+    // Whatever is still queued at shutdown is freed before exiting.
+    if (jobs_.empty()) {
+      return;
+    }
+
+    Job job = std::move(jobs_.front());
+    jobs_.pop_front();
+    lock.unlock();
+
+    job.run();
+    pending_.fetch_sub(job.objects, std::memory_order_relaxed);
+    freed_.fetch_add(job.objects, std::memory_order_relaxed);
+
+    lock.lock();
+  }
+}
+
+}  // namespace redis
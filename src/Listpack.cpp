@@ -0,0 +1,176 @@
+#include "redis/Listpack.h"
+
+#include <cstring>
+#include <new>
+
+namespace redis {
+
+namespace {
+
+size_t varintSize(size_t n) {
+  size_t size = 1;
+  while (n >= 0x80) {
+    n >>= 7;
+    size++;
+  }
+  return size;
+}
+
+// Little-endian base 128: seven bits per byte, high bit set while more
+// bytes follow.
+char* writeLength(char* p, size_t n) {
+  while (n >= 0x80) {
+    *p++ = static_cast<char>((n & 0x7F) | 0x80);
+    n >>= 7;
+  }
+  *p++ = static_cast<char>(n);
+  return p;
+}
+
+size_t readLength(const char* p, size_t& n) {
+  n = 0;
+  size_t used = 0;
+  unsigned shift = 0;
+  while (true) {
+    auto byte = static_cast<uint8_t>(p[used++]);
+    n |= static_cast<size_t>(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) return used;
+    shift += 7;
+  }
+}
+
+// The mirror image, read from the end: the last byte holds the lowest
+// seven bits and its high bit says more bytes precede it.
+void writeBackLength(char* p, size_t n) {
+  for (size_t i = varintSize(n); i-- > 0;) {
+    p[i] = static_cast<char>((n & 0x7F) | (i > 0 ? 0x80 : 0));
+    n >>= 7;
+  }
+}
+
+size_t readBackLength(const char* end, size_t& n) {
+  n = 0;
+  size_t used = 0;
+  unsigned shift = 0;
+  while (true) {
+    auto byte = static_cast<uint8_t>(*(end - ++used));
+    n |= static_cast<size_t>(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) return used;
+    shift += 7;
+  }
+}
+
+void encodeElement(char* p, std::string_view value) {
+  char* data = writeLength(p, value.size());
+  std::memcpy(data, value.data(), value.size());
+  writeBackLength(data + value.size(), data - p + value.size());
+}
+
+}  // namespace
+
+size_t Listpack::encodedSize(size_t length) {
+  size_t body = varintSize(length) + length;
+  return body + varintSize(body);
+}
+
+size_t Listpack::next(size_t pos) const {
+  size_t length;
+  size_t header = readLength(buf_ + pos, length);
+  return pos + header + length + varintSize(header + length);
+}
+
+size_t Listpack::prev(size_t pos) const {
+  size_t body;
+  size_t back = readBackLength(buf_ + pos, body);
+  return pos - back - body;
+}
+
+std::string_view Listpack::get(size_t pos) const {
+  size_t length;
+  size_t header = readLength(buf_ + pos, length);
+  return std::string_view(buf_ + pos + header, length);
+}
+
+size_t Listpack::find(size_t pos, std::string_view value,
+                      size_t skip) const {
+  size_t last = end();
+  while (pos < last) {
+    size_t length;
+    size_t header = readLength(buf_ + pos, length);
+    if (length == value.size() &&
+        std::memcmp(buf_ + pos + header, value.data(), length) == 0) {
+      return pos;
+    }
+    pos += header + length + varintSize(header + length);
+    for (size_t i = 0; i < skip && pos < last; i++) {
+      pos = next(pos);
+    }
+  }
+  return last;
+}
+
+void Listpack::resize(size_t pos, size_t oldSize, size_t newSize) {
+  size_t total = end();
+  size_t resized = total - oldSize + newSize;
+  if (resized == kHeaderSize) {
+    std::free(std::exchange(buf_, nullptr));
+    return;
+  }
+
+  size_t tail = total - pos - oldSize;
+  if (newSize < oldSize) {
+    std::memmove(buf_ + pos + newSize, buf_ + pos + oldSize, tail);
+  }
+  bool fresh = buf_ == nullptr;
+  char* grown = static_cast<char*>(std::realloc(buf_, resized));
+  if (grown == nullptr) {
+    throw std::bad_alloc();
+  }
+  buf_ = grown;
+  if (fresh) {
+    header().count = 0;
+  }
+  if (newSize > oldSize) {
+    std::memmove(buf_ + pos + newSize, buf_ + pos + oldSize, tail);
+  }
+  header().bytes = static_cast<uint32_t>(resized);
+}
+
+void Listpack::insert(size_t pos, std::string_view value) {
+  resize(pos, 0, encodedSize(value.size()));
+  encodeElement(buf_ + pos, value);
+  header().count++;
+}
+
+void Listpack::pushBack(std::span<const std::string_view> values) {
+  if (values.empty()) {
+    return;
+  }
+  size_t size = 0;
+  for (std::string_view value : values) {
+    size += encodedSize(value.size());
+  }
+  size_t pos = end();
+  resize(pos, 0, size);
+  for (std::string_view value : values) {
+    encodeElement(buf_ + pos, value);
+    pos += encodedSize(value.size());
+  }
+  header().count += static_cast<uint32_t>(values.size());
+}
+
+void Listpack::replace(size_t pos, std::string_view value) {
+  resize(pos, next(pos) - pos, encodedSize(value.size()));
+  encodeElement(buf_ + pos, value);
+}
+
+void Listpack::erase(size_t pos, size_t count) {
+  size_t last = pos;
+  for (size_t i = 0; i < count; i++) {
+    last = next(last);
+  }
+  header().count -= static_cast<uint32_t>(count);
+  resize(pos, last - pos, 0);
+}
+
+}  // namespace redis
@@ -0,0 +1,151 @@
+#include "redis/Quicklist.h"
+
+namespace redis {
+
+Quicklist::~Quicklist() {
+  while (head_ != nullptr) {
+    delete std::exchange(head_, head_->next);
+  }
+}
+
+size_t Quicklist::memoryUsage() const {
+  return sizeof(Quicklist) + nodes_ * sizeof(Node) + bytes_;
+}
+
+Quicklist::Node* Quicklist::insertNode(Node* after) {
+  Node* node = new Node;
+  node->prev = after;
+  node->next = after ? after->next : head_;
+  (node->next ? node->next->prev : tail_) = node;
+  (after ? after->next : head_) = node;
+  nodes_++;
+  return node;
+}
+
+void Quicklist::unlinkNode(Node* node) {
+  (node->prev ? node->prev->next : head_) = node->next;
+  (node->next ? node->next->prev : tail_) = node->prev;
+  nodes_--;
+  delete node;
+}
+
+Quicklist::Node* Quicklist::nodeWithRoom(Node* end, size_t encodedSize,
+                                         bool front) {
+  if (end != nullptr &&
+      end->entries.bytes() + encodedSize <= kMaxNodeBytes) {
+    return end;
+  }
+  return insertNode(front ? nullptr : tail_);
+}
+
+void Quicklist::pushFront(std::string_view value) {
+  Node* node =
+      nodeWithRoom(head_, Listpack::encodedSize(value.size()), true);
+  // Shifting a node's bytes is a memmove within a few pages, which is what
+  // keeps the node size bounded.
+  size_t before = node->entries.bytes();
+  node->entries.pushFront(value);
+  count_++;
+  bytes_ += node->entries.bytes() - before;
+}
+
+void Quicklist::pushBack(std::string_view value) {
+  Node* node =
+      nodeWithRoom(tail_, Listpack::encodedSize(value.size()), false);
+  size_t before = node->entries.bytes();
+  node->entries.pushBack(value);
+  count_++;
+  bytes_ += node->entries.bytes() - before;
+}
+
+std::string Quicklist::popFront() {
+  Node* node = head_;
+  Listpack& entries = node->entries;
+  std::string value(entries.get(entries.begin()));
+  size_t before = entries.bytes();
+  entries.erase(entries.begin());
+
+  count_--;
+  bytes_ -= before - entries.bytes();
+  if (entries.empty()) {
+    unlinkNode(node);
+  }
+  return value;
+}
+
+std::string Quicklist::popBack() {
+  Node* node = tail_;
+  Listpack& entries = node->entries;
+  size_t last = entries.prev(entries.end());
+  std::string value(entries.get(last));
+  size_t before = entries.bytes();
+  entries.erase(last);
+
+  count_--;
+  bytes_ -= before - entries.bytes();
+  if (entries.empty()) {
+    unlinkNode(node);
+  }
+  return value;
+}
+
+std::pair<const Quicklist::Node*, size_t> Quicklist::locate(
+    size_t index) const {
+  if (index < count_ / 2) {
+    const Node* node = head_;
+    while (index >= node->entries.size()) {
+      index -= node->entries.size();
+      node = node->next;
+    }
+    return {node, index};
+  }
+  size_t fromEnd = count_ - 1 - index;
+  const Node* node = tail_;
+  while (fromEnd >= node->entries.size()) {
+    fromEnd -= node->entries.size();
+    node = node->prev;
+  }
+  return {node, node->entries.size() - 1 - fromEnd};
+}
+
+std::string_view Quicklist::at(size_t index) const {
+  auto [node, position] = locate(index);
+  const Listpack& entries = node->entries;
+  if (position < entries.size() / 2) {
+    size_t pos = entries.begin();
+    for (size_t i = 0; i < position; i++) {
+      pos = entries.next(pos);
+    }
+    return entries.get(pos);
+  }
+  size_t pos = entries.end();
+  for (size_t i = entries.size(); i > position; i--) {
+    pos = entries.prev(pos);
+  }
+  return entries.get(pos);
+}
+
+void Quicklist::forRange(
+    size_t start, size_t count,
+    const std::function<void(std::string_view)>& visit) const {
+  if (count == 0) {
+    return;
+  }
+  auto [node, position] = locate(start);
+  size_t pos = node->entries.begin();
+  for (size_t i = 0; i < position; i++) {
+    pos = node->entries.next(pos);
+  }
+
+  while (true) {
+    const Listpack& entries = node->entries;
+    for (size_t end = entries.end(); pos < end; pos = entries.next(pos)) {
+      visit(entries.get(pos));
+      if (--count == 0) return;
+    }
+    node = node->next;
+    pos = node->entries.begin();
+  }
+}
+
+}  // namespace redis
@@ -1,72 +1,325 @@
 #include "redis/RDBParser.h"
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <charconv>
 #include <chrono>
+#include <cmath>
 #include <cstdint>
+#include <cstring>
 #include <filesystem>
-#include <fstream>
 #include <iostream>
-
+#include <limits>
+#include <optional>
+
+#include "redis/Hash.h"
+#include "redis/IntSet.h"
+#include "redis/Quicklist.h"
+#include "redis/Set.h"
+#include "redis/SortedSet.h"
 #include "redis/Storage.h"
+#include "redis/StringUtil.h"
 
 namespace redis {
 
+namespace {
+
+// Value types, as numbered in Redis's rdb.h.
+constexpr uint8_t kTypeString = 0;
+constexpr uint8_t kTypeList = 1;
+constexpr uint8_t kTypeSet = 2;
+constexpr uint8_t kTypeZset = 3;
+constexpr uint8_t kTypeHash = 4;
+constexpr uint8_t kTypeZset2 = 5;
+constexpr uint8_t kTypeSetIntset = 11;
+constexpr uint8_t kTypeZsetZiplist = 12;
+constexpr uint8_t kTypeHashZiplist = 13;
+constexpr uint8_t kTypeHashListpack = 16;
+constexpr uint8_t kTypeZsetListpack = 17;
+constexpr uint8_t kTypeListQuicklist2 = 18;
+constexpr uint8_t kTypeSetListpack = 20;
+
+// Quicklist node containers: one element, or a listpack of several.
+constexpr uint64_t kContainerPlain = 1;
+
+// The most an LZF byte can produce: a back reference of 3 bytes copies at
+// most 264.
+constexpr size_t kLzfMaxExpansion = 88;
+
+// LZF, as written for strings when rdbcompression is on: literal runs and
+// back references into the output. Returns nothing if the data is corrupt.
+std::optional<std::string> lzfDecompress(std::string_view in,
+                                         size_t length) {
+  // A length the input cannot produce is not trusted with an allocation.
+  if (length > in.size() * kLzfMaxExpansion) return std::nullopt;
+  std::string out;
+  out.reserve(length);
+  size_t i = 0;
+  while (i < in.size()) {
+    unsigned ctrl = static_cast<uint8_t>(in[i++]);
+    if (ctrl < 32) {
+      size_t run = ctrl + 1;
+      if (run > in.size() - i) return std::nullopt;
+      out.append(in.substr(i, run));
+      i += run;
+      continue;
+    }
+    size_t run = ctrl >> 5;
+    if (run == 7) {
+      if (i >= in.size()) return std::nullopt;
+      run += static_cast<uint8_t>(in[i++]);
+    }
+    if (i >= in.size()) return std::nullopt;
+    size_t offset = ((ctrl & 0x1F) << 8) + static_cast<uint8_t>(in[i++]) + 1;
+    if (offset > out.size()) return std::nullopt;
+    // Byte by byte: the reference may overlap what it produces.
+    size_t from = out.size() - offset;
+    for (size_t k = 0; k < run + 2; k++) {
+      out.push_back(out[from + k]);
+    }
+  }
+  if (out.size() != length) return std::nullopt;
+  return out;
+}
+
+// Size of a listpack entry's back length field.
+size_t listpackBacklenSize(size_t entryLength) {
+  if (entryLength <= 127) return 1;
+  if (entryLength < 16383) return 2;
+  if (entryLength < 2097151) return 3;
+  if (entryLength < 268435455) return 4;
+  return 5;
+}
+
+// Calls visit with each element of a listpack, Redis's packed node format;
+// integer entries are passed formatted as decimal strings.
+bool decodeListpack(std::string_view blob,
+                    const std::function<void(std::string_view)>& visit) {
+  // Total bytes (32 bits) and element count (16 bits), then the entries.
+  constexpr size_t kHeaderSize = 6;
+  auto byte = [&blob](size_t i) { return static_cast<uint8_t>(blob[i]); };
+  // Little-endian two's complement integer of width bytes at pos.
+  auto readInt = [&](size_t pos, size_t width) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < width; i++) {
+      value |= static_cast<uint64_t>(byte(pos + i)) << (8 * i);
+    }
+    unsigned shift = 64 - 8 * width;
+    return static_cast<int64_t>(value << shift) >> shift;
+  };
+
+  size_t pos = kHeaderSize;
+  while (pos < blob.size()) {
+    uint8_t first = byte(pos);
+    if (first == 0xFF) {
+      return true;
+    }
+
+    size_t available = blob.size() - pos;
+    size_t entryLength = 0;
+    size_t strOffset = 0;
+    size_t strLength = 0;
+    std::optional<int64_t> number;
+    if ((first & 0x80) == 0) {  // 7-bit unsigned
+      number = first;
+      entryLength = 1;
+    } else if ((first & 0xC0) == 0x80) {  // string up to 63 bytes
+      strOffset = 1;
+      strLength = first & 0x3F;
+    } else if ((first & 0xE0) == 0xC0) {  // 13-bit signed
+      if (available < 2) return false;
+      int value = ((first & 0x1F) << 8) | byte(pos + 1);
+      number = value >= (1 << 12) ? value - (1 << 13) : value;
+      entryLength = 2;
+    } else if ((first & 0xF0) == 0xE0) {  // string up to 4095 bytes
+      if (available < 2) return false;
+      strOffset = 2;
+      strLength = ((first & 0x0F) << 8) | byte(pos + 1);
+    } else if (first == 0xF0) {  // string with a 32-bit length
+      if (available < 5) return false;
+      strOffset = 5;
+      strLength = static_cast<uint32_t>(readInt(pos + 1, 4));
+    } else if (first >= 0xF1 && first <= 0xF4) {  // 16/24/32/64-bit
+      static constexpr size_t kWidths[] = {2, 3, 4, 8};
+      size_t width = kWidths[first - 0xF1];
+      if (available < 1 + width) return false;
+      number = readInt(pos + 1, width);
+      entryLength = 1 + width;
+    } else {
+      return false;
+    }
+    if (!number) {
+      entryLength = strOffset + strLength;
+    }
+    if (entryLength > available) return false;
+
+    if (number) {
+      char text[24];
+      auto end = std::to_chars(text, text + sizeof(text), *number).ptr;
+      visit(std::string_view(text, end - text));
+    } else {
+      visit(blob.substr(pos + strOffset, strLength));
+    }
+    pos += entryLength + listpackBacklenSize(entryLength);
+  }
+  return false;  // no terminator
+}
+
+// The same for a ziplist, the packed format listpacks replaced; RDB files
+// from before Redis 7 still store small hashes this way.
+bool decodeZiplist(std::string_view blob,
+                   const std::function<void(std::string_view)>& visit) {
+  // Total bytes, tail offset (32 bits each) and entry count (16 bits).
+  constexpr size_t kHeaderSize = 10;
+  auto byte = [&blob](size_t i) { return static_cast<uint8_t>(blob[i]); };
+  auto readInt = [&](size_t pos, size_t width) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < width; i++) {
+      value |= static_cast<uint64_t>(byte(pos + i)) << (8 * i);
+    }
+    unsigned shift = 64 - 8 * width;
+    return static_cast<int64_t>(value << shift) >> shift;
+  };
+
+  size_t pos = kHeaderSize;
+  while (pos < blob.size()) {
+    if (byte(pos) == 0xFF) {
+      return true;
+    }
+    // The previous entry's length: one byte, or 0xFE and 32 bits.
+    pos += byte(pos) == 0xFE ? 5 : 1;
+    if (pos >= blob.size()) return false;
+
+    uint8_t first = byte(pos);
+    size_t available = blob.size() - pos;
+    size_t headerLength = 1;
+    size_t strLength = 0;
+    std::optional<int64_t> number;
+    switch (first >> 6) {
+      case 0:  // string up to 63 bytes
+        strLength = first & 0x3F;
+        break;
+      case 1:  // string up to 16383 bytes, big-endian length
+        if (available < 2) return false;
+        headerLength = 2;
+        strLength = ((first & 0x3F) << 8) | byte(pos + 1);
+        break;
+      case 2:  // string with a big-endian 32-bit length
+        if (available < 5) return false;
+        headerLength = 5;
+        strLength = (static_cast<size_t>(byte(pos + 1)) << 24) |
+                    (byte(pos + 2) << 16) | (byte(pos + 3) << 8) |
+                    byte(pos + 4);
+        break;
+      default: {
+        size_t width = 0;
+        if (first == 0xC0) {
+          width = 2;
+        } else if (first == 0xD0) {
+          width = 4;
+        } else if (first == 0xE0) {
+          width = 8;
+        } else if (first == 0xF0) {
+          width = 3;
+        } else if (first == 0xFE) {
+          width = 1;
+        } else if (first >= 0xF1 && first <= 0xFD) {
+          number = (first & 0x0F) - 1;  // 0 to 12 in the encoding itself
+        } else {
+          return false;
+        }
+        if (width != 0) {
+          if (available < 1 + width) return false;
+          number = readInt(pos + 1, width);
+          headerLength += width;
+        }
+      }
+    }
+    if (headerLength + strLength > available) return false;
+
+    if (number) {
+      char text[24];
+      auto end = std::to_chars(text, text + sizeof(text), *number).ptr;
+      visit(std::string_view(text, end - text));
+    } else {
+      visit(blob.substr(pos + headerLength, strLength));
+    }
+    pos += headerLength + strLength;
+  }
+  return false;
+}
+
+}  // namespace
+
 bool RDBParser::parseFile(const std::string& filepath, Storage& storage) {
   if (!std::filesystem::exists(filepath)) {
     std::cout << "RDB file not found: " << filepath << std::endl;
     return true;  // Not an error - database starts empty
   }
 
-  file_.open(filepath, std::ios::binary);
-  if (!file_.is_open()) {
+  int fd = open(filepath.c_str(), O_RDONLY | O_CLOEXEC);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0) {
     std::cerr << "Failed to open RDB file: " << filepath << std::endl;
+    if (fd >= 0) {
+      close(fd);
+    }
     return false;
   }
+  size_t size = static_cast<size_t>(st.st_size);
+  void* mapped = nullptr;
+  if (size > 0) {
+    mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  close(fd);  // The mapping holds its own reference to the file.
+  if (mapped == MAP_FAILED) {
+    std::cerr << "Failed to map RDB file: " << filepath << std::endl;
+    return false;
+  }
+  if (mapped != nullptr) {
+    // Read once, front to back: deep readahead, and pages behind the
+    // cursor may be dropped first.
+    madvise(mapped, size, MADV_SEQUENTIAL);
+  }
 
-  bool success = false;
+  pos_ = static_cast<const uint8_t*>(mapped);
+  end_ = pos_ + size;
+  failed_ = false;
+  bool success = readHeader() && skipMetadata() && readDatabase(storage);
 
-  if (readHeader() && skipMetadata() && readDatabase(storage)) {
-    success = true;
+  if (mapped != nullptr) {
+    munmap(mapped, size);
   }
-
-  file_.close();
+  pos_ = nullptr;
+  end_ = nullptr;
   return success;
 }
 
 bool RDBParser::readHeader() {
-  char header[9];
-  file_.read(header, 9);
-
-  if (!file_ || std::string(header, 5) != "REDIS") {
+  // "REDIS" and a four-digit version.
+  if (!need(9) || std::memcmp(pos_, "REDIS", 5) != 0) {
     std::cerr << "Invalid RDB file header" << std::endl;
     return false;
   }
-
+  pos_ += 9;
   return true;
 }
 
 bool RDBParser::skipMetadata() {
-  while (!isEOF()) {
-    uint8_t type = readByte();
-
-    if (type == 0xFA) {
-      // Metadata subsection
-      readString();  // metadata name
-      readString();  // metadata value
-    } else if (type == 0xFE) {
-      // Database subsection starts
-      file_.seekg(-1, std::ios::cur);  // Go back one byte
-      return true;
-    } else if (type == 0xFF) {
-      // End of file
-      file_.seekg(-1, std::ios::cur);
-      return true;
-    } else {
-      // Unknown type in metadata section
-      file_.seekg(-1, std::ios::cur);
-      return true;
-    }
+  // Auxiliary fields, up to the first database or the end marker; any
+  // other byte is left for readDatabase to reject.
+  while (!isEOF() && peekByte() == 0xFA) {
+    readByte();
+    readString();  // metadata name
+    readString();  // metadata value
+  }
+  if (failed_) {
+    std::cerr << "Truncated or corrupt RDB metadata" << std::endl;
+    return false;
   }
-
   return true;
 }
 
@@ -79,22 +332,19 @@ bool RDBParser::readDatabase(Storage& storage) {
       uint64_t dbIndex = readLength();
 
       // Check for hash table size info
-      uint8_t nextByte = readByte();
-      if (nextByte == 0xFB) {
+      if (!isEOF() && peekByte() == 0xFB) {
+        readByte();
         readLength();  // hash table size
         readLength();  // expire hash table size
-      } else {
-        file_.seekg(-1, std::ios::cur);
       }
 
       // Read key-value pairs
       while (!isEOF()) {
-        uint8_t marker = readByte();
-
+        uint8_t marker = peekByte();
         if (marker == 0xFE || marker == 0xFF) {
-          file_.seekg(-1, std::ios::cur);
           break;
         }
+        readByte();
 
         // Check for expiry
         bool hasExpiry = false;
@@ -102,7 +352,7 @@ bool RDBParser::readDatabase(Storage& storage) {
 
         if (marker == 0xFD) {
           // Expire in seconds
-          expiryTime = readUInt32LE() * 1000;  // Convert to milliseconds
+          expiryTime = uint64_t{readUInt32LE()} * 1000;  // To milliseconds
           hasExpiry = true;
           marker = readByte();  // Read value type
         } else if (marker == 0xFC) {
@@ -112,15 +362,32 @@ bool RDBParser::readDatabase(Storage& storage) {
           marker = readByte();  // Read value type
         }
 
-        // For now, we only support string values (type 0)
-        if (marker != 0x00) {
+        if (marker != kTypeString && marker != kTypeList &&
+            marker != kTypeListQuicklist2 && marker != kTypeHash &&
+            marker != kTypeHashZiplist && marker != kTypeHashListpack &&
+            marker != kTypeZset && marker != kTypeZset2 &&
+            marker != kTypeZsetZiplist && marker != kTypeZsetListpack &&
+            marker != kTypeSet && marker != kTypeSetIntset &&
+            marker != kTypeSetListpack) {
           std::cerr << "Unsupported value type: " << (int)marker << std::endl;
           return false;
         }
 
         std::string key = readString();
-        std::string value = readString();
+        if (failed_) {
+          std::cerr << "Truncated or corrupt RDB file" << std::endl;
+          return false;
+        }
 
+        // Keys owned by another shard or already expired are read past.
+        bool keep = !keyFilter_ || keyFilter_(key);
+        if (key.size() > Entry::kMaxKeyLength) {
+          std::cerr << "Skipping key of " << key.size()
+                    << " bytes, longer than the longest supported"
+                    << std::endl;
+          keep = false;
+        }
+        std::optional<int64_t> durationMs;
         if (hasExpiry) {
           // Convert Unix timestamp to duration from now
           auto now = std::chrono::system_clock::now();
@@ -128,18 +395,106 @@ bool RDBParser::readDatabase(Storage& storage) {
                            now.time_since_epoch())
                            .count();
 
+          // Stored as a signed 64-bit millisecond timestamp.
+          if (expiryTime >
+              static_cast<uint64_t>(std::numeric_limits<int64_t>::max())) {
+            std::cerr << "Invalid expire time for key: " << key << std::endl;
+            return false;
+          }
           if (expiryTime > static_cast<uint64_t>(nowMs)) {
-            int64_t durationMs = expiryTime - nowMs;
-            storage.setWithExpiry(key, value, durationMs);
+            durationMs = expiryTime - nowMs;
+          } else {
+            keep = false;
           }
-          // If expired, don't add to storage
-        } else {
-          storage.set(key, value);
+        }
+
+        if (marker == kTypeString) {
+          std::string value = readString();
+          if (failed_) {
+            std::cerr << "Corrupt string value for key: " << key << std::endl;
+            return false;
+          }
+          if (keep && durationMs) {
+            storage.setWithExpiry(key, value, *durationMs);
+          } else if (keep) {
+            storage.set(key, value);
+          }
+          continue;
+        }
+
+        if (marker == kTypeHash || marker == kTypeHashZiplist ||
+            marker == kTypeHashListpack) {
+          // Fields go straight into the hash's own encoding, a listpack
+          // until the limits are passed.
+          std::optional<Hash> hash;
+          if (keep) {
+            hash = storage.createHash(key, durationMs);
+          }
+          if (!readHash(marker, [&hash](std::string_view field,
+                                        std::string_view value) {
+                if (hash) hash->set(field, value);
+              })) {
+            std::cerr << "Corrupt hash value for key: " << key << std::endl;
+            return false;
+          }
+          if (hash && hash->size() == 0) {
+            storage.remove(key);
+          }
+          continue;
+        }
+
+        if (marker == kTypeZset || marker == kTypeZset2 ||
+            marker == kTypeZsetZiplist || marker == kTypeZsetListpack) {
+          std::optional<SortedSet> set;
+          if (keep) {
+            set = storage.createSortedSet(key, durationMs);
+          }
+          if (!readSortedSet(marker, [&set](std::string_view member,
+                                            double score) {
+                if (set) set->set(member, score);
+              })) {
+            std::cerr << "Corrupt sorted set value for key: " << key
+                      << std::endl;
+            return false;
+          }
+          if (set && set->size() == 0) {
+            storage.remove(key);
+          }
+          continue;
+        }
+
+        if (marker == kTypeSet || marker == kTypeSetIntset ||
+            marker == kTypeSetListpack) {
+          std::optional<Set> set;
+          if (keep) {
+            set = storage.createSet(key, durationMs);
+          }
+          if (!readSet(marker, set ? &*set : nullptr)) {
+            std::cerr << "Corrupt set value for key: " << key << std::endl;
+            return false;
+          }
+          if (set && set->size() == 0) {
+            storage.remove(key);
+          }
+          continue;
+        }
+
+        Quicklist skipped;
+        Quicklist& list = keep ? storage.createList(key, durationMs) : skipped;
+        if (!readList(marker, list)) {
+          std::cerr << "Corrupt list value for key: " << key << std::endl;
+          return false;
+        }
+        if (keep && list.empty()) {
+          storage.remove(key);
         }
       }
     } else if (type == 0xFF) {
-      // End of file marker
-      skipBytes(8);  // Skip checksum
+      // End of file marker, then a checksum that is not verified
+      if (!skipBytes(8)) {
+        std::cerr << "Truncated RDB checksum" << std::endl;
+        return false;
+      }
       return true;
     } else {
       std::cerr << "Unexpected byte in database section: " << (int)type
@@ -148,25 +503,196 @@ bool RDBParser::readDatabase(Storage& storage) {
     }
   }
 
-  return true;
+  std::cerr << "RDB file ends without its EOF marker" << std::endl;
+  return false;
 }
 
-uint8_t RDBParser::readByte() {
-  uint8_t byte;
-  file_.read(reinterpret_cast<char*>(&byte), 1);
-  return byte;
+bool RDBParser::readList(uint8_t type, Quicklist& list) {
+  uint64_t length = readLength();
+  if (type == kTypeList) {
+    for (uint64_t i = 0; i < length && !failed_; i++) {
+      list.pushBack(readString());
+    }
+    return !failed_;
+  }
+
+  // Quicklist: length counts nodes, each a container type and a blob.
+  for (uint64_t i = 0; i < length && !failed_; i++) {
+    uint64_t container = readLength();
+    std::string node = readString();
+    if (container == kContainerPlain) {
+      list.pushBack(node);
+    } else if (!decodeListpack(node, [&list](std::string_view value) {
+                 list.pushBack(value);
+               })) {
+      return false;
+    }
+  }
+  return !failed_;
 }
 
+bool RDBParser::readHash(
+    uint8_t type,
+    const std::function<void(std::string_view, std::string_view)>& visit) {
+  if (type == kTypeHash) {
+    uint64_t length = readLength();
+    for (uint64_t i = 0; i < length && !failed_; i++) {
+      std::string field = readString();
+      std::string value = readString();
+      visit(field, value);
+    }
+    return !failed_;
+  }
+
+  // A ziplist or listpack of alternating fields and values.
+  std::string blob = readString();
+  if (failed_) {
+    return false;
+  }
+  std::string field;
+  bool isField = true;
+  auto pair = [&](std::string_view element) {
+    if (isField) {
+      field = element;
+    } else {
+      visit(field, element);
+    }
+    isField = !isField;
+  };
+  bool decoded = type == kTypeHashListpack ? decodeListpack(blob, pair)
+                                           : decodeZiplist(blob, pair);
+  return decoded && isField;
+}
+
+bool RDBParser::readSortedSet(
+    uint8_t type, const std::function<void(std::string_view, double)>& visit) {
+  if (type == kTypeZset || type == kTypeZset2) {
+    uint64_t length = readLength();
+    for (uint64_t i = 0; i < length && !failed_; i++) {
+      std::string member = readString();
+      double score = 0;
+      if (type == kTypeZset2) {
+        // A little-endian binary double.
+        uint64_t bits = readUInt64LE();
+        std::memcpy(&score, &bits, sizeof(score));
+      } else if (!readTextScore(score)) {
+        return false;
+      }
+      if (std::isnan(score)) {
+        return false;
+      }
+      visit(member, score);
+    }
+    return !failed_;
+  }
+
+  // A ziplist or listpack of alternating members and scores.
+  std::string blob = readString();
+  if (failed_) {
+    return false;
+  }
+  std::string member;
+  bool isMember = true;
+  bool valid = true;
+  auto pair = [&](std::string_view element) {
+    if (isMember) {
+      member = element;
+    } else {
+      double score = 0;
+      valid = valid && parseDouble(element, score);
+      if (valid) visit(member, score);
+    }
+    isMember = !isMember;
+  };
+  bool decoded = type == kTypeZsetListpack ? decodeListpack(blob, pair)
+                                           : decodeZiplist(blob, pair);
+  return decoded && valid && isMember;
+}
+
+bool RDBParser::readSet(uint8_t type, Set* set) {
+  if (type == kTypeSet) {
+    uint64_t length = readLength();
+    for (uint64_t i = 0; i < length && !failed_; i++) {
+      std::string member = readString();
+      if (set) set->add(member);
+    }
+    return !failed_;
+  }
+
+  std::string blob = readString();
+  if (failed_) {
+    return false;
+  }
+  if (type == kTypeSetIntset) {
+    // Stored as we keep it, so it is checked and taken whole.
+    IntSet values;
+    if (!values.assign(blob)) {
+      return false;
+    }
+    if (set) set->assign(std::move(values));
+    return true;
+  }
+  return decodeListpack(blob, [set](std::string_view member) {
+    if (set) set->add(member);
+  });
+}
+
+// The score of an old-style zset: a length byte, with 253 to 255 standing
+// for NaN, +inf and -inf, then the number as text.
+bool RDBParser::readTextScore(double& score) {
+  uint8_t length = readByte();
+  switch (length) {
+    case 253:
+      return false;
+    case 254:
+      score = std::numeric_limits<double>::infinity();
+      return true;
+    case 255:
+      score = -std::numeric_limits<double>::infinity();
+      return true;
+  }
+  if (!need(length)) {
+    return false;
+  }
+  std::string_view text(reinterpret_cast<const char*>(pos_), length);
+  pos_ += length;
+  return parseDouble(text, score);
+}
+
+bool RDBParser::need(size_t count) {
+  if (failed_ || static_cast<size_t>(end_ - pos_) < count) {
+    failed_ = true;
+    return false;
+  }
+  return true;
+}
+
+uint8_t RDBParser::peekByte() { return need(1) ? *pos_ : 0; }
+
+uint8_t RDBParser::readByte() { return need(1) ? *pos_++ : 0; }
+
 uint32_t RDBParser::readUInt32LE() {
-  uint32_t value;
-  file_.read(reinterpret_cast<char*>(&value), 4);
-  return value;  // Assuming little-endian system
+  if (!need(4)) {
+    return 0;
+  }
+  uint32_t value = 0;
+  for (int i = 3; i >= 0; i--) {
+    value = (value << 8) | pos_[i];
+  }
+  pos_ += 4;
+  return value;
 }
 
 uint64_t RDBParser::readUInt64LE() {
-  uint64_t value;
-  file_.read(reinterpret_cast<char*>(&value), 8);
-  return value;  // Assuming little-endian system
+  if (!need(8)) {
+    return 0;
+  }
+  uint64_t value = 0;
+  for (int i = 7; i >= 0; i--) {
+    value = (value << 8) | pos_[i];
+  }
+  pos_ += 8;
+  return value;
 }
 
 uint64_t RDBParser::readLength() {
@@ -180,38 +706,42 @@ uint64_t RDBParser::readLength() {
     // Size is in the next 14 bits
     uint8_t secondByte = readByte();
     return ((firstByte & 0x3F) << 8) | secondByte;
-  } else if (type == 2) {
+  } else if (firstByte == 0x80) {
     // Size is in the next 4 bytes (big-endian)
     uint32_t size = 0;
     for (int i = 0; i < 4; i++) {
       size = (size << 8) | readByte();
     }
     return size;
-  } else {
-    // Special encoding (type == 3)
+  } else if (firstByte == 0x81) {
+    // Size is in the next 8 bytes (big-endian)
+    uint64_t size = 0;
+    for (int i = 0; i < 8; i++) {
+      size = (size << 8) | readByte();
+    }
+    return size;
+  } else if (type == 3) {
+    // Special encoding
     uint8_t format = firstByte & 0x3F;
     if (format == 0) {
       // 8-bit integer
       return readByte();
     } else if (format == 1) {
       // 16-bit integer
-      uint16_t value;
-      file_.read(reinterpret_cast<char*>(&value), 2);
-      return value;
+      uint16_t value = readByte();
+      return value | readByte() << 8;
     } else if (format == 2) {
       // 32-bit integer
-      uint32_t value;
-      file_.read(reinterpret_cast<char*>(&value), 4);
-      return value;
+      return readUInt32LE();
     }
   }
 
+  failed_ = true;
   return 0;
 }
 
 std::string RDBParser::readString() {
-  uint8_t firstByte = readByte();
-  file_.seekg(-1, std::ios::cur);  // Go back to re-read with readLength
+  uint8_t firstByte = peekByte();
 
   if ((firstByte & 0xC0) == 0xC0) {
     // Special encoding
@@ -220,33 +750,58 @@ std::string RDBParser::readString() {
 
     if (format == 0) {
       // 8-bit integer
-      uint8_t value = readByte();
-      return std::to_string(value);
+      return std::to_string(static_cast<int8_t>(readByte()));
     } else if (format == 1) {
       // 16-bit integer
-      uint16_t value;
-      file_.read(reinterpret_cast<char*>(&value), 2);
+      if (!need(2)) {
+        return std::string();
+      }
+      auto value = static_cast<int16_t>(pos_[0] | pos_[1] << 8);
+      pos_ += 2;
       return std::to_string(value);
     } else if (format == 2) {
       // 32-bit integer
-      uint32_t value;
-      file_.read(reinterpret_cast<char*>(&value), 4);
-      return std::to_string(value);
+      return std::to_string(static_cast<int32_t>(readUInt32LE()));
+    } else if (format == 3) {
+      // LZF compressed: compressed and original length, then the data.
+      uint64_t compressedLength = readLength();
+      uint64_t length = readLength();
+      if (!need(compressedLength)) {
+        return std::string();
+      }
+      std::string_view compressed(reinterpret_cast<const char*>(pos_),
+                                  compressedLength);
+      pos_ += compressedLength;
+      std::optional<std::string> value = lzfDecompress(compressed, length);
+      if (!value) {
+        std::cerr << "Corrupt LZF string in RDB file" << std::endl;
+        failed_ = true;
+        return std::string();
+      }
+      return std::move(*value);
     }
+    failed_ = true;
+    return std::string();
   }
 
-  // Regular string encoding
+  // Regular string encoding, copied straight out of the mapping
   uint64_t length = readLength();
-  std::string str(length, '\0');
-  file_.read(&str[0], length);
+  if (!need(length)) {
+    return std::string();
+  }
+  std::string str(reinterpret_cast<const char*>(pos_), length);
+  pos_ += length;
   return str;
 }
 
 bool RDBParser::skipBytes(size_t count) {
-  file_.seekg(count, std::ios::cur);
-  return file_.good();
+  if (!need(count)) {
+    return false;
+  }
+  pos_ += count;
+  return true;
 }
 
-bool RDBParser::isEOF() { return file_.eof() || file_.peek() == EOF; }
+bool RDBParser::isEOF() { return pos_ == end_; }
 
-}  // namespace redis
\ No newline at end of file
+}  // namespace redis
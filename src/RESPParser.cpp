@@ -1,48 +1,143 @@
 #include "redis/RESPParser.h"
 
-#include <sstream>
+#include <charconv>
+#include <cstring>
+
+#include "redis/ReplyBuffer.h"
 
 namespace redis {
 
-std::vector<std::string> RESPParser::parseArray(const std::string& data) {
-  std::vector<std::string> result;
-  std::istringstream iss(data);
-  std::string line;
+namespace {
 
-  if (!std::getline(iss, line) || line.empty() || line[0] != '*') {
-    return result;
-  }
+constexpr long long kMaxMultibulkLength = 1024 * 1024;
+constexpr long long kMaxBulkLength = 512LL * 1024 * 1024;
+constexpr size_t kMaxHeaderLine = 64 * 1024;
 
-  if (!line.empty() && line.back() == '\r') {
-    line.pop_back();
-  }
+void appendLength(std::string& out, char prefix, size_t length) {
+  char header[24];
+  header[0] = prefix;
+  char* end =
+      std::to_chars(header + 1, header + sizeof(header) - 2, length).ptr;
+  *end++ = '\r';
+  *end++ = '\n';
+  out.append(header, end - header);
+}
 
-  int numElements = std::stoi(line.substr(1));
+void appendBulkString(std::string& out, std::string_view str) {
+  appendLength(out, '$', str.size());
+  out.append(str);
+  out.append("\r\n");
+}
 
-  for (int i = 0; i < numElements; i++) {
-    if (!std::getline(iss, line)) break;
-    if (line.empty() || line[0] != '$') break;
+}  // namespace
 
-    if (!line.empty() && line.back() == '\r') {
-      line.pop_back();
-    }
+RESPParser::ParseResult RESPParser::RequestParser::readLength(
+    std::string_view data, char prefix, long long& value) {
+  if (pos_ >= data.size()) return ParseResult::Incomplete;
+  if (data[pos_] != prefix) return ParseResult::Error;
 
-    int length = std::stoi(line.substr(1));
+  const char* begin = data.data() + pos_ + 1;
+  const char* end = static_cast<const char*>(
+      std::memchr(begin, '\r', data.size() - pos_ - 1));
+  if (end == nullptr) {
+    return data.size() - pos_ > kMaxHeaderLine ? ParseResult::Error
+                                               : ParseResult::Incomplete;
+  }
+  if (end + 1 == data.data() + data.size()) return ParseResult::Incomplete;
+  if (end[1] != '\n') return ParseResult::Error;
 
-    if (!std::getline(iss, line)) break;
+  auto [ptr, ec] = std::from_chars(begin, end, value);
+  if (ec != std::errc() || ptr != end) return ParseResult::Error;
 
-    if (!line.empty() && line.back() == '\r') {
-      line.pop_back();
-    }
+  pos_ = end + 2 - data.data();
+  return ParseResult::Complete;
+}
 
-    if (line.length() != static_cast<size_t>(length)) {
-      line = line.substr(0, length);
+RESPParser::ParseResult RESPParser::RequestParser::parse(std::string_view data,
+                                                         size_t& consumed) {
+  args_.clear();
+
+  while (true) {
+    switch (state_) {
+      case State::ArrayHeader: {
+        long long count = 0;
+        ParseResult result = readLength(data, '*', count);
+        if (result != ParseResult::Complete) return result;
+        if (count > kMaxMultibulkLength) return ParseResult::Error;
+
+        if (count <= 0) {
+          // Empty and null arrays are valid frames with no command.
+          consumed = pos_;
+          reset();
+          return ParseResult::Complete;
+        }
+        remaining_ = count;
+        offsets_.clear();
+        offsets_.reserve(count);
+        state_ = State::BulkHeader;
+        break;
+      }
+
+      case State::BulkHeader: {
+        ParseResult result = readLength(data, '$', bulkLength_);
+        if (result != ParseResult::Complete) return result;
+        if (bulkLength_ < 0 || bulkLength_ > kMaxBulkLength) {
+          return ParseResult::Error;
+        }
+        state_ = State::BulkBody;
+        break;
+      }
+
+      case State::BulkBody: {
+        size_t length = static_cast<size_t>(bulkLength_);
+        if (data.size() - pos_ < length + 2) return ParseResult::Incomplete;
+        if (data[pos_ + length] != '\r' || data[pos_ + length + 1] != '\n') {
+          return ParseResult::Error;
+        }
+        offsets_.emplace_back(static_cast<uint32_t>(pos_),
+                              static_cast<uint32_t>(length));
+        pos_ += length + 2;
+
+        if (--remaining_ > 0) {
+          state_ = State::BulkHeader;
+          break;
+        }
+
+        args_.reserve(offsets_.size());
+        for (auto [offset, len] : offsets_) {
+          args_.emplace_back(data.data() + offset, len);
+        }
+        consumed = pos_;
+        state_ = State::ArrayHeader;
+        pos_ = 0;
+        return ParseResult::Complete;
+      }
     }
+  }
+}
 
-    result.push_back(line);
+size_t RESPParser::RequestParser::bytesNeeded() const {
+  if (state_ != State::BulkBody) return 0;
+  return pos_ + static_cast<size_t>(bulkLength_) + 2;
+}
+
+void RESPParser::RequestParser::reset() {
+  state_ = State::ArrayHeader;
+  pos_ = 0;
+  remaining_ = 0;
+  bulkLength_ = 0;
+  offsets_.clear();
+}
+
+std::vector<std::string> RESPParser::parseArray(const std::string& data) {
+  RequestParser parser;
+  size_t consumed = 0;
+  if (parser.parse(data, consumed) != ParseResult::Complete) {
+    return {};
   }
 
-  return result;
+  auto args = parser.args();
+  return std::vector<std::string>(args.begin(), args.end());
 }
 
 std::string RESPParser::parseSimpleString(const std::string& data) {
@@ -59,25 +154,45 @@ std::string RESPParser::parseSimpleString(const std::string& data) {
 }
 
 std::string RESPParser::encodeSimpleString(const std::string& str) {
-  return "+" + str + "\r\n";
+  std::string result;
+  result.reserve(str.size() + 3);
+  result.push_back('+');
+  result.append(str);
+  result.append("\r\n");
+  return result;
 }
 
 std::string RESPParser::encodeBulkString(const std::string& str) {
-  return "$" + std::to_string(str.length()) + "\r\n" + str + "\r\n";
+  std::string result;
+  result.reserve(str.size() + 24);
+  appendBulkString(result, str);
+  return result;
 }
 
 std::string RESPParser::encodeArray(const std::vector<std::string>& items) {
-  std::string result = "*" + std::to_string(items.size()) + "\r\n";
+  size_t size = 24;
+  for (const auto& item : items) {
+    size += item.size() + 24;
+  }
+
+  std::string result;
+  result.reserve(size);
+  appendLength(result, '*', items.size());
   for (const auto& item : items) {
-    result += encodeBulkString(item);
+    appendBulkString(result, item);
   }
   return result;
 }
 
 std::string RESPParser::encodeError(const std::string& error) {
-  return "-" + error + "\r\n";
+  std::string result;
+  result.reserve(error.size() + 3);
+  result.push_back('-');
+  result.append(error);
+  result.append("\r\n");
+  return result;
 }
 
-std::string RESPParser::encodeNull() { return "$-1\r\n"; }
+std::string RESPParser::encodeNull() { return std::string(reply::kNull); }
 
 }  // namespace redis
\ No newline at end of file
@@ -1,45 +1,126 @@
 #include "redis/RedisServer.h"
 
 #include <arpa/inet.h>
+#include <fcntl.h>
 #include <netdb.h>
-#include <sys/select.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <unistd.h>
 
 #include <algorithm>
+#include <cerrno>
+#include <chrono>
 #include <cstring>
 #include <iostream>
+#include <span>
+#include <utility>
 
+#include "redis/Client.h"
 #include "redis/CommandHandler.h"
+#include "redis/CommandTable.h"
 #include "redis/Config.h"
+#include "redis/IOThreads.h"
 #include "redis/RDBParser.h"
 #include "redis/RESPParser.h"
+#include "redis/ReplyBuffer.h"
+#include "redis/ShardSet.h"
 #include "redis/Storage.h"
+#include "redis/StringUtil.h"
+#include "redis/UringLoop.h"
 
 namespace redis {
 
+namespace {
+
+// io_uring user_data: the operation in the high word, the fd in the low.
+enum UringOp : uint64_t {
+  kOpAccept = 1,
+  kOpRecv,
+  kOpSend,
+  kOpCron,
+  kOpShardEvent,
+  kOpCancel,
+};
+
+uint64_t uringData(UringOp op, int fd) {
+  return (static_cast<uint64_t>(op) << 32) | static_cast<uint32_t>(fd);
+}
+
+int64_t monotonicMs() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+}  // namespace
+
 RedisServer::RedisServer(std::shared_ptr<Config> config)
+    : RedisServer(std::move(config), nullptr, 0) {}
+
+RedisServer::RedisServer(std::shared_ptr<Config> config, ShardSet *shards,
+                         size_t shardId)
     : config_(config),
       storage_(std::make_shared<Storage>()),
       commandHandler_(std::make_shared<CommandHandler>(config, storage_)),
       serverFd_(-1),
-      masterFd_(-1) {}
+      cronTimerFd_(-1),
+      masterFd_(-1),
+      numClients_(0),
+      cronLoops_(0),
+      clientsCronCursor_(0),
+      shards_(shards),
+      shardId_(shardId),
+      nextClientId_(0),
+      nextBlockedId_(0) {
+  storage_->setLazyFreeExpire(config_->getLazyFreeLazyExpire());
+  storage_->setHashLimits({config_->getHashMaxListpackEntries(),
+                           config_->getHashMaxListpackValue()});
+  storage_->setSortedSetLimits({config_->getZsetMaxListpackEntries(),
+                                config_->getZsetMaxListpackValue()});
+  storage_->setSetLimits({config_->getSetMaxIntsetEntries()});
+  storage_->setMaxMemory(config_->getMaxMemory() /
+                         (shards_ ? shards_->size() : 1));
+  storage_->setEvictionPolicy(config_->getMaxMemoryPolicy());
+  storage_->setDefragLimits(
+      {config_->getActiveDefrag(), config_->getActiveDefragIgnoreBytes(),
+       config_->getActiveDefragCycleMin(),
+       std::max(config_->getActiveDefragCycleMax(),
+                config_->getActiveDefragCycleMin())});
+  if (shards_) {
+    outbox_.resize(shards_->size());
+    commandHandler_->setShard(shardId_, shards_->size());
+  }
+}
 
 RedisServer::~RedisServer() {
-  for (int fd : clientFds_) {
-    close(fd);
+  for (auto &client : clients_) {
+    if (client) {
+      close(client->fd);
+    }
   }
   if (serverFd_ != -1) {
     close(serverFd_);
   }
+  if (cronTimerFd_ != -1) {
+    close(cronTimerFd_);
+  }
   if (masterFd_ != -1) {
     close(masterFd_);
   }
+  for (auto &pending : outbox_) {
+    for (ShardMessage *message : pending) {
+      delete message;
+    }
+  }
+  for (auto &[id, blocked] : blocked_) {
+    delete blocked.message;
+  }
 }
 
 bool RedisServer::createServerSocket() {
-  serverFd_ = socket(AF_INET, SOCK_STREAM, 0);
+  serverFd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
   if (serverFd_ < 0) {
     std::cerr << "Failed to create server socket\n";
     return false;
@@ -51,6 +132,13 @@ bool RedisServer::createServerSocket() {
     std::cerr << "setsockopt failed\n";
     return false;
   }
+  // Every shard binds its own listener and the kernel spreads new
+  // connections across them.
+  if (shards_ && setsockopt(serverFd_, SOL_SOCKET, SO_REUSEPORT, &reuse,
+                            sizeof(reuse)) < 0) {
+    std::cerr << "setsockopt(SO_REUSEPORT) failed\n";
+    return false;
+  }
 
   struct sockaddr_in server_addr;
   server_addr.sin_family = AF_INET;
@@ -63,14 +151,16 @@ bool RedisServer::createServerSocket() {
     return false;
   }
 
-  int connection_backlog = 5;
+  int connection_backlog = 511;
   if (listen(serverFd_, connection_backlog) != 0) {
     std::cerr << "listen failed" << std::endl;
     return false;
   }
 
-  std::cout << "Server listening on port " << config_->getPort() << "..."
-            << std::endl;
+  if (shardId_ == 0) {
+    std::cout << "Server listening on port " << config_->getPort() << "..."
+              << std::endl;
+  }
   return true;
 }
 
@@ -238,88 +328,901 @@ void RedisServer::run() {
   loadRDBFile();
 
   // If we're a replica, connect to master
-  if (config_->isReplica()) {
+  if (config_->isReplica() && shardId_ == 0) {
     if (!connectToMaster()) {
       std::cerr << "Failed to connect to master, exiting\n";
       return;
     }
   }
 
-  std::cout << "Logs from your program will appear here!" << std::endl;
+  if (shardId_ == 0) {
+    std::cout << "Logs from your program will appear here!" << std::endl;
+  }
+
+  if (config_->getIOBackend() == Config::IOBackend::Uring) {
+    uring_ = std::make_unique<UringLoop>();
+    if (uring_->init(kUringEntries, kUringBufferCount, kIOBufferSize)) {
+      runUring();
+      return;
+    }
+    uring_.reset();
+    if (shardId_ == 0) {
+      std::cerr << "io_uring is not usable on this kernel, falling back to "
+                   "epoll"
+                << std::endl;
+    }
+  }
+  runEpoll();
+}
+
+void RedisServer::runEpoll() {
+  if (!loop_.init()) {
+    return;
+  }
+
+  if (!loop_.addFd(serverFd_, EventLoop::kReadable)) {
+    std::cerr << "Failed to register server socket" << std::endl;
+    return;
+  }
+
+  cronTimerFd_ = loop_.addTimer(1000 / kServerHz);
+  if (cronTimerFd_ < 0) {
+    return;
+  }
+
+  if (shards_ && !loop_.addFd(shards_->eventFd(shardId_),
+                              EventLoop::kReadable)) {
+    std::cerr << "Failed to register shard eventfd" << std::endl;
+    return;
+  }
+
+  if (config_->getIOThreads() > 1 && !shards_) {
+    ioThreads_ = std::make_unique<IOThreads>(config_->getIOThreads());
+    std::cout << "Threaded I/O enabled with " << ioThreads_->size()
+              << " threads" << std::endl;
+  }
 
   while (true) {
-    fd_set readFds;
-    FD_ZERO(&readFds);
-    FD_SET(serverFd_, &readFds);
+    // Clients whose blocking command was served carry on with their
+    // pipelines.
+    while (!unblockedClients_.empty()) {
+      processUnblockedClients();
+    }
 
-    int maxFd = serverFd_;
-    for (int clientFd : clientFds_) {
-      FD_SET(clientFd, &readFds);
-      maxFd = std::max(maxFd, clientFd);
+    // A slow expire cycle that ran out of time left stale keys behind;
+    // reclaim a few more before blocking instead of waiting for the cron.
+    if (storage_->needsFastExpireCycle()) {
+      storage_->activeExpireCycle(ExpireCycle::Fast, kFastExpireBudget);
     }
 
-    int activity = select(maxFd + 1, &readFds, nullptr, nullptr, nullptr);
-    if (activity < 0) {
-      std::cerr << "select error" << std::endl;
+    // Clients left over from a read batch still have input buffered in
+    // the kernel that epoll will not report again, and messages for a full
+    // shard queue are retried as soon as it drains.
+    bool pendingWork = !pendingReads_.empty() || flushShardOutbox();
+    int numEvents = loop_.poll(pendingWork ? 0 : -1);
+    if (numEvents < 0) {
+      std::cerr << "epoll_wait error" << std::endl;
       break;
     }
 
-    if (FD_ISSET(serverFd_, &readFds)) {
-      handleNewConnection();
-    }
+    for (int i = 0; i < numEvents; i++) {
+      const EventLoop::Event &event = loop_.ready(i);
+
+      if (event.fd == serverFd_) {
+        handleNewConnection();
+        continue;
+      }
+
+      if (shards_ && event.fd == shards_->eventFd(shardId_)) {
+        // An eventfd counter reads like a timerfd's expiration count.
+        EventLoop::drainTimer(event.fd);
+        handleShardMessages();
+        continue;
+      }
+
+      if (event.fd == cronTimerFd_) {
+        if (EventLoop::drainTimer(cronTimerFd_) > 0) {
+          serverCron();
+        }
+        continue;
+      }
 
-    auto clientFdsSnapshot = clientFds_;
-    for (int clientFd : clientFdsSnapshot) {
-      if (FD_ISSET(clientFd, &readFds)) {
-        handleClientData(clientFd);
+      // Writes first so replies queued by an earlier read go out before we
+      // process more input; a read may close the client.
+      if (event.mask & EventLoop::kWritable) {
+        handleClientWritable(event.fd);
       }
+      if (event.mask & (EventLoop::kReadable | EventLoop::kHangup)) {
+        if (ioThreads_) {
+          queueClientRead(event.fd);
+        } else {
+          handleClientData(event.fd);
+        }
+      }
+    }
+
+    if (!pendingReads_.empty()) {
+      handleClientsPendingReads();
+    }
+    if (shards_) {
+      flushShardOutbox();
     }
   }
 }
 
 void RedisServer::handleNewConnection() {
-  struct sockaddr_in client_addr;
-  socklen_t client_addr_len = sizeof(client_addr);
-  int clientFd =
-      accept(serverFd_, (struct sockaddr *)&client_addr, &client_addr_len);
+  // Edge-triggered: keep accepting until the backlog is drained.
+  while (true) {
+    struct sockaddr_in client_addr;
+    socklen_t client_addr_len = sizeof(client_addr);
+    int clientFd = accept4(serverFd_, (struct sockaddr *)&client_addr,
+                           &client_addr_len, SOCK_NONBLOCK | SOCK_CLOEXEC);
 
-  if (clientFd < 0) {
-    std::cerr << "Failed to accept client connection" << std::endl;
-    return;
+    if (clientFd < 0) {
+      if (errno == EINTR) continue;
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        std::cerr << "Failed to accept client connection" << std::endl;
+      }
+      return;
+    }
+
+    int nodelay = 1;
+    setsockopt(clientFd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
+    if (!loop_.addFd(clientFd, EventLoop::kReadable | EventLoop::kWritable)) {
+      std::cerr << "Failed to register client (fd: " << clientFd << ")"
+                << std::endl;
+      close(clientFd);
+      continue;
+    }
+
+    addClient(clientFd);
   }
+}
 
-  clientFds_.insert(clientFd);
+Client &RedisServer::addClient(int clientFd) {
+  if (static_cast<size_t>(clientFd) >= clients_.size()) {
+    clients_.resize(clientFd + 1);
+  }
+  clients_[clientFd] = std::make_unique<Client>(clientFd, ++nextClientId_);
+  numClients_++;
   std::cout << "New client connected (fd: " << clientFd << ")" << std::endl;
+  return *clients_[clientFd];
 }
 
 void RedisServer::handleClientData(int clientFd) {
-  char buffer[1024];
-  int bytesRead = recv(clientFd, buffer, sizeof(buffer), 0);
+  if (static_cast<size_t>(clientFd) >= clients_.size() ||
+      !clients_[clientFd]) {
+    return;
+  }
+  Client &client = *clients_[clientFd];
+  if (client.readPaused) {
+    return;
+  }
 
-  if (bytesRead <= 0) {
+  // Edge-triggered: drain the socket until the kernel reports EAGAIN,
+  // executing every complete command as its bytes arrive. Replies are
+  // accumulated and flushed once at the end.
+  while (true) {
+    ReadResult result = readQueryBuffer(client);
+    if (result == ReadResult::Drained) break;
+    if (result == ReadResult::Closed) {
+      closeClient(clientFd);
+      return;
+    }
+
+    if (!processInput(client)) {
+      closeClient(clientFd);
+      return;
+    }
+    if (client.readPaused) {
+      // The rest of the input stays in the kernel, which pushes back on
+      // the sender; the writable event picks it up again.
+      return;
+    }
+  }
+
+  if (!flushPendingOutput(client)) {
     closeClient(clientFd);
+  }
+}
+
+RedisServer::ReadResult RedisServer::readQueryBuffer(Client &client) {
+  while (true) {
+    size_t used = client.queryBuf.size();
+    size_t readLen = kIOBufferSize;
+    size_t needed = client.parser.bytesNeeded();
+    if (needed > used + readLen) {
+      // Read the rest of a large bulk argument in one go.
+      readLen = needed - used;
+    }
+    ssize_t bytesRead = 0;
+    client.queryBuf.resize_and_overwrite(
+        used + readLen, [&](char *buf, size_t) {
+          bytesRead = recv(client.fd, buf + used, readLen, 0);
+          return used + std::max<ssize_t>(bytesRead, 0);
+        });
+
+    if (bytesRead > 0) return ReadResult::Data;
+    if (bytesRead == 0) return ReadResult::Closed;
+    if (errno == EINTR) continue;
+    if (errno == EAGAIN || errno == EWOULDBLOCK) return ReadResult::Drained;
+    return ReadResult::Closed;
+  }
+}
+
+bool RedisServer::processQueryBuffer(Client &client) {
+  std::string_view data(client.queryBuf);
+  size_t offset = 0;
+
+  // A command forwarded to another shard or a blocked one holds back the
+  // rest of the pipeline until its reply is in, and a client that is not
+  // taking its replies gets no new ones.
+  while (offset < data.size() && client.awaitingShards == 0 &&
+         client.blockedId == 0 &&
+         client.outputBytes() < kReadPauseOutputBytes) {
+    size_t consumed = 0;
+    auto result = client.parser.parse(data.substr(offset), consumed);
+
+    if (result == RESPParser::ParseResult::Incomplete) {
+      break;
+    }
+    if (result == RESPParser::ParseResult::Error) {
+      client.reply.appendRaw(reply::kProtocolError);
+      return false;
+    }
+
+    auto args = client.parser.args();
+    if (!args.empty()) {
+      dispatchCommand(client, args);
+    }
+    offset += consumed;
+  }
+
+  return consumeQueryBuffer(client, offset);
+}
+
+// Runs the buffered commands. Parsing stops while the client is behind on
+// its output; if flushing cannot catch it up, its reads are paused until
+// the socket drains.
+bool RedisServer::processInput(Client &client) {
+  while (true) {
+    if (!processQueryBuffer(client)) {
+      flushPendingOutput(client);
+      return false;
+    }
+    if (client.outputBytes() < kReadPauseOutputBytes) {
+      return true;
+    }
+    // Parsing stopped early; carry on only if the socket takes the output.
+    if (!flushPendingOutput(client)) {
+      return false;
+    }
+    if (client.outputBytes() >= kReadPauseOutputBytes) {
+      pauseClientReads(client);
+      return true;
+    }
+  }
+}
+
+bool RedisServer::consumeQueryBuffer(Client &client, size_t parsed) {
+  // Keep only the unparsed tail; it is completed by a later recv.
+  client.queryBuf.erase(0, parsed);
+
+  if (client.queryBuf.size() > kMaxQueryBufferSize) {
+    std::cerr << "Closing client that exceeded the query buffer limit (fd: "
+              << client.fd << ")" << std::endl;
+    return false;
+  }
+
+  // Size the buffer for a large bulk argument up front instead of growing
+  // it one read at a time.
+  size_t needed = client.parser.bytesNeeded();
+  if (needed > client.queryBuf.capacity() && needed <= kMaxQueryBufferSize) {
+    client.queryBuf.reserve(needed);
+  }
+  return true;
+}
+
+void RedisServer::queueClientRead(int clientFd) {
+  if (static_cast<size_t>(clientFd) >= clients_.size() ||
+      !clients_[clientFd]) {
+    return;
+  }
+  Client &client = *clients_[clientFd];
+  if (!client.readQueued && !client.readPaused) {
+    client.readQueued = true;
+    pendingReads_.push_back(&client);
+  }
+}
+
+void RedisServer::handleClientsPendingReads() {
+  // Fan the socket reads and parsing out to the I/O threads, run the
+  // parsed commands here in arrival order, then fan the reply writes out
+  // again. Storage and the command handler only ever see this thread.
+  readBatch_.swap(pendingReads_);
+  ioThreads_->run(readBatch_.size(),
+                  [this](size_t i) { readAndParse(*readBatch_[i]); });
+
+  writeBatch_.clear();
+  for (Client *client : readBatch_) {
+    client->readQueued = false;
+    if (!executeParsedCommands(*client)) {
+      flushPendingOutput(*client);
+      closeClient(client->fd);
+      continue;
+    }
+    if (client->readStatus == Client::ReadStatus::More) {
+      queueClientRead(client->fd);
+    }
+    if (!client->reply.empty()) {
+      writeBatch_.push_back(client);
+    }
+  }
+  readBatch_.clear();
+
+  writeFailed_.assign(writeBatch_.size(), 0);
+  ioThreads_->run(writeBatch_.size(), [this](size_t i) {
+    writeFailed_[i] = !flushPendingOutput(*writeBatch_[i]);
+  });
+  for (size_t i = 0; i < writeBatch_.size(); i++) {
+    Client *client = writeBatch_[i];
+    if (writeFailed_[i]) {
+      closeClient(client->fd);
+    } else if (client->outputBytes() >= kReadPauseOutputBytes) {
+      pauseClientReads(*client);
+    }
+  }
+}
+
+void RedisServer::readAndParse(Client &client) {
+  // Runs on an I/O thread: touches nothing but the client itself.
+  client.readStatus = Client::ReadStatus::Ok;
+  size_t start = client.queryBuf.size();
+  while (true) {
+    ReadResult result = readQueryBuffer(client);
+    if (result == ReadResult::Drained) break;
+    if (result == ReadResult::Closed) {
+      client.readStatus = Client::ReadStatus::Closed;
+      return;
+    }
+    if (client.queryBuf.size() - start >= kIOThreadReadBudget) {
+      client.readStatus = Client::ReadStatus::More;
+      break;
+    }
+  }
+
+  // The argument views stay valid because the buffer is not touched again
+  // until the main thread has run the commands.
+  std::string_view data(client.queryBuf);
+  size_t offset = 0;
+  while (offset < data.size()) {
+    size_t consumed = 0;
+    auto result = client.parser.parse(data.substr(offset), consumed);
+    if (result == RESPParser::ParseResult::Incomplete) {
+      break;
+    }
+    if (result == RESPParser::ParseResult::Error) {
+      client.readStatus = Client::ReadStatus::ProtocolError;
+      break;
+    }
+
+    auto args = client.parser.args();
+    if (!args.empty()) {
+      client.parsedArgs.insert(client.parsedArgs.end(), args.begin(),
+                               args.end());
+      client.parsedArgc.push_back(static_cast<uint32_t>(args.size()));
+      client.parsedEnds.push_back(offset + consumed);
+    }
+    offset += consumed;
+  }
+  client.parsedBytes = offset;
+}
+
+bool RedisServer::executeParsedCommands(Client &client) {
+  if (client.readStatus == Client::ReadStatus::Closed) {
+    return false;
+  }
+
+  std::span<const std::string_view> args(client.parsedArgs);
+  size_t executed = 0;
+  for (size_t i = 0; i < client.parsedArgc.size() && client.blockedId == 0;
+       i++) {
+    dispatchCommand(client, args.first(client.parsedArgc[i]));
+    args = args.subspan(client.parsedArgc[i]);
+    executed = client.parsedEnds[i];
+  }
+  client.parsedArgs.clear();
+  client.parsedArgc.clear();
+  client.parsedEnds.clear();
+  size_t parsed = std::exchange(client.parsedBytes, 0);
+
+  if (client.blockedId != 0) {
+    // The commands behind the blocked one stay in the query buffer and are
+    // parsed again, from the start, once it has been served.
+    client.parser.reset();
+    return consumeQueryBuffer(client, executed);
+  }
+  if (client.readStatus == Client::ReadStatus::ProtocolError) {
+    client.reply.appendRaw(reply::kProtocolError);
+    return false;
+  }
+  return consumeQueryBuffer(client, parsed);
+}
+
+void RedisServer::dispatchCommand(Client &client,
+                                  std::span<const std::string_view> argv) {
+  // The connection becomes a replica link; its stream gets the replica
+  // output buffer limits.
+  if (equalsIgnoreCase(argv[0], "psync")) {
+    client.clientClass = Config::ClientClass::Replica;
+  }
+  if (shards_) {
+    // Malformed calls fall through and get their error locally.
+    const CommandSpec *spec = CommandTable::lookup(argv[0]);
+    if (spec != nullptr && spec->acceptsArgc(argv.size())) {
+      size_t target = shards_->route(*spec, argv);
+      if (target == ShardSet::kCrossShard) {
+        client.reply.appendRaw(reply::kCrossSlot);
+        return;
+      }
+      if (target == ShardSet::kAllShards) {
+        broadcastCommand(client, argv);
+        return;
+      }
+      if (target != ShardSet::kLocal && target != shardId_) {
+        if (spec->flags & kCmdBlocking) {
+          client.blockedOnShard = target;
+        }
+        forwardCommand(client, argv, target, false);
+        return;
+      }
+    }
+  }
+  call(&client, nullptr, argv, client.reply);
+}
+
+// Runs a command for a local client or for a message from another shard.
+// A blocking command with nothing to serve parks its caller instead of
+// replying, and false is returned. Clients blocked on keys the command
+// gave data to are served straight after it, as in Redis.
+bool RedisServer::call(Client *client, ShardMessage *message,
+                       std::span<const std::string_view> argv,
+                       ReplyBuffer &out) {
+  commandHandler_->handleCommand(argv, out);
+  bool replied = true;
+  if (auto request = commandHandler_->takeBlockRequest()) {
+    blockCommand(client, message, argv, std::move(*request));
+    replied = false;
+  }
+  if (storage_->hasReadyKeys()) {
+    handleClientsBlockedOnKeys();
+  }
+  return replied;
+}
+
+void RedisServer::blockCommand(Client *client, ShardMessage *message,
+                               std::span<const std::string_view> argv,
+                               CommandHandler::BlockRequest request) {
+  uint64_t id = ++nextBlockedId_;
+  BlockedCommand &blocked = blocked_[id];
+  if (request.args.empty()) {
+    blocked.args.assign(argv.begin(), argv.end());
+  } else {
+    blocked.args = std::move(request.args);
+  }
+  blocked.keys = std::move(request.keys);
+  blocked.client = client;
+  blocked.message = message;
+  if (request.timeoutMs > 0) {
+    blocked.deadlineMs = monotonicMs() + request.timeoutMs;
+    blockedTimeouts_.emplace(blocked.deadlineMs, id);
+  }
+  for (const std::string &key : blocked.keys) {
+    blockingKeys_[key].push_back(id);
+    storage_->addBlockingKey(key);
+  }
+  if (client) {
+    client->blockedId = id;
+  }
+}
+
+RedisServer::BlockedCommand RedisServer::unlinkBlockedCommand(uint64_t id) {
+  auto it = blocked_.find(id);
+  BlockedCommand blocked = std::move(it->second);
+  blocked_.erase(it);
+
+  for (const std::string &key : blocked.keys) {
+    auto waiters = blockingKeys_.find(key);
+    std::erase(waiters->second, id);
+    if (waiters->second.empty()) {
+      blockingKeys_.erase(waiters);
+    }
+    storage_->removeBlockingKey(key);
+  }
+  if (blocked.deadlineMs != 0) {
+    blockedTimeouts_.erase({blocked.deadlineMs, id});
+  }
+  if (blocked.client) {
+    blocked.client->blockedId = 0;
+  }
+  return blocked;
+}
+
+// Releases a parked command with its reply. A forwarded one goes back to
+// its shard; a local client resumes its pipeline before the loop sleeps,
+// not here, where another client's command may still be running.
+void RedisServer::unblockCommand(uint64_t id, ReplyBuffer &&reply) {
+  BlockedCommand blocked = unlinkBlockedCommand(id);
+  if (blocked.message) {
+    blocked.message->reply.append(std::move(reply));
+    outbox_[blocked.message->origin].push_back(blocked.message);
     return;
   }
+  blocked.client->reply.append(std::move(reply));
+  unblockedClients_.emplace_back(blocked.client->fd, blocked.client->id);
+}
 
-  std::string data(buffer, bytesRead);
-  auto command = RESPParser::parseArray(data);
+void RedisServer::handleClientsBlockedOnKeys() {
+  // Each ready key serves its waiters in arrival order by running their
+  // command again. One that finds nothing stays parked; the rest are still
+  // tried, since a stream serves every reader, unless the key is gone, as
+  // a drained list is.
+  std::vector<std::string_view> argv;
+  std::vector<uint64_t> ids;
+  while (storage_->hasReadyKeys()) {
+    for (const std::string &key : storage_->takeReadyKeys()) {
+      auto waiters = blockingKeys_.find(key);
+      if (waiters == blockingKeys_.end()) continue;
+
+      ids.assign(waiters->second.begin(), waiters->second.end());
+      for (uint64_t id : ids) {
+        const BlockedCommand &blocked = blocked_.at(id);
+        argv.assign(blocked.args.begin(), blocked.args.end());
+        ReplyBuffer reply;
+        commandHandler_->handleCommand(argv, reply);
+        if (commandHandler_->takeBlockRequest()) {
+          if (!storage_->contains(key)) break;
+          continue;
+        }
+        unblockCommand(id, std::move(reply));
+      }
+    }
+  }
+}
 
-  if (!command.empty()) {
-    std::string response = commandHandler_->handleCommand(command);
-    send(clientFd, response.c_str(), response.length(), 0);
+void RedisServer::handleBlockedClientsTimeout() {
+  int64_t now = monotonicMs();
+  while (!blockedTimeouts_.empty() &&
+         blockedTimeouts_.begin()->first <= now) {
+    ReplyBuffer timedOut;
+    timedOut.appendRaw(reply::kNullArray);
+    unblockCommand(blockedTimeouts_.begin()->second, std::move(timedOut));
   }
 }
 
+void RedisServer::processUnblockedClients() {
+  // Resuming a pipeline can unblock more clients; they go in a new list.
+  std::vector<std::pair<int, uint64_t>> unblocked;
+  unblocked.swap(unblockedClients_);
+  for (auto [fd, id] : unblocked) {
+    if (static_cast<size_t>(fd) >= clients_.size() || !clients_[fd] ||
+        clients_[fd]->id != id || clients_[fd]->closing) {
+      continue;
+    }
+    Client &client = *clients_[fd];
+    if (!processInput(client) || !flushPendingOutput(client)) {
+      closeClient(fd);
+      continue;
+    }
+    if (client.readPaused && client.outputBytes() < kReadPauseOutputBytes) {
+      resumeClientReads(client);
+    }
+  }
+}
+
+void RedisServer::forwardCommand(Client &client,
+                                 std::span<const std::string_view> argv,
+                                 size_t shard, bool broadcast) {
+  auto *message = new ShardMessage;
+  message->origin = shardId_;
+  message->clientFd = client.fd;
+  message->clientId = client.id;
+  message->broadcast = broadcast;
+  message->args.assign(argv.begin(), argv.end());
+
+  client.awaitingShards++;
+  outbox_[shard].push_back(message);
+}
+
+void RedisServer::broadcastCommand(Client &client,
+                                   std::span<const std::string_view> argv) {
+  ReplyBuffer local;
+  commandHandler_->handleCommand(argv, local);
+  client.shardReplies.push_back(local.toString());
+  for (size_t shard = 0; shard < shards_->size(); shard++) {
+    if (shard != shardId_) {
+      forwardCommand(client, argv, shard, true);
+    }
+  }
+}
+
+void RedisServer::handleShardMessages() {
+  std::vector<std::string_view> argv;
+  for (size_t from = 0; from < shards_->size(); from++) {
+    ShardMessage *message;
+    while (shards_->receive(from, shardId_, message)) {
+      if (message->origin == shardId_) {
+        completeForwardedCommand(message);
+        continue;
+      }
+      if (message->cancel) {
+        cancelParkedCommand(message);
+        continue;
+      }
+      // A command for keys this shard owns: run it and send it back, or
+      // park it if it blocks.
+      argv.assign(message->args.begin(), message->args.end());
+      if (call(nullptr, message, argv, message->reply)) {
+        outbox_[message->origin].push_back(message);
+      }
+    }
+  }
+}
+
+void RedisServer::cancelParkedCommand(ShardMessage *cancel) {
+  auto parked = std::find_if(blocked_.begin(), blocked_.end(),
+                             [cancel](const auto &entry) {
+                               const ShardMessage *message =
+                                   entry.second.message;
+                               return message &&
+                                      message->origin == cancel->origin &&
+                                      message->clientId == cancel->clientId;
+                             });
+  if (parked != blocked_.end()) {
+    // Back without a reply; the origin drops it like the cancel itself.
+    ShardMessage *message = parked->second.message;
+    unlinkBlockedCommand(parked->first);
+    outbox_[message->origin].push_back(message);
+  }
+  outbox_[cancel->origin].push_back(cancel);
+}
+
+void RedisServer::completeForwardedCommand(ShardMessage *message) {
+  std::unique_ptr<ShardMessage> owned(message);
+  int fd = message->clientFd;
+  if (message->cancel || static_cast<size_t>(fd) >= clients_.size() ||
+      !clients_[fd] || clients_[fd]->id != message->clientId ||
+      clients_[fd]->closing) {
+    return;  // The client went away while the command was out.
+  }
+  Client &client = *clients_[fd];
+
+  if (message->broadcast) {
+    client.shardReplies.push_back(message->reply.toString());
+  } else {
+    client.reply.append(std::move(message->reply));
+    client.blockedOnShard = SIZE_MAX;
+  }
+  if (--client.awaitingShards > 0) {
+    return;
+  }
+  if (!client.shardReplies.empty()) {
+    ShardSet::mergeReplies(client.shardReplies, client.reply);
+    client.shardReplies.clear();
+  }
+
+  // Pick up the pipeline where the forwarded command paused it.
+  if (!processInput(client) || !flushPendingOutput(client)) {
+    closeClient(fd);
+    return;
+  }
+  if (client.readPaused && client.outputBytes() < kReadPauseOutputBytes) {
+    resumeClientReads(client);
+  }
+}
+
+bool RedisServer::flushShardOutbox() {
+  bool pending = false;
+  for (size_t shard = 0; shard < outbox_.size(); shard++) {
+    auto &messages = outbox_[shard];
+    if (messages.empty()) continue;
+
+    size_t sent = 0;
+    while (sent < messages.size() &&
+           shards_->send(shardId_, shard, messages[sent])) {
+      sent++;
+    }
+    if (sent > 0) {
+      messages.erase(messages.begin(), messages.begin() + sent);
+      shards_->notify(shard);
+    }
+    pending = pending || !messages.empty();
+  }
+  return pending;
+}
+
+void RedisServer::handleClientWritable(int clientFd) {
+  if (static_cast<size_t>(clientFd) >= clients_.size() ||
+      !clients_[clientFd]) {
+    return;
+  }
+  Client &client = *clients_[clientFd];
+  if (!flushPendingOutput(client)) {
+    closeClient(clientFd);
+    return;
+  }
+  if (client.readPaused && client.outputBytes() < kReadPauseOutputBytes) {
+    resumeClientReads(client);
+  }
+}
+
+void RedisServer::pauseClientReads(Client &client) {
+  if (client.readPaused) {
+    return;
+  }
+  client.readPaused = true;
+  if (client.readQueued) {
+    std::erase(pendingReads_, &client);
+    client.readQueued = false;
+  }
+  if (uring_ && client.recvArmed) {
+    // Whatever the receive delivers before the cancel lands is kept in
+    // the query buffer.
+    uring_->prepareCancel(uringData(kOpRecv, client.fd),
+                          uringData(kOpCancel, client.fd));
+  }
+}
+
+void RedisServer::resumeClientReads(Client &client) {
+  // May close the client.
+  client.readPaused = false;
+  if (ioThreads_) {
+    queueClientRead(client.fd);
+    return;
+  }
+
+  // Commands that parsing stopped at are still in the query buffer.
+  if (!processInput(client)) {
+    closeClient(client.fd);
+    return;
+  }
+  if (client.readPaused) {
+    return;
+  }
+  if (!uring_) {
+    // Edge-triggered: the input left in the kernel is not reported again.
+    handleClientData(client.fd);
+    return;
+  }
+  if (!client.recvArmed) {
+    armUringRecv(client);
+  }
+  if (!flushPendingOutput(client)) {
+    closeClient(client.fd);
+  }
+}
+
+bool RedisServer::checkOutputBufferLimits(Client &client) {
+  const Config::OutputBufferLimit &limit =
+      config_->getOutputBufferLimit(client.clientClass);
+  size_t used = client.outputBytes();
+
+  bool overHard = limit.hardBytes > 0 && used >= limit.hardBytes;
+  bool overSoft = false;
+  if (limit.softBytes > 0 && used >= limit.softBytes) {
+    int64_t now = monotonicMs();
+    if (client.softLimitSinceMs == 0) {
+      client.softLimitSinceMs = now;
+    }
+    auto softMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+        limit.softSeconds);
+    overSoft = now - client.softLimitSinceMs > softMs.count();
+  } else {
+    client.softLimitSinceMs = 0;
+  }
+
+  if (overHard || overSoft) {
+    std::cerr << "Closing client that exceeded its "
+              << (overHard ? "hard" : "soft") << " output buffer limit (fd: "
+              << client.fd << ", " << used << " bytes pending)" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool RedisServer::flushPendingOutput(Client &client) {
+  if (uring_) {
+    // Sent with the next batch of submissions.
+    queueUringSend(client);
+  } else if (client.reply.writeTo(client.fd) ==
+             ReplyBuffer::WriteResult::Error) {
+    return false;
+  }
+  // A blocked write is resumed when the socket drains, unless the client
+  // has fallen too far behind.
+  return checkOutputBufferLimits(client);
+}
+
 void RedisServer::closeClient(int clientFd) {
+  Client &client = *clients_[clientFd];
+  if (client.blockedId != 0) {
+    unlinkBlockedCommand(client.blockedId);
+  }
+  if (client.blockedOnShard != SIZE_MAX) {
+    auto *cancel = new ShardMessage;
+    cancel->origin = shardId_;
+    cancel->clientFd = clientFd;
+    cancel->clientId = client.id;
+    cancel->cancel = true;
+    outbox_[client.blockedOnShard].push_back(cancel);
+    client.blockedOnShard = SIZE_MAX;
+  }
+
+  if (uring_) {
+    closeUringClient(clientFd);
+    return;
+  }
+  if (client.readQueued) {
+    std::erase(pendingReads_, &client);
+  }
+  loop_.removeFd(clientFd);
   close(clientFd);
-  clientFds_.erase(clientFd);
+  clients_[clientFd].reset();
+  numClients_--;
   std::cout << "Client disconnected (fd: " << clientFd << ")" << std::endl;
 }
 
+void RedisServer::serverCron() {
+  // Periodic housekeeping, run kServerHz times per second from the loop.
+  cronLoops_++;
+
+  // Help an in-progress keyspace resize along while the server is idle.
+  storage_->activeRehash(kActiveRehashBudget);
+
+  // Reclaim keys that expired without being read again.
+  storage_->activeExpireCycle(ExpireCycle::Slow,
+                              config_->getActiveExpireBudget());
+
+  // Move entries out of sparse slabs, then report this keyspace's size
+  // for the process-wide fragmentation ratio.
+  storage_->activeDefragCycle(std::chrono::microseconds(1000000 / kServerHz));
+  storage_->publishUsedMemory();
+
+  // Blocking commands whose timeout has passed get a null reply.
+  handleBlockedClientsTimeout();
+
+  // Give back query buffer memory held by idle clients after a burst of
+  // large requests. Each run visits a slice of the table so every slot is
+  // seen about once per second without an O(connected) pause.
+  size_t slots = clients_.size();
+  size_t budget = std::max<size_t>(slots / kServerHz, 16);
+  for (size_t n = 0; n < budget && slots > 0; n++) {
+    clientsCronCursor_ = (clientsCronCursor_ + 1) % slots;
+    auto &client = clients_[clientsCronCursor_];
+    // The soft limit also has to catch a client that stopped reading
+    // altogether and so never triggers another write.
+    if (client && !client->closing && client->outputBytes() > 0 &&
+        !checkOutputBufferLimits(*client)) {
+      closeClient(client->fd);
+      continue;
+    }
+    if (client && client->queryBuf.empty() &&
+        client->queryBuf.capacity() > kIdleQueryBufferCapacity) {
+      client->queryBuf.shrink_to_fit();
+    }
+  }
+}
+
 bool RedisServer::loadRDBFile() {
   std::string rdbPath = config_->getDir() + "/" + config_->getDbFilename();
 
   RDBParser parser;
+  if (shards_) {
+    parser.setKeyFilter([this](std::string_view key) {
+      return shards_->shardOf(key) == shardId_;
+    });
+  }
   if (!parser.parseFile(rdbPath, *storage_)) {
     std::cerr << "Failed to parse RDB file: " << rdbPath << std::endl;
     return false;
@@ -328,4 +1231,240 @@ bool RedisServer::loadRDBFile() {
   return true;
 }
 
-}  // namespace redis
\ No newline at end of file
+void RedisServer::runUring() {
+  cronTimerFd_ = EventLoop::createTimerFd(1000 / kServerHz);
+  if (cronTimerFd_ < 0) {
+    return;
+  }
+  uring_->prepareMultishotAccept(serverFd_, uringData(kOpAccept, serverFd_));
+  uring_->prepareMultishotPoll(cronTimerFd_, uringData(kOpCron, cronTimerFd_));
+  if (shards_) {
+    int eventFd = shards_->eventFd(shardId_);
+    uring_->prepareMultishotPoll(eventFd, uringData(kOpShardEvent, eventFd));
+  }
+  if (shardId_ == 0) {
+    std::cout << "Using the io_uring backend" << std::endl;
+  }
+
+  while (true) {
+    while (!unblockedClients_.empty()) {
+      processUnblockedClients();
+    }
+    if (storage_->needsFastExpireCycle()) {
+      storage_->activeExpireCycle(ExpireCycle::Fast, kFastExpireBudget);
+    }
+
+    // Every reply produced by the last batch goes out with this one
+    // io_uring_enter, together with any re-armed receives.
+    submitUringSends();
+    bool pendingWork = shards_ && flushShardOutbox();
+    int numCompletions = uring_->submitAndWait(!pendingWork);
+    if (numCompletions < 0) {
+      std::cerr << "io_uring_enter error" << std::endl;
+      break;
+    }
+
+    for (int i = 0; i < numCompletions; i++) {
+      handleUringCompletion(uring_->completion(i));
+    }
+  }
+}
+
+void RedisServer::handleUringCompletion(const UringLoop::Completion &event) {
+  auto op = static_cast<UringOp>(event.userData >> 32);
+  int fd = static_cast<int>(event.userData & 0xFFFFFFFFu);
+  bool more = UringLoop::hasMore(event.flags);
+
+  switch (op) {
+    case kOpAccept:
+      if (event.result >= 0) {
+        int nodelay = 1;
+        setsockopt(event.result, IPPROTO_TCP, TCP_NODELAY, &nodelay,
+                   sizeof(nodelay));
+        Client &client = addClient(event.result);
+        armUringRecv(client);
+      } else if (event.result != -EINTR && event.result != -EAGAIN) {
+        std::cerr << "Failed to accept client connection" << std::endl;
+      }
+      if (!more) {
+        uring_->prepareMultishotAccept(serverFd_, event.userData);
+      }
+      return;
+
+    case kOpCron:
+      if (EventLoop::drainTimer(cronTimerFd_) > 0) {
+        serverCron();
+      }
+      if (!more) {
+        uring_->prepareMultishotPoll(cronTimerFd_, event.userData);
+      }
+      return;
+
+    case kOpShardEvent:
+      EventLoop::drainTimer(fd);
+      handleShardMessages();
+      if (!more) {
+        uring_->prepareMultishotPoll(fd, event.userData);
+      }
+      return;
+
+    case kOpRecv:
+      handleUringRecv(fd, event);
+      return;
+
+    case kOpSend:
+      handleUringSend(fd, event);
+      return;
+
+    case kOpCancel:
+      return;
+  }
+}
+
+void RedisServer::armUringRecv(Client &client) {
+  client.uringOps++;
+  client.recvArmed = true;
+  uring_->prepareMultishotRecv(client.fd, uringData(kOpRecv, client.fd));
+}
+
+void RedisServer::handleUringRecv(int fd, const UringLoop::Completion &event) {
+  Client *client =
+      static_cast<size_t>(fd) < clients_.size() ? clients_[fd].get() : nullptr;
+  bool more = UringLoop::hasMore(event.flags);
+
+  if (UringLoop::hasBuffer(event.flags)) {
+    uint16_t id = UringLoop::bufferId(event.flags);
+    if (client && !client->closing && event.result > 0) {
+      client->queryBuf.append(uring_->buffer(id, event.result));
+    }
+    uring_->recycleBuffer(id);
+  }
+  if (!client) {
+    return;
+  }
+  if (!more) {
+    client->uringOps--;
+    client->recvArmed = false;
+  }
+  if (client->closing) {
+    finishUringClose(*client);
+    return;
+  }
+
+  if (event.result > 0 && !client->readPaused) {
+    if (!processInput(*client) ||
+        (!client->reply.empty() && !flushPendingOutput(*client))) {
+      closeClient(fd);
+      return;
+    }
+  }
+
+  if (!more) {
+    // The kernel ends a multishot receive on EOF and errors, when it runs
+    // out of provided buffers, and when paused reads cancel it. A paused
+    // client is re-armed once its output drains.
+    if (event.result > 0 || event.result == -ENOBUFS ||
+        event.result == -ECANCELED) {
+      if (!client->readPaused) {
+        armUringRecv(*client);
+      }
+    } else {
+      closeClient(fd);
+    }
+  }
+}
+
+void RedisServer::queueUringSend(Client &client) {
+  if (!client.sendQueued) {
+    client.sendQueued = true;
+    sendQueue_.push_back(client.fd);
+  }
+}
+
+void RedisServer::submitUringSends() {
+  for (int fd : sendQueue_) {
+    Client *client = clients_[fd].get();
+    if (!client) continue;
+    client->sendQueued = false;
+    if (client->closing || client->sendInFlight) continue;
+
+    // Replies collect in `reply` while `sending` is with the kernel.
+    if (client->sending.empty()) {
+      std::swap(client->sending, client->reply);
+    }
+    if (client->sending.empty()) continue;
+
+    client->sendIov.resize(client->sending.iovNeeded());
+    client->sendMsg = msghdr{};
+    client->sendMsg.msg_iov = client->sendIov.data();
+    client->sendMsg.msg_iovlen = client->sending.fillIov(
+        client->sendIov.data(), client->sendIov.size());
+    uring_->prepareSendmsg(fd, &client->sendMsg, uringData(kOpSend, fd));
+    client->sendInFlight = true;
+    client->uringOps++;
+  }
+  sendQueue_.clear();
+}
+
+void RedisServer::handleUringSend(int fd, const UringLoop::Completion &event) {
+  Client *client =
+      static_cast<size_t>(fd) < clients_.size() ? clients_[fd].get() : nullptr;
+  if (!client) {
+    return;
+  }
+  client->uringOps--;
+  client->sendInFlight = false;
+  if (client->closing) {
+    finishUringClose(*client);
+    return;
+  }
+  if (event.result < 0) {
+    closeClient(fd);
+    return;
+  }
+
+  // A short write leaves the rest in `sending` for the next submission.
+  client->sending.consume(static_cast<size_t>(event.result));
+  if (!client->sending.empty() || !client->reply.empty()) {
+    queueUringSend(*client);
+  }
+  if (client->readPaused && client->outputBytes() < kReadPauseOutputBytes) {
+    resumeClientReads(*client);
+  }
+}
+
+void RedisServer::closeUringClient(int clientFd) {
+  Client &client = *clients_[clientFd];
+  if (client.closing) {
+    return;
+  }
+  client.closing = true;
+  std::cout << "Client disconnected (fd: " << clientFd << ")" << std::endl;
+
+  // Best effort for a final reply such as a protocol error, unless the
+  // kernel is still sending earlier bytes.
+  if (!client.sendInFlight &&
+      client.sending.writeTo(clientFd) == ReplyBuffer::WriteResult::Done) {
+    client.reply.writeTo(clientFd);
+  }
+
+  if (client.uringOps > 0) {
+    // Keep the fd, and with it the client slot, until the kernel has
+    // finished with every operation that refers to them.
+    shutdown(clientFd, SHUT_RDWR);
+    uring_->prepareCancelFd(clientFd, uringData(kOpCancel, clientFd));
+  }
+  finishUringClose(client);
+}
+
+void RedisServer::finishUringClose(Client &client) {
+  if (!client.closing || client.uringOps > 0) {
+    return;
+  }
+  int fd = client.fd;
+  close(fd);
+  clients_[fd].reset();
+  numClients_--;
+}
+
+}  // namespace redis
@@ -0,0 +1,244 @@
+#include "redis/ReplyBuffer.h"
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <climits>
+
+namespace redis {
+
+namespace {
+
+// Capacity kept across flushes; a buffer that grew past it for one large
+// reply is released rather than pinned for the life of the connection.
+constexpr size_t kRetainedCapacity = 64 * 1024;
+
+#ifdef IOV_MAX
+constexpr size_t kMaxIov = IOV_MAX;
+#else
+constexpr size_t kMaxIov = 1024;
+#endif
+
+}  // namespace
+
+void ReplyBuffer::appendRaw(std::string_view data) {
+  buffer_.append(data);
+  pendingBytes_ += data.size();
+}
+
+void ReplyBuffer::appendPrefixed(char prefix, int64_t value) {
+  char header[24];
+  header[0] = prefix;
+  char* end = std::to_chars(header + 1, header + sizeof(header) - 2, value).ptr;
+  *end++ = '\r';
+  *end++ = '\n';
+  appendRaw(std::string_view(header, end - header));
+}
+
+void ReplyBuffer::appendSimpleString(std::string_view str) {
+  buffer_.push_back('+');
+  buffer_.append(str);
+  buffer_.append("\r\n");
+  pendingBytes_ += str.size() + 3;
+}
+
+void ReplyBuffer::appendError(std::string_view error) {
+  buffer_.push_back('-');
+  buffer_.append(error);
+  buffer_.append("\r\n");
+  pendingBytes_ += error.size() + 3;
+}
+
+void ReplyBuffer::appendInteger(int64_t value) {
+  if (value == 0) {
+    appendRaw(reply::kZero);
+  } else if (value == 1) {
+    appendRaw(reply::kOne);
+  } else {
+    appendPrefixed(':', value);
+  }
+}
+
+void ReplyBuffer::appendBulkString(std::string_view str) {
+  appendPrefixed('$', static_cast<int64_t>(str.size()));
+  buffer_.append(str);
+  buffer_.append("\r\n");
+  pendingBytes_ += str.size() + 2;
+}
+
+void ReplyBuffer::appendBulkString(std::string_view str,
+                                   std::shared_ptr<const void> owner) {
+  if (str.size() < kMinReferencedBulk) {
+    appendBulkString(str);
+    return;
+  }
+
+  appendPrefixed('$', static_cast<int64_t>(str.size()));
+  sealInline();
+  pushExternal(str.data(), str.size(), std::move(owner));
+  appendRaw("\r\n");
+}
+
+void ReplyBuffer::appendArrayHeader(size_t count) {
+  if (count == 0) {
+    appendRaw(reply::kEmptyArray);
+  } else {
+    appendPrefixed('*', static_cast<int64_t>(count));
+  }
+}
+
+size_t ReplyBuffer::beginDeferredArray() {
+  sealInline();
+  pushExternal(nullptr, 0, nullptr);
+  return segments_.size() - 1;
+}
+
+void ReplyBuffer::setDeferredArrayLength(size_t handle, size_t count) {
+  char header[24];
+  header[0] = '*';
+  char* end = std::to_chars(header + 1, header + sizeof(header) - 2,
+                            static_cast<uint64_t>(count))
+                  .ptr;
+  *end++ = '\r';
+  *end++ = '\n';
+
+  auto text = std::make_shared<const std::string>(header, end - header);
+  Segment& segment = segments_[handle];
+  segment.data = text->data();
+  segment.length = text->size();
+  segment.owner = std::move(text);
+  pendingBytes_ += segment.length;
+}
+
+void ReplyBuffer::append(ReplyBuffer&& other) {
+  other.sealInline();
+  for (size_t i = other.sentSegments_; i < other.segments_.size(); i++) {
+    Segment& segment = other.segments_[i];
+    size_t skip = i == other.sentSegments_ ? other.sentOffset_ : 0;
+    if (segment.data == nullptr) {
+      appendRaw(std::string_view(other.buffer_)
+                    .substr(segment.offset + skip, segment.length - skip));
+    } else if (segment.length > skip) {
+      sealInline();
+      pushExternal(segment.data + skip, segment.length - skip,
+                   std::move(segment.owner));
+    }
+  }
+  other.clear();
+}
+
+std::string ReplyBuffer::toString() const {
+  std::string out;
+  out.reserve(pendingBytes_);
+  for (size_t i = sentSegments_; i < segments_.size(); i++) {
+    const Segment& segment = segments_[i];
+    size_t skip = i == sentSegments_ ? sentOffset_ : 0;
+    const char* base =
+        segment.data ? segment.data : buffer_.data() + segment.offset;
+    out.append(base + skip, segment.length - skip);
+  }
+  // Bytes after the last segment have never been written.
+  out.append(buffer_, inlineStart_);
+  return out;
+}
+
+void ReplyBuffer::sealInline() {
+  if (buffer_.size() > inlineStart_) {
+    Segment segment;
+    segment.offset = inlineStart_;
+    segment.length = buffer_.size() - inlineStart_;
+    segments_.push_back(std::move(segment));
+    inlineStart_ = buffer_.size();
+  }
+}
+
+void ReplyBuffer::pushExternal(const char* data, size_t length,
+                               std::shared_ptr<const void> owner) {
+  Segment segment;
+  segment.data = data;
+  segment.length = length;
+  segment.owner = std::move(owner);
+  segments_.push_back(std::move(segment));
+  pendingBytes_ += length;
+}
+
+ReplyBuffer::WriteResult ReplyBuffer::writeTo(int fd) {
+  iovec iov[kMaxIov];
+  while (pendingBytes_ > 0) {
+    msghdr msg{};
+    msg.msg_iov = iov;
+    msg.msg_iovlen = fillIov(iov, kMaxIov);
+    ssize_t sent = sendmsg(fd, &msg, MSG_NOSIGNAL);
+    if (sent < 0) {
+      if (errno == EINTR) continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK) return WriteResult::Blocked;
+      return WriteResult::Error;
+    }
+    consume(static_cast<size_t>(sent));
+  }
+
+  clear();
+  return WriteResult::Done;
+}
+
+size_t ReplyBuffer::iovNeeded() const {
+  size_t count = segments_.size() - sentSegments_;
+  return std::min(count + (buffer_.size() > inlineStart_ ? 1 : 0), kMaxIov);
+}
+
+size_t ReplyBuffer::fillIov(iovec* iov, size_t max) {
+  sealInline();
+
+  size_t count = 0;
+  for (size_t i = sentSegments_; i < segments_.size() && count < max; i++) {
+    const Segment& segment = segments_[i];
+    size_t skip = i == sentSegments_ ? sentOffset_ : 0;
+    if (segment.length == skip) continue;
+
+    const char* base =
+        segment.data ? segment.data : buffer_.data() + segment.offset;
+    iov[count].iov_base = const_cast<char*>(base + skip);
+    iov[count].iov_len = segment.length - skip;
+    count++;
+  }
+  return count;
+}
+
+void ReplyBuffer::consume(size_t sent) {
+  pendingBytes_ -= sent;
+  while (sent > 0 || (sentSegments_ < segments_.size() &&
+                      segments_[sentSegments_].length == sentOffset_)) {
+    Segment& segment = segments_[sentSegments_];
+    size_t available = segment.length - sentOffset_;
+    if (sent < available) {
+      sentOffset_ += sent;
+      break;
+    }
+    sent -= available;
+    // Drop the reference as soon as its bytes are in the kernel.
+    segment.owner.reset();
+    sentSegments_++;
+    sentOffset_ = 0;
+  }
+  if (pendingBytes_ == 0) {
+    clear();
+  }
+}
+
+void ReplyBuffer::clear() {
+  if (buffer_.capacity() > kRetainedCapacity) {
+    std::string().swap(buffer_);
+  } else {
+    buffer_.clear();
+  }
+  segments_.clear();
+  inlineStart_ = 0;
+  sentSegments_ = 0;
+  sentOffset_ = 0;
+  pendingBytes_ = 0;
+}
+
+}  // namespace redis
@@ -0,0 +1,255 @@
+#include "redis/Set.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <vector>
+
+#include "redis/Entry.h"
+#include "redis/IntSet.h"
+#include "redis/StringUtil.h"
+
+namespace redis {
+
+namespace {
+
+void visitInteger(int64_t value, const MemberVisitor& visit) {
+  char text[kMaxInt64Chars];
+  visit(formatInt64(value, text));
+}
+
+// Intersects intsets, smallest first, as arrays of T: each step writes the
+// values left over the previous ones, so the working set only shrinks.
+template <typename T>
+void intersectIntSets(std::span<const Set* const> sets, size_t limit,
+                      const MemberVisitor& visit) {
+  // A set stored narrower than T is widened into a copy.
+  std::vector<std::vector<T>> widened;
+  widened.reserve(sets.size());
+  auto valuesOf = [&widened](const IntSet& set) -> std::span<const T> {
+    if (set.width() == sizeof(T)) {
+      return set.values<T>();
+    }
+    std::vector<T>& copy = widened.emplace_back(set.size());
+    for (size_t i = 0; i < set.size(); i++) {
+      copy[i] = static_cast<T>(set.get(i));
+    }
+    return copy;
+  };
+
+  std::span<const T> smallest = valuesOf(*sets[0]->intSet());
+  std::vector<T> common(smallest.begin(), smallest.end());
+  for (size_t k = 1; k < sets.size() && !common.empty(); k++) {
+    common.resize(
+        intersectSorted(common, valuesOf(*sets[k]->intSet()), common.data()));
+  }
+  for (size_t i = 0; i < common.size() && i < limit; i++) {
+    visitInteger(common[i], visit);
+  }
+}
+
+bool allIntSets(std::span<const Set> sets) {
+  return std::all_of(sets.begin(), sets.end(),
+                     [](const Set& set) { return set.intSet() != nullptr; });
+}
+
+}  // namespace
+
+SetMember* SetMember::create(std::string_view member) {
+  SetMember* created =
+      new (::operator new(sizeof(SetMember) + member.size())) SetMember();
+  created->length_ = static_cast<uint32_t>(member.size());
+  std::memcpy(reinterpret_cast<char*>(created + 1), member.data(),
+              member.size());
+  return created;
+}
+
+size_t SetTable::memoryUsage() const {
+  // A slot and its control byte per bucket.
+  return sizeof(SetTable) +
+         members_.capacity() * (sizeof(SetMemberPtr) + 1) + bytes_;
+}
+
+bool SetTable::add(std::string_view member) {
+  auto [slot, inserted] = members_.findOrInsert(
+      member, [&] { return SetMemberPtr(SetMember::create(member)); });
+  if (inserted) {
+    bytes_ += (*slot)->allocationSize();
+  }
+  return inserted;
+}
+
+bool SetTable::remove(std::string_view member) {
+  SetMemberPtr removed;
+  if (!members_.extract(member, removed)) {
+    return false;
+  }
+  bytes_ -= removed->allocationSize();
+  return true;
+}
+
+void SetTable::forEach(const MemberVisitor& visit) const {
+  members_.forEach(
+      [&visit](const SetMemberPtr& member) { visit(member->view()); });
+}
+
+size_t Set::size() const {
+  if (entry_->encoding() == Encoding::IntSet) {
+    return entry_->intSetValue().size();
+  }
+  return entry_->setTableValue().size();
+}
+
+const IntSet* Set::intSet() const {
+  return entry_->encoding() == Encoding::IntSet ? &entry_->intSetValue()
+                                                : nullptr;
+}
+
+bool Set::contains(std::string_view member) const {
+  if (entry_->encoding() == Encoding::IntSet) {
+    int64_t value = 0;
+    return parseCanonicalInt64(member, value) &&
+           entry_->intSetValue().contains(value);
+  }
+  return entry_->setTableValue().contains(member);
+}
+
+bool Set::add(std::string_view member) {
+  if (entry_->encoding() == Encoding::IntSet) {
+    IntSet& intSet = entry_->intSetValue();
+    int64_t value = 0;
+    if (parseCanonicalInt64(member, value)) {
+      if (intSet.size() < limits_->maxIntsetEntries) {
+        return intSet.insert(value);
+      }
+      if (intSet.contains(value)) {
+        return false;
+      }
+    }
+    return convertToTable().add(member);
+  }
+  return entry_->setTableValue().add(member);
+}
+
+bool Set::remove(std::string_view member) {
+  if (entry_->encoding() == Encoding::IntSet) {
+    int64_t value = 0;
+    return parseCanonicalInt64(member, value) &&
+           entry_->intSetValue().erase(value);
+  }
+  return entry_->setTableValue().remove(member);
+}
+
+void Set::forEach(const MemberVisitor& visit) const {
+  if (entry_->encoding() == Encoding::IntSet) {
+    const IntSet& intSet = entry_->intSetValue();
+    for (size_t i = 0; i < intSet.size(); i++) {
+      visitInteger(intSet.get(i), visit);
+    }
+    return;
+  }
+  entry_->setTableValue().forEach(visit);
+}
+
+void Set::assign(IntSet&& values) {
+  if (entry_->encoding() == Encoding::IntSet &&
+      values.size() <= limits_->maxIntsetEntries) {
+    entry_->intSetValue() = std::move(values);
+    return;
+  }
+  for (size_t i = 0; i < values.size(); i++) {
+    visitInteger(values.get(i), [this](std::string_view member) {
+      add(member);
+    });
+  }
+}
+
+SetTable& Set::convertToTable() {
+  auto table = std::make_unique<SetTable>();
+  forEach([&table](std::string_view member) { table->add(member); });
+  entry_->convertToSetTable(std::move(table));
+  return entry_->setTableValue();
+}
+
+void intersectSets(std::span<const Set> sets, size_t limit,
+                   const MemberVisitor& visit) {
+  if (sets.empty() || limit == 0) {
+    return;
+  }
+  std::vector<const Set*> bySize;
+  bySize.reserve(sets.size());
+  for (const Set& set : sets) {
+    bySize.push_back(&set);
+  }
+  std::sort(bySize.begin(), bySize.end(), [](const Set* a, const Set* b) {
+    return a->size() < b->size();
+  });
+
+  if (allIntSets(sets)) {
+    // Four-byte values take the SIMD kernels; anything wider, 64-bit ones.
+    size_t width = 0;
+    for (const Set* set : bySize) {
+      width = std::max(width, set->intSet()->width());
+    }
+    if (width <= sizeof(int32_t)) {
+      intersectIntSets<int32_t>(bySize, limit, visit);
+    } else {
+      intersectIntSets<int64_t>(bySize, limit, visit);
+    }
+    return;
+  }
+
+  // As Redis does: each member of the smallest set, looked up in the rest.
+  bySize[0]->forEach([&](std::string_view member) {
+    if (limit == 0) {
+      return;
+    }
+    for (size_t k = 1; k < bySize.size(); k++) {
+      if (!bySize[k]->contains(member)) {
+        return;
+      }
+    }
+    visit(member);
+    limit--;
+  });
+}
+
+void unionSets(std::span<const Set> sets, const MemberVisitor& visit) {
+  if (allIntSets(sets)) {
+    std::vector<int64_t> values;
+    for (const Set& set : sets) {
+      const IntSet& intSet = *set.intSet();
+      for (size_t i = 0; i < intSet.size(); i++) {
+        values.push_back(intSet.get(i));
+      }
+    }
+    std::sort(values.begin(), values.end());
+    values.erase(std::unique(values.begin(), values.end()), values.end());
+    for (int64_t value : values) {
+      visitInteger(value, visit);
+    }
+    return;
+  }
+
+  SetTable merged;
+  for (const Set& set : sets) {
+    set.forEach([&merged](std::string_view member) { merged.add(member); });
+  }
+  merged.forEach(visit);
+}
+
+void diffSets(std::span<const Set> sets, const MemberVisitor& visit) {
+  if (sets.empty()) {
+    return;
+  }
+  sets[0].forEach([&](std::string_view member) {
+    for (const Set& other : sets.subspan(1)) {
+      if (other.contains(member)) {
+        return;
+      }
+    }
+    visit(member);
+  });
+}
+
+}  // namespace redis
@@ -0,0 +1,202 @@
+#include "redis/ShardSet.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <iostream>
+#include <thread>
+
+#include "redis/CommandTable.h"
+#include "redis/RedisServer.h"
+#include "redis/StringUtil.h"
+
+namespace redis {
+
+namespace {
+
+constexpr uint16_t kHashSlots = 16384;
+
+// CRC16-CCITT (XMODEM), the checksum Redis Cluster uses for key slots.
+constexpr std::array<uint16_t, 256> makeCrc16Table() {
+  std::array<uint16_t, 256> table{};
+  for (uint32_t byte = 0; byte < 256; byte++) {
+    uint16_t crc = static_cast<uint16_t>(byte << 8);
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x8000) ? static_cast<uint16_t>((crc << 1) ^ 0x1021)
+                           : static_cast<uint16_t>(crc << 1);
+    }
+    table[byte] = crc;
+  }
+  return table;
+}
+
+constexpr auto kCrc16Table = makeCrc16Table();
+
+uint16_t crc16(std::string_view data) {
+  uint16_t crc = 0;
+  for (char c : data) {
+    uint8_t index = static_cast<uint8_t>((crc >> 8) ^ static_cast<uint8_t>(c));
+    crc = static_cast<uint16_t>((crc << 8) ^ kCrc16Table[index]);
+  }
+  return crc;
+}
+
+void pinToCore(std::thread& thread, size_t shard) {
+  unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(shard % cores, &set);
+  pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+}
+
+}  // namespace
+
+ShardSet::ShardSet(std::shared_ptr<Config> config, size_t count)
+    : config_(std::move(config)), count_(std::max<size_t>(count, 1)) {
+  queues_.reserve(count_ * count_);
+  for (size_t i = 0; i < count_ * count_; i++) {
+    queues_.push_back(std::make_unique<Queue>());
+  }
+  for (size_t i = 0; i < count_; i++) {
+    eventFds_.push_back(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC));
+  }
+}
+
+ShardSet::~ShardSet() {
+  for (int fd : eventFds_) {
+    if (fd != -1) {
+      close(fd);
+    }
+  }
+}
+
+void ShardSet::run() {
+  if (std::find(eventFds_.begin(), eventFds_.end(), -1) != eventFds_.end()) {
+    std::cerr << "Failed to create shard eventfds" << std::endl;
+    return;
+  }
+
+  std::vector<std::unique_ptr<RedisServer>> servers;
+  for (size_t shard = 0; shard < count_; shard++) {
+    servers.push_back(std::make_unique<RedisServer>(config_, this, shard));
+  }
+
+  std::cout << "Starting " << count_ << " shards" << std::endl;
+  std::vector<std::thread> threads;
+  for (size_t shard = 0; shard < count_; shard++) {
+    threads.emplace_back([&servers, shard] { servers[shard]->run(); });
+    pinToCore(threads.back(), shard);
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+uint16_t ShardSet::keyHashSlot(std::string_view key) {
+  // Only the part between the first '{' and the next '}' is hashed, so
+  // "{user1}.name" and "{user1}.mail" land on the same shard.
+  size_t open = key.find('{');
+  if (open != std::string_view::npos) {
+    size_t close = key.find('}', open + 1);
+    if (close != std::string_view::npos && close != open + 1) {
+      key = key.substr(open + 1, close - open - 1);
+    }
+  }
+  return crc16(key) & (kHashSlots - 1);
+}
+
+size_t ShardSet::route(const CommandSpec& spec,
+                       std::span<const std::string_view> argv) const {
+  if (spec.flags & kCmdAllShards) {
+    return kAllShards;
+  }
+  if (spec.flags & kCmdShardCursor) {
+    // A malformed cursor gets its error locally.
+    uint64_t cursor;
+    if (argv.size() < 2 || !parseUint64(argv[1], cursor) ||
+        cursorShard(cursor) >= count_) {
+      return kLocal;
+    }
+    return cursorShard(cursor);
+  }
+  if (spec.findKeys != nullptr) {
+    size_t target = kLocal;
+    for (std::string_view key : spec.findKeys(argv)) {
+      size_t shard = shardOf(key);
+      if (target == kLocal) {
+        target = shard;
+      } else if (target != shard) {
+        return kCrossShard;
+      }
+    }
+    return target;
+  }
+  if (spec.firstKey <= 0) {
+    return kLocal;
+  }
+
+  int argc = static_cast<int>(argv.size());
+  int last = spec.lastKey < 0 ? argc + spec.lastKey : spec.lastKey;
+  int step = std::max(spec.keyStep, 1);
+  size_t target = kLocal;
+  for (int i = spec.firstKey; i <= last && i < argc; i += step) {
+    size_t shard = shardOf(argv[i]);
+    if (target == kLocal) {
+      target = shard;
+    } else if (target != shard) {
+      return kCrossShard;
+    }
+  }
+  return target;
+}
+
+void ShardSet::notify(size_t shard) {
+  uint64_t one = 1;
+  // EAGAIN means the counter is saturated, so the shard is awake anyway.
+  ssize_t written = write(eventFds_[shard], &one, sizeof(one));
+  (void)written;
+}
+
+void ShardSet::mergeReplies(const std::vector<std::string>& replies,
+                            ReplyBuffer& out) {
+  bool arrays = true;
+  bool integers = true;
+  for (const std::string& reply : replies) {
+    if (reply.empty() || reply[0] == '-') {
+      out.appendRaw(reply);
+      return;
+    }
+    arrays = arrays && reply[0] == '*';
+    integers = integers && reply[0] == ':';
+  }
+
+  if (arrays) {
+    int64_t total = 0;
+    for (const std::string& reply : replies) {
+      size_t end = reply.find("\r\n");
+      int64_t count = 0;
+      parseInt64(std::string_view(reply).substr(1, end - 1), count);
+      total += std::max<int64_t>(count, 0);
+    }
+    out.appendArrayHeader(total);
+    for (const std::string& reply : replies) {
+      out.appendRaw(std::string_view(reply).substr(reply.find("\r\n") + 2));
+    }
+  } else if (integers) {
+    int64_t total = 0;
+    for (const std::string& reply : replies) {
+      int64_t value = 0;
+      parseInt64(std::string_view(reply).substr(1, reply.size() - 3), value);
+      total += value;
+    }
+    out.appendInteger(total);
+  } else {
+    out.appendRaw(replies.front());
+  }
+}
+
+}  // namespace redis
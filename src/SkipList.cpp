@@ -0,0 +1,259 @@
+#include "redis/SkipList.h"
+
+#include <cstring>
+#include <new>
+
+namespace redis {
+
+namespace {
+
+// Whether node sorts before (score, member).
+bool before(const SkipList::Node* node, double score,
+            std::string_view member) {
+  return node->score() < score ||
+         (node->score() == score && node->member() < member);
+}
+
+}  // namespace
+
+SkipList::SkipList() : head_(createNode(kMaxLevel, 0, {})) {
+  bytes_ = nodeSize(kMaxLevel, 0);
+}
+
+SkipList::~SkipList() {
+  Node* node = head_;
+  while (node != nullptr) {
+    Node* next = node->next();
+    ::operator delete(node);
+    node = next;
+  }
+}
+
+size_t SkipList::nodeSize(int level, size_t memberLength) {
+  return sizeof(Node) + level * sizeof(Node::Level) + memberLength;
+}
+
+SkipList::Node* SkipList::createNode(int level, double score,
+                                     std::string_view member) {
+  Node* node = new (::operator new(nodeSize(level, member.size()))) Node;
+  node->score_ = score;
+  node->backward_ = nullptr;
+  node->memberLength_ = static_cast<uint32_t>(member.size());
+  node->level_ = static_cast<uint8_t>(level);
+  for (int i = 0; i < level; i++) {
+    node->levels()[i] = {nullptr, 0};
+  }
+  std::memcpy(node->levels() + level, member.data(), member.size());
+  return node;
+}
+
+// Each level holds a quarter of the nodes of the one below, as in Redis.
+int SkipList::randomLevel() {
+  // xorshift64*: the level only needs to be unpredictable enough to keep
+  // the list balanced.
+  thread_local uint64_t state = 0x9E3779B97F4A7C15ull;
+  state ^= state >> 12;
+  state ^= state << 25;
+  state ^= state >> 27;
+  uint64_t bits = state * 0x2545F4914F6CDD1Dull;
+
+  int level = 1;
+  while ((bits & 3) == 0 && level < kMaxLevel) {
+    level++;
+    bits >>= 2;
+  }
+  return level;
+}
+
+void SkipList::findPredecessors(double score, std::string_view member,
+                                Node** update, size_t* rank) const {
+  Node* node = head_;
+  for (int i = level_ - 1; i >= 0; i--) {
+    rank[i] = i == level_ - 1 ? 0 : rank[i + 1];
+    while (node->levels()[i].forward != nullptr &&
+           before(node->levels()[i].forward, score, member)) {
+      rank[i] += node->levels()[i].span;
+      node = node->levels()[i].forward;
+    }
+    update[i] = node;
+  }
+}
+
+void SkipList::link(Node* node, Node** update, const size_t* rank) {
+  int level = node->level_;
+  for (int i = 0; i < level; i++) {
+    Node::Level& prev = update[i]->levels()[i];
+    node->levels()[i].forward = prev.forward;
+    node->levels()[i].span = prev.span - (rank[0] - rank[i]);
+    prev.forward = node;
+    prev.span = rank[0] - rank[i] + 1;
+  }
+  // Links above the node now skip one more.
+  for (int i = level; i < level_; i++) {
+    update[i]->levels()[i].span++;
+  }
+
+  node->backward_ = update[0] == head_ ? nullptr : update[0];
+  if (Node* next = node->next()) {
+    next->backward_ = node;
+  } else {
+    tail_ = node;
+  }
+  length_++;
+}
+
+void SkipList::unlink(Node* node, Node** update) {
+  for (int i = 0; i < level_; i++) {
+    Node::Level& prev = update[i]->levels()[i];
+    if (prev.forward == node) {
+      prev.span += node->levels()[i].span - 1;
+      prev.forward = node->levels()[i].forward;
+    } else {
+      prev.span--;
+    }
+  }
+  if (Node* next = node->next()) {
+    next->backward_ = node->backward_;
+  } else {
+    tail_ = node->backward_;
+  }
+  while (level_ > 1 && head_->levels()[level_ - 1].forward == nullptr) {
+    level_--;
+  }
+  length_--;
+}
+
+SkipList::Node* SkipList::insert(double score, std::string_view member) {
+  Node* update[kMaxLevel];
+  size_t rank[kMaxLevel];
+  findPredecessors(score, member, update, rank);
+
+  int level = randomLevel();
+  for (int i = level_; i < level; i++) {
+    rank[i] = 0;
+    update[i] = head_;
+    head_->levels()[i].span = length_;
+  }
+  if (level > level_) {
+    level_ = level;
+  }
+
+  Node* node = createNode(level, score, member);
+  bytes_ += nodeSize(level, member.size());
+  link(node, update, rank);
+  return node;
+}
+
+bool SkipList::erase(double score, std::string_view member) {
+  Node* update[kMaxLevel];
+  size_t rank[kMaxLevel];
+  findPredecessors(score, member, update, rank);
+
+  Node* node = update[0]->next();
+  if (node == nullptr || node->score() != score || node->member() != member) {
+    return false;
+  }
+  unlink(node, update);
+  bytes_ -= nodeSize(node->level_, node->memberLength_);
+  ::operator delete(node);
+  return true;
+}
+
+void SkipList::updateScore(Node* node, double newScore) {
+  // Still between its neighbours: the order is unchanged.
+  Node* prev = node->prev();
+  Node* next = node->next();
+  if ((prev == nullptr || prev->score() < newScore) &&
+      (next == nullptr || next->score() > newScore)) {
+    node->score_ = newScore;
+    return;
+  }
+
+  Node* update[kMaxLevel];
+  size_t rank[kMaxLevel];
+  findPredecessors(node->score(), node->member(), update, rank);
+  unlink(node, update);
+
+  node->score_ = newScore;
+  findPredecessors(newScore, node->member(), update, rank);
+  // Unlinking may have lowered the list below the node's own height.
+  for (int i = level_; i < node->level_; i++) {
+    rank[i] = 0;
+    update[i] = head_;
+    head_->levels()[i].span = length_;
+  }
+  if (node->level_ > level_) {
+    level_ = node->level_;
+  }
+  link(node, update, rank);
+}
+
+size_t SkipList::rank(double score, std::string_view member) const {
+  const Node* node = head_;
+  size_t rank = 0;
+  for (int i = level_ - 1; i >= 0; i--) {
+    while (true) {
+      const Node* next = node->levels()[i].forward;
+      if (next == nullptr ||
+          !(before(next, score, member) ||
+            (next->score() == score && next->member() == member))) {
+        break;
+      }
+      rank += node->levels()[i].span;
+      node = next;
+    }
+    if (node != head_ && node->member() == member) {
+      return rank;
+    }
+  }
+  return 0;
+}
+
+SkipList::Node* SkipList::byRank(size_t rank) const {
+  Node* node = head_;
+  size_t traversed = 0;
+  for (int i = level_ - 1; i >= 0; i--) {
+    while (node->levels()[i].forward != nullptr &&
+           traversed + node->levels()[i].span <= rank) {
+      traversed += node->levels()[i].span;
+      node = node->levels()[i].forward;
+    }
+    if (traversed == rank) {
+      return node == head_ ? nullptr : node;
+    }
+  }
+  return nullptr;
+}
+
+SkipList::Node* SkipList::firstInRange(const ScoreRange& range) const {
+  if (range.isEmpty() || tail_ == nullptr || !range.aboveMin(tail_->score())) {
+    return nullptr;
+  }
+  Node* node = head_;
+  for (int i = level_ - 1; i >= 0; i--) {
+    while (node->levels()[i].forward != nullptr &&
+           !range.aboveMin(node->levels()[i].forward->score())) {
+      node = node->levels()[i].forward;
+    }
+  }
+  node = node->next();
+  return range.belowMax(node->score()) ? node : nullptr;
+}
+
+SkipList::Node* SkipList::lastInRange(const ScoreRange& range) const {
+  Node* first = this->first();
+  if (range.isEmpty() || first == nullptr ||
+      !range.belowMax(first->score())) {
+    return nullptr;
+  }
+  Node* node = head_;
+  for (int i = level_ - 1; i >= 0; i--) {
+    while (node->levels()[i].forward != nullptr &&
+           range.belowMax(node->levels()[i].forward->score())) {
+      node = node->levels()[i].forward;
+    }
+  }
+  return range.aboveMin(node->score()) ? node : nullptr;
+}
+
+}  // namespace redis
@@ -0,0 +1,287 @@
+#include "redis/SlabAllocator.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <new>
+
+namespace redis {
+
+namespace {
+
+constexpr size_t kChunkBytes = 4 * 1024 * 1024;
+
+// Objects start a cache line in, after the slab's header.
+constexpr size_t kSlabHeaderBytes = 64;
+
+// Partial slabs compared when the current one fills up.
+constexpr size_t kPartialScan = 16;
+
+thread_local SlabAllocator* tlsAllocator = nullptr;
+
+}  // namespace
+
+struct SlabAllocator::Slab {
+  SlabAllocator* owner;
+  Slab* prev;
+  Slab* next;
+  // Freed objects, linked through their first word.
+  void* freeList;
+  // Objects past this point have never been handed out.
+  char* unused;
+  uint32_t objectSize;
+  uint32_t sizeClass;
+  uint32_t used;
+  uint32_t capacity;
+};
+
+SlabAllocator& SlabAllocator::local() {
+  if (tlsAllocator == nullptr) {
+    tlsAllocator = new SlabAllocator;
+  }
+  return *tlsAllocator;
+}
+
+size_t SlabAllocator::classOf(size_t size) {
+  if (size <= 256) {
+    return (size - 1) / 16;
+  }
+  if (size <= 512) {
+    return 16 + (size - 257) / 32;
+  }
+  return 24 + (size - 513) / 64;
+}
+
+size_t SlabAllocator::classSize(size_t index) {
+  if (index < 16) {
+    return (index + 1) * 16;
+  }
+  if (index < 24) {
+    return 256 + (index - 15) * 32;
+  }
+  return 512 + (index - 23) * 64;
+}
+
+SlabAllocator::Slab* SlabAllocator::slabOf(const void* p) {
+  return reinterpret_cast<Slab*>(reinterpret_cast<uintptr_t>(p) &
+                                 ~uintptr_t{kSlabBytes - 1});
+}
+
+void* SlabAllocator::allocate(size_t size) {
+  if (size > kMaxObjectBytes) {
+    return ::operator new(size);
+  }
+  if (remoteFrees_.load(std::memory_order_relaxed) != nullptr) {
+    reclaimRemoteFrees();
+  }
+
+  size_t index = classOf(size);
+  SizeClass& cls = classes_[index];
+  Slab* slab = cls.current;
+  if (slab == nullptr || slab->used == slab->capacity) {
+    slab = cls.current = nextSlab(index);
+  }
+
+  void* p;
+  if (slab->freeList != nullptr) {
+    p = slab->freeList;
+    slab->freeList = *static_cast<void**>(p);
+  } else {
+    p = slab->unused;
+    slab->unused += slab->objectSize;
+  }
+  slab->used++;
+  cls.used++;
+  return p;
+}
+
+void SlabAllocator::deallocate(void* p, size_t size) {
+  if (size > kMaxObjectBytes) {
+    ::operator delete(p);
+    return;
+  }
+  Slab* slab = slabOf(p);
+  SlabAllocator* owner = slab->owner;
+  if (owner == tlsAllocator) {
+    owner->freeLocal(slab, p);
+    return;
+  }
+  void* head = owner->remoteFrees_.load(std::memory_order_relaxed);
+  do {
+    *static_cast<void**>(p) = head;
+  } while (!owner->remoteFrees_.compare_exchange_weak(
+      head, p, std::memory_order_release, std::memory_order_relaxed));
+}
+
+void SlabAllocator::reclaimRemoteFrees() {
+  void* p = remoteFrees_.exchange(nullptr, std::memory_order_acquire);
+  while (p != nullptr) {
+    void* next = *static_cast<void**>(p);
+    freeLocal(slabOf(p), p);
+    p = next;
+  }
+}
+
+void SlabAllocator::freeLocal(Slab* slab, void* p) {
+  SizeClass& cls = classes_[slab->sizeClass];
+  bool wasFull = slab->used == slab->capacity;
+  *static_cast<void**>(p) = slab->freeList;
+  slab->freeList = p;
+  slab->used--;
+  cls.used--;
+
+  if (slab == cls.current) {
+    return;
+  }
+  // A full slab is on no list; any other that is not current is partial.
+  if (slab->used == 0) {
+    if (!wasFull) {
+      unlinkPartial(cls, slab);
+    }
+    cls.slabs--;
+    releaseSlab(slab);
+  } else if (wasFull) {
+    linkPartial(cls, slab);
+  }
+}
+
+SlabAllocator::Slab* SlabAllocator::nextSlab(size_t index) {
+  SizeClass& cls = classes_[index];
+  // The fullest of the first few partial slabs, so the emptier ones are
+  // left to drain.
+  Slab* best = nullptr;
+  size_t scanned = 0;
+  for (Slab* slab = cls.partial; slab != nullptr && scanned < kPartialScan;
+       slab = slab->next, scanned++) {
+    if (best == nullptr || slab->used > best->used) {
+      best = slab;
+    }
+  }
+  if (best != nullptr) {
+    unlinkPartial(cls, best);
+    return best;
+  }
+  cls.slabs++;
+  return newSlab(index);
+}
+
+SlabAllocator::Slab* SlabAllocator::newSlab(size_t index) {
+  static_assert(sizeof(Slab) <= kSlabHeaderBytes);
+  char* memory;
+  if (!freeSlabs_.empty()) {
+    memory = reinterpret_cast<char*>(freeSlabs_.back());
+    freeSlabs_.pop_back();
+  } else {
+    if (chunkNext_ == chunkEnd_) {
+      // Over-map by a slab so the chunk can start on a slab boundary.
+      size_t mapped = kChunkBytes + kSlabBytes;
+      void* region = mmap(nullptr, mapped, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (region == MAP_FAILED) {
+        throw std::bad_alloc();
+      }
+      char* start = static_cast<char*>(region);
+      char* aligned = reinterpret_cast<char*>(
+          (reinterpret_cast<uintptr_t>(start) + kSlabBytes - 1) &
+          ~uintptr_t{kSlabBytes - 1});
+      if (aligned != start) {
+        munmap(start, aligned - start);
+      }
+      char* end = aligned + kChunkBytes;
+      if (end != start + mapped) {
+        munmap(end, start + mapped - end);
+      }
+      chunkNext_ = aligned;
+      chunkEnd_ = end;
+    }
+    memory = chunkNext_;
+    chunkNext_ += kSlabBytes;
+  }
+
+  Slab* slab = new (memory) Slab;
+  size_t objectSize = classSize(index);
+  slab->owner = this;
+  slab->prev = nullptr;
+  slab->next = nullptr;
+  slab->freeList = nullptr;
+  slab->unused = memory + kSlabHeaderBytes;
+  slab->objectSize = static_cast<uint32_t>(objectSize);
+  slab->sizeClass = static_cast<uint32_t>(index);
+  slab->used = 0;
+  slab->capacity =
+      static_cast<uint32_t>((kSlabBytes - kSlabHeaderBytes) / objectSize);
+  return slab;
+}
+
+void SlabAllocator::releaseSlab(Slab* slab) {
+  // The pages read back as zeros when the slab is reused.
+  madvise(slab, kSlabBytes, MADV_DONTNEED);
+  freeSlabs_.push_back(slab);
+}
+
+void SlabAllocator::linkPartial(SizeClass& cls, Slab* slab) {
+  slab->prev = nullptr;
+  slab->next = cls.partial;
+  if (cls.partial != nullptr) {
+    cls.partial->prev = slab;
+  }
+  cls.partial = slab;
+}
+
+void SlabAllocator::unlinkPartial(SizeClass& cls, Slab* slab) {
+  if (slab->prev != nullptr) {
+    slab->prev->next = slab->next;
+  } else {
+    cls.partial = slab->next;
+  }
+  if (slab->next != nullptr) {
+    slab->next->prev = slab->prev;
+  }
+  slab->prev = nullptr;
+  slab->next = nullptr;
+}
+
+bool SlabAllocator::shouldMove(const void* p, size_t size) const {
+  if (size > kMaxObjectBytes) {
+    return false;
+  }
+  const Slab* slab = slabOf(p);
+  if (slab->owner != this) {
+    return true;
+  }
+  const SizeClass& cls = classes_[slab->sizeClass];
+  if (slab == cls.current) {
+    return false;
+  }
+  // Below the average use of the class's slabs.
+  return slab->used * cls.slabs < cls.used;
+}
+
+SlabAllocator::Stats SlabAllocator::stats() const {
+  Stats stats;
+  for (size_t i = 0; i < kClasses; i++) {
+    stats.allocated += classes_[i].used * classSize(i);
+    stats.active += classes_[i].slabs * kSlabBytes;
+  }
+  return stats;
+}
+
+size_t residentMemory() {
+  FILE* file = std::fopen("/proc/self/statm", "r");
+  if (file == nullptr) {
+    return 0;
+  }
+  unsigned long long pages = 0;
+  unsigned long long resident = 0;
+  int fields = std::fscanf(file, "%llu %llu", &pages, &resident);
+  std::fclose(file);
+  if (fields != 2) {
+    return 0;
+  }
+  return static_cast<size_t>(resident) *
+         static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+}  // namespace redis
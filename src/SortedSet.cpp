@@ -0,0 +1,255 @@
+#include "redis/SortedSet.h"
+
+#include "redis/Entry.h"
+#include "redis/Listpack.h"
+#include "redis/StringUtil.h"
+
+namespace redis {
+
+namespace {
+
+// Scores are stored as text in the listpack, in the form they reply with.
+double scoreAt(const Listpack& listpack, size_t pos) {
+  double score = 0;
+  parseDouble(listpack.get(pos), score);
+  return score;
+}
+
+// The member of the last pair.
+size_t lastMember(const Listpack& listpack) {
+  return listpack.prev(listpack.prev(listpack.end()));
+}
+
+void insertSorted(Listpack& listpack, std::string_view member,
+                  double score) {
+  size_t pos = listpack.begin();
+  while (pos < listpack.end()) {
+    size_t scorePos = listpack.next(pos);
+    double current = scoreAt(listpack, scorePos);
+    if (current > score ||
+        (current == score && listpack.get(pos) > member)) {
+      break;
+    }
+    pos = listpack.next(scorePos);
+  }
+  char text[kMaxDoubleChars];
+  listpack.insert(pos, member);
+  listpack.insert(listpack.next(pos), formatDouble(score, text));
+}
+
+}  // namespace
+
+size_t SkipListSet::memoryUsage() const {
+  // A slot and its control byte per dictionary bucket.
+  return sizeof(SkipListSet) + list_.nodeBytes() +
+         members_.capacity() * (sizeof(SkipList::Node*) + 1);
+}
+
+const SkipList::Node* SkipListSet::find(std::string_view member) const {
+  SkipList::Node* const* slot = members_.find(member);
+  return slot ? *slot : nullptr;
+}
+
+bool SkipListSet::set(std::string_view member, double score) {
+  auto [slot, inserted] = members_.findOrInsert(
+      member, [&] { return list_.insert(score, member); });
+  if (!inserted && (*slot)->score() != score) {
+    list_.updateScore(*slot, score);
+  }
+  return inserted;
+}
+
+bool SkipListSet::remove(std::string_view member) {
+  SkipList::Node* node = nullptr;
+  if (!members_.extract(member, node)) {
+    return false;
+  }
+  list_.erase(node->score(), member);
+  return true;
+}
+
+size_t SortedSet::size() const {
+  if (entry_->encoding() == Encoding::Listpack) {
+    return entry_->listpackValue().size() / 2;
+  }
+  return entry_->skipListValue().size();
+}
+
+std::optional<double> SortedSet::score(std::string_view member) const {
+  if (entry_->encoding() == Encoding::Listpack) {
+    const Listpack& listpack = entry_->listpackValue();
+    size_t pos = listpack.find(listpack.begin(), member, 1);
+    if (pos == listpack.end()) {
+      return std::nullopt;
+    }
+    return scoreAt(listpack, listpack.next(pos));
+  }
+  const SkipList::Node* node = entry_->skipListValue().find(member);
+  if (node == nullptr) {
+    return std::nullopt;
+  }
+  return node->score();
+}
+
+bool SortedSet::set(std::string_view member, double score) {
+  if (entry_->encoding() != Encoding::Listpack) {
+    return entry_->skipListValue().set(member, score);
+  }
+
+  Listpack& listpack = entry_->listpackValue();
+  size_t pos = listpack.find(listpack.begin(), member, 1);
+  bool added = pos == listpack.end();
+  if (!added) {
+    if (scoreAt(listpack, listpack.next(pos)) == score) {
+      return false;
+    }
+    listpack.erase(pos, 2);
+  } else if (member.size() > limits_->maxListpackValue ||
+             size() >= limits_->maxListpackEntries) {
+    return convertToSkipList().set(member, score);
+  }
+  insertSorted(listpack, member, score);
+  return added;
+}
+
+bool SortedSet::remove(std::string_view member) {
+  if (entry_->encoding() != Encoding::Listpack) {
+    return entry_->skipListValue().remove(member);
+  }
+  Listpack& listpack = entry_->listpackValue();
+  size_t pos = listpack.find(listpack.begin(), member, 1);
+  if (pos == listpack.end()) {
+    return false;
+  }
+  listpack.erase(pos, 2);
+  return true;
+}
+
+std::optional<size_t> SortedSet::rank(std::string_view member,
+                                      bool reverse) const {
+  size_t rank = 0;
+  if (entry_->encoding() == Encoding::Listpack) {
+    const Listpack& listpack = entry_->listpackValue();
+    size_t pos = listpack.begin();
+    while (pos < listpack.end() && listpack.get(pos) != member) {
+      pos = listpack.next(listpack.next(pos));
+      rank++;
+    }
+    if (pos == listpack.end()) {
+      return std::nullopt;
+    }
+  } else {
+    const SkipListSet& set = entry_->skipListValue();
+    const SkipList::Node* node = set.find(member);
+    if (node == nullptr) {
+      return std::nullopt;
+    }
+    rank = set.list().rank(node->score(), member) - 1;
+  }
+  return reverse ? size() - 1 - rank : rank;
+}
+
+void SortedSet::forRankRange(size_t start, size_t stop, bool reverse,
+                             const ScoredMemberVisitor& visit) const {
+  size_t count = stop - start + 1;
+  if (entry_->encoding() == Encoding::Listpack) {
+    const Listpack& listpack = entry_->listpackValue();
+    if (reverse) {
+      size_t pos = lastMember(listpack);
+      for (size_t i = 0; i < start; i++) {
+        pos = listpack.prev(listpack.prev(pos));
+      }
+      for (size_t i = 0; i < count; i++) {
+        visit(listpack.get(pos), scoreAt(listpack, listpack.next(pos)));
+        if (pos > listpack.begin()) {
+          pos = listpack.prev(listpack.prev(pos));
+        }
+      }
+      return;
+    }
+    size_t pos = listpack.begin();
+    for (size_t i = 0; i < start; i++) {
+      pos = listpack.next(listpack.next(pos));
+    }
+    for (size_t i = 0; i < count; i++) {
+      size_t scorePos = listpack.next(pos);
+      visit(listpack.get(pos), scoreAt(listpack, scorePos));
+      pos = listpack.next(scorePos);
+    }
+    return;
+  }
+
+  // The descent finds the first node in O(log n); the rest is a walk.
+  const SkipList& list = entry_->skipListValue().list();
+  const SkipList::Node* node =
+      list.byRank(reverse ? list.size() - start : start + 1);
+  for (size_t i = 0; i < count; i++) {
+    visit(node->member(), node->score());
+    node = reverse ? node->prev() : node->next();
+  }
+}
+
+void SortedSet::forScoreRange(const ScoreRange& range, bool reverse,
+                              size_t offset, size_t count,
+                              const ScoredMemberVisitor& visit) const {
+  if (range.isEmpty() || count == 0) {
+    return;
+  }
+
+  if (entry_->encoding() == Encoding::Listpack) {
+    const Listpack& listpack = entry_->listpackValue();
+    if (listpack.empty()) {
+      return;
+    }
+    size_t pos = reverse ? lastMember(listpack) : listpack.begin();
+    while (true) {
+      size_t scorePos = listpack.next(pos);
+      double score = scoreAt(listpack, scorePos);
+      if (reverse ? !range.aboveMin(score) : !range.belowMax(score)) {
+        return;
+      }
+      if (reverse ? range.belowMax(score) : range.aboveMin(score)) {
+        if (offset > 0) {
+          offset--;
+        } else {
+          visit(listpack.get(pos), score);
+          if (--count == 0) return;
+        }
+      }
+      if (reverse) {
+        if (pos == listpack.begin()) return;
+        pos = listpack.prev(listpack.prev(pos));
+      } else {
+        pos = listpack.next(scorePos);
+        if (pos == listpack.end()) return;
+      }
+    }
+  }
+
+  const SkipList& list = entry_->skipListValue().list();
+  const SkipList::Node* node =
+      reverse ? list.lastInRange(range) : list.firstInRange(range);
+  auto inRange = [&](const SkipList::Node* node) {
+    return node != nullptr && (reverse ? range.aboveMin(node->score())
+                                       : range.belowMax(node->score()));
+  };
+  for (; offset > 0 && inRange(node); offset--) {
+    node = reverse ? node->prev() : node->next();
+  }
+  for (; count > 0 && inRange(node); count--) {
+    visit(node->member(), node->score());
+    node = reverse ? node->prev() : node->next();
+  }
+}
+
+SkipListSet& SortedSet::convertToSkipList() {
+  auto set = std::make_unique<SkipListSet>();
+  forRankRange(0, size() - 1, false,
+               [&set](std::string_view member, double score) {
+                 set->set(member, score);
+               });
+  entry_->convertToSkipList(std::move(set));
+  return entry_->skipListValue();
+}
+
+}  // namespace redis
@@ -1,65 +1,886 @@
 #include "redis/Storage.h"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+#include "redis/LazyFree.h"
+#include "redis/Quicklist.h"
+#include "redis/SlabAllocator.h"
+#include "redis/StringUtil.h"
+
 namespace redis {
 
-void Storage::set(const std::string& key, const std::string& value) {
-  std::lock_guard<std::mutex> lock(mutex_);
-  data_[key] = ValueWithExpiry(value);
+namespace {
+
+// Groups moved per rehash step before the time budget is checked again.
+constexpr size_t kRehashBatchGroups = 100;
+
+// Active expiry tuning, after Redis's activeExpireCycle defaults.
+constexpr size_t kExpireKeysPerLoop = 20;
+constexpr size_t kExpireGroupsPerKey = 20;
+constexpr double kExpireAcceptableStalePerc = 10.0;
+
+// Keys prefetched together by the batch operations: enough to hide memory
+// latency, few enough that the lines are still cached when probed.
+constexpr size_t kBatchWindow = 16;
+
+// Entries at least this large are freed on the lazyfree thread when the
+// removal allows it. Above glibc's default mmap threshold, so these are
+// the frees that unmap memory rather than return it to a free list.
+constexpr size_t kLazyFreeMinBytes = 256 * 1024;
+
+// Eviction tuning, after Redis's maxmemory-samples and
+// maxmemory-eviction-tenacity defaults.
+constexpr size_t kEvictionSamples = 5;
+constexpr size_t kEvictionMaxGroups = 64;
+constexpr size_t kEvictionMaxRounds = 16;
+constexpr std::chrono::microseconds kEvictionTimeLimit(500);
+
+// Entries handed out for writing before they are measured regardless.
+constexpr size_t kMaxPendingEntries = 1024;
+
+// Active defrag thresholds, as Redis's active-defrag-threshold-lower and
+// -upper: slab bytes beyond what the objects need, in percent of the
+// latter.
+constexpr double kDefragThresholdLower = 10;
+constexpr double kDefragThresholdUpper = 100;
+
+// Groups scanned per defrag step before the time budget is checked again.
+constexpr size_t kDefragBatchGroups = 16;
+
+std::atomic<size_t>& processMemory() {
+  static std::atomic<size_t> bytes{0};
+  return bytes;
+}
+
+int64_t nowMs() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// The deadline of a TTL, saturating rather than overflowing.
+int64_t expireAt(int64_t expiryMs) {
+  int64_t deadline;
+  if (__builtin_add_overflow(nowMs(), expiryMs, &deadline)) {
+    return std::numeric_limits<int64_t>::max();
+  }
+  return deadline;
+}
+
+}  // namespace
+
+Storage::~Storage() {
+  processMemory().fetch_sub(publishedMemory_, std::memory_order_relaxed);
+}
+
+void Storage::store(Entry* entry) {
+  int64_t now = nowMs();
+  entry->setAccess(evictionPolicy_ == EvictionPolicy::AllKeysLfu
+                       ? access::lfuInitial(now)
+                       : access::lruClock(now));
+  entriesBytes_ += entry->memoryUsage();
+
+  EntryPtr owned(entry);
+  auto [slot, inserted] = data_.findOrInsert(
+      owned->key(), [&owned] { return EntryPtr(std::move(owned)); });
+
+  bool indexed = false;
+  if (!inserted) {
+    untrack(**slot);
+    // An overwrite is one more access to the key, not a new key.
+    if (evictionPolicy_ == EvictionPolicy::AllKeysLfu) {
+      entry->setAccess((*slot)->access());
+      touch(entry, now);
+    }
+    // The expires index points at the old entry, so it must be updated
+    // while that entry is still alive.
+    if ((*slot)->hasExpiry()) {
+      if (entry->hasExpiry()) {
+        *expires_.find(entry->key()) = entry;
+        indexed = true;
+      } else {
+        expires_.erase(entry->key());
+      }
+    }
+    // Same key, so the slot stays where it is; only the entry changes.
+    *slot = std::move(owned);
+  }
+
+  if (entry->hasExpiry() && !indexed) {
+    expires_.findOrInsert(entry->key(), [entry] { return entry; });
+  }
+}
+
+bool Storage::remove(std::string_view key, bool lazy) {
+  EntryPtr* slot = data_.find(key);
+  if (slot == nullptr) {
+    return false;
+  }
+  if ((*slot)->hasExpiry()) {
+    expires_.erase(key);
+  }
+  if (untrack(**slot) >= kLazyFreeMinBytes && lazy) {
+    EntryPtr entry;
+    data_.extract(key, entry);
+    LazyFree::instance().free(std::move(entry));
+  } else {
+    data_.erase(key);
+  }
+  return true;
+}
+
+void Storage::markUnsettled(Entry* entry) {
+  if (entry->unsettled()) {
+    return;
+  }
+  // Bounds the list where no command boundary settles it, as when an RDB
+  // file is loaded. Only the entry being handed out is still written to.
+  if (pending_.size() >= kMaxPendingEntries) {
+    settle();
+  }
+  entry->setUnsettled(true);
+  pending_.push_back({entry, entry->memoryUsage()});
+}
+
+void Storage::settle() {
+  for (PendingEntry& pending : pending_) {
+    // Wraps around when the entry shrank, which the sum absorbs.
+    entriesBytes_ += pending.entry->memoryUsage() - pending.bytes;
+    pending.entry->setUnsettled(false);
+  }
+  pending_.clear();
+}
+
+size_t Storage::untrack(const Entry& entry) {
+  size_t bytes = entry.memoryUsage();
+  if (!entry.unsettled()) {
+    entriesBytes_ -= bytes;
+    return bytes;
+  }
+  auto it = std::find_if(pending_.begin(), pending_.end(),
+                         [&entry](const PendingEntry& pending) {
+                           return pending.entry == &entry;
+                         });
+  entriesBytes_ -= it->bytes;
+  *it = pending_.back();
+  pending_.pop_back();
+  return bytes;
+}
+
+void Storage::touch(Entry* entry, int64_t now) {
+  if (evictionPolicy_ == EvictionPolicy::AllKeysLfu) {
+    double random = static_cast<double>(nextRandom() >> 11) * 0x1.0p-53;
+    entry->setAccess(access::lfuTouch(entry->access(), now, random));
+    return;
+  }
+  // Most reads land in the same second as the last one; skip the store.
+  uint32_t clock = access::lruClock(now);
+  if (entry->access() != clock) {
+    entry->setAccess(clock);
+  }
+}
+
+uint64_t Storage::nextRandom() {
+  // xorshift64*: the sampling only needs to be unpredictable to a pattern
+  // of keys, not to an attacker.
+  random_ ^= random_ >> 12;
+  random_ ^= random_ << 25;
+  random_ ^= random_ >> 27;
+  return random_ * 0x2545f4914f6cdd1dull;
+}
+
+bool Storage::expire(std::string_view key) {
+  if (!remove(key, lazyFreeExpire_)) {
+    return false;
+  }
+  expireStats_.expiredKeys++;
+  return true;
+}
+
+void Storage::flush(bool lazy) {
+  expireCursor_ = 0;
+  entriesBytes_ = 0;
+  pending_.clear();
+  evictionPool_.clear();
+  if (lazy && !data_.empty()) {
+    // Detach both tables and let the lazyfree thread walk them.
+    size_t keys = data_.size();
+    LazyFree::instance().free(
+        std::make_pair(std::move(expires_), std::move(data_)), keys);
+    return;
+  }
+  expires_.clear();
+  data_.clear();
+}
+
+void Storage::set(std::string_view key, std::string_view value) {
+  store(Entry::createString(key, value, std::nullopt));
+}
+
+bool Storage::isValidExpiry(int64_t expiryMs) {
+  int64_t deadline;
+  return expiryMs > 0 && !__builtin_add_overflow(nowMs(), expiryMs, &deadline);
 }
 
-void Storage::setWithExpiry(const std::string& key, const std::string& value,
+void Storage::setWithExpiry(std::string_view key, std::string_view value,
                             int64_t expiryMs) {
-  std::lock_guard<std::mutex> lock(mutex_);
-  auto expiryTime =
-      std::chrono::steady_clock::now() + std::chrono::milliseconds(expiryMs);
-  data_[key] = ValueWithExpiry(value, expiryTime);
+  store(Entry::createString(key, value, expireAt(expiryMs)));
+}
+
+IncrStatus Storage::incrementBy(std::string_view key, int64_t delta,
+                                int64_t& value) {
+  Entry* entry = lookupEntry(key);
+  if (entry == nullptr) {
+    value = delta;
+    store(Entry::createInteger(key, delta, std::nullopt));
+    return IncrStatus::Ok;
+  }
+  if (entry->type() != ValueType::String) {
+    return IncrStatus::WrongType;
+  }
+  if (entry->encoding() != Encoding::Int) {
+    // Only a string edited in place, by SETBIT say, can hold a canonical
+    // integer without being stored as one.
+    int64_t current = 0;
+    if (entry->encoding() != Encoding::Raw ||
+        !parseCanonicalInt64(*entry->rawValue(), current)) {
+      return IncrStatus::NotNumber;
+    }
+    std::optional<int64_t> expireAtMs;
+    if (entry->hasExpiry()) {
+      expireAtMs = entry->expireAtMs();
+    }
+    entry = Entry::createInteger(key, current, expireAtMs);
+    store(entry);
+  }
+  if (__builtin_add_overflow(entry->intValue(), delta, &value)) {
+    return IncrStatus::Overflow;
+  }
+  entry->setIntValue(value);
+  return IncrStatus::Ok;
+}
+
+IncrStatus Storage::incrementByFloat(std::string_view key, long double delta,
+                                     long double& value) {
+  Entry* entry = lookupEntry(key);
+  long double current = 0;
+  std::optional<int64_t> expireAtMs;
+  if (entry != nullptr) {
+    if (entry->type() != ValueType::String) {
+      return IncrStatus::WrongType;
+    }
+    if (!parseLongDouble(StringValue(*entry).view(), current)) {
+      return IncrStatus::NotNumber;
+    }
+    if (entry->hasExpiry()) {
+      expireAtMs = entry->expireAtMs();
+    }
+  }
+  value = current + delta;
+  if (!std::isfinite(value)) {
+    return IncrStatus::Overflow;
+  }
+  char text[kMaxLongDoubleChars];
+  store(Entry::createString(key, formatLongDouble(value, text), expireAtMs));
+  return IncrStatus::Ok;
+}
+
+std::string* Storage::findMutableString(std::string_view key,
+                                       bool& wrongType) {
+  Entry* entry = lookupEntry(key);
+  wrongType = entry != nullptr && entry->type() != ValueType::String;
+  if (entry == nullptr || wrongType) {
+    return nullptr;
+  }
+  // Only the raw encoding holds a string to write to.
+  if (entry->encoding() != Encoding::Raw) {
+    std::optional<int64_t> expireAtMs;
+    if (entry->hasExpiry()) {
+      expireAtMs = entry->expireAtMs();
+    }
+    entry = Entry::createRawString(key, StringValue(*entry).view(),
+                                   expireAtMs);
+    store(entry);
+  }
+  markUnsettled(entry);
+  return &entry->mutableRawValue();
 }
 
-std::optional<std::string> Storage::get(const std::string& key) {
-  std::lock_guard<std::mutex> lock(mutex_);
+std::string& Storage::createMutableString(std::string_view key) {
+  Entry* entry = Entry::createRawString(key, {}, std::nullopt);
+  store(entry);
+  markUnsettled(entry);
+  return entry->mutableRawValue();
+}
 
-  auto it = data_.find(key);
-  if (it == data_.end()) {
+const Entry* Storage::lookup(std::string_view key) {
+  return lookupEntry(key);
+}
+
+Entry* Storage::lookupEntry(std::string_view key) {
+  EntryPtr* slot = data_.find(key);
+  if (slot == nullptr) {
+    return nullptr;
+  }
+
+  int64_t now = nowMs();
+  if ((*slot)->isExpired(now)) {
+    expire(key);
+    return nullptr;
+  }
+  touch(slot->get(), now);
+  return slot->get();
+}
+
+std::optional<std::string> Storage::get(std::string_view key) {
+  std::optional<StringValue> value = getString(key);
+  if (!value) {
+    return std::nullopt;
+  }
+  return std::string(value->view());
+}
+
+std::optional<StringValue> Storage::getString(std::string_view key) {
+  const Entry* entry = lookup(key);
+  if (entry == nullptr) {
     return std::nullopt;
   }
+  return StringValue(*entry);
+}
+
+bool Storage::contains(std::string_view key) {
+  return lookup(key) != nullptr;
+}
+
+Quicklist* Storage::findList(std::string_view key, bool& wrongType) {
+  Entry* entry = lookupEntry(key);
+  wrongType = entry != nullptr && entry->type() != ValueType::List;
+  if (entry == nullptr || wrongType) {
+    return nullptr;
+  }
+  markUnsettled(entry);
+  return &entry->listValue();
+}
 
-  if (it->second.hasExpiry) {
-    auto now = std::chrono::steady_clock::now();
-    if (now >= it->second.expiryTime) {
-      data_.erase(it);
-      return std::nullopt;
+Quicklist& Storage::createList(std::string_view key,
+                               std::optional<int64_t> expiryMs) {
+  std::optional<int64_t> expireAtMs;
+  if (expiryMs) {
+    expireAtMs = expireAt(*expiryMs);
+  }
+  Entry* entry = Entry::createList(key, expireAtMs);
+  store(entry);
+  markUnsettled(entry);
+  return entry->listValue();
+}
+
+Stream* Storage::findStream(std::string_view key, bool& wrongType) {
+  Entry* entry = lookupEntry(key);
+  wrongType = entry != nullptr && entry->type() != ValueType::Stream;
+  if (entry == nullptr || wrongType) {
+    return nullptr;
+  }
+  markUnsettled(entry);
+  return &entry->streamValue();
+}
+
+Stream& Storage::createStream(std::string_view key) {
+  Entry* entry = Entry::createStream(key, std::nullopt);
+  store(entry);
+  markUnsettled(entry);
+  return entry->streamValue();
+}
+
+std::optional<Hash> Storage::findHash(std::string_view key,
+                                     bool& wrongType) {
+  Entry* entry = lookupEntry(key);
+  wrongType = entry != nullptr && entry->type() != ValueType::Hash;
+  if (entry == nullptr || wrongType) {
+    return std::nullopt;
+  }
+  markUnsettled(entry);
+  return Hash(*entry, hashLimits_);
+}
+
+Hash Storage::createHash(std::string_view key,
+                         std::optional<int64_t> expiryMs) {
+  std::optional<int64_t> expireAtMs;
+  if (expiryMs) {
+    expireAtMs = expireAt(*expiryMs);
+  }
+  Entry* entry = Entry::createHash(key, expireAtMs);
+  store(entry);
+  markUnsettled(entry);
+  return Hash(*entry, hashLimits_);
+}
+
+std::optional<SortedSet> Storage::findSortedSet(std::string_view key,
+                                               bool& wrongType) {
+  Entry* entry = lookupEntry(key);
+  wrongType = entry != nullptr && entry->type() != ValueType::ZSet;
+  if (entry == nullptr || wrongType) {
+    return std::nullopt;
+  }
+  markUnsettled(entry);
+  return SortedSet(*entry, sortedSetLimits_);
+}
+
+SortedSet Storage::createSortedSet(std::string_view key,
+                                   std::optional<int64_t> expiryMs) {
+  std::optional<int64_t> expireAtMs;
+  if (expiryMs) {
+    expireAtMs = expireAt(*expiryMs);
+  }
+  Entry* entry = Entry::createSortedSet(key, expireAtMs);
+  store(entry);
+  markUnsettled(entry);
+  return SortedSet(*entry, sortedSetLimits_);
+}
+
+std::optional<Set> Storage::findSet(std::string_view key, bool& wrongType) {
+  Entry* entry = lookupEntry(key);
+  wrongType = entry != nullptr && entry->type() != ValueType::Set;
+  if (entry == nullptr || wrongType) {
+    return std::nullopt;
+  }
+  markUnsettled(entry);
+  return Set(*entry, setLimits_);
+}
+
+Set Storage::createSet(std::string_view key,
+                       std::optional<int64_t> expiryMs) {
+  std::optional<int64_t> expireAtMs;
+  if (expiryMs) {
+    expireAtMs = expireAt(*expiryMs);
+  }
+  Entry* entry = Entry::createSet(key, expireAtMs);
+  store(entry);
+  markUnsettled(entry);
+  return Set(*entry, setLimits_);
+}
+
+void Storage::addBlockingKey(std::string_view key) {
+  blockingKeys_[std::string(key)].waiters++;
+}
+
+void Storage::removeBlockingKey(std::string_view key) {
+  auto it = blockingKeys_.find(std::string(key));
+  if (it != blockingKeys_.end() && --it->second.waiters == 0) {
+    blockingKeys_.erase(it);
+  }
+}
+
+void Storage::signalKeyAsReady(std::string_view key) {
+  // Called on every push, so the common case of nobody blocking is one
+  // branch.
+  if (blockingKeys_.empty()) {
+    return;
+  }
+  auto it = blockingKeys_.find(std::string(key));
+  if (it != blockingKeys_.end() && !it->second.ready) {
+    it->second.ready = true;
+    readyKeys_.emplace_back(key);
+  }
+}
+
+std::vector<std::string> Storage::takeReadyKeys() {
+  for (const std::string& key : readyKeys_) {
+    auto it = blockingKeys_.find(key);
+    if (it != blockingKeys_.end()) {
+      it->second.ready = false;
     }
   }
+  return std::exchange(readyKeys_, {});
+}
+
+void Storage::getMany(std::span<const std::string_view> keys,
+                      const std::function<void(const Entry*)>& visit) {
+  int64_t now = nowMs();
+  std::array<uint64_t, kBatchWindow> hashes;
+  std::array<Entry*, kBatchWindow> entries;
+  std::array<bool, kBatchWindow> expired;
 
-  return it->second.value;
+  for (size_t start = 0; start < keys.size(); start += kBatchWindow) {
+    auto window = keys.subspan(start, std::min(kBatchWindow,
+                                               keys.size() - start));
+    for (size_t i = 0; i < window.size(); i++) {
+      hashes[i] = Keyspace::hashOf(window[i]);
+      data_.prefetch(hashes[i]);
+    }
+    // Probe, and start loading the entries themselves.
+    for (size_t i = 0; i < window.size(); i++) {
+      EntryPtr* slot = data_.find(window[i], hashes[i]);
+      entries[i] = slot ? slot->get() : nullptr;
+      if (entries[i]) __builtin_prefetch(entries[i]);
+    }
+    bool anyExpired = false;
+    for (size_t i = 0; i < window.size(); i++) {
+      expired[i] = entries[i] && entries[i]->isExpired(now);
+      anyExpired = anyExpired || expired[i];
+      if (entries[i] && !expired[i]) {
+        touch(entries[i], now);
+      }
+      visit(expired[i] ? nullptr : entries[i]);
+    }
+    // Only now, since a key repeated in the window shares its entry.
+    if (anyExpired) {
+      for (size_t i = 0; i < window.size(); i++) {
+        if (expired[i]) {
+          expire(window[i]);
+        }
+      }
+    }
+  }
 }
 
-void Storage::removeExpiredKey(const std::string& key) {
-  auto it = data_.find(key);
-  if (it != data_.end() && it->second.hasExpiry) {
-    auto now = std::chrono::steady_clock::now();
-    if (now >= it->second.expiryTime) {
-      data_.erase(it);
+void Storage::setMany(std::span<const std::string_view> keyValues) {
+  for (size_t start = 0; start < keyValues.size();
+       start += 2 * kBatchWindow) {
+    size_t end = std::min(start + 2 * kBatchWindow, keyValues.size());
+    for (size_t i = start; i < end; i += 2) {
+      data_.prefetch(Keyspace::hashOf(keyValues[i]));
+    }
+    for (size_t i = start; i + 1 < end; i += 2) {
+      set(keyValues[i], keyValues[i + 1]);
     }
   }
 }
 
-std::vector<std::string> Storage::getAllKeys() {
-  std::lock_guard<std::mutex> lock(mutex_);
-  std::vector<std::string> keys;
+size_t Storage::removeMany(std::span<const std::string_view> keys,
+                           bool lazy) {
+  int64_t now = nowMs();
+  size_t removed = 0;
+  std::array<uint64_t, kBatchWindow> hashes;
+
+  for (size_t start = 0; start < keys.size(); start += kBatchWindow) {
+    auto window = keys.subspan(start, std::min(kBatchWindow,
+                                               keys.size() - start));
+    for (size_t i = 0; i < window.size(); i++) {
+      hashes[i] = Keyspace::hashOf(window[i]);
+      data_.prefetch(hashes[i]);
+    }
+    for (size_t i = 0; i < window.size(); i++) {
+      EntryPtr* slot = data_.find(window[i], hashes[i]);
+      if (slot == nullptr) continue;
+      // An expired key counts as already gone.
+      if ((*slot)->isExpired(now)) {
+        expire(window[i]);
+      } else {
+        remove(window[i], lazy);
+        removed++;
+      }
+    }
+  }
+  return removed;
+}
 
-  auto now = std::chrono::steady_clock::now();
+void Storage::forEachKey(const std::function<void(std::string_view)>& visit) {
+  // One pass over the keyspace; expired keys are removed afterwards since
+  // the table must not change under forEach.
+  int64_t now = nowMs();
+  std::vector<const Entry*> expired;
+  data_.forEach([&](const EntryPtr& entry) {
+    if (entry->isExpired(now)) {
+      expired.push_back(entry.get());
+    } else {
+      visit(entry->key());
+    }
+  });
+  removeExpired(expired);
+}
 
-  for (auto it = data_.begin(); it != data_.end();) {
-    if (it->second.hasExpiry && now >= it->second.expiryTime) {
-      it = data_.erase(it);
+uint64_t Storage::scan(uint64_t cursor,
+                       const std::function<void(const Entry&)>& visit) {
+  int64_t now = nowMs();
+  std::vector<const Entry*> expired;
+  cursor = data_.scan(cursor, [&](const EntryPtr& entry) {
+    if (entry->isExpired(now)) {
+      expired.push_back(entry.get());
     } else {
-      keys.push_back(it->first);
-      ++it;
+      visit(*entry);
+    }
+  });
+  removeExpired(expired);
+  return cursor;
+}
+
+void Storage::removeExpired(const std::vector<const Entry*>& expired) {
+  for (const Entry* entry : expired) {
+    expire(entry->key());
+  }
+}
+
+size_t Storage::size() const {
+  return data_.size();
+}
+
+size_t Storage::expiresSize() const {
+  return expires_.size();
+}
+
+ExpireStats Storage::expireStats() const {
+  return expireStats_;
+}
+
+size_t Storage::usedMemory() {
+  settle();
+  // A slot per bucket plus its control byte.
+  return entriesBytes_ + data_.capacity() * (sizeof(EntryPtr) + 1) +
+         expires_.capacity() * (sizeof(Entry*) + 1);
+}
+
+void Storage::publishUsedMemory() {
+  size_t used = usedMemory();
+  // Wraps around when usage fell, which the sum absorbs.
+  processMemory().fetch_add(used - publishedMemory_,
+                            std::memory_order_relaxed);
+  publishedMemory_ = used;
+}
+
+size_t Storage::processUsedMemory() {
+  return processMemory().load(std::memory_order_relaxed);
+}
+
+bool Storage::performEvictions() {
+  if (maxMemory_ == 0 || usedMemory() <= maxMemory_) {
+    return true;
+  }
+  if (evictionPolicy_ == EvictionPolicy::NoEviction) {
+    return false;
+  }
+  auto deadline = std::chrono::steady_clock::now() + kEvictionTimeLimit;
+  for (size_t evicted = 1; usedMemory() > maxMemory_; evicted++) {
+    if (!evictOne()) {
+      return false;
+    }
+    if (evicted % 16 == 0 && std::chrono::steady_clock::now() >= deadline) {
+      break;
+    }
+  }
+  return true;
+}
+
+bool Storage::evictOne() {
+  bool volatileOnly = evictionPolicy_ == EvictionPolicy::VolatileTtl;
+  for (size_t round = 0; round < kEvictionMaxRounds; round++) {
+    if (volatileOnly ? expires_.empty() : data_.empty()) {
+      return false;
+    }
+    sampleForEviction();
+    while (evictionPool_.pop(evictionKey_)) {
+      // Candidates outlive their sample: the key may be gone, or no longer
+      // volatile, by now.
+      EntryPtr* slot = data_.find(evictionKey_);
+      if (slot == nullptr || (volatileOnly && !(*slot)->hasExpiry())) {
+        continue;
+      }
+      remove(evictionKey_);
+      evictedKeys_++;
+      return true;
+    }
+  }
+  return false;
+}
+
+void Storage::sampleForEviction() {
+  int64_t now = nowMs();
+  size_t sampled = 0;
+  auto offer = [&](const Entry& entry) {
+    uint64_t score = 0;
+    switch (evictionPolicy_) {
+      case EvictionPolicy::AllKeysLru:
+        score = access::lruIdleMs(entry.access(), now);
+        break;
+      case EvictionPolicy::AllKeysLfu:
+        score = 255 - access::lfuCounter(entry.access(), now);
+        break;
+      case EvictionPolicy::VolatileTtl:
+        score = UINT64_MAX - static_cast<uint64_t>(entry.expireAtMs());
+        break;
+      case EvictionPolicy::NoEviction:
+        break;
+    }
+    evictionPool_.offer(entry.key(), score);
+    sampled++;
+  };
+
+  // A few slots from a random point of the table stand in for random keys.
+  uint64_t cursor = nextRandom();
+  for (size_t groups = 0;
+       sampled < kEvictionSamples && groups < kEvictionMaxGroups; groups++) {
+    if (evictionPolicy_ == EvictionPolicy::VolatileTtl) {
+      cursor = expires_.scan(cursor, [&](Entry* entry) { offer(*entry); });
+    } else {
+      cursor = data_.scan(cursor,
+                          [&](const EntryPtr& entry) { offer(*entry); });
+    }
+  }
+}
+
+bool Storage::activeRehash(std::chrono::microseconds budget) {
+  auto deadline = std::chrono::steady_clock::now() + budget;
+  while (data_.rehashSteps(kRehashBatchGroups) |
+         expires_.rehashSteps(kRehashBatchGroups)) {
+    if (std::chrono::steady_clock::now() >= deadline) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void Storage::activeDefragCycle(std::chrono::microseconds period) {
+  SlabAllocator& allocator = SlabAllocator::local();
+  allocator.reclaimRemoteFrees();
+  if (!defragLimits_.enabled) {
+    defragStats_.running = false;
+    return;
+  }
+
+  SlabAllocator::Stats slabs = allocator.stats();
+  size_t wasted = slabs.active - slabs.allocated;
+  double fragPerc =
+      slabs.allocated ? 100.0 * wasted / slabs.allocated : 0.0;
+  if (!defragStats_.running) {
+    if (wasted < defragLimits_.ignoreBytes ||
+        fragPerc < kDefragThresholdLower) {
+      return;
+    }
+    defragStats_.running = true;
+    defragCursor_ = 0;
+  }
+
+  double scale = std::clamp((fragPerc - kDefragThresholdLower) /
+                                (kDefragThresholdUpper - kDefragThresholdLower),
+                            0.0, 1.0);
+  double percent =
+      defragLimits_.cycleMinPercent +
+      (defragLimits_.cycleMaxPercent - defragLimits_.cycleMinPercent) * scale;
+  auto deadline = std::chrono::steady_clock::now() +
+                  std::chrono::duration_cast<std::chrono::microseconds>(
+                      period * percent / 100);
+
+  // Relocation must not leave pending_ pointing at a freed entry.
+  settle();
+  size_t groups = 0;
+  do {
+    defragCursor_ = data_.scan(defragCursor_, [&](EntryPtr& slot) {
+      Entry* entry = slot.get();
+      if (!allocator.shouldMove(entry, entry->allocationSize())) {
+        defragStats_.misses++;
+        return;
+      }
+      // The expires index compares the keys of the entries it points at,
+      // so its slot is found while the old entry is still there. Only the
+      // key bytes locate either slot, and they move along.
+      Entry** indexed =
+          entry->hasExpiry() ? expires_.find(entry->key()) : nullptr;
+      Entry* moved = Entry::relocate(slot.release());
+      slot.reset(moved);
+      if (indexed != nullptr) {
+        *indexed = moved;
+      }
+      defragStats_.hits++;
+    });
+    if (defragCursor_ == 0) {
+      // A full pass; the next tick decides whether another is needed.
+      defragStats_.running = false;
+      break;
+    }
+  } while (++groups % kDefragBatchGroups != 0 ||
+           std::chrono::steady_clock::now() < deadline);
+}
+
+bool Storage::needsFastExpireCycle() const {
+  return expireTimeLimitHit_ ||
+         expireStats_.expiredStalePerc > kExpireAcceptableStalePerc;
+}
+
+void Storage::activeExpireCycle(ExpireCycle type,
+                                std::chrono::microseconds budget) {
+  auto start = std::chrono::steady_clock::now();
+  if (type == ExpireCycle::Fast) {
+    if (!expireTimeLimitHit_ &&
+        expireStats_.expiredStalePerc <= kExpireAcceptableStalePerc) {
+      return;
+    }
+    // Leave at least as much time between fast cycles as they may take.
+    if (start < lastFastExpireCycle_ + budget * 2) {
+      return;
+    }
+    lastFastExpireCycle_ = start;
+  }
+
+  auto deadline = start + budget;
+  expireTimeLimitHit_ = false;
+  if (expires_.empty()) {
+    expireStats_.avgTtlMs = 0;
+  }
+
+  int64_t now = nowMs();
+  size_t totalSampled = 0;
+  size_t totalExpired = 0;
+  std::vector<Entry*> expired;
+  expired.reserve(kExpireKeysPerLoop);
+
+  while (!expires_.empty()) {
+    size_t target = std::min(expires_.size(), kExpireKeysPerLoop);
+    size_t maxGroups = target * kExpireGroupsPerKey;
+    size_t sampled = 0;
+    size_t groups = 0;
+    int64_t ttlSum = 0;
+    size_t ttlSamples = 0;
+    expired.clear();
+
+    // Walk the index with a persistent scan cursor rather than random
+    // probes, so successive cycles cover all of it.
+    do {
+      expireCursor_ = expires_.scan(expireCursor_, [&](Entry* entry) {
+        sampled++;
+        if (entry->isExpired(now)) {
+          expired.push_back(entry);
+        } else {
+          ttlSum += entry->expireAtMs() - now;
+          ttlSamples++;
+        }
+      });
+      groups++;
+    } while (expireCursor_ != 0 && sampled < target && groups < maxGroups);
+
+    for (Entry* entry : expired) {
+      expire(entry->key());
+    }
+
+    totalSampled += sampled;
+    totalExpired += expired.size();
+
+    if (ttlSamples > 0) {
+      int64_t avgTtl = ttlSum / static_cast<int64_t>(ttlSamples);
+      int64_t& avg = expireStats_.avgTtlMs;
+      avg = avg == 0 ? avgTtl : avg / 50 * 49 + avgTtl / 50;
+    }
+
+    if (std::chrono::steady_clock::now() >= deadline) {
+      expireTimeLimitHit_ = true;
+      expireStats_.timeCapReachedCount++;
+      break;
+    }
+
+    // Another round only pays off while samples are mostly stale.
+    if (sampled == 0 || expired.size() * 100.0 <=
+                            sampled * kExpireAcceptableStalePerc) {
+      break;
     }
   }
 
-  return keys;
+  double stalePerc =
+      totalSampled ? 100.0 * totalExpired / totalSampled : 0.0;
+  expireStats_.expiredStalePerc =
+      stalePerc * 0.05 + expireStats_.expiredStalePerc * 0.95;
 }
 
-}  // namespace redis
\ No newline at end of file
+}  // namespace redis
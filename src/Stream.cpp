@@ -0,0 +1,176 @@
+#include "redis/Stream.h"
+
+#include <charconv>
+#include <vector>
+
+#include "redis/StringUtil.h"
+
+namespace redis {
+
+namespace {
+
+// Block entries hold their numbers as decimal text.
+struct NumberText {
+  explicit NumberText(uint64_t value) {
+    length = std::to_chars(text, text + sizeof(text), value).ptr - text;
+  }
+  std::string_view view() const { return std::string_view(text, length); }
+
+  char text[20];
+  size_t length;
+};
+
+uint64_t numberAt(const Listpack& listpack, size_t pos) {
+  uint64_t value = 0;
+  parseUint64(listpack.get(pos), value);
+  return value;
+}
+
+// Marks an entry whose fields are those at the start of its block.
+constexpr std::string_view kSameFields = "0";
+
+}  // namespace
+
+std::string StreamID::toString() const {
+  char text[41];
+  char* end = std::to_chars(text, text + 20, ms).ptr;
+  *end++ = '-';
+  end = std::to_chars(end, text + sizeof(text), seq).ptr;
+  return std::string(text, end - text);
+}
+
+Stream::~Stream() {
+  while (head_ != nullptr) {
+    delete std::exchange(head_, head_->next);
+  }
+}
+
+std::string Stream::radixKey(StreamID id) {
+  std::string key(16, '\0');
+  for (int i = 0; i < 8; i++) {
+    key[i] = static_cast<char>(id.ms >> (56 - 8 * i));
+    key[8 + i] = static_cast<char>(id.seq >> (56 - 8 * i));
+  }
+  return key;
+}
+
+size_t Stream::memoryUsage() const {
+  // Each block also costs a radix tree leaf of about its own size.
+  return sizeof(Stream) + blocks_ * 2 * sizeof(Block) + bytes_;
+}
+
+void Stream::append(StreamID id,
+                    std::span<const std::string_view> fieldValues) {
+  size_t fields = fieldValues.size() / 2;
+  if (tail_ == nullptr || tail_->count >= kMaxBlockEntries ||
+      tail_->entries.bytes() >= kMaxBlockBytes) {
+    Block* block = new Block;
+    block->first = id;
+    block->masterFields = fields;
+    NumberText count(fields);
+    block->entries.pushBack(count.view());
+    for (size_t i = 0; i < fields; i++) {
+      block->entries.pushBack(fieldValues[2 * i]);
+    }
+    (tail_ ? tail_->next : head_) = block;
+    tail_ = block;
+    index_.insert(radixKey(id), block);
+    blocks_++;
+    bytes_ += block->entries.bytes();
+  }
+
+  Block* block = tail_;
+  bool sameFields = fields == block->masterFields;
+  for (size_t i = 0, pos = block->entries.next(block->entries.begin());
+       sameFields && i < fields; i++, pos = block->entries.next(pos)) {
+    sameFields = block->entries.get(pos) == fieldValues[2 * i];
+  }
+
+  // The ID as deltas from the block's first: the sequence is relative only
+  // within the same millisecond.
+  uint64_t msDelta = id.ms - block->first.ms;
+  NumberText ms(msDelta);
+  NumberText seq(msDelta == 0 ? id.seq - block->first.seq : id.seq);
+  NumberText count(fields);
+
+  std::vector<std::string_view> elements;
+  elements.reserve(3 + fieldValues.size());
+  elements.push_back(ms.view());
+  elements.push_back(seq.view());
+  if (sameFields) {
+    elements.push_back(kSameFields);
+    for (size_t i = 0; i < fields; i++) {
+      elements.push_back(fieldValues[2 * i + 1]);
+    }
+  } else {
+    elements.push_back(count.view());
+    elements.insert(elements.end(), fieldValues.begin(), fieldValues.end());
+  }
+
+  size_t before = block->entries.bytes();
+  block->entries.pushBack(elements);
+  bytes_ += block->entries.bytes() - before;
+  block->count++;
+  length_++;
+  lastId_ = id;
+}
+
+void Stream::range(StreamID start, StreamID end, size_t count,
+                   const EntryVisitor& visit) const {
+  if (count == 0 || head_ == nullptr || start > end) {
+    return;
+  }
+  // The block whose first ID is the last one not above start holds start,
+  // if anything does.
+  Block* const* found = index_.floor(radixKey(start));
+  const Block* block = found ? *found : head_;
+
+  std::vector<std::string_view> fieldValues;
+  for (; block != nullptr && block->first <= end; block = block->next) {
+    const Listpack& entries = block->entries;
+    size_t pos = entries.begin();
+    std::vector<std::string_view> masterFields;
+    masterFields.reserve(block->masterFields);
+    for (size_t i = 0; i < block->masterFields; i++) {
+      pos = entries.next(pos);
+      masterFields.push_back(entries.get(pos));
+    }
+    pos = entries.next(pos);
+
+    while (pos < entries.end()) {
+      uint64_t msDelta = numberAt(entries, pos);
+      pos = entries.next(pos);
+      uint64_t seq = numberAt(entries, pos);
+      pos = entries.next(pos);
+      StreamID id{block->first.ms + msDelta,
+                  msDelta == 0 ? block->first.seq + seq : seq};
+      bool sameFields = entries.get(pos) == kSameFields;
+      size_t fields = sameFields ? block->masterFields : numberAt(entries, pos);
+      pos = entries.next(pos);
+
+      if (id > end) {
+        return;
+      }
+      fieldValues.clear();
+      for (size_t i = 0; i < fields; i++) {
+        if (sameFields) {
+          fieldValues.push_back(masterFields[i]);
+        } else {
+          fieldValues.push_back(entries.get(pos));
+          pos = entries.next(pos);
+        }
+        fieldValues.push_back(entries.get(pos));
+        pos = entries.next(pos);
+      }
+      if (id < start) {
+        continue;
+      }
+      visit(id, fieldValues);
+      if (--count == 0) {
+        return;
+      }
+    }
+  }
+}
+
+}  // namespace redis
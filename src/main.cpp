@@ -3,6 +3,7 @@
 
 #include "redis/Config.h"
 #include "redis/RedisServer.h"
+#include "redis/ShardSet.h"
 
 int main(int argc, char **argv) {
   std::cout << std::unitbuf;
@@ -11,8 +12,13 @@ int main(int argc, char **argv) {
   auto config = std::make_shared<redis::Config>();
   config->parseArgs(argc, argv);
 
-  redis::RedisServer server(config);
-  server.run();
+  if (config->getShards() > 1) {
+    redis::ShardSet shards(config, config->getShards());
+    shards.run();
+  } else {
+    redis::RedisServer server(config);
+    server.run();
+  }
 
   return 0;
 }
\ No newline at end of file